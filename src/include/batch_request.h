@@ -147,6 +147,22 @@ struct rq_manage {
 	pbs_list_head    rq_attr;	/* svrattrlist */
 };
 
+/*
+ * ModifyJobs and AsyrunJobs - one entry per job, each handled as its own
+ * ModifyJob or AsyrunJob request
+ */
+
+struct rq_jobent {
+	char	     rq_jid[PBS_MAXSVRJOBID+1];
+	pbs_list_head    rq_attr;	/* svrattrlist, ModifyJobs */
+	char	    *rq_destin;	/* exec_vnode, AsyrunJobs */
+};
+
+struct rq_jobs {
+	int		  rq_njobs;
+	struct rq_jobent *rq_jobs;
+};
+
 /* HoldJob -  plus preference flag */
 
 struct rq_hold {
@@ -319,6 +335,7 @@ struct batch_request {
 	struct batch_request * rq_parentbr;
 	/* parent request for job array request */
 	int	  rq_refct;	/* reference count - child requests     */
+	int	 *rq_jobcode;	/* where a multi-job child puts its code */
 	int	  rq_type;	/* type of request			*/
 	int	  rq_perm;	/* access permissions for the user	*/
 	int	  rq_fromsvr;	/* true if request from another server	*/
@@ -354,6 +371,7 @@ struct batch_request {
 		struct rq_relnodes	rq_relnodes;
 		struct rq_py_spawn	rq_py_spawn;
 		struct rq_manage	rq_modify;
+		struct rq_jobs		rq_jobs;
 		struct rq_move		rq_move;
 		struct rq_register	rq_register;
 		struct rq_manage	rq_release;
@@ -378,6 +396,7 @@ struct batch_request {
 
 
 extern struct batch_request *alloc_br(int type);
+extern struct batch_request *alloc_jobent_br(struct batch_request *parent, int type, int idx);
 extern void  reply_ack(struct batch_request *);
 extern void  req_reject(int code, int aux, struct batch_request *);
 extern void  req_reject_msg(int code, int aux, struct batch_request *, int istcp);
@@ -413,6 +432,7 @@ extern void  req_register(struct batch_request *req);
 extern void  req_releasejob(struct batch_request *req);
 extern void  req_rescq(struct batch_request *req);
 extern void  req_runjob(struct batch_request *req);
+extern void  req_asyrunjobs(struct batch_request *req);
 extern void  req_selectjobs(struct batch_request *req);
 extern void  req_stat_que(struct batch_request *req);
 extern void  req_stat_svr(struct batch_request *req);
@@ -443,6 +463,8 @@ extern int decode_DIS_Manage(int socket, struct batch_request *);
 extern int decode_DIS_MoveJob(int socket, struct batch_request *);
 extern int decode_DIS_MessageJob(int socket, struct batch_request *);
 extern int decode_DIS_ModifyResv(int socket, struct batch_request *);
+extern int decode_DIS_ModifyJobs(int socket, struct batch_request *);
+extern int decode_DIS_RunJobs(int socket, struct batch_request *);
 extern int decode_DIS_PySpawn(int socket, struct batch_request *);
 extern int decode_DIS_QueueJob(int socket, struct batch_request *);
 extern int decode_DIS_Register(int socket, struct batch_request *);
@@ -178,6 +178,11 @@ struct brp_rescq {            /* reply to Resource Query Request */
 	int     *brq_down;
 };
 
+struct brp_jobcodes {		/* reply to a multi-job request */
+	int	brp_njobs;	/* number of entries in brp_codes */
+	int    *brp_codes;	/* per-job reply code, in request order */
+};
+
 /*
  * the following is the basic Batch Reply structure
  */
@@ -191,6 +196,7 @@ struct brp_rescq {            /* reply to Resource Query Request */
 #define BATCH_REPLY_CHOICE_Text		7	/* text,   see brp_txt	  */
 #define BATCH_REPLY_CHOICE_Locate	8	/* locate, see brp_locate */
 #define BATCH_REPLY_CHOICE_RescQuery	9	/* Resource Query         */
+#define BATCH_REPLY_CHOICE_JobCodes	10	/* per-job codes, see brp_jobcodes */
 
 struct batch_reply {
 	int	brp_code;
@@ -207,6 +213,7 @@ struct batch_reply {
 		} brp_txt;		/* text and credential reply */
 		char	  brp_locate[PBS_MAXDEST+1];
 		struct brp_rescq brp_rescq;	/* query resource reply */
+		struct brp_jobcodes brp_jobcodes; /* multi-job request reply */
 	} brp_un;
 };
 
@@ -240,6 +247,7 @@ struct batch_reply {
 #define PBS_BATCH_StatusSvr	21
 #define PBS_BATCH_TrackJob	22
 #define PBS_BATCH_AsyrunJob	23
+#define PBS_BATCH_AsyrunJobs	94	/* many AsyrunJob in one request */
 #define PBS_BATCH_Rescq		24
 #define PBS_BATCH_ReserveResc	25
 #define PBS_BATCH_ReleaseResc	26
@@ -282,6 +290,10 @@ struct batch_reply {
 #define PBS_BATCH_RelnodesJob	90
 #define PBS_BATCH_ModifyResv	91
 #define PBS_BATCH_ResvOccurEnd	92
+#define PBS_BATCH_ModifyJobs	93
+
+/* most jobs in one ModifyJobs or AsyrunJobs request or its reply */
+#define PBS_MAX_JOBS_PER_REQ	10000
 
 #define PBS_BATCH_FileOpt_Default	0
 #define PBS_BATCH_FileOpt_OFlg		1
@@ -359,6 +371,8 @@ extern int encode_DIS_Manage(int socket, int cmd, int objt,
 extern int encode_DIS_MessageJob(int socket, char *jid, int fopt, char *m);
 extern int encode_DIS_MoveJob(int socket, char *jid, char *dest);
 extern int encode_DIS_ModifyResv(int socket, char *resv_id, struct attropl *aoplp);
+extern int encode_DIS_ModifyJobs(int socket, int njobs, char **jobids, struct attrl **attribs);
+extern int encode_DIS_RunJobs(int socket, int njobs, char **jobids, char **locations);
 extern int encode_DIS_RelnodesJob(int socket, char *jid, char *node_list);
 extern int encode_DIS_PySpawn(int socket, char *jid, char **argv, char **envp);
 extern int encode_DIS_QueueJob(int socket, char *jid,
@@ -134,6 +134,11 @@ int get_num_occurrences(char *rrule, time_t dtstart, char *tz);
  */
 time_t get_occurrence(char *, time_t, char *, int);
 
+/* Get the start times of the first count occurrences of a recurrence rule
+ * in one pass, as get_occurrence() would for indexes 1 to count
+ */
+int get_occurrences(char *, time_t, char *, int, time_t *);
+
 /*
  * Check if a recurrence rule is valid and consistent.
  * The recurrence rule is verified against a start date and checks
@@ -100,6 +100,31 @@ extern int	has_hardlimits(void *);
  */
 extern int	has_softlimits(void *);
 
+/**	@fn unsigned long long lim_fingerprint(void *p, unsigned long long fp)
+ *	@brief	fold the hard limits into a fingerprint
+ *
+ *	@param p	the limit storage
+ *	@param fp	the fingerprint so far
+ *
+ *	@return		the new fingerprint
+ *
+ *	@par MT-safe:	No
+ */
+extern unsigned long long	lim_fingerprint(void *, unsigned long long);
+
+/**	@fn int has_overall_hardlimits(void *p)
+ *	@brief	is at least one hard overall (o:PBS_ALL) limit set?
+ *
+ *	@param p	the limit storage
+ *
+ *	@return		int
+ *	@retval	1	an overall hard limit is set
+ *	@retval	0	no overall hard limit is set
+ *
+ *	@par MT-safe:	No
+ */
+extern int	has_overall_hardlimits(void *);
+
 /**	@fn int is_reslimattr(const struct attrl *a)
  *	@brief	is the given attribute a new-style resource limit attribute?
  *
@@ -564,8 +564,12 @@ DECLDIR char *__pbs_server_location(void);
 
 DECLDIR int pbs_asyrunjob(int, char *, char *, char *);
 
+DECLDIR int pbs_asyrunjobs(int, int, char **, char **, int *, char *);
+
 DECLDIR int pbs_alterjob(int, char *, struct attrl *, char *);
 
+DECLDIR int pbs_alterjobs(int, int, char **, struct attrl **, int *, char *);
+
 DECLDIR int pbs_connect(char *);
 
 DECLDIR int pbs_connect_extend(char *, char *);
@@ -655,8 +659,12 @@ extern char *__pbs_server_location(void);
 
 extern int pbs_asyrunjob(int, char *, char *, char *);
 
+extern int pbs_asyrunjobs(int, int, char **, char **, int *, char *);
+
 extern int pbs_alterjob(int, char *, struct attrl *, char *);
 
+extern int pbs_alterjobs(int, int, char **, struct attrl **, int *, char *);
+
 extern int pbs_connect(char *);
 
 extern int pbs_connect_extend(char *, char *);
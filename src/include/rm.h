@@ -51,5 +51,6 @@ int	allreq		(char *);
 char*	getreq		(int);
 int	flushreq	(void);
 int	activereq	(void);
+int	pollreq		(int);
 void	fullresp	(int);
 
@@ -259,6 +259,7 @@ extern void  req_messagejob(struct batch_request *preq);
 extern void  req_py_spawn(struct batch_request *preq);
 extern void  req_relnodesjob(struct batch_request *preq);
 extern void  req_modifyjob(struct batch_request *preq);
+extern void  req_modifyjobs(struct batch_request *preq);
 extern void  req_modifyReservation(struct batch_request *preq);
 extern void  req_orderjob(struct batch_request *req);
 extern void  req_rescreserve(struct batch_request *preq);
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+/*
+ * decode_DIS_ModifyJobs() - decode a Modify Jobs Request
+ *
+ *	This request is used for modifying the attributes of many jobs
+ *	in a single request.
+ *
+ *	The batch_request structure must already exist (be allocated by the
+ *	caller.   It is assumed that the header fields (protocol type,
+ *	protocol version, request type, and user name) have already been decoded.
+ *
+ *	Data items are:	unsigned int	number of jobs
+ *	and for each job:
+ *			string		job id
+ *			svrattrl	attributes
+ */
+
+#include <pbs_config.h>   /* the master config generated by configure */
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include "libpbs.h"
+#include "list_link.h"
+#include "server_limits.h"
+#include "attribute.h"
+#include "credential.h"
+#include "batch_request.h"
+#include "dis.h"
+
+/**
+ * @brief Read the modify request for a set of jobs.
+ *
+ * @param[in] sock - connection identifier
+ * @param[out] preq - batch_request that the information will be read into.
+ *
+ * @return 0 - on success
+ * @return PBSE_PROTOCOL - too many jobs in the request
+ * @return DIS error
+ *
+ * @par
+ *	rq_njobs only counts the entries that were started, so a partially
+ *	decoded request can be released with free_br().
+ */
+int
+decode_DIS_ModifyJobs(int sock, struct batch_request *preq)
+{
+	int rc = 0;
+	unsigned int ct;
+	unsigned int i;
+	struct rq_jobent *pent;
+
+	preq->rq_ind.rq_jobs.rq_njobs = 0;
+	preq->rq_ind.rq_jobs.rq_jobs = NULL;
+
+	ct = disrui(sock, &rc);
+	if (rc)
+		return rc;
+	if (ct == 0)
+		return 0;
+	if (ct > PBS_MAX_JOBS_PER_REQ)
+		return PBSE_PROTOCOL;
+
+	preq->rq_ind.rq_jobs.rq_jobs = (struct rq_jobent *)calloc(ct, sizeof(struct rq_jobent));
+	if (preq->rq_ind.rq_jobs.rq_jobs == NULL)
+		return DIS_NOMALLOC;
+
+	for (i = 0; i < ct; i++) {
+		pent = &preq->rq_ind.rq_jobs.rq_jobs[i];
+		CLEAR_HEAD(pent->rq_attr);
+		preq->rq_ind.rq_jobs.rq_njobs = i + 1;
+		rc = disrfst(sock, PBS_MAXSVRJOBID+1, pent->rq_jid);
+		if (rc)
+			return rc;
+		rc = decode_DIS_svrattrl(sock, &pent->rq_attr);
+		if (rc)
+			return rc;
+	}
+	return 0;
+}
@@ -237,6 +237,26 @@ decode_DIS_replyCmd(int sock, struct batch_reply *reply)
 				*(reply->brp_un.brp_rescq.brq_down+i)  = disrui(sock, &rc);
 			break;
 
+		case BATCH_REPLY_CHOICE_JobCodes:
+
+			/* Multi-job Reply, one code per job */
+
+			reply->brp_un.brp_jobcodes.brp_codes = NULL;
+			ct = disrui(sock, &rc);
+			if (rc) break;
+			if (ct > PBS_MAX_JOBS_PER_REQ)
+				return DIS_PROTO;
+			reply->brp_un.brp_jobcodes.brp_njobs = ct;
+			if (ct == 0)
+				break;
+			reply->brp_un.brp_jobcodes.brp_codes =
+				(int *)malloc(ct * sizeof(int));
+			if (reply->brp_un.brp_jobcodes.brp_codes == NULL)
+				return DIS_NOMALLOC;
+			for (i=0; (i < ct) && (rc == 0); ++i)
+				*(reply->brp_un.brp_jobcodes.brp_codes+i) = disrsi(sock, &rc);
+			break;
+
 		default:
 			return -1;
 	}
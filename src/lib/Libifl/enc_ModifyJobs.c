@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+#include <pbs_config.h>   /* the master config generated by configure */
+
+#include "libpbs.h"
+#include "pbs_error.h"
+#include "dis.h"
+
+/**
+ * @brief encode the Modify Jobs request for sending to the server.
+ *
+ *	Data items are:	unsigned int	number of jobs
+ *	and for each job:
+ *			string		job id
+ *			attrl		attributes
+ *
+ * @param[in] sock - socket descriptor for the connection.
+ * @param[in] njobs - number of entries in jobids and attribs
+ * @param[in] jobids - identifiers of the jobs to modify
+ * @param[in] attribs - list of attributes to modify for each job
+ *
+ * @return - error code while writing data to the socket.
+ */
+int
+encode_DIS_ModifyJobs(int sock, int njobs, char **jobids, struct attrl **attribs)
+{
+	int rc;
+	int i;
+
+	if ((rc = diswui(sock, njobs)) != 0)
+		return rc;
+
+	for (i = 0; i < njobs; i++) {
+		if (((rc = diswst(sock, jobids[i])) != 0) ||
+			((rc = encode_DIS_attrl(sock, attribs[i])) != 0))
+			return rc;
+	}
+
+	return 0;
+}
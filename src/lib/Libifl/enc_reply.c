@@ -201,6 +201,19 @@ encode_DIS_reply_inner(int sock, struct batch_reply *reply)
 			if (rc) return rc;
 			break;
 
+		case BATCH_REPLY_CHOICE_JobCodes:
+
+			/* Multi-job Reply, one code per job */
+
+			ct = reply->brp_un.brp_jobcodes.brp_njobs;
+			if ((rc = diswui(sock, ct)) != 0)
+				return rc;
+			for (i=0; (i<ct) && (rc == 0); ++i) {
+				rc = diswsi(sock, *(reply->brp_un.brp_jobcodes.brp_codes+i));
+			}
+			if (rc) return rc;
+			break;
+
 		default:
 			return -1;
 	}
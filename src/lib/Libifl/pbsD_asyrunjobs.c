@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+/**
+ * @file	pbsD_asyrunjobs.c
+ * @brief
+ * Send the Run Jobs request to the server --
+ * asynchronously run many jobs with one request and one reply.
+ */
+
+#include <pbs_config.h>   /* the master config generated by configure */
+
+#include <string.h>
+#include <stdio.h>
+#include "libpbs.h"
+#include "dis.h"
+#include "pbs_ecl.h"
+
+
+/**
+ * @brief
+ *	-send async run jobs batch request and read the consolidated reply.
+ *
+ * @par
+ *	Each job is handled by the server as if pbs_asyrunjob() had been
+ *	called for it.
+ *
+ * @param[in] c - connection handle
+ * @param[in] njobs - number of entries in jobids, locations and codes
+ *			(at most PBS_MAX_JOBS_PER_REQ)
+ * @param[in] jobids - job identifiers
+ * @param[in] locations - string of vnodes/resources to be allocated to each job
+ * @param[out] codes - PBS error code for each job, in request order
+ * @param[in] extend - extend string for encoding req
+ *
+ * @return      int
+ * @retval      0       the request was processed, see codes for each job
+ * @retval      !0      error, the request as a whole failed and every
+ *			entry of codes holds this error
+ *
+ */
+int
+pbs_asyrunjobs(int c, int njobs, char **jobids, char **locations, int *codes, char *extend)
+{
+	int	rc;
+	int	i;
+	struct batch_reply   *reply;
+	int	sock;
+
+	if ((njobs <= 0) || (njobs > PBS_MAX_JOBS_PER_REQ) ||
+		(jobids == NULL) || (locations == NULL) || (codes == NULL))
+		return (pbs_errno = PBSE_IVALREQ);
+	for (i = 0; i < njobs; i++) {
+		if ((jobids[i] == NULL) || (*jobids[i] == '\0'))
+			return (pbs_errno = PBSE_IVALREQ);
+	}
+
+	sock = connection[c].ch_socket;
+
+	/* initialize the thread context data, if not already initialized */
+	if (pbs_client_thread_init_thread_context() != 0)
+		return pbs_errno;
+
+	/* lock pthread mutex here for this connection */
+	/* blocking call, waits for mutex release */
+	if (pbs_client_thread_lock_connection(c) != 0)
+		return pbs_errno;
+
+	/* setup DIS support routines for following DIS calls */
+
+	DIS_tcp_setup(sock);
+
+	/* send run request */
+
+	if ((rc = encode_DIS_ReqHdr(sock, PBS_BATCH_AsyrunJobs,
+		pbs_current_user)) ||
+		(rc = encode_DIS_RunJobs(sock, njobs, jobids, locations)) ||
+		(rc = encode_DIS_ReqExtend(sock, extend))) {
+		connection[c].ch_errtxt = strdup(dis_emsg[rc]);
+		if (connection[c].ch_errtxt == NULL) {
+			pbs_errno = PBSE_SYSTEM;
+		} else {
+			pbs_errno = PBSE_PROTOCOL;
+		}
+		(void)pbs_client_thread_unlock_connection(c);
+		return pbs_errno;
+	}
+
+	if (DIS_tcp_wflush(sock)) {
+		pbs_errno = PBSE_PROTOCOL;
+		(void)pbs_client_thread_unlock_connection(c);
+		return pbs_errno;
+	}
+
+	/* get reply */
+
+	reply = PBSD_rdrpy(c);
+	rc = connection[c].ch_errno;
+
+	if ((rc == 0) && (reply != NULL) &&
+		(reply->brp_choice == BATCH_REPLY_CHOICE_JobCodes) &&
+		(reply->brp_un.brp_jobcodes.brp_njobs == njobs)) {
+		for (i = 0; i < njobs; i++)
+			codes[i] = reply->brp_un.brp_jobcodes.brp_codes[i];
+	} else {
+		if (rc == 0)
+			rc = pbs_errno = PBSE_PROTOCOL;
+		for (i = 0; i < njobs; i++)
+			codes[i] = rc;
+	}
+
+	PBSD_FreeReply(reply);
+
+	/* unlock the thread lock and update the thread context data */
+	if (pbs_client_thread_unlock_connection(c) != 0)
+		return pbs_errno;
+
+	return rc;
+}
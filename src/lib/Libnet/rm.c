@@ -51,6 +51,7 @@
 #include	<netdb.h>
 #include	<netinet/in.h>
 #include	<arpa/inet.h>
+#include	<poll.h>
 
 #include	"pbs_ifl.h"
 #include	"pbs_internal.h"
@@ -78,11 +79,14 @@ static	int	full = 1;
  **	pointed to by "outs".  If len is -1, no
  **	request is active.  If len is -2, a request has been
  **	sent and is waiting to be read.  If len is > 0, the number
- **	indicates how much data is waiting to be sent.
+ **	indicates how much data is waiting to be sent.  If ready
+ **	is set, the response has already been polled for and is
+ **	waiting to be read.
  */
 struct	out {
 	int	stream;
 	int	len;
+	int	ready;
 	struct	out	*next;
 };
 
@@ -113,6 +117,7 @@ addrm(int stream)
 	head = &outs[stream % HASHOUT];
 	op->stream = stream;
 	op->len = -1;
+	op->ready = 0;
 	op->next = *head;
 	*head = op;
 	return 0;
@@ -373,8 +378,14 @@ simpleget(int stream)
 
 #if RPP
 	fd_set selset;
+	struct	out	*op;
+	int	i;
 
-	while(1) {
+	for (op = outs[stream % HASHOUT]; op; op = op->next) {
+		if (op->stream == stream)
+			break;
+	}
+	while (op == NULL || !op->ready) {
 		/* since tpp recvs are essentially allways non blocking
 		 * we can call a dis function only if we are sure we have
 		 * data on that rpp fd
@@ -382,11 +393,24 @@ simpleget(int stream)
 		FD_ZERO(&selset);
 		FD_SET(rpp_fd, &selset);
 		if (select(FD_SETSIZE, &selset, NULL, NULL, NULL) > 0) {
-			if (rpp_poll() == stream)
+			if ((i = rpp_poll()) == stream)
 				break;
+			if (i >= 0) {
+				/* remember the response for when it is read */
+				struct	out	*other;
+
+				for (other = outs[i % HASHOUT]; other; other = other->next) {
+					if (other->stream == i) {
+						other->ready = 1;
+						break;
+					}
+				}
+			}
 		} else
 			break; /* let it flow down and fail in the DIS read */
 	}
+	if (op != NULL)
+		op->ready = 0;
 #endif
 
 	num = disrsi(stream, &ret);
@@ -796,6 +820,7 @@ activereq()
 			bucket = i % HASHOUT;
 			op->stream = i;
 			op->len = -2;
+			op->ready = 0;
 			op->next = outs[bucket];
 			outs[bucket] = op;
 		}
@@ -858,6 +883,121 @@ activereq()
 #endif
 }
 
+/**
+ * @brief
+ *	Send any outstanding messages and return the stream number of
+ *	the next stream with a response to read.  Unlike activereq(),
+ *	only streams opened with openrm() are returned and the caller
+ *	chooses how long to wait.  The response can then be read with
+ *	getreq() without waiting again.
+ *
+ * @param[in] timeout - milliseconds to wait, -1 to wait forever
+ *
+ * @return	int
+ * @retval	next stream num		success
+ * @retval	-2			timeout
+ * @retval	-1			error
+ */
+int
+pollreq(int timeout)
+{
+	struct	out	*op;
+	int		i, num;
+#if	RPP
+	struct	pollfd	pfd;
+#else
+	struct	pollfd	*pfds;
+	int		npfds;
+#endif
+
+	pbs_errno = 0;
+	flushreq();
+
+#if	RPP
+	/* a response seen while waiting for another stream */
+	for (i=0; i<HASHOUT; i++) {
+		for (op=outs[i]; op; op=op->next) {
+			if (op->ready)
+				return op->stream;
+		}
+	}
+
+	for (;;) {
+		extern	int	rpp_fd;
+
+		if ((i = rpp_poll()) >= 0) {
+			for (op=outs[i % HASHOUT]; op; op=op->next) {
+				if (op->stream == i)
+					break;
+			}
+			if (op == NULL)
+				continue;
+			op->ready = 1;
+			return i;
+		}
+		else if (i == -1) {
+			pbs_errno = errno;
+			return -1;
+		}
+
+		pfd.fd = rpp_fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		num = poll(&pfd, 1, timeout);
+		if (num == -1) {
+			if (errno == EINTR)
+				continue;
+			pbs_errno = errno;
+			DBPRT(("%s: poll %d\n", __func__, pbs_errno))
+			return -1;
+		}
+		if (num == 0)
+			return -2;
+	}
+#else
+	/* poll() rather than select(), a stream may be >= FD_SETSIZE */
+	npfds = 0;
+	for (i=0; i<HASHOUT; i++) {
+		for (op=outs[i]; op; op=op->next)
+			npfds++;
+	}
+	if (npfds == 0)
+		return -2;
+	pfds = malloc(npfds * sizeof(struct pollfd));
+	if (pfds == NULL) {
+		pbs_errno = errno;
+		return -1;
+	}
+	npfds = 0;
+	for (i=0; i<HASHOUT; i++) {
+		for (op=outs[i]; op; op=op->next) {
+			pfds[npfds].fd = op->stream;
+			pfds[npfds].events = POLLIN;
+			pfds[npfds].revents = 0;
+			npfds++;
+		}
+	}
+
+	num = poll(pfds, npfds, timeout);
+	if (num == -1) {
+		pbs_errno = errno;
+		DBPRT(("%s: poll %d\n", __func__, pbs_errno))
+		i = -1;
+	}
+	else {
+		i = -2;
+		for (num=0; num<npfds; num++) {
+			if (pfds[num].revents != 0) {
+				i = pfds[num].fd;
+				break;
+			}
+		}
+	}
+	free(pfds);
+	return i;
+#endif
+}
+
 /**
  * @brief
  *	If flag is true, turn on "full response" mode where getreq
@@ -233,6 +233,94 @@ get_occurrence(char *rrule, time_t dtstart, char *tz, int idx)
 #endif
 }
 
+/**
+ * @brief
+ * 	Get the start times of the first count occurrences of a recurrence
+ * 	rule in one pass.  occr_arr[i] is what get_occurrence() returns for
+ * 	index i+1, without walking the rule from dtstart for every index.
+ *
+ * @param[in] rrule - The recurrence rule as defined by the user
+ * @param[in] dtstart - The start time from which to start
+ * @param[in] tz - The timezone associated to the recurrence rule
+ * @param[in] count - The number of occurrences to compute
+ * @param[out] occr_arr - array of at least count times to fill
+ *
+ * @return	int
+ * @retval	0	success
+ * @retval	-1	bad arguments
+ *
+ */
+int
+get_occurrences(char *rrule, time_t dtstart, char *tz, int count, time_t *occr_arr)
+{
+	int i;
+#ifdef LIBICAL
+	struct icalrecurrencetype rt;
+	struct icaltimetype start;
+	icaltimezone *localzone;
+	struct icaltimetype next;
+	struct icaltimetype utc_next;
+	struct icalrecur_iterator_impl *itr;
+#endif
+
+	if (count < 0 || (count > 0 && occr_arr == NULL))
+		return -1;
+
+#ifdef LIBICAL
+	if (rrule == NULL) {
+		for (i = 0; i < count; i++)
+			occr_arr[i] = dtstart;
+		return 0;
+	}
+
+	localzone = NULL;
+	if (tz != NULL) {
+		icalerror_clear_errno();
+
+		icalerror_set_error_state(ICAL_PARSE_ERROR, ICAL_ERROR_NONFATAL);
+#ifdef LIBICAL_API2
+		icalerror_set_errors_are_fatal(0);
+#else
+		icalerror_errors_are_fatal = 0;
+#endif
+		localzone = icaltimezone_get_builtin_timezone(tz);
+	}
+
+	if (localzone == NULL) {
+		for (i = 0; i < count; i++)
+			occr_arr[i] = -1;
+		return 0;
+	}
+
+	rt = icalrecurrencetype_from_string(rrule);
+
+	start = icaltime_from_timet_with_zone(dtstart, 0, NULL);
+	icaltimezone_convert_time(&start, icaltimezone_get_utc_timezone(), localzone);
+	next = start;
+
+	itr = (struct icalrecur_iterator_impl*) icalrecur_iterator_new(rt, start);
+	for (i = 0; i < count; i++) {
+		if (!icaltime_is_null_time(next))
+			next = icalrecur_iterator_next(itr);
+
+		if (!icaltime_is_null_time(next)) {
+			utc_next = next;
+			icaltimezone_convert_time(&utc_next, localzone,
+				icaltimezone_get_utc_timezone());
+			occr_arr[i] = icaltime_as_timet(utc_next);
+		}
+		else
+			occr_arr[i] = -1; /* reached the end of possible date-time */
+	}
+	icalrecur_iterator_free(itr);
+#else
+	for (i = 0; i < count; i++)
+		occr_arr[i] = dtstart;
+#endif
+
+	return 0;
+}
+
 /**
  * @brief
  * 	Check if a recurrence rule is valid and consistent.
@@ -55,6 +55,26 @@
 #include "sort.h"
 #include "node_partition.h"
 #include "check.h"
+#include "avltree.h"
+
+/*
+ * node bucket definitions carried across scheduling cycles.  Nodes are
+ * matched to a definition by a fingerprint of their resources, queue, and
+ * priority, so a node only changes buckets when one of those changes.
+ */
+struct node_bucket_def {
+	unsigned long long fp;		/* fingerprint of resources, queue, and priority */
+	schd_resource *res_spec;	/* resources that describe the bucket */
+	char *name;			/* name of the bucket */
+	char *queue_name;		/* queue of the bucket or NULL */
+	int priority;			/* priority of the bucket */
+	int ind;			/* index into the buckets being created or -1 */
+	int used;			/* used since the last sweep */
+	struct node_bucket_def *next;
+};
+
+static struct node_bucket_def *bkt_def_list = NULL;
+static AVL_IX_DESC *bkt_def_index = NULL;
 
 /* bucket_bitpool constructor */
 bucket_bitpool *
@@ -379,7 +399,210 @@ char *create_node_bucket_name(status *policy, node_bucket *nb) {
 }
 
 /**
- * @brief create node buckets from an array of nodes
+ * @brief free a list of node bucket definitions
+ * @param[in] def - the head of the list
+ */
+static void
+free_node_bucket_def_list(struct node_bucket_def *def)
+{
+	struct node_bucket_def *next;
+
+	for (; def != NULL; def = next) {
+		next = def->next;
+		free_resource_list(def->res_spec);
+		free(def->name);
+		free(def->queue_name);
+		free(def);
+	}
+}
+
+/**
+ * @brief forget the node bucket definitions kept from previous cycles.
+ *        They refer to resource definitions, so they must be dropped
+ *        when those are.
+ */
+void
+reset_node_bucket_cache(void)
+{
+	free_node_bucket_def_list(bkt_def_list);
+	bkt_def_list = NULL;
+
+	if (bkt_def_index != NULL) {
+		avl_destroy_index(bkt_def_index);
+		free(bkt_def_index);
+		bkt_def_index = NULL;
+	}
+}
+
+/**
+ * @brief fold a node's resources into a fingerprint the way two nodes are
+ *        compared for a node bucket: the resources to check and all
+ *        booleans, with unset booleans being False
+ * @param[in] policy - policy info
+ * @param[in] ninfo - the node
+ * @param[in] qinfo - the queue of the node or NULL
+ * @return unsigned long long
+ * @retval the fingerprint
+ */
+static unsigned long long
+node_bucket_fingerprint(status *policy, node_info *ninfo, queue_info *qinfo)
+{
+	unsigned long long fp = FINGERPRINT_INIT;
+	schd_resource *res;
+	sch_resource_t avail;
+	int i;
+	int j;
+
+	for (i = 0; policy->resdef_to_check_no_hostvnode[i] != NULL; i++) {
+		if (policy->resdef_to_check_no_hostvnode[i]->type.is_boolean)
+			continue;
+		res = find_resource(ninfo->res, policy->resdef_to_check_no_hostvnode[i]);
+		if (res == NULL)
+			continue;
+		fp = fingerprint_str(fp, res->name);
+		if (res->def->type.is_string) {
+			for (j = 0; res->str_avail != NULL && res->str_avail[j] != NULL; j++)
+				fp = fingerprint_str(fp, res->str_avail[j]);
+		} else
+			fp = fingerprint_bytes(fp, &res->avail, sizeof(res->avail));
+	}
+
+	for (i = 0; boolres != NULL && boolres[i] != NULL; i++) {
+		res = find_resource(ninfo->res, boolres[i]);
+		avail = (res == NULL) ? 0 : res->avail;
+		fp = fingerprint_str(fp, boolres[i]->name);
+		fp = fingerprint_bytes(fp, &avail, sizeof(avail));
+	}
+
+	fp = fingerprint_bytes(fp, &ninfo->priority, sizeof(ninfo->priority));
+	fp = fingerprint_str(fp, qinfo == NULL ? NULL : qinfo->name);
+
+	return fp;
+}
+
+/**
+ * @brief find the node bucket definition a node belongs to, creating it
+ *        if this is the first node of its kind
+ * @param[in] policy - policy info
+ * @param[in] ninfo - the node
+ * @param[in] qinfo - the queue of the node or NULL
+ * @return struct node_bucket_def *
+ * @retval the definition
+ * @retval NULL if the node's fingerprint collides with a different
+ *         definition or on error.  The caller should search the buckets.
+ */
+static struct node_bucket_def *
+find_node_bucket_def(status *policy, node_info *ninfo, queue_info *qinfo)
+{
+	struct node_bucket_def *def;
+	node_bucket nb = {0};
+	schd_resource *cur_res;
+	unsigned long long fp;
+
+	if (policy->resdef_to_check_no_hostvnode == NULL)
+		return NULL;
+
+	if (bkt_def_index == NULL) {
+		bkt_def_index = create_tree(AVL_NO_DUP_KEYS, sizeof(unsigned long long));
+		if (bkt_def_index == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return NULL;
+		}
+	}
+
+	fp = node_bucket_fingerprint(policy, ninfo, qinfo);
+	def = find_tree(bkt_def_index, &fp);
+	if (def != NULL) {
+		if (def->priority != ninfo->priority)
+			return NULL;
+		if ((def->queue_name == NULL) != (qinfo == NULL))
+			return NULL;
+		if (qinfo != NULL && strcmp(def->queue_name, qinfo->name) != 0)
+			return NULL;
+		if (!compare_resource_avail_list(def->res_spec, ninfo->res))
+			return NULL;
+		def->used = 1;
+		return def;
+	}
+
+	def = calloc(1, sizeof(struct node_bucket_def));
+	if (def == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	def->fp = fp;
+	def->priority = ninfo->priority;
+	def->ind = -1;
+	def->used = 1;
+
+	def->res_spec = dup_selective_resource_list(ninfo->res, policy->resdef_to_check_no_hostvnode,
+						    (ADD_UNSET_BOOLS_FALSE | ADD_ALL_BOOL));
+	if (def->res_spec == NULL) {
+		free_node_bucket_def_list(def);
+		return NULL;
+	}
+	for (cur_res = def->res_spec; cur_res != NULL; cur_res = cur_res->next)
+		if (cur_res->type.is_consumable)
+			cur_res->assigned = 0;
+
+	if (qinfo != NULL) {
+		def->queue_name = string_dup(qinfo->name);
+		if (def->queue_name == NULL) {
+			free_node_bucket_def_list(def);
+			return NULL;
+		}
+	}
+
+	nb.res_spec = def->res_spec;
+	nb.queue = qinfo;
+	nb.priority = def->priority;
+	def->name = create_node_bucket_name(policy, &nb);
+	if (def->name == NULL) {
+		free_node_bucket_def_list(def);
+		return NULL;
+	}
+
+	if (tree_add_del(bkt_def_index, &def->fp, def, TREE_OP_ADD) != 0) {
+		free_node_bucket_def_list(def);
+		return NULL;
+	}
+	def->next = bkt_def_list;
+	bkt_def_list = def;
+
+	return def;
+}
+
+/**
+ * @brief drop the node bucket definitions no node has used since the
+ *        last sweep
+ */
+static void
+sweep_node_bucket_defs(void)
+{
+	struct node_bucket_def *def;
+	struct node_bucket_def *prev = NULL;
+	struct node_bucket_def *next;
+
+	for (def = bkt_def_list; def != NULL; def = next) {
+		next = def->next;
+		if (def->used) {
+			def->used = 0;
+			prev = def;
+			continue;
+		}
+		tree_add_del(bkt_def_index, &def->fp, NULL, TREE_OP_DEL);
+		if (prev == NULL)
+			bkt_def_list = next;
+		else
+			prev->next = next;
+		def->next = NULL;
+		free_node_bucket_def_list(def);
+	}
+}
+
+/**
+ * @brief create node buckets from an array of nodes.  Nodes are matched
+ *        to buckets through the node bucket definitions kept across cycles.
  * @param[in] policy - policy info
  * @param[in] nodes - the nodes to create buckets from
  * @param[in] queues - the queues the nodes may be associated with.  May be NULL
@@ -396,6 +619,7 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 	int j = 0;
 	node_bucket **buckets = NULL;
 	node_bucket **tmp;
+	struct node_bucket_def *def;
 	int node_ct;
 	
 	if (policy == NULL || nodes == NULL)
@@ -408,8 +632,10 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 		log_err(errno, __func__, MEM_ERR_MSG);
 		return NULL;
 	}
-		
-	
+
+	for (def = bkt_def_list; def != NULL; def = def->next)
+		def->ind = -1;
+
 	for (i = 0; i < node_ct; i++) {
 		node_bucket *nb = NULL;
 		int bkt_ind;
@@ -422,7 +648,11 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 		if (queues != NULL && nodes[i]->queue_name != NULL)
 			qinfo = find_queue_info(queues, nodes[i]->queue_name);
 		
-		bkt_ind = find_node_bucket_ind(buckets, nodes[i]->res, qinfo, nodes[i]->priority);
+		def = find_node_bucket_def(policy, nodes[i], qinfo);
+		if (def != NULL)
+			bkt_ind = def->ind;
+		else
+			bkt_ind = find_node_bucket_ind(buckets, nodes[i]->res, qinfo, nodes[i]->priority);
 		if (flags & UPDATE_BUCKET_IND) {
 			if (bkt_ind == -1)
 				nodes[i]->bucket_ind = j;
@@ -442,8 +672,11 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 				return NULL;
 			}
 
-			buckets[j]->res_spec = dup_selective_resource_list(nodes[i]->res, policy->resdef_to_check_no_hostvnode,
-									   (ADD_UNSET_BOOLS_FALSE | ADD_ALL_BOOL));
+			if (def != NULL)
+				buckets[j]->res_spec = dup_resource_list(def->res_spec);
+			else
+				buckets[j]->res_spec = dup_selective_resource_list(nodes[i]->res, policy->resdef_to_check_no_hostvnode,
+										   (ADD_UNSET_BOOLS_FALSE | ADD_ALL_BOOL));
 
 			if (buckets[j]->res_spec == NULL) {
 				free_node_bucket_array(buckets);
@@ -455,9 +688,11 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 			
 			buckets[j]->priority = nodes[i]->priority;
 
-			for (cur_res = buckets[j]->res_spec; cur_res != NULL; cur_res = cur_res->next)
-				if (cur_res->type.is_consumable)
-					cur_res->assigned = 0;
+			if (def == NULL) {
+				for (cur_res = buckets[j]->res_spec; cur_res != NULL; cur_res = cur_res->next)
+					if (cur_res->type.is_consumable)
+						cur_res->assigned = 0;
+			}
 
 			
 			buckets[j]->busy_later_pool->truth_ct = 0;
@@ -466,7 +701,11 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 
 			buckets[j]->total = 0;
 
-			buckets[j]->name = create_node_bucket_name(policy, buckets[j]);
+			if (def != NULL) {
+				buckets[j]->name = string_dup(def->name);
+				def->ind = j;
+			} else
+				buckets[j]->name = create_node_bucket_name(policy, buckets[j]);
 			if (buckets[j]->name == NULL) {
 				free_node_bucket_array(buckets);
 				return NULL;
@@ -496,6 +735,12 @@ create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsi
 		}
 	}
 	
+	/* the server's buckets cover every node, so definitions they did not
+	 * use are no longer needed
+	 */
+	if (flags & UPDATE_BUCKET_IND)
+		sweep_node_bucket_defs();
+
 	if (j == 0) {
 		free(buckets);
 		return NULL;
@@ -687,6 +932,35 @@ bucket_match(chunk_map **cmap, resource_resv *resresv, schd_error *err)
 
 			}
 
+			/* Without provisioning, every free node is taken.  Claim the
+			 * nodes a long at a time by moving the bits up to the last
+			 * node we need.
+			 */
+			if (resresv->aoename == NULL && num_chunks_needed > chunks_added &&
+			    bkt->free_pool->working_ct > 0) {
+				int chunk_count = cmap[i]->bkt_cnts[j]->chunk_count;
+				long nodes_needed;
+				long last;
+
+				if (chunk_count > 0)
+					nodes_needed = (num_chunks_needed - chunks_added + chunk_count - 1) / chunk_count;
+				else
+					nodes_needed = bkt->free_pool->working_ct;
+				if (nodes_needed > bkt->free_pool->working_ct)
+					nodes_needed = bkt->free_pool->working_ct;
+
+				last = pbs_bitmap_nth_on_bit(bkt->free_pool->working, nodes_needed);
+				if (last >= 0) {
+					clear_schd_error(err);
+					pbs_bitmap_or_range(bkt->busy_pool->working, bkt->free_pool->working, 0, last);
+					pbs_bitmap_or_range(cmap[i]->node_bits, bkt->free_pool->working, 0, last);
+					pbs_bitmap_clear_range(bkt->free_pool->working, 0, last);
+					bkt->free_pool->working_ct -= nodes_needed;
+					bkt->busy_pool->working_ct += nodes_needed;
+					chunks_added += nodes_needed * chunk_count;
+				}
+			}
+
 			for (k = pbs_bitmap_first_on_bit(bkt->free_pool->working);
 			     num_chunks_needed > chunks_added && k >= 0;
 			     k = pbs_bitmap_next_on_bit(bkt->free_pool->working, k)) {
@@ -57,6 +57,9 @@ void free_node_bucket_array(node_bucket **buckets);
 /* find index of node_bucket in an array */
 int find_node_bucket_ind(node_bucket **buckets, schd_resource *rl, queue_info *queue, int priority);
 
+/* forget the node bucket definitions kept across cycles */
+void reset_node_bucket_cache(void);
+
 /* create node_buckets an array of nodes */
 node_bucket **create_node_buckets(status *policy, node_info **nodes, queue_info **queues, unsigned int flags);
 
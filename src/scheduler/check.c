@@ -103,6 +103,7 @@
 #include "resource.h"
 #include "buckets.h"
 #include "pbs_bitmap.h"
+#include "undo_log.h"
 
 
 /**
@@ -731,6 +732,7 @@ is_ok_to_run(status *policy, server_info *sinfo,
 		return NULL;
 
 	err = perr;
+	undo_resource_resv(sinfo->undo, resresv);
 
 	if(resresv->is_job && sinfo->equiv_classes != NULL &&
 	   !(flags & (IGNORE_EQUIV_CLASS | RETURN_ALL_ERR)) &&
@@ -1142,6 +1144,7 @@ check_avail_resources(schd_resource *reslist, resource_req *reqlist,
 	schd_resource *fres = false_res();
 	schd_resource *zres = zero_res();
 	schd_resource *ustr = unset_str_res();
+	schd_resource unset_res;		/* copy of one of the above for resreq */
 	char resbuf1[MAX_LOG_SIZE];
 	char resbuf2[MAX_LOG_SIZE];
 	char resbuf3[MAX_LOG_SIZE];
@@ -1197,8 +1200,13 @@ check_avail_resources(schd_resource *reslist, resource_req *reqlist,
 				else /* ignore check: effect is resource is infinite */
 					continue;
 
-				res->name = resreq->name;
-				res->def = resreq->def;
+				/* the unset resources are shared, use a copy so this
+				 * function can be used from several threads at once
+				 */
+				unset_res = *res;
+				unset_res.name = resreq->name;
+				unset_res.def = resreq->def;
+				res = &unset_res;
 			}
 
 			if (res->indirect_res != NULL) {
@@ -1365,7 +1373,7 @@ count_res_by_user(resource_resv **resresv_arr, char *user,
  * @return	resource amount
  */
 sch_resource_t
-find_counts_elm(counts *cts_list, char *name, char *res)
+find_counts_elm(counts *cts_list, char *name, resdef *res)
 {
 	resource_req *req;
 	counts *cts;
@@ -1378,7 +1386,7 @@ find_counts_elm(counts *cts_list, char *name, char *res)
 		if (res == NULL)
 			return cts->running;
 		else {
-			if ((req = find_resource_req_by_str(cts->rescts, res)) != NULL)
+			if ((req = find_resource_req(cts->rescts, res)) != NULL)
 				return req->amount;
 		}
 	}
@@ -1604,6 +1612,8 @@ check_nodes(status *policy, server_info *sinfo, queue_info *qinfo, resource_resv
 		 * created in query_reservations()
 		 */
 		if (resresv->node_set == NULL) {
+			undo_own(undo_owner(sinfo->undo, resresv),
+				(void **) &resresv->node_set, free);
 			resresv->node_set = create_node_array_from_str(
 				qinfo->num_nodes > 0 ? qinfo->nodes :
 				sinfo->unassoc_nodes,
@@ -1869,7 +1879,8 @@ check_prime_boundary(status *policy, resource_resv  *resresv, struct schd_error
 /**
  * @brief
  * 		return a boolean resource that is False
- *         It is up to the caller to set the name and def fields
+ *         The resource is shared: copy it before setting the name and
+ *         def fields
  *
  * @return	schd_resource * (set to False)
  *
@@ -1892,16 +1903,14 @@ false_res()
 			return NULL;
 	}
 
-	res->def = NULL;
-	res->name = NULL;
-
 	return res;
 }
 
 /**
  * @brief
  * 		return a string resource that is "unset" (set to "")
- *         It is up to the caller to set the name and def fields
+ *         The resource is shared: copy it before setting the name and
+ *         def fields
  *
  * @return	schd_resource *
  * @retval	NULL	: fail
@@ -1934,15 +1943,13 @@ unset_str_res()
 			return NULL;
 	}
 
-	res->name = NULL;
-	res->def = NULL;
-
 	return res;
 }
 /**
  * @brief
  * 		return a numeric resource that is 0
- *         It is up to the caller to set the name and def fields
+ *         The resource is shared: copy it before setting the name and
+ *         def fields
  *
  * @return	schd_resource *
  * @retval	NULL	: fail
@@ -1964,9 +1971,6 @@ zero_res()
 			return NULL;
 	}
 
-	res->name = NULL;
-	res->def = NULL;
-
 	return res;
 }
 
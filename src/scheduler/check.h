@@ -126,7 +126,7 @@ sch_resource_t dynamic_avail(schd_resource *res);
  *	res      - resource to find or if NULL, return number of running
  *			resource amount
  */
-sch_resource_t find_counts_elm(counts *cts_list, char *name, char *res);
+sch_resource_t find_counts_elm(counts *cts_list, char *name, resdef *res);
 
 
 /*
@@ -94,6 +94,27 @@
  */
 #define SHRINK_MAX_RETRY 5
 
+/* maximum number of threads used to evaluate vnodes */
+#define MAX_NODE_EVAL_THREADS 64
+
+/* fewest vnodes worth evaluating with node_eval_threads */
+#define MIN_PARALLEL_NODE_EVAL 256
+
+/* maximum number of threads used to convert queried jobs and vnodes */
+#define MAX_QUERY_THREADS 64
+
+/* fewest jobs or vnodes worth converting with query_threads */
+#define MIN_PARALLEL_QUERY 256
+
+/* shortest counts list worth indexing by entity name */
+#define MIN_COUNTS_INDEX 16
+
+/* most jobs whose attribute updates are sent in one Modify Jobs request */
+#define MAX_JOB_UPDATES_PER_REQ 1000
+
+/* most jobs run with one Async Run Jobs request */
+#define MAX_JOB_RUNS_PER_REQ 1000
+
 /* parsing -
  * names that appear on the left hand side in the sched config file
  */
@@ -143,6 +164,19 @@
 #define PARSE_STRICT_ORDERING "strict_ordering"
 #define PARSE_RES_UNSET_INFINITE "resource_unset_infinite"
 #define PARSE_SELECT_PROVISION "provision_policy"
+#define PARSE_JOB_QUERY_DELTA "job_query_delta"
+#define PARSE_JOB_QUERY_RESYNC "job_query_resync"
+#define PARSE_NODE_EVAL_THREADS "node_eval_threads"
+#define PARSE_QUERY_THREADS "query_threads"
+#define PARSE_EQUIV_VERDICT_CACHE "equiv_class_verdict_cache"
+#define PARSE_CYCLE_STATS_FILE "cycle_stats_file"
+#define PARSE_CYCLE_STATS_JOB_DETAIL "cycle_stats_job_detail"
+#define PARSE_SNAPSHOT_FILE "snapshot_file"
+#define PARSE_SNAPSHOT_MIN_DURATION "snapshot_min_duration"
+#define PARSE_SERVER_DYN_RES_TTL "server_dyn_res_ttl"
+#define PARSE_SERVER_DYN_RES_TIMEOUT "server_dyn_res_timeout"
+#define PARSE_MOM_RESOURCES_REFRESH "mom_resources_refresh"
+#define PARSE_MOM_RESOURCES_TIMEOUT "mom_resources_timeout"
 
 #ifdef NAS
 /* localmod 034 */
@@ -113,6 +113,9 @@ enum select_job_status
 /* Error message when we fail to allocate memory */
 #define MEM_ERR_MSG "Unable to allocate memory (malloc error)"
 
+/* starting value of a fingerprint (see fingerprint_bytes()) */
+#define FINGERPRINT_INIT 14695981039346656037ULL
+
 /* accrue types for update_accruetype */
 #define ACCRUE_INIT     "0"
 #define ACCRUE_INEL     "1"
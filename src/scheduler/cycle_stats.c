@@ -0,0 +1,465 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+/**
+ * @file    cycle_stats.c
+ *
+ * @brief
+ * 		cycle_stats.c - This file contains the scheduling cycle profiler.
+ *		The cycle's phases are timed with a monotonic clock and counted.
+ *		At the end of the cycle a JSON summary is appended as a single
+ *		line to the file named by the cycle_stats_file sched_config
+ *		option.  With cycle_stats_job_detail set, the summary also lists
+ *		the time each job considered by main_sched_loop() spent in the
+ *		per job phases and what happened to it.  The latency of each
+ *		server_dyn_res program and the age of the value used are listed
+ *		as well.
+ *
+ *		Nothing is timed unless cycle_stats_file is set.
+ *
+ * Functions included are:
+ * 	now_usec()
+ * 	start_cycle_stats()
+ * 	begin_phase()
+ * 	end_phase()
+ * 	begin_job_stats()
+ * 	end_job_stats()
+ * 	add_dyn_res_stats()
+ * 	write_cycle_stats()
+ *
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#ifdef WIN32
+#include <windows.h>
+#endif
+#include <log.h>
+#include "cycle_stats.h"
+#include "data_types.h"
+#include "constant.h"
+#include "globals.h"
+#include "misc.h"
+
+/* names of the phases in the JSON summary - indexed by enum cycle_phase */
+static const char *phase_names[PHASE_HIGH] = {
+	"query_server",
+	"sort_jobs",
+	"main_sched_loop",
+	"is_ok_to_run",
+	"run_job",
+	"preemption",
+	"add_job_to_calendar",
+	"end_cycle_tasks"
+};
+
+/* names of the job outcomes - indexed by enum job_outcome */
+static const char *outcome_names[JOB_OUTCOME_HIGH] = {
+	"not_run",
+	"run",
+	"run_preempting",
+	"calendared"
+};
+
+/* statistics of one job considered by main_sched_loop() */
+struct job_stats
+{
+	char *name;
+	long long usec[PHASE_HIGH];
+	enum job_outcome outcome;
+};
+
+/* a server_dyn_res value used by the cycle */
+struct dyn_res_stats
+{
+	char *res;
+	long long latency;		/* how long the program's last run took */
+	long age;			/* age of the value in seconds */
+	int stale;			/* the value is stale */
+};
+
+/* statistics of the current cycle */
+static struct
+{
+	int enabled;			/* cycle_stats_file was set when the cycle started */
+	int job_detail;			/* keep per job statistics */
+	time_t start_time;		/* wall clock time the cycle started */
+	long long start;		/* monotonic time the cycle started */
+	long long usec[PHASE_HIGH];	/* time spent in each phase */
+	long long began[PHASE_HIGH];	/* when the outermost open phase began */
+	int depth[PHASE_HIGH];		/* nesting of each phase */
+	long count[PHASE_HIGH];		/* number of times each phase ran */
+	long outcomes[JOB_OUTCOME_HIGH];
+	struct job_stats *jobs;		/* per job statistics */
+	int num_jobs;
+	int jobs_size;
+	struct job_stats *cur_job;	/* job being considered */
+	struct dyn_res_stats dyn_res[MAX_SERVER_DYN_RES];
+	int num_dyn_res;
+} cs;
+
+/**
+ * @brief
+ * 		the current value of a monotonic clock in microseconds
+ *
+ * @return	long long
+ */
+long long
+now_usec(void)
+{
+#ifdef WIN32
+	LARGE_INTEGER cnt;
+	LARGE_INTEGER freq;
+
+	QueryPerformanceCounter(&cnt);
+	QueryPerformanceFrequency(&freq);
+	return cnt.QuadPart * 1000000 / freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+/**
+ * @brief
+ * 		free the per job statistics of the last cycle
+ *
+ * @return	void
+ */
+static void
+free_job_stats(void)
+{
+	int i;
+
+	for (i = 0; i < cs.num_jobs; i++)
+		free(cs.jobs[i].name);
+	free(cs.jobs);
+	cs.jobs = NULL;
+	cs.num_jobs = 0;
+	cs.jobs_size = 0;
+	cs.cur_job = NULL;
+}
+
+/**
+ * @brief
+ * 		free the server_dyn_res statistics of the last cycle
+ *
+ * @return	void
+ */
+static void
+free_dyn_res_stats(void)
+{
+	int i;
+
+	for (i = 0; i < cs.num_dyn_res; i++)
+		free(cs.dyn_res[i].res);
+	cs.num_dyn_res = 0;
+}
+
+/**
+ * @brief
+ * 		start collecting the statistics of a new cycle.  Whether the
+ *		cycle is profiled is decided here for the whole cycle.
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+start_cycle_stats(void)
+{
+	free_job_stats();
+	free_dyn_res_stats();
+	memset(&cs, 0, sizeof(cs));
+
+	if (conf.cycle_stats_file == NULL)
+		return;
+
+	cs.enabled = 1;
+	cs.job_detail = conf.cycle_stats_job_detail;
+	cs.start_time = time(NULL);
+	cs.start = now_usec();
+}
+
+/**
+ * @brief
+ * 		start timing a phase of the cycle.  If the phase is already
+ *		being timed (e.g. it is reached recursively), only the
+ *		outermost call is timed.
+ *
+ * @param[in]	phase	-	the phase
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+begin_phase(enum cycle_phase phase)
+{
+	if (!cs.enabled)
+		return;
+
+	if (cs.depth[phase]++ == 0)
+		cs.began[phase] = now_usec();
+}
+
+/**
+ * @brief
+ * 		stop timing a phase of the cycle.  The time is also charged to
+ *		the job being considered, if any.
+ *
+ * @param[in]	phase	-	the phase
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+end_phase(enum cycle_phase phase)
+{
+	long long elapsed;
+
+	if (!cs.enabled || cs.depth[phase] == 0)
+		return;
+
+	if (--cs.depth[phase] > 0)
+		return;
+
+	elapsed = now_usec() - cs.began[phase];
+	cs.usec[phase] += elapsed;
+	cs.count[phase]++;
+	if (cs.cur_job != NULL)
+		cs.cur_job->usec[phase] += elapsed;
+}
+
+/**
+ * @brief
+ * 		charge the per job phases to a job until end_job_stats()
+ *
+ * @param[in]	name	-	name of the job
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+begin_job_stats(char *name)
+{
+	struct job_stats *tmp;
+
+	if (!cs.enabled || !cs.job_detail)
+		return;
+
+	if (cs.num_jobs == cs.jobs_size) {
+		int size = cs.jobs_size == 0 ? 256 : cs.jobs_size * 2;
+
+		tmp = realloc(cs.jobs, size * sizeof(struct job_stats));
+		if (tmp == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return;
+		}
+		cs.jobs = tmp;
+		cs.jobs_size = size;
+	}
+
+	cs.cur_job = &cs.jobs[cs.num_jobs++];
+	memset(cs.cur_job, 0, sizeof(struct job_stats));
+	cs.cur_job->name = string_dup(name);
+}
+
+/**
+ * @brief
+ * 		record what happened to the job being considered
+ *
+ * @param[in]	outcome	-	what happened to the job
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+end_job_stats(enum job_outcome outcome)
+{
+	if (!cs.enabled)
+		return;
+
+	cs.outcomes[outcome]++;
+	if (cs.cur_job != NULL)
+		cs.cur_job->outcome = outcome;
+	cs.cur_job = NULL;
+}
+
+/**
+ * @brief
+ * 		record the server_dyn_res value a cycle used for a resource
+ *
+ * @param[in]	res	-	name of the resource
+ * @param[in]	latency	-	how long the program's last run took (usec)
+ * @param[in]	age	-	age of the value in seconds
+ * @param[in]	stale	-	the value is stale
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+add_dyn_res_stats(char *res, long long latency, long age, int stale)
+{
+	struct dyn_res_stats *drs;
+
+	if (!cs.enabled || cs.num_dyn_res == MAX_SERVER_DYN_RES)
+		return;
+
+	drs = &cs.dyn_res[cs.num_dyn_res++];
+	drs->res = string_dup(res);
+	drs->latency = latency;
+	drs->age = age;
+	drs->stale = stale;
+}
+
+/**
+ * @brief
+ * 		write a string to a JSON file as a quoted string
+ *
+ * @param[in]	fp	-	the file
+ * @param[in]	str	-	the string
+ *
+ * @return	void
+ */
+static void
+write_json_str(FILE *fp, const char *str)
+{
+	const unsigned char *p;
+
+	fputc('"', fp);
+	for (p = (const unsigned char *) (str == NULL ? "" : str); *p != '\0'; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(fp, "\\%c", *p);
+		else if (*p < 0x20)
+			fprintf(fp, "\\u%04x", *p);
+		else
+			fputc(*p, fp);
+	}
+	fputc('"', fp);
+}
+
+/**
+ * @brief
+ * 		append the statistics of the cycle to the cycle_stats_file as
+ *		one line of JSON.  Called at the very end of the cycle.
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+write_cycle_stats(void)
+{
+	FILE *fp;
+	char logbuf[MAX_LOG_SIZE];
+	long considered = 0;
+	int i;
+	int j;
+
+	if (!cs.enabled || conf.cycle_stats_file == NULL)
+		return;
+
+	if ((fp = fopen(conf.cycle_stats_file, "a")) == NULL) {
+		snprintf(logbuf, sizeof(logbuf), "Can not open %s: %s",
+			conf.cycle_stats_file, strerror(errno));
+		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, __func__, logbuf);
+		free_job_stats();
+		free_dyn_res_stats();
+		cs.enabled = 0;
+		return;
+	}
+
+	for (i = 0; i < JOB_OUTCOME_HIGH; i++)
+		considered += cs.outcomes[i];
+
+	fprintf(fp, "{\"cycle_start\":%ld,\"duration_us\":%lld,\"phases\":{",
+		(long) cs.start_time, now_usec() - cs.start);
+	for (i = 0; i < PHASE_HIGH; i++)
+		fprintf(fp, "%s\"%s\":{\"count\":%ld,\"us\":%lld}", i ? "," : "",
+			phase_names[i], cs.count[i], cs.usec[i]);
+	fprintf(fp, "},\"jobs_considered\":%ld", considered);
+	for (i = 0; i < JOB_OUTCOME_HIGH; i++)
+		fprintf(fp, ",\"jobs_%s\":%ld", outcome_names[i], cs.outcomes[i]);
+
+	if (cs.num_dyn_res > 0) {
+		fprintf(fp, ",\"server_dyn_res\":[");
+		for (i = 0; i < cs.num_dyn_res; i++) {
+			fprintf(fp, "%s{\"resource\":", i ? "," : "");
+			write_json_str(fp, cs.dyn_res[i].res);
+			fprintf(fp, ",\"latency_us\":%lld,\"age\":%ld,\"stale\":%s}",
+				cs.dyn_res[i].latency, cs.dyn_res[i].age,
+				cs.dyn_res[i].stale ? "true" : "false");
+		}
+		fputc(']', fp);
+	}
+
+	if (cs.job_detail) {
+		fprintf(fp, ",\"jobs\":[");
+		for (i = 0; i < cs.num_jobs; i++) {
+			fprintf(fp, "%s{\"name\":", i ? "," : "");
+			write_json_str(fp, cs.jobs[i].name);
+			fprintf(fp, ",\"outcome\":\"%s\"", outcome_names[cs.jobs[i].outcome]);
+			for (j = PHASE_IS_OK_TO_RUN; j <= PHASE_CALENDAR; j++)
+				fprintf(fp, ",\"%s_us\":%lld", phase_names[j], cs.jobs[i].usec[j]);
+			fputc('}', fp);
+		}
+		fputc(']', fp);
+	}
+	fprintf(fp, "}\n");
+
+	if (fclose(fp) != 0) {
+		snprintf(logbuf, sizeof(logbuf), "Error writing %s: %s",
+			conf.cycle_stats_file, strerror(errno));
+		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, __func__, logbuf);
+	}
+
+	free_job_stats();
+	free_dyn_res_stats();
+	cs.enabled = 0;
+}
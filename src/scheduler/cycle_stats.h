@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+#ifndef	_CYCLE_STATS_H
+#define	_CYCLE_STATS_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* timed phases of a scheduling cycle.  Phases nest (e.g. sort_jobs inside
+ * main_sched_loop), so their times overlap.  Keep phase_names[] in order.
+ */
+enum cycle_phase
+{
+	PHASE_QUERY_SERVER,
+	PHASE_SORT_JOBS,
+	PHASE_MAIN_LOOP,
+	PHASE_IS_OK_TO_RUN,		/* per job phases: PHASE_IS_OK_TO_RUN ... PHASE_CALENDAR */
+	PHASE_RUN_JOB,
+	PHASE_PREEMPT,
+	PHASE_CALENDAR,
+	PHASE_END_CYCLE,
+	PHASE_HIGH
+};
+
+/* what happened to a job considered by main_sched_loop().
+ * Keep outcome_names[] in order.
+ */
+enum job_outcome
+{
+	JOB_OUTCOME_NOT_RUN,
+	JOB_OUTCOME_RUN,
+	JOB_OUTCOME_RUN_PREEMPTING,
+	JOB_OUTCOME_CALENDARED,
+	JOB_OUTCOME_HIGH
+};
+
+/*
+ *	now_usec - the current value of a monotonic clock in microseconds
+ */
+long long now_usec(void);
+
+/*
+ *	start_cycle_stats - start collecting the statistics of a new cycle
+ */
+void start_cycle_stats(void);
+
+/*
+ *	begin_phase - start timing a phase of the cycle
+ */
+void begin_phase(enum cycle_phase phase);
+
+/*
+ *	end_phase - stop timing a phase of the cycle
+ */
+void end_phase(enum cycle_phase phase);
+
+/*
+ *	begin_job_stats - charge the per job phases to a job until
+ *			  end_job_stats() is called
+ */
+void begin_job_stats(char *name);
+
+/*
+ *	end_job_stats - record the outcome of the job from begin_job_stats()
+ */
+void end_job_stats(enum job_outcome outcome);
+
+/*
+ *	add_dyn_res_stats - record the server_dyn_res value a cycle used
+ */
+void add_dyn_res_stats(char *res, long long latency, long age, int stale);
+
+/*
+ *	write_cycle_stats - append the cycle's statistics to the stats file
+ */
+void write_cycle_stats(void);
+
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* _CYCLE_STATS_H */
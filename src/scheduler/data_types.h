@@ -57,6 +57,7 @@ extern "C" {
 #include <time.h>
 #include <pbs_ifl.h>
 #include <libutil.h>
+#include <avltree.h>
 #include "constant.h"
 #include "config.h"
 #include "pbs_bitmap.h"
@@ -70,6 +71,7 @@ struct queue_info;
 struct node_info;
 struct job_info;
 struct schd_resource;
+struct res_ord_index;
 struct resource_req;
 struct holiday;
 struct prev_job_info;
@@ -87,6 +89,7 @@ struct chunk;
 struct selspec;
 struct resdef;
 struct event_list;
+struct event_time_index;
 struct status;
 struct fairshare_head;
 struct node_scratch;
@@ -95,6 +98,8 @@ struct node_bucket;
 struct bucket_bitpool;
 struct chunk_map;
 struct node_bucket_count;
+struct node_res_profile;
+struct undo_log;
 
 
 typedef struct state_count state_count;
@@ -103,6 +108,7 @@ typedef struct queue_info queue_info;
 typedef struct job_info job_info;
 typedef struct node_info node_info;
 typedef struct schd_resource schd_resource;
+typedef struct res_ord_index res_ord_index;
 typedef struct resource_req resource_req;
 typedef struct usage_info usage_info;
 typedef struct group_info group_info;
@@ -130,6 +136,8 @@ typedef struct node_bucket node_bucket;
 typedef struct bucket_bitpool bucket_bitpool;
 typedef struct chunk_map chunk_map;
 typedef struct node_bucket_count node_bucket_count;
+typedef struct node_res_profile node_res_profile;
+typedef struct undo_log undo_log;
 
 #ifdef NAS
 /* localmod 034 */
@@ -368,6 +376,20 @@ struct server_info
 	resresv_set **equiv_classes;
 	node_bucket **buckets;		/* node bucket array */
 	node_info **unordered_nodes;
+
+	/* per-cycle name indexes.  Used by the find_*() functions when they are
+	 * passed the server's own arrays.  They are rebuilt (not duplicated)
+	 * in dup_server_info()
+	 */
+	AVL_IX_DESC *node_index;	/* node name -> node_info */
+	AVL_IX_DESC *host_index;	/* host -> first vnode on the host */
+	AVL_IX_DESC *queue_index;	/* queue name -> queue_info */
+	AVL_IX_DESC *resresv_index;	/* job/resv name -> resource_resv */
+
+	/* changes to undo after a simulation run directly on this universe.
+	 * NULL unless a simulation is in progress (see undo_log.c)
+	 */
+	undo_log *undo;
 #ifdef NAS
 	/* localmod 049 */
 	node_info **nodes_by_NASrank;	/* nodes indexed by NASrank */
@@ -495,6 +517,8 @@ struct job_info
 
 	struct attrl *attr_updates;	/* used to federate all attr updates to server*/
 	float formula_value;		/* evaluated job sort formula value */
+	unsigned long long sort_fp;	/* fingerprint of the sort keys at the last sort */
+	unsigned long long sort_fp_new;	/* fingerprint of the sort keys being sorted on */
 	nspec **resreleased;		/* list of resources released by the job on each node */
 	resource_req *resreq_rel;	/* list of resources released */
 
@@ -673,9 +697,9 @@ struct resource_resv
 	unsigned	will_use_multinode:1;	/* res resv will use multiple nodes */
 
 	char		*name;			/* name of res resv */
-	char		*user;			/* username of the owner of the res resv */
-	char		*group;			/* exec group of owner of res resv */
-	char		*project;		/* exec project of owner of res resv */
+	char		*user;			/* username of the owner of the res resv (interned) */
+	char		*group;			/* exec group of owner of res resv (interned) */
+	char		*project;		/* exec project of owner of res resv (interned) */
 	char		*nodepart_name;		/* name of node partition to run res resv in */
 
 	long		sch_priority;		/* scheduler priority of res resv */
@@ -748,6 +772,18 @@ struct schd_resource
 	resdef *def;			/* resource definition */
 
 	struct schd_resource *next;	/* next resource in list */
+
+	res_ord_index *ord_index;	/* index of the list by resdef ordinal - only
+					 * set on the head of a list
+					 */
+};
+
+/* dense view of a schd_resource list addressed by resdef ordinal */
+struct res_ord_index
+{
+	int size;			/* number of slots in res */
+	schd_resource **res;		/* [reference] resource of each ordinal or NULL */
+	schd_resource *tail;		/* [reference] last resource of the list indexed */
 };
 
 struct resource_req
@@ -766,6 +802,7 @@ struct resdef
 	char *name;			/* name of resource */
 	struct resource_type type;	/* resource type */
 	unsigned int flags;		/* resource flags (see pbs_ifl.h) */
+	int ord;			/* ordinal of the definition in allres or -1 */
 };
 
 struct prev_job_info
@@ -784,9 +821,11 @@ struct mom_res
 
 struct counts
 {
-	char *name;		/* name of entitiy */
+	char *name;		/* name of entitiy (interned) */
 	int running;		/* count of running jobs in object */
 	resource_req *rescts;	/* resources used */
+	AVL_IX_DESC *name_index;	/* name -> counts, kept by the head of a long list */
+	counts *tail;		/* last counts in the list, kept with name_index */
 	counts *next;
 };
 
@@ -830,6 +869,11 @@ struct group_info
 	group_info *parent;			/* parent node */
 	group_info *sibling;			/* sibling node */
 	group_info *child;			/* child node */
+
+	/* name -> group_info index of the whole tree.  Every node points to
+	 * the same index.  It is owned by the root of the tree
+	 */
+	AVL_IX_DESC *name_index;
 };
 
 /**
@@ -841,10 +885,11 @@ struct group_info
 struct resresv_set
 {
 	unsigned can_not_run:1;		/* set can not run */
+	unsigned keep_verdict:1;	/* can_not_run was decided before anything ran this cycle */
 	schd_error *err;		/* reason why set can not run*/
-	char *user;			/* user of set, can be NULL */
-	char *group;			/* group of set, can be NULL */
-	char *project;			/* project of set, can be NULL */
+	char *user;			/* interned user of set, can be NULL */
+	char *group;			/* interned group of set, can be NULL */
+	char *project;			/* interned project of set, can be NULL */
 	char *partition;		/* partition of set, can be NULL */
 	selspec *select_spec;		/* select spec of set */
 	place *place_spec;		/* place spec of set */
@@ -853,6 +898,10 @@ struct resresv_set
 
 	resource_resv **resresv_arr;	/* The resresvs in the set */
 	int num_resresvs;		/* The number of resresvs in the set */
+
+	/* fingerprints of the state at the start of the cycle (verdict cache) */
+	unsigned long long lim_fp;	/* limits and running counts of the set */
+	unsigned long long res_fp;	/* lim_fp plus nodes, reservations and resources */
 };
 
 struct node_partition
@@ -1051,6 +1100,9 @@ struct config
 	unsigned resv_conf_ignore:1;  /* if we want to ignore dedicated time when confirming reservations.  Move to enum if ever expanded */
 	unsigned allow_aoe_calendar:1;        /* allow jobs requesting aoe in calendar*/
 	unsigned logstderr:1;               /* log to stderr as well as log file */
+	unsigned job_query_delta:1;		/* only query jobs which changed since last cycle */
+	unsigned equiv_verdict_cache:1;		/* keep equivalence class verdicts across cycles */
+	unsigned cycle_stats_job_detail:1;	/* add per job detail to the cycle statistics */
 #ifdef NAS /* localmod 034 */
 	unsigned prime_sto	:1;	/* shares_track_only--no enforce shares */
 	unsigned non_prime_sto:1;
@@ -1078,6 +1130,14 @@ struct config
 	int preempt_queue_prio;			/* Queue prio that defines an express queue */
 	int max_preempt_attempts;		/* max num of preempt attempts per cyc*/
 	int max_jobs_to_check;			/* max number of jobs to check in cyc*/
+	int job_query_resync;			/* cycles between full job queries */
+	int node_eval_threads;			/* threads used to evaluate vnodes */
+	int query_threads;			/* threads used to convert queried jobs and vnodes */
+	time_t snapshot_min_duration;		/* shortest cycle worth a snapshot */
+	time_t server_dyn_res_ttl;		/* how long a server_dyn_res value is used */
+	time_t server_dyn_res_timeout;		/* longest a server_dyn_res program may run */
+	time_t mom_resources_refresh;		/* how long the answers of a mom are used */
+	time_t mom_resources_timeout;		/* how long a cycle waits for the moms to answer */
 	long dflt_opt_backfill_fuzzy;		/* default time for the fuzzy backfill optimization */
 	char ded_prefix[PBS_MAXQUEUENAME +1];	/* prefix to dedicated queues */
 	char pt_prefix[PBS_MAXQUEUENAME +1];	/* prefix to primetime queues */
@@ -1085,6 +1145,8 @@ struct config
 	char *fairshare_res;			/* resource to calc fairshare usage */
 	float fairshare_decay_factor;		/* decay factor used when decaying fairshare tree */
 	char *fairshare_ent;			/* job attribute to use as fs entity */
+	char *cycle_stats_file;			/* file cycle statistics are appended to */
+	char *snapshot_file;			/* file the server replies of a cycle are captured to */
 	char **dyn_res_to_get;			/* dynamic resources to get from moms */
 	char **res_to_check;			/* the resources schedule on */
 	resdef **resdef_to_check;		/* the res to schedule on in def form */
@@ -1129,6 +1191,10 @@ struct event_list
 	timed_event *events;		/* the calendar of events */
 	timed_event *next_event;	/* the next event to be performed */
 	time_t *current_time;		/* [reference] current time in the calendar */
+	struct event_time_index *time_index;	/* skip list of the distinct event times */
+	AVL_IX_DESC *name_index;	/* event name -> te_list of events with that name */
+	size_t name_keylen;		/* length of the longest name added to name_index */
+	server_info *server;		/* [reference] server the calendar belongs to */
 };
 
 struct timed_event
@@ -1149,6 +1215,25 @@ struct te_list {
 	timed_event *event;
 };
 
+/* free amounts of the consumable resources a job requests, summed over the
+ * server's vnodes, and how many of each of its chunks the vnodes can hold.
+ * Kept current by calc_run_time() as events are simulated
+ */
+struct node_res_profile
+{
+	int num_res;			/* number of resources in defs */
+	int num_chunks;			/* number of chunks counted (0: no counts) */
+	int num_nodes;			/* number of nodes in nodes */
+	node_info **nodes;		/* [reference] sinfo->unordered_nodes */
+	resdef **defs;			/* resources the job requests */
+	sch_resource_t *need;		/* total amount requested (0: not checked) */
+	sch_resource_t *total;		/* free amount summed over all nodes */
+	sch_resource_t *node_free;	/* free amount per node: [node_ind * num_res + i] */
+	chunk **chunks;			/* [reference] the job's select chunks */
+	long long *chunk_total;		/* chunks all the nodes can hold */
+	long long *node_chunks;		/* chunks per node: [node_ind * num_chunks + c] */
+};
+
 struct bucket_bitpool {
 	pbs_bitmap *truth;		/* The actual bits.  This only changes if the bitmaps are changing */
 	int truth_ct;			/* number of 1 bits in truth bitmap*/
@@ -1183,6 +1268,13 @@ struct resresv_filter {
 	resource_resv *job;
 	schd_error *err;		/* reason why set can not run*/
 };
+
+/* argument to preempt_candidate_filter() */
+struct preempt_cand_filter {
+	status *policy;			/* policy info */
+	resource_resv *hjob;		/* the high priority job */
+	char *preempt_nodes;		/* from find_preempt_nodes() */
+};
 #ifdef	__cplusplus
 }
 #endif
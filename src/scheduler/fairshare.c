@@ -73,6 +73,7 @@
  * 	dup_fairshare_head()
  * 	free_fairshare_head()
  * 	reset_temp_usage()
+ * 	create_fairshare_index()
  *
  */
 #include <pbs_config.h>
@@ -99,6 +100,7 @@
 #ifdef NAS /* localmod 041 */
 #include "sort.h"
 #endif
+#include "undo_log.h"
 
 
 extern time_t last_decay;
@@ -122,6 +124,9 @@ add_child(group_info *ginfo, group_info *parent)
 		ginfo->parent = parent;
 		ginfo->resgroup = parent->cresgroup;
 		ginfo->gpath = create_group_path(ginfo);
+		ginfo->name_index = parent->name_index;
+		if (ginfo->name_index != NULL && ginfo->name != NULL)
+			tree_add_del(ginfo->name_index, ginfo->name, ginfo, TREE_OP_ADD);
 	}
 }
 
@@ -147,8 +152,9 @@ add_unknown(group_info *ginfo, group_info *root)
 
 /**
  * @brief
- *		find_group_info - recursive function to find a group_info in the
- *			  resgroup tree
+ *		find_group_info - find a group_info in the resgroup tree.  If root
+ *			  is the root of an indexed tree, the name index is used.
+ *			  Otherwise the sub-tree is searched recursively.
  *
  * @param[in]	name	-	name of the ginfo to find
  * @param[in]	root	-	the root of the current sub-tree
@@ -163,6 +169,9 @@ find_group_info(char *name, group_info *root)
 	if (root == NULL || name == NULL || !strcmp(name, root->name))
 		return root;
 
+	if (root->parent == NULL && root->name_index != NULL)
+		return find_tree(root->name_index, name);
+
 	ginfo = find_group_info(name, root->sibling);
 	if (ginfo == NULL)
 		ginfo = find_group_info(name, root->child);
@@ -233,6 +242,7 @@ new_group_info()
 	new->parent = NULL;
 	new->sibling = NULL;
 	new->child = NULL;
+	new->name_index = NULL;
 
 	return new;
 }
@@ -381,6 +391,11 @@ preload_tree()
 	root->cresgroup = 0;
 	root->tree_percentage = 1.0;
 
+	if (!create_fairshare_index(root)) {
+		free_fairshare_head(head);
+		return NULL;
+	}
+
 	if ((unknown = new_group_info()) == NULL) {
 		free_fairshare_head(head);
 		return NULL;
@@ -492,6 +507,8 @@ update_usage_on_run(resource_resv *resresv)
 	if (resresv->job->ginfo !=NULL) {
 		gpath = resresv->job->ginfo->gpath;
 		while (gpath != NULL) {
+			undo_save(resresv->server->undo, &gpath->ginfo->temp_usage,
+				sizeof(gpath->ginfo->temp_usage));
 			gpath->ginfo->temp_usage += u;
 			gpath = gpath->next;
 		}
@@ -976,7 +993,14 @@ dup_fairshare_tree(group_info *root, group_info *nparent)
 		return NULL;
 	}
 
-	add_child(nroot, nparent);
+	if (nparent == NULL) {
+		if (!create_fairshare_index(nroot)) {
+			free_fairshare_node(nroot);
+			return NULL;
+		}
+	}
+	else
+		add_child(nroot, nparent);
 
 
 	nroot->sibling = dup_fairshare_tree(root->sibling, nparent);
@@ -1014,6 +1038,12 @@ free_fairshare_node(group_info *node)
 	if (node == NULL)
 		return;
 
+	/* the root of the tree owns the name index */
+	if (node->parent == NULL && node->name_index != NULL) {
+		avl_destroy_index(node->name_index);
+		free(node->name_index);
+	}
+
 	free(node->name);
 	free_group_path_list(node->gpath);
 	free(node);
@@ -1173,3 +1203,29 @@ void reset_usage(group_info *node) {
 	node->usage = 1;
 	node->temp_usage = 1;
 }
+
+/**
+ * @brief
+ *		create the name index of a fairshare tree.  The index is maintained
+ *		by add_child() as nodes are added below root.
+ *
+ * @param[in,out]	root	-	root of the fairshare tree
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+int
+create_fairshare_index(group_info *root)
+{
+	if (root == NULL || root->name == NULL)
+		return 0;
+
+	if ((root->name_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return 0;
+	}
+	tree_add_del(root->name_index, root->name, root, TREE_OP_ADD);
+
+	return 1;
+}
@@ -48,8 +48,8 @@ extern "C" {
 void add_child(group_info *ginfo, group_info *parent);
 
 /*
- *      find_group_info - recursive function to find a ginfo in the
- resgroup tree
+ *      find_group_info - find a ginfo in the resgroup tree.  Uses the
+ *			  name index if root is the root of the tree
  */
 group_info *find_group_info(char *name, group_info *root);
 
@@ -213,6 +213,11 @@ void free_fairshare_tree(group_info *root);
  */
 void free_fairshare_node(group_info *node);
 
+/*
+ *	create_fairshare_index - create the name index of a fairshare tree
+ */
+int create_fairshare_index(group_info *root);
+
 /*
  *	new_fairshare_head - constructor
  */
@@ -54,6 +54,7 @@
  * 	update_last_running()
  * 	update_job_can_not_run()
  * 	run_job()
+ * 	flush_job_runs()
  * 	run_update_resresv()
  * 	sim_run_update_resresv()
  * 	should_backfill_with_job()
@@ -109,11 +110,16 @@
 #include "node_partition.h"
 #include "resource.h"
 #include "resource_resv.h"
+#include "attribute.h"
 #include "pbs_share.h"
 #include "pbs_internal.h"
 #include "limits_if.h"
 #include "pbs_version.h"
 #include "buckets.h"
+#include "mem_pool.h"
+#include "cycle_stats.h"
+#include "snapshot.h"
+#include "undo_log.h"
 
 
 #ifdef NAS
@@ -124,6 +130,20 @@
 static prev_job_info *last_running = NULL;
 static int last_running_size = 0;
 
+/*
+ * Async run requests queued by run_job() in throughput mode.  They are sent
+ * to the server with as few Async Run Jobs requests as possible by
+ * flush_job_runs().
+ */
+static int pend_run_sd = -1;			/* server the jobs are run on */
+static int pend_run_num = 0;			/* number of queued runs */
+static int pend_run_size = 0;			/* allocated size of the arrays */
+static char **pend_run_names = NULL;		/* job names */
+static char **pend_run_execvnodes = NULL;	/* where to run each job */
+static int pend_run_unsupported = 0;		/* server can't take Async Run Jobs */
+
+static int queue_job_run(int pbs_sd, resource_resv *rjob, char *execvnode);
+
 #ifdef WIN32
 extern void win_toolong(void);
 #endif
@@ -540,6 +560,8 @@ schedule(int cmd, int sd, char *runjobid)
 			 * may have been added.  Dump what we have so we'll requery them.
 			 */
 			reset_global_resource_ptrs();
+			reset_job_status_cache();
+			reset_resresv_verdict_cache();
 
 		case SCH_SCHEDULE_NEW:
 		case SCH_SCHEDULE_TERM:
@@ -558,6 +580,8 @@ schedule(int cmd, int sd, char *runjobid)
 				"reconfigure", "Scheduler is reconfiguring");
 			free_fairshare_head(conf.fairshare);
 			reset_global_resource_ptrs();
+			reset_job_status_cache();
+			reset_resresv_verdict_cache();
 			free(conf.prime_sort);
 			free(conf.non_prime_sort);
 
@@ -570,6 +594,7 @@ schedule(int cmd, int sd, char *runjobid)
 			 * This is required since there is a probability that scheduler's configuration has been changed at
 			 * server through qmgr.
 			 */
+			reset_resresv_verdict_cache();
 			if (!update_svr_schedobj(connector, 0, 0)) {
 				sprintf(log_buffer, "update_svr_schedobj failed");
 				log_err(-1, __func__, log_buffer);
@@ -660,14 +685,19 @@ scheduling_cycle(int sd, char *jobid)
 	schdlog(PBSEVENT_DEBUG, PBS_EVENTCLASS_REQUEST, LOG_DEBUG,
 		"", "Starting Scheduling Cycle");
 
-	update_cycle_status(&cstat, 0);
+	start_cycle_stats();
+	update_cycle_status(&cstat, replay_time);
+	snapshot_begin_cycle(cstat.current_time);
 
 #ifdef NAS /* localmod 030 */
 	do_soft_cycle_interrupt = 0;
 	do_hard_cycle_interrupt = 0;
 #endif /* localmod 030 */
 	/* create the server / queue / job / node structures */
-	if ((sinfo = query_server(&cstat, sd)) == NULL) {
+	begin_phase(PHASE_QUERY_SERVER);
+	sinfo = query_server(&cstat, sd);
+	end_phase(PHASE_QUERY_SERVER);
+	if (sinfo == NULL) {
 		schdlog(PBSEVENT_SYSTEM, PBS_EVENTCLASS_SERVER, LOG_NOTICE,
 			"", "Problem with creating server data structure");
 		end_cycle_tasks(sinfo);
@@ -731,14 +761,27 @@ scheduling_cycle(int sd, char *jobid)
 		}
 	}
 
+	/* a qrun job is always evaluated, so don't reuse verdicts for it */
+	if (jobid == NULL)
+		apply_resresv_verdict_cache(policy, sinfo);
+
 	/* run loop run */
-	if (error == 0)
+	if (error == 0) {
+		begin_phase(PHASE_MAIN_LOOP);
 		rc = main_sched_loop(policy, sd, sinfo, &err);
+		end_phase(PHASE_MAIN_LOOP);
+	}
+
+	if (jobid == NULL)
+		save_resresv_verdict_cache(policy, sinfo);
 
 	if (jobid != NULL) {
 		int def_rc = -1;
 		int i;
 
+		/* the qrun job's comment should be set before we answer the server */
+		flush_job_updates();
+
 		for (i = 0; i < MAX_DEF_REPLY && def_rc != 0; i++) {
 			/* smooth sailing, the job ran */
 			if (rc == SUCCESS)
@@ -834,6 +877,9 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 	schd_error *err;
 	schd_error *chk_lim_err;
 	unsigned int flags = NO_FLAGS;	/* flags to is_ok_to_run @see is_ok_to_run() */
+	int state_changed = 0;		/* a job has been run or preempted this cycle */
+	int num_preempted;		/* number of preempted jobs at the start of the cycle */
+	enum job_outcome outcome;	/* what happened to the job, for the cycle stats */
 	
 
 	if (policy == NULL || sinfo == NULL || rerr == NULL)
@@ -843,6 +889,8 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 	/* calculate the time which we've been in the cycle too long */
 	cycle_end_time = cycle_start_time + sinfo->sched_cycle_len;
 
+	num_preempted = sinfo->num_preempted;
+
 	chk_lim_err = new_schd_error();
 	if(chk_lim_err == NULL)
 		return -1;
@@ -880,16 +928,20 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 
 		schdlog(PBSEVENT_DEBUG, PBS_EVENTCLASS_JOB, LOG_DEBUG,
 			njob->name, "Considering job to run");
+		begin_job_stats(njob->name);
+		outcome = JOB_OUTCOME_NOT_RUN;
 
 		should_use_buckets = job_should_use_buckets(njob);
 		if(should_use_buckets)
 			flags = USE_BUCKETS;
 
+		begin_phase(PHASE_IS_OK_TO_RUN);
 		if (njob->is_shrink_to_fit) {
 			/* Pass the suitable heuristic for shrinking */
 			ns_arr = is_ok_to_run_STF(policy, sinfo, qinfo, njob, flags, err, shrink_job_algorithm);
 		} else
 			ns_arr = is_ok_to_run(policy, sinfo, qinfo, njob, flags, err);
+		end_phase(PHASE_IS_OK_TO_RUN);
 		
 		if (err->status_code == NEVER_RUN)
 			njob->can_never_run = 1;
@@ -906,9 +958,15 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				tj = njob;
 
 			if (rc != SCHD_ERROR) {
-				if(run_update_resresv(policy, sd, sinfo, qinfo, tj, ns_arr, RURR_ADD_END_EVENT, err) > 0 ) {
+				int run_rc;
+
+				begin_phase(PHASE_RUN_JOB);
+				run_rc = run_update_resresv(policy, sd, sinfo, qinfo, tj, ns_arr, RURR_ADD_END_EVENT, err);
+				end_phase(PHASE_RUN_JOB);
+				if (run_rc > 0) {
 					rc = SUCCESS;
 					sort_again = MAY_RESORT_JOBS;
+					outcome = JOB_OUTCOME_RUN;
 				} else {
 					/* if run_update_resresv() returns 0 and pbs_errno == PBSE_HOOKERROR,
 					 * then this job is required to be ignored in this scheduling cycle
@@ -920,14 +978,23 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				free_nspecs(ns_arr);
 		}
 		else if (policy->preempting && in_runnable_state(njob) && (!njob -> can_never_run)) {
-			if (find_and_preempt_jobs(policy, sd, njob, sinfo, err) > 0) {
+			int preempt_rc;
+
+			begin_phase(PHASE_PREEMPT);
+			preempt_rc = find_and_preempt_jobs(policy, sd, njob, sinfo, err);
+			end_phase(PHASE_PREEMPT);
+			if (preempt_rc > 0) {
 				rc = SUCCESS;
 				sort_again = MUST_RESORT_JOBS;
+				outcome = JOB_OUTCOME_RUN_PREEMPTING;
 			}
 			else
 				sort_again = SORTED;
 		}
 
+		if (rc == SUCCESS || sinfo->num_preempted != num_preempted)
+			state_changed = 1;
+
 #ifdef NAS /* localmod 034 */
 		if (rc == SUCCESS && !site_is_queue_topjob_set_aside(njob)) {
 			site_bump_topjobs(njob);
@@ -954,9 +1021,12 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 			sort_again = SORTED;
 			if (should_backfill_with_job(policy, sinfo, njob, num_topjobs) != 0) {
 #endif
+				begin_phase(PHASE_CALENDAR);
 				cal_rc = add_job_to_calendar(sd, policy, sinfo, njob, should_use_buckets);
+				end_phase(PHASE_CALENDAR);
 
 				if (cal_rc > 0) { /* Success! */
+					outcome = JOB_OUTCOME_CALENDARED;
 #ifdef NAS /* localmod 034 */
 					switch(bf_rc)
 					{
@@ -1039,6 +1109,8 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 				if (rc != RUN_FAILURE &&  !ec->can_not_run) {
 					ec->can_not_run = 1;
 					ec->err = dup_schd_error(err);
+					/* only verdicts reached in the state the cycle started in can be reused */
+					ec->keep_verdict = !state_changed;
 				}
 			}
 		}
@@ -1107,6 +1179,7 @@ main_sched_loop(status *policy, int sd, server_info *sinfo, schd_error **rerr)
 
 		/* send any attribute updates to server that we've collected */
 		send_job_updates(sd, njob);
+		end_job_stats(outcome);
 	}
 
 	*rerr = err;
@@ -1129,6 +1202,11 @@ end_cycle_tasks(server_info *sinfo)
 {
 	int i;
 
+	begin_phase(PHASE_END_CYCLE);
+
+	/* send the job attribute updates collected during the cycle */
+	flush_job_updates();
+
 	/* keep track of update used resources for fairshare */
 	if (sinfo != NULL && sinfo->policy->fair_share)
 		update_last_running(sinfo);
@@ -1158,6 +1236,12 @@ end_cycle_tasks(server_info *sinfo)
 		cmp_aoename = NULL;
 	}
 
+	log_mem_pool_stats();
+
+	end_phase(PHASE_END_CYCLE);
+	write_cycle_stats();
+	snapshot_end_cycle();
+
 	got_sigpipe = 0;
 	schdlog(PBSEVENT_DEBUG, PBS_EVENTCLASS_REQUEST, LOG_DEBUG,
 		"", "Leaving Scheduling Cycle");
@@ -1318,13 +1402,13 @@ run_job(int pbs_sd, resource_resv *rjob, char *execvnode, int throughput, schd_e
 					schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_NOTICE, rjob->name, logbuf);
 				}
 				if (throughput)
-					rc = pbs_asyrunjob(pbs_sd, rjob->name, execvnode, NULL);
+					rc = queue_job_run(pbs_sd, rjob, execvnode);
 				else
 					rc = pbs_runjob(pbs_sd, rjob->name, execvnode, NULL);
 			}
 		} else {
 			if (throughput)
-				rc = pbs_asyrunjob(pbs_sd, rjob->name, execvnode, NULL);
+				rc = queue_job_run(pbs_sd, rjob, execvnode);
 			else
 				rc = pbs_runjob(pbs_sd, rjob->name, execvnode, NULL);
 		}
@@ -1347,6 +1431,210 @@ run_job(int pbs_sd, resource_resv *rjob, char *execvnode, int throughput, schd_e
 	return rc;
 }
 
+/**
+ * @brief
+ * 		queue an async run request to be sent by flush_job_runs()
+ *
+ * @par
+ * 		The job is considered running from now on.  If the server later
+ * 		refuses to run it, flush_job_runs() logs why and updates its comment;
+ * 		the next cycle sees the job's real state.  A qrun job is run right
+ * 		away since the server waits on the scheduler's answer for it.
+ *
+ * @param[in]	pbs_sd	-	connection descriptor to pbs_server
+ * @param[in]	rjob	-	the job to run
+ * @param[in]	execvnode	-	the execvnode to run the job on
+ *
+ * @return	int
+ * @retval	0	: success
+ * @retval	!0	: pbs_errno of the failure to run the job
+ */
+static int
+queue_job_run(int pbs_sd, resource_resv *rjob, char *execvnode)
+{
+	char **tmp_names;
+	char **tmp_execvnodes;
+	char *name = NULL;
+	char *ev = NULL;
+
+	if (rjob->server->qrun_job == NULL) {
+		if (pend_run_num > 0 && pbs_sd != pend_run_sd)
+			flush_job_runs();
+
+		if (pend_run_num == pend_run_size) {
+			int new_size = (pend_run_size == 0) ? 64 : pend_run_size * 2;
+
+			tmp_names = realloc(pend_run_names, new_size * sizeof(char *));
+			if (tmp_names != NULL) {
+				pend_run_names = tmp_names;
+				tmp_execvnodes = realloc(pend_run_execvnodes, new_size * sizeof(char *));
+				if (tmp_execvnodes != NULL) {
+					pend_run_execvnodes = tmp_execvnodes;
+					pend_run_size = new_size;
+				}
+			}
+		}
+
+		if (pend_run_num < pend_run_size) {
+			name = string_dup(rjob->name);
+			ev = string_dup(execvnode == NULL ? "" : execvnode);
+		}
+
+		if (name != NULL && ev != NULL) {
+			pend_run_names[pend_run_num] = name;
+			pend_run_execvnodes[pend_run_num] = ev;
+			pend_run_num++;
+			pend_run_sd = pbs_sd;
+
+			if (pend_run_num >= MAX_JOB_RUNS_PER_REQ)
+				flush_job_runs();
+			return 0;
+		}
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free(name);
+		free(ev);
+	}
+
+	/* keep the order the server sees requests in */
+	flush_job_runs();
+
+	return pbs_asyrunjob(pbs_sd, rjob->name, execvnode, NULL);
+}
+
+/**
+ * @brief
+ * 		log and comment on a job queued by queue_job_run() which the
+ * 		server refused to run
+ *
+ * @param[in]	pbs_sd	-	connection descriptor to pbs_server
+ * @param[in]	job_name	-	name of the job
+ * @param[in]	code	-	PBS error code from the server
+ * @param[in]	errbuf	-	error message from the server
+ *
+ * @return	void
+ */
+static void
+job_run_failed(int pbs_sd, char *job_name, int code, char *errbuf)
+{
+	char comment[MAX_LOG_SIZE];
+	char log_msg[MAX_LOG_SIZE];
+	char buf[MAX_LOG_SIZE];
+	struct attrl *pattr;
+	schd_error *err;
+
+	err = new_schd_error();
+	if (err == NULL)
+		return;
+
+	set_schd_error_codes(err, NOT_RUN, RUN_FAILURE);
+	set_schd_error_arg(err, ARG1, errbuf == NULL ? "" : errbuf);
+	snprintf(buf, sizeof(buf), "%d", code);
+	set_schd_error_arg(err, ARG2, buf);
+	translate_fail_code(err, comment, log_msg);
+	free_schd_error(err);
+
+	if (log_msg[0] != '\0')
+		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO,
+			job_name, log_msg);
+
+	if (comment[0] != '\0' && conf.update_comments) {
+		pattr = new_attrl();
+		if (pattr == NULL)
+			return;
+		pattr->name = string_dup(ATTR_comment);
+		pattr->value = string_dup(comment);
+		if (pattr->name == NULL || pattr->value == NULL) {
+			free_attrl(pattr);
+			return;
+		}
+		queue_job_updates(pbs_sd, job_name, pattr);
+	}
+}
+
+/**
+ * @brief
+ * 		send the async run requests queued by queue_job_run()
+ *
+ * @par
+ * 		Jobs are sent MAX_JOB_RUNS_PER_REQ at a time with pbs_asyrunjobs().
+ * 		If the server doesn't know the Async Run Jobs request, we fall back
+ * 		to one pbs_asyrunjob() per job.  This needs to be called before
+ * 		anything else is sent to the server about the queued jobs.
+ *
+ * @return	void
+ */
+void
+flush_job_runs(void)
+{
+	int codes[MAX_JOB_RUNS_PER_REQ];
+	char logbuf[MAX_LOG_SIZE];
+	char **names;
+	char **execvnodes;
+	char *errbuf;
+	int num_runs;
+	int sd;
+	int start;
+	int num;
+	int rc;
+	int i;
+
+	if (pend_run_num == 0)
+		return;
+
+	/* take the queue, a failure's comment may flush it again */
+	names = pend_run_names;
+	execvnodes = pend_run_execvnodes;
+	num_runs = pend_run_num;
+	sd = pend_run_sd;
+	pend_run_names = NULL;
+	pend_run_execvnodes = NULL;
+	pend_run_num = 0;
+	pend_run_size = 0;
+
+	for (start = 0; start < num_runs && !got_sigpipe; start += num) {
+		num = num_runs - start;
+		if (num > MAX_JOB_RUNS_PER_REQ)
+			num = MAX_JOB_RUNS_PER_REQ;
+
+		if (!pend_run_unsupported) {
+			rc = pbs_asyrunjobs(sd, num, &names[start], &execvnodes[start],
+				codes, NULL);
+			if (rc == 0) {
+				for (i = 0; i < num; i++) {
+					if (codes[i] != PBSE_NONE)
+						job_run_failed(sd, names[start + i], codes[i],
+							pbse_to_txt(codes[i]));
+				}
+				continue;
+			}
+			if (rc != PBSE_UNKREQ) {
+				errbuf = pbs_geterrmsg(sd);
+				snprintf(logbuf, MAX_LOG_SIZE,
+					"Failed to run %d jobs: %s (%d)",
+					num, errbuf == NULL ? "" : errbuf, rc);
+				schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING,
+					"", logbuf);
+				continue;
+			}
+			pend_run_unsupported = 1;
+			schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_INFO, "",
+				"Server does not support Async Run Jobs, running jobs one at a time");
+		}
+		for (i = 0; i < num; i++) {
+			if (pbs_asyrunjob(sd, names[start + i], execvnodes[start + i], NULL) != 0)
+				job_run_failed(sd, names[start + i], pbs_errno,
+					pbs_geterrmsg(sd));
+		}
+	}
+
+	for (i = 0; i < num_runs; i++) {
+		free(names[i]);
+		free(execvnodes[i]);
+	}
+	free(names);
+	free(execvnodes);
+}
+
 #ifdef NAS_CLUSTER /* localmod 125 */
 /**
  * @brief
@@ -1429,6 +1717,7 @@ run_update_resresv(status *policy, int pbs_sd, server_info *sinfo,
 	resource_resv *rr;
 	char *err_txt = NULL;
 	char old_state = 0;
+	undo_log *ul = NULL;
 
 	if (resresv == NULL || sinfo == NULL)
 		ret = -1;
@@ -1448,9 +1737,13 @@ run_update_resresv(status *policy, int pbs_sd, server_info *sinfo,
 		return ret;
 	}
 
+	ul = sinfo->undo;
+	undo_resource_resv(ul, resresv);
+
 	pbs_errno = PBSE_NONE;
 	if (resresv->is_job && resresv->job->is_suspended) {
 		if (pbs_sd != SIMULATE_SD) {
+			flush_job_runs();
 			pbsrc = pbs_sigjob(pbs_sd, resresv->name, "resume", NULL);
 			if (!pbsrc)
 				ret = 1;
@@ -1470,6 +1763,9 @@ run_update_resresv(status *policy, int pbs_sd, server_info *sinfo,
 			ret = 1;
 
 		rr = resresv;
+		/* the nspecs are combined below, change a copy when simulating */
+		undo_copy_ptr(undo_owner(ul, rr), (void **) &rr->nspec_arr,
+			(undo_copy_func_t) copy_nspec_array, (undo_func_t) free_nspecs);
 		ns = resresv->nspec_arr;
 		/* we didn't use nspec_arr, we need to free it */
 		free_nspecs(ns_arr);
@@ -1495,10 +1791,14 @@ run_update_resresv(status *policy, int pbs_sd, server_info *sinfo,
 		} else
 			rr = resresv;
 
+		undo_resource_resv(ul, rr);
+
 		/* Where should we run our resresv? */
 
 		/* 1) if the resresv knows where it should be run, run it there */
 		if (rr->nspec_arr != NULL) {
+			undo_copy_ptr(undo_owner(ul, rr), (void **) &rr->nspec_arr,
+				(undo_copy_func_t) copy_nspec_array, (undo_func_t) free_nspecs);
 			ns = rr->nspec_arr;
 			/* we didn't use nspec_arr, we need to free it */
 			free_nspecs(ns_arr);
@@ -1615,6 +1915,8 @@ run_update_resresv(status *policy, int pbs_sd, server_info *sinfo,
 		 * nodes into 1 entry for updating our local data structures
 		 */
 		combine_nspec_array(ns);
+		undo_own(undo_owner(ul, rr), (void **) &rr->nspec_arr,
+			(undo_func_t) free_nspecs);
 		rr->nspec_arr = ns;
 
 		if (rr->is_job && !(flags & RURR_NOPRINT)) {
@@ -1636,6 +1938,9 @@ run_update_resresv(status *policy, int pbs_sd, server_info *sinfo,
 		}
 
 		if (array != NULL) {
+			undo_resource_resv(ul, array);
+			undo_copy_ptr(undo_owner(ul, array), (void **) &array->job->queued_subjobs,
+				(undo_copy_func_t) dup_range_list, (undo_func_t) free_range_list);
 			update_array_on_run(array->job, rr->job);
 
 			/* Subjobs inherit all attributes from their parent job array. This means
@@ -1891,7 +2196,8 @@ add_job_to_calendar(int pbs_sd, status *policy, server_info *sinfo,
 		 * Note: We only ever look from now into the future
 		 */
 		nexte = get_next_event(sinfo->calendar);
-		if (find_timed_event(nexte, topjob->name, TIMED_NOEVENT, 0) != NULL)
+		if (nexte != NULL && find_calendar_event(sinfo->calendar, nexte,
+			topjob->name, TIMED_NOEVENT, 0) != NULL)
 			return 1;
 	}
 	if ((nsinfo = dup_server_info(sinfo)) == NULL)
@@ -2273,11 +2579,14 @@ next_job(status *policy, server_info *sinfo, int flag)
 			skip = SKIP_RESERVATIONS;
 	}
 
-	if ((sort_status != SORTED) || ((flag == MAY_RESORT_JOBS) && policy->fair_share)
-		|| (flag == MUST_RESORT_JOBS)) {
+	if ((sort_status != SORTED) || (flag == MUST_RESORT_JOBS)) {
 		sort_jobs(policy, sinfo);
 		sort_status = SORTED;
 		last_job_index = 0;
+	} else if ((flag == MAY_RESORT_JOBS) && policy->fair_share) {
+		/* only the jobs whose fairshare usage changed need to move */
+		resort_jobs(policy, sinfo);
+		last_job_index = 0;
 	}
 	if (policy->round_robin) {
 		/* Below is a pictorial representation of how queue_list
@@ -176,6 +176,11 @@ int add_job_to_calendar(int pbs_sd, status *policy, server_info *sinfo, resource
  */
 int run_job(int pbs_sd, resource_resv *rjob, char *execvnode, int throughput, schd_error *err);
 
+/*
+ *	flush_job_runs - send the async run requests run_job() queued
+ */
+void flush_job_runs(void);
+
 /*
  *	should_backfill_with_job - should we call add_job_to_calendar() with job
  *	returns 1: we should backfill 0: we should not
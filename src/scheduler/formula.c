@@ -0,0 +1,953 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+/**
+ * @file    formula.c
+ *
+ * @brief
+ * 		formula.c - This file contains the native evaluator for formulas
+ *		(job_sort_formula and fairshare_usage_res).  A formula is compiled
+ *		once into a small stack program and then evaluated for each job
+ *		without the embedded python interpreter.  The evaluator follows
+ *		python 2 arithmetic (e.g. integer division floors).  Formulas which
+ *		use python syntax it doesn't know are left to python.
+ *
+ * Functions included are:
+ * 	find_compiled_formula()
+ * 	eval_compiled_formula()
+ * 	reset_formula_cache()
+ *
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <log.h>
+#include <libutil.h>
+#include <pbs_share.h>
+#include "formula.h"
+#include "data_types.h"
+#include "resource_resv.h"
+#include "constant.h"
+#include "config.h"
+#include "globals.h"
+#include "misc.h"
+
+/* number of different formulas kept compiled at once */
+#define FORMULA_CACHE_SIZE 4
+
+/* instructions of a compiled formula.  Operands are on a value stack */
+enum formula_op
+{
+	FOP_NUM,		/* push a constant */
+	FOP_RES,		/* push a consumable resource of the job */
+	FOP_ELIGIBLE_TIME,	/* push a special case key word */
+	FOP_QUEUE_PRIO,
+	FOP_JOB_PRIO,
+	FOP_FSPERC,
+	FOP_TREE_USAGE,
+	FOP_FSFACTOR,
+	FOP_ACCRUE_TYPE,
+	FOP_NEG,
+	FOP_POS,
+	FOP_ADD,
+	FOP_SUB,
+	FOP_MUL,
+	FOP_DIV,
+	FOP_FLOORDIV,
+	FOP_MOD,
+	FOP_POW,
+	FOP_LT,
+	FOP_LE,
+	FOP_GT,
+	FOP_GE,
+	FOP_EQ,
+	FOP_NE,
+	FOP_ABS,
+	FOP_MIN,
+	FOP_MAX,
+	FOP_INT,
+	FOP_FLOAT
+};
+
+/* a formula value.  Like python 2, integers and floats are kept apart */
+struct formula_val
+{
+	double num;
+	int is_int;
+};
+
+struct formula_inst
+{
+	enum formula_op op;
+	struct formula_val val;		/* constant for FOP_NUM */
+	char *res_name;			/* resource for FOP_RES */
+	int argc;			/* number of operands for FOP_MIN/FOP_MAX */
+};
+
+struct formula_prog
+{
+	struct formula_inst *insts;
+	int ninsts;
+	int max_depth;			/* deepest the value stack gets */
+	struct formula_val *stack;	/* value stack used to evaluate */
+};
+
+/* state of the parser while compiling a formula */
+struct formula_parser
+{
+	const char *cur;		/* next character to parse */
+	formula_prog *prog;		/* program being emitted */
+	int size;			/* allocated number of instructions */
+	int depth;			/* current depth of the value stack */
+	int unsupported;		/* formula needs python */
+	int error;			/* malloc failed */
+};
+
+struct formula_cache_ent
+{
+	char *formula;
+	formula_prog *prog;		/* NULL if the formula is left to python */
+};
+
+static struct formula_cache_ent formula_cache[FORMULA_CACHE_SIZE];
+static int formula_cache_next;		/* entry to replace when the cache is full */
+
+/* the special case key words - map to the same values python sees */
+static const struct
+{
+	char *name;
+	enum formula_op op;
+} formula_keywords[] = {
+	{FORMULA_ELIGIBLE_TIME, FOP_ELIGIBLE_TIME},
+	{FORMULA_QUEUE_PRIO, FOP_QUEUE_PRIO},
+	{FORMULA_JOB_PRIO, FOP_JOB_PRIO},
+	{FORMULA_FSPERC, FOP_FSPERC},
+	{FORMULA_FSPERC_DEP, FOP_FSPERC},
+	{FORMULA_TREE_USAGE, FOP_TREE_USAGE},
+	{FORMULA_FSFACTOR, FOP_FSFACTOR},
+	{FORMULA_ACCRUE_TYPE, FOP_ACCRUE_TYPE},
+	{NULL, FOP_NUM}
+};
+
+/* the python builtin functions the native evaluator knows */
+static const struct
+{
+	char *name;
+	enum formula_op op;
+	int min_args;
+	int max_args;
+} formula_funcs[] = {
+	{"abs", FOP_ABS, 1, 1},
+	{"min", FOP_MIN, 2, -1},
+	{"max", FOP_MAX, 2, -1},
+	{"pow", FOP_POW, 2, 2},
+	{"int", FOP_INT, 1, 1},
+	{"float", FOP_FLOAT, 1, 1},
+	{NULL, FOP_NUM, 0, 0}
+};
+
+static void parse_expr(struct formula_parser *fp);
+
+/**
+ * @brief
+ * 		formula_prog destructor
+ *
+ * @param[in]	prog	-	compiled formula to free
+ */
+static void
+free_formula_prog(formula_prog *prog)
+{
+	int i;
+
+	if (prog == NULL)
+		return;
+
+	for (i = 0; i < prog->ninsts; i++)
+		free(prog->insts[i].res_name);
+	free(prog->insts);
+	free(prog->stack);
+	free(prog);
+}
+
+/**
+ * @brief
+ * 		append an instruction to the program being compiled
+ *
+ * @param[in]	fp  - parser state
+ * @param[in]	op  - instruction to append
+ * @param[in]	pop - number of values the instruction pops
+ *
+ * @return	the new instruction
+ * @retval	NULL	: malloc failed
+ */
+static struct formula_inst *
+emit_inst(struct formula_parser *fp, enum formula_op op, int pop)
+{
+	formula_prog *prog = fp->prog;
+	struct formula_inst *inst;
+
+	if (prog->ninsts == fp->size) {
+		inst = realloc(prog->insts, (fp->size * 2 + 8) * sizeof(struct formula_inst));
+		if (inst == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			fp->error = 1;
+			return NULL;
+		}
+		prog->insts = inst;
+		fp->size = fp->size * 2 + 8;
+	}
+
+	inst = &prog->insts[prog->ninsts++];
+	inst->op = op;
+	inst->val.num = 0;
+	inst->val.is_int = 1;
+	inst->res_name = NULL;
+	inst->argc = pop;
+
+	/* every instruction leaves one value on the stack */
+	fp->depth += 1 - pop;
+	if (fp->depth > prog->max_depth)
+		prog->max_depth = fp->depth;
+
+	return inst;
+}
+
+/**
+ * @brief
+ * 		skip spaces and check if the parser is in a good state
+ *
+ * @param[in]	fp	-	parser state
+ *
+ * @return	int
+ * @retval	1	: parsing can continue
+ * @retval	0	: parsing has failed
+ */
+static int
+parse_ok(struct formula_parser *fp)
+{
+	while (*fp->cur == ' ' || *fp->cur == '\t')
+		fp->cur++;
+
+	return !fp->unsupported && !fp->error;
+}
+
+/**
+ * @brief
+ * 		parse a number literal
+ *
+ * @param[in]	fp	-	parser state
+ */
+static void
+parse_number(struct formula_parser *fp)
+{
+	struct formula_inst *inst;
+	const char *p = fp->cur;
+	char *endp;
+	int is_int = 1;
+	double num;
+
+	/* python 2 octal, hex and binary literals are left to python */
+	if (p[0] == '0' && p[1] != '\0' && strchr("0123456789xXoObB", p[1]) != NULL) {
+		fp->unsupported = 1;
+		return;
+	}
+
+	while (isdigit((int)*p))
+		p++;
+	if (*p == '.') {
+		is_int = 0;
+		for (p++; isdigit((int)*p); p++)
+			;
+	}
+	if (*p == 'e' || *p == 'E')
+		is_int = 0;
+
+	num = strtod(fp->cur, &endp);
+	/* long (L) or complex (j) suffixes or junk right after the number */
+	if (endp == fp->cur || isalnum((int)*endp) || *endp == '_' || *endp == '.') {
+		fp->unsupported = 1;
+		return;
+	}
+	fp->cur = endp;
+
+	if ((inst = emit_inst(fp, FOP_NUM, 0)) == NULL)
+		return;
+	inst->val.num = num;
+	inst->val.is_int = is_int;
+}
+
+/**
+ * @brief
+ * 		parse a name: a key word, a consumable resource or a function call
+ *
+ * @param[in]	fp	-	parser state
+ */
+static void
+parse_name(struct formula_parser *fp)
+{
+	struct formula_inst *inst;
+	char name[MAX_RES_NAME_SIZE];
+	const char *start = fp->cur;
+	int is_var = 0;
+	int argc = 0;
+	int len;
+	int i;
+
+	while (isalnum((int)*fp->cur) || *fp->cur == '_')
+		fp->cur++;
+	len = fp->cur - start;
+	if (len >= MAX_RES_NAME_SIZE) {
+		fp->unsupported = 1;
+		return;
+	}
+	strncpy(name, start, len);
+	name[len] = '\0';
+
+	/* the key words are set after the resources, so they win */
+	for (i = 0; formula_keywords[i].name != NULL; i++) {
+		if (strcmp(name, formula_keywords[i].name) == 0)
+			break;
+	}
+	if (formula_keywords[i].name != NULL) {
+		if (!parse_ok(fp) || *fp->cur == '(') {
+			fp->unsupported = 1;
+			return;
+		}
+		emit_inst(fp, formula_keywords[i].op, 0);
+		return;
+	}
+
+	for (i = 0; consres[i] != NULL; i++) {
+		if (strcmp(name, consres[i]->name) == 0)
+			break;
+	}
+	if (consres[i] != NULL)
+		is_var = 1;
+
+	if (!parse_ok(fp))
+		return;
+
+	if (*fp->cur != '(') {
+		if (!is_var) {
+			/* python would raise a NameError (or it is a python key word) */
+			fp->unsupported = 1;
+			return;
+		}
+		if ((inst = emit_inst(fp, FOP_RES, 0)) == NULL)
+			return;
+		if ((inst->res_name = string_dup(name)) == NULL)
+			fp->error = 1;
+		return;
+	}
+
+	/* function call - a resource with a function's name hides the function */
+	for (i = 0; formula_funcs[i].name != NULL; i++) {
+		if (strcmp(name, formula_funcs[i].name) == 0)
+			break;
+	}
+	if (is_var || formula_funcs[i].name == NULL) {
+		fp->unsupported = 1;
+		return;
+	}
+
+	fp->cur++;
+	if (!parse_ok(fp))
+		return;
+	if (*fp->cur != ')') {
+		while (1) {
+			parse_expr(fp);
+			argc++;
+			if (!parse_ok(fp))
+				return;
+			if (*fp->cur != ',')
+				break;
+			fp->cur++;
+		}
+	}
+	if (!parse_ok(fp))
+		return;
+	if (*fp->cur != ')' || argc < formula_funcs[i].min_args ||
+		(formula_funcs[i].max_args != -1 && argc > formula_funcs[i].max_args)) {
+		fp->unsupported = 1;
+		return;
+	}
+	fp->cur++;
+
+	emit_inst(fp, formula_funcs[i].op, argc);
+}
+
+/**
+ * @brief
+ * 		parse an atom: a number, a name or a parenthesized expression
+ *
+ * @param[in]	fp	-	parser state
+ */
+static void
+parse_atom(struct formula_parser *fp)
+{
+	if (!parse_ok(fp))
+		return;
+
+	if (*fp->cur == '(') {
+		fp->cur++;
+		parse_expr(fp);
+		if (!parse_ok(fp))
+			return;
+		if (*fp->cur != ')') {
+			fp->unsupported = 1;
+			return;
+		}
+		fp->cur++;
+	} else if (isdigit((int)*fp->cur) || (*fp->cur == '.' && isdigit((int)fp->cur[1])))
+		parse_number(fp);
+	else if (isalpha((int)*fp->cur) || *fp->cur == '_')
+		parse_name(fp);
+	else
+		fp->unsupported = 1;
+}
+
+static void parse_factor(struct formula_parser *fp);
+
+/**
+ * @brief
+ * 		parse a power: atom [** factor]
+ *
+ * @param[in]	fp	-	parser state
+ */
+static void
+parse_power(struct formula_parser *fp)
+{
+	parse_atom(fp);
+	if (!parse_ok(fp))
+		return;
+
+	if (fp->cur[0] == '*' && fp->cur[1] == '*') {
+		fp->cur += 2;
+		parse_factor(fp);
+		if (!parse_ok(fp))
+			return;
+		emit_inst(fp, FOP_POW, 2);
+	}
+}
+
+/**
+ * @brief
+ * 		parse a factor: unary + or - applied to a factor, or a power
+ *
+ * @param[in]	fp	-	parser state
+ */
+static void
+parse_factor(struct formula_parser *fp)
+{
+	enum formula_op op;
+
+	if (!parse_ok(fp))
+		return;
+
+	if (*fp->cur == '-' || *fp->cur == '+') {
+		op = (*fp->cur == '-') ? FOP_NEG : FOP_POS;
+		fp->cur++;
+		parse_factor(fp);
+		if (!parse_ok(fp))
+			return;
+		emit_inst(fp, op, 1);
+	} else
+		parse_power(fp);
+}
+
+/**
+ * @brief
+ * 		parse a term: factors joined by *, /, // or %
+ *
+ * @param[in]	fp	-	parser state
+ */
+static void
+parse_term(struct formula_parser *fp)
+{
+	enum formula_op op;
+
+	parse_factor(fp);
+	while (parse_ok(fp)) {
+		if (fp->cur[0] == '/' && fp->cur[1] == '/') {
+			op = FOP_FLOORDIV;
+			fp->cur += 2;
+		} else if (fp->cur[0] == '*' && fp->cur[1] != '*') {
+			op = FOP_MUL;
+			fp->cur++;
+		} else if (fp->cur[0] == '/') {
+			op = FOP_DIV;
+			fp->cur++;
+		} else if (fp->cur[0] == '%') {
+			op = FOP_MOD;
+			fp->cur++;
+		} else
+			break;
+
+		/* augmented assignment (e.g. *=) isn't an expression */
+		if (*fp->cur == '=') {
+			fp->unsupported = 1;
+			return;
+		}
+		parse_factor(fp);
+		if (!parse_ok(fp))
+			return;
+		emit_inst(fp, op, 2);
+	}
+}
+
+/**
+ * @brief
+ * 		parse an arithmetic expression: terms joined by + or -
+ *
+ * @param[in]	fp	-	parser state
+ */
+static void
+parse_arith(struct formula_parser *fp)
+{
+	enum formula_op op;
+
+	parse_term(fp);
+	while (parse_ok(fp) && (*fp->cur == '+' || *fp->cur == '-')) {
+		op = (*fp->cur == '+') ? FOP_ADD : FOP_SUB;
+		fp->cur++;
+		if (*fp->cur == '=') {
+			fp->unsupported = 1;
+			return;
+		}
+		parse_term(fp);
+		if (!parse_ok(fp))
+			return;
+		emit_inst(fp, op, 2);
+	}
+}
+
+/**
+ * @brief
+ * 		parse an expression: an arithmetic expression optionally compared
+ *		to another one.  Chained comparisons are left to python.
+ *
+ * @param[in]	fp	-	parser state
+ */
+static void
+parse_expr(struct formula_parser *fp)
+{
+	enum formula_op op;
+	const char *c;
+
+	parse_arith(fp);
+	if (!parse_ok(fp))
+		return;
+
+	c = fp->cur;
+	if (c[0] == '<' && c[1] == '=')
+		op = FOP_LE;
+	else if (c[0] == '>' && c[1] == '=')
+		op = FOP_GE;
+	else if (c[0] == '=' && c[1] == '=')
+		op = FOP_EQ;
+	else if (c[0] == '!' && c[1] == '=')
+		op = FOP_NE;
+	else if (c[0] == '<' && c[1] != '>' && c[1] != '<')
+		op = FOP_LT;
+	else if (c[0] == '>' && c[1] != '>')
+		op = FOP_GT;
+	else
+		return;
+
+	fp->cur += (op == FOP_LT || op == FOP_GT) ? 1 : 2;
+	parse_arith(fp);
+	if (!parse_ok(fp))
+		return;
+	emit_inst(fp, op, 2);
+
+	if (strchr("<>=!", *fp->cur) != NULL && *fp->cur != '\0')
+		fp->unsupported = 1;
+}
+
+/**
+ * @brief
+ * 		compile a formula into a program for the native evaluator
+ *
+ * @param[in]	formula     - formula text
+ * @param[out]	unsupported - set to 1 if the formula needs python
+ *
+ * @return	compiled formula
+ * @retval	NULL	: formula needs python or malloc failed
+ */
+static formula_prog *
+compile_formula(char *formula, int *unsupported)
+{
+	struct formula_parser fp;
+	formula_prog *prog;
+
+	*unsupported = 0;
+
+	if ((prog = calloc(1, sizeof(formula_prog))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	memset(&fp, 0, sizeof(fp));
+	fp.cur = formula;
+	fp.prog = prog;
+
+	parse_expr(&fp);
+	if (parse_ok(&fp) && *fp.cur != '\0')
+		fp.unsupported = 1;
+
+	if (!fp.unsupported && !fp.error) {
+		prog->stack = malloc(prog->max_depth * sizeof(struct formula_val));
+		if (prog->stack == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			fp.error = 1;
+		}
+	}
+
+	if (fp.unsupported || fp.error) {
+		*unsupported = fp.unsupported;
+		free_formula_prog(prog);
+		return NULL;
+	}
+
+	return prog;
+}
+
+/**
+ * @brief
+ * 		find a formula in the compiled formula cache.  A formula not in
+ *		the cache is compiled and added to it.
+ *
+ * @param[in]	formula	-	formula text
+ *
+ * @return	compiled formula
+ * @retval	NULL	: the formula must be evaluated by python
+ *
+ * @par MT-Safe:	no
+ */
+formula_prog *
+find_compiled_formula(char *formula)
+{
+	struct formula_cache_ent *ent;
+	formula_prog *prog;
+	char logbuf[MAX_LOG_SIZE];
+	int unsupported;
+	int i;
+
+	if (formula == NULL || consres == NULL)
+		return NULL;
+
+	for (i = 0; i < FORMULA_CACHE_SIZE; i++) {
+		if (formula_cache[i].formula != NULL &&
+			strcmp(formula_cache[i].formula, formula) == 0)
+			return formula_cache[i].prog;
+	}
+
+	prog = compile_formula(formula, &unsupported);
+	/* don't remember malloc failures, try again next time */
+	if (prog == NULL && !unsupported)
+		return NULL;
+
+	ent = &formula_cache[formula_cache_next];
+	formula_cache_next = (formula_cache_next + 1) % FORMULA_CACHE_SIZE;
+	free(ent->formula);
+	free_formula_prog(ent->prog);
+	ent->prog = NULL;
+
+	if ((ent->formula = string_dup(formula)) == NULL) {
+		free_formula_prog(prog);
+		return NULL;
+	}
+	ent->prog = prog;
+
+	if (prog == NULL) {
+		snprintf(logbuf, sizeof(logbuf),
+			"Formula will be evaluated by python: %s", formula);
+		schdlog(PBSEVENT_DEBUG, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, logbuf);
+	}
+
+	return prog;
+}
+
+/**
+ * @brief
+ * 		get the value python would see for a number printed with "%.*f"
+ *
+ * @param[in]	num    - number
+ * @param[in]	digits - digits after the decimal point
+ * @param[out]	val    - value
+ */
+static void
+printed_val(double num, int digits, struct formula_val *val)
+{
+	char buf[128];
+
+	snprintf(buf, sizeof(buf), "%.*f", digits, num);
+	val->num = strtod(buf, NULL);
+	val->is_int = 0;
+}
+
+/**
+ * @brief
+ * 		evaluate a compiled formula for a job
+ *
+ * @param[in]	prog    - compiled formula
+ * @param[in]	resresv - job for special case key words
+ * @param[in]	resreq  - resources to use when evaluating
+ * @param[out]	ans     - evaluated answer
+ * @param[out]	err     - python's message for the error on failure
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: evaluation error (e.g. division by zero)
+ *
+ * @par MT-Safe:	no
+ */
+int
+eval_compiled_formula(formula_prog *prog, resource_resv *resresv,
+	resource_req *resreq, sch_resource_t *ans, const char **err)
+{
+	struct formula_val *stack;
+	struct formula_val *a;
+	struct formula_val *b;
+	struct formula_inst *inst;
+	resource_req *req;
+	job_info *job;
+	int sp = 0;
+	int i;
+	int j;
+
+	if (prog == NULL || resresv == NULL || resresv->job == NULL || ans == NULL)
+		return 0;
+
+	stack = prog->stack;
+	job = resresv->job;
+
+	for (i = 0; i < prog->ninsts; i++) {
+		inst = &prog->insts[i];
+		switch (inst->op) {
+			case FOP_NUM:
+				stack[sp++] = inst->val;
+				continue;
+			case FOP_RES:
+				a = &stack[sp++];
+				req = find_resource_req_by_str(resreq, inst->res_name);
+				if (req == NULL) {
+					a->num = 0;
+					a->is_int = 1;
+				} else if ((j = float_digits(req->amount, FLOAT_NUM_DIGITS)) == 0) {
+					/* printed without a decimal point - python sees an int */
+					a->num = floor(req->amount + 0.5);
+					a->is_int = 1;
+				} else
+					printed_val(req->amount, j, a);
+				continue;
+			case FOP_ELIGIBLE_TIME:
+			case FOP_QUEUE_PRIO:
+			case FOP_JOB_PRIO:
+			case FOP_ACCRUE_TYPE:
+				a = &stack[sp++];
+				a->is_int = 1;
+				if (inst->op == FOP_ELIGIBLE_TIME)
+					a->num = job->eligible_time;
+				else if (inst->op == FOP_QUEUE_PRIO)
+					a->num = job->queue != NULL ? job->queue->priority : 0;
+				else if (inst->op == FOP_JOB_PRIO)
+					a->num = job->priority;
+				else
+					a->num = job->accrue_type;
+				continue;
+			case FOP_FSPERC:
+			case FOP_TREE_USAGE:
+			case FOP_FSFACTOR:
+				a = &stack[sp++];
+				if (job->ginfo == NULL)
+					printed_val(0, 6, a);
+				else if (inst->op == FOP_FSPERC)
+					printed_val(job->ginfo->tree_percentage, 6, a);
+				else if (inst->op == FOP_TREE_USAGE)
+					printed_val(job->ginfo->usage_factor, 6, a);
+				else
+					printed_val(job->ginfo->tree_percentage == 0 ? 0 :
+						pow(2, -(job->ginfo->usage_factor / job->ginfo->tree_percentage)), 6, a);
+				continue;
+			default:
+				break;
+		}
+
+		/* operators - the result replaces the first operand */
+		sp -= inst->argc;
+		a = &stack[sp++];
+		b = a + 1;
+
+		switch (inst->op) {
+			case FOP_NEG:
+				a->num = -a->num;
+				break;
+			case FOP_POS:
+				break;
+			case FOP_ADD:
+				a->num += b->num;
+				a->is_int = a->is_int && b->is_int;
+				break;
+			case FOP_SUB:
+				a->num -= b->num;
+				a->is_int = a->is_int && b->is_int;
+				break;
+			case FOP_MUL:
+				a->num *= b->num;
+				a->is_int = a->is_int && b->is_int;
+				break;
+			case FOP_DIV:
+			case FOP_FLOORDIV:
+				a->is_int = a->is_int && b->is_int;
+				if (b->num == 0) {
+					if (a->is_int)
+						*err = "integer division or modulo by zero";
+					else
+						*err = (inst->op == FOP_DIV) ? "float division by zero" : "float divmod()";
+					return 0;
+				}
+				/* python 2 floors the division of two integers */
+				if (a->is_int || inst->op == FOP_FLOORDIV)
+					a->num = floor(a->num / b->num);
+				else
+					a->num /= b->num;
+				break;
+			case FOP_MOD:
+				a->is_int = a->is_int && b->is_int;
+				if (b->num == 0) {
+					*err = a->is_int ? "integer division or modulo by zero" : "float modulo";
+					return 0;
+				}
+				/* python's modulo takes the sign of the divisor */
+				a->num = fmod(a->num, b->num);
+				if (a->num != 0 && ((a->num < 0) != (b->num < 0)))
+					a->num += b->num;
+				break;
+			case FOP_POW:
+				if (!(a->is_int && b->is_int && b->num >= 0)) {
+					if (a->num == 0 && b->num < 0) {
+						*err = "0.0 cannot be raised to a negative power";
+						return 0;
+					}
+					if (a->num < 0 && b->num != floor(b->num)) {
+						*err = "negative number cannot be raised to a fractional power";
+						return 0;
+					}
+					a->is_int = 0;
+				}
+				a->num = pow(a->num, b->num);
+				break;
+			case FOP_LT:
+				a->num = a->num < b->num;
+				a->is_int = 1;
+				break;
+			case FOP_LE:
+				a->num = a->num <= b->num;
+				a->is_int = 1;
+				break;
+			case FOP_GT:
+				a->num = a->num > b->num;
+				a->is_int = 1;
+				break;
+			case FOP_GE:
+				a->num = a->num >= b->num;
+				a->is_int = 1;
+				break;
+			case FOP_EQ:
+				a->num = a->num == b->num;
+				a->is_int = 1;
+				break;
+			case FOP_NE:
+				a->num = a->num != b->num;
+				a->is_int = 1;
+				break;
+			case FOP_ABS:
+				a->num = fabs(a->num);
+				break;
+			case FOP_MIN:
+			case FOP_MAX:
+				/* like python, the first of equal values wins */
+				for (j = 1; j < inst->argc; j++) {
+					if ((inst->op == FOP_MIN && a[j].num < a->num) ||
+						(inst->op == FOP_MAX && a[j].num > a->num))
+						*a = a[j];
+				}
+				break;
+			case FOP_INT:
+				a->num = (a->num < 0) ? ceil(a->num) : floor(a->num);
+				a->is_int = 1;
+				break;
+			case FOP_FLOAT:
+				a->is_int = 0;
+				break;
+			default:
+				break;
+		}
+	}
+
+	*ans = stack[0].num;
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		free all compiled formulas.  Called when the resource definitions
+ *		change since a formula's names are resolved when it is compiled.
+ *
+ * @par MT-Safe:	no
+ */
+void
+reset_formula_cache(void)
+{
+	int i;
+
+	for (i = 0; i < FORMULA_CACHE_SIZE; i++) {
+		free(formula_cache[i].formula);
+		formula_cache[i].formula = NULL;
+		free_formula_prog(formula_cache[i].prog);
+		formula_cache[i].prog = NULL;
+	}
+	formula_cache_next = 0;
+}
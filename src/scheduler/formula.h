@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+#ifndef	_FORMULA_H
+#define	_FORMULA_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include "data_types.h"
+
+/* a formula compiled for the native evaluator */
+typedef struct formula_prog formula_prog;
+
+/*
+ *	find_compiled_formula - find a formula in the compiled formula cache,
+ *				compiling it if it isn't there yet
+ *
+ *	  formula - formula text
+ *
+ *	return compiled formula or NULL if it must be evaluated by python
+ */
+formula_prog *find_compiled_formula(char *formula);
+
+/*
+ *	eval_compiled_formula - evaluate a compiled formula for a job
+ *
+ *	  prog    - compiled formula
+ *	  resresv - job for special case key words
+ *	  resreq  - resources to use when evaluating
+ *	  ans     - [out] evaluated answer
+ *	  err     - [out] python style error message on failure
+ *
+ *	return 1 on success / 0 on an evaluation error
+ */
+int eval_compiled_formula(formula_prog *prog, resource_resv *resresv,
+	resource_req *resreq, sch_resource_t *ans, const char **err);
+
+/*
+ *	reset_formula_cache - free all compiled formulas
+ */
+void reset_formula_cache(void);
+
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* _FORMULA_H */
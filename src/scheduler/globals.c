@@ -168,3 +168,6 @@ char path_log[_MAX_PATH];
 char path_log[_POSIX_PATH_MAX];
 #endif
 int dflt_sched = 0;
+
+/* time of the cycle being replayed by pbs_sched_replay, 0 otherwise */
+time_t replay_time = 0;
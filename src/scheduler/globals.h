@@ -84,6 +84,7 @@ extern char path_log[_MAX_PATH];
 extern char path_log[_POSIX_PATH_MAX];
 #endif
 extern int dflt_sched;
+extern time_t replay_time;
 
 
 /**
@@ -44,10 +44,15 @@
  * Functions included are:
  * 	query_jobs()
  * 	query_job()
+ * 	query_job_in_pool()
+ * 	query_jobs_in_pool()
+ * 	free_job_query()
  * 	new_job_info()
  * 	free_job_info()
  * 	set_job_state()
  * 	update_job_attr()
+ * 	queue_job_updates()
+ * 	flush_job_updates()
  * 	send_job_updates()
  * 	send_attr_updates()
  * 	unset_job_attr()
@@ -60,6 +65,10 @@
  * 	preempt_job()
  * 	find_and_preempt_jobs()
  * 	find_jobs_to_preempt()
+ * 	non_consumable_resdefs()
+ * 	preempt_node_fits()
+ * 	find_preempt_nodes()
+ * 	preempt_candidate_filter()
  * 	select_index_to_preempt()
  * 	preempt_level()
  * 	set_preempt_prio()
@@ -82,6 +91,12 @@
  * 	is_finished_job()
  * 	preemption_similarity()
  * 	geteoename()
+ * 	reset_job_status_cache()
+ * 	prep_job_status_cache()
+ * 	sweep_job_status_cache()
+ * 	reset_resresv_verdict_cache()
+ * 	apply_resresv_verdict_cache()
+ * 	save_resresv_verdict_cache()
  *
  */
 #include <pbs_config.h>
@@ -98,6 +113,9 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <math.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
 #include <pbs_ifl.h>
 #include <log.h>
 #include <libutil.h>
@@ -111,6 +129,7 @@
 #include "misc.h"
 #include "config.h"
 #include "globals.h"
+#include "snapshot.h"
 #include "fairshare.h"
 #include "node_info.h"
 #include "check.h"
@@ -123,6 +142,10 @@
 #include "resource.h"
 #include "server_info.h"
 #include "attribute.h"
+#include "avltree.h"
+#include "formula.h"
+#include "thread_pool.h"
+#include "undo_log.h"
 
 #ifdef NAS
 #include "site_code.h"
@@ -132,6 +155,25 @@
 
 extern char *pbse_to_txt(int err);
 
+#ifndef WIN32
+/* guards the fairshare tree and execvnode parsing while jobs are queried in parallel */
+static pthread_mutex_t query_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LOCK_QUERY()	pthread_mutex_lock(&query_lock)
+#define UNLOCK_QUERY()	pthread_mutex_unlock(&query_lock)
+#else
+#define LOCK_QUERY()
+#define UNLOCK_QUERY()
+#endif
+
+/* the jobs of one query_jobs() call being converted by the thread pool */
+struct job_query
+{
+	struct batch_status **jobs;	/* batch_status of each job */
+	server_info *sinfo;		/* server the jobs belong to */
+	resource_resv **resresvs;	/* converted jobs, in the order of jobs */
+	schd_error **errs;		/* error of each conversion */
+};
+
 /**
  *	This table contains job comment and information messages that correspond
  *	to the sched_error enums in "constant.h".  The order of the strings in
@@ -494,6 +536,672 @@ static struct fc_translation_table fctt[] = {
 #define	ERR2COMMENT(code)	(fctt[(code) - RET_BASE].fc_comment)
 #define	ERR2INFO(code)		(fctt[(code) - RET_BASE].fc_info)
 
+/*
+ * Cross-cycle cache of job batch_status entries used for delta job queries.
+ * Only jobs in a state which can't change behind our back (i.e. not running)
+ * are cached.  An entry is valid as long as the job's mtime has not changed
+ * and is older than when the entry was fetched.
+ */
+struct job_status_cache
+{
+	char *mtime;				/* job's mtime when it was cached */
+	time_t cached_at;			/* cycle time the entry was fetched */
+	unsigned long long seen;		/* last cycle the job was seen in */
+	struct batch_status *bs;		/* copy of the job's batch_status */
+	struct job_status_cache *next;
+};
+
+static AVL_IX_DESC *jsc_index = NULL;		/* job name -> cache entry */
+static struct job_status_cache *jsc_list = NULL;/* all cache entries */
+static time_t jsc_last_query = 0;		/* time of the last cached query */
+static int jsc_cycles = 0;			/* cycles since the last full query */
+static int jsc_resync = 1;			/* do a full query this cycle */
+
+/* job states which are served from the job status cache */
+#define JSC_CACHE_STATES	"QHWT"
+/* job states which are always queried from the server */
+#define JSC_VOLATILE_STATES	"BERSUX"
+/* slop (in seconds) subtracted from the last query time for mtime queries
+ * and from the time an entry was fetched when deciding if it is current
+ */
+#define JSC_MTIME_SLOP		2
+
+/*
+ * Job attribute updates queued by send_job_updates().  They are sent to the
+ * server with as few Modify Jobs requests as possible by flush_job_updates().
+ */
+static int pend_sd = -1;			/* server the updates are for */
+static int pend_num = 0;			/* number of queued updates */
+static int pend_size = 0;			/* allocated size of the arrays */
+static char **pend_names = NULL;		/* job names */
+static struct attrl **pend_attrs = NULL;	/* attributes for each job */
+static int pend_unsupported = 0;		/* server can't take Modify Jobs */
+
+/**
+ * @brief
+ *		find the value of an attribute in a batch_status
+ *
+ * @param[in]	bs	-	batch_status to search
+ * @param[in]	name	-	name of the attribute
+ *
+ * @return	char *
+ * @retval	value of the attribute
+ * @retval	NULL	: attribute not found
+ */
+static char *
+find_bs_attr_value(struct batch_status *bs, char *name)
+{
+	struct attrl *attrp;
+
+	if (bs == NULL || name == NULL)
+		return NULL;
+
+	for (attrp = bs->attribs; attrp != NULL; attrp = attrp->next)
+		if (!strcmp(attrp->name, name))
+			return attrp->value;
+
+	return NULL;
+}
+
+/**
+ * @brief
+ *		duplicate a single job batch_status.  The copy can be freed
+ *		with pbs_statfree()
+ *
+ * @param[in]	obs	-	batch_status to duplicate
+ *
+ * @return	struct batch_status *
+ * @retval	duplicated batch_status
+ * @retval	NULL	: on error
+ */
+static struct batch_status *
+dup_job_status(struct batch_status *obs)
+{
+	struct batch_status *nbs;
+
+	if (obs == NULL)
+		return NULL;
+
+	if ((nbs = malloc(sizeof(struct batch_status))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	nbs->next = NULL;
+	nbs->name = string_dup(obs->name);
+	nbs->text = string_dup(obs->text);
+	nbs->attribs = dup_attrl_list(obs->attribs);
+
+	if (nbs->name == NULL || (obs->attribs != NULL && nbs->attribs == NULL)) {
+		pbs_statfree(nbs);
+		return NULL;
+	}
+
+	return nbs;
+}
+
+/**
+ * @brief
+ *		free a job status cache entry.  The entry must already be
+ *		unlinked from jsc_list and removed from jsc_index
+ *
+ * @param[in]	ent	-	entry to free
+ *
+ * @return	nothing
+ */
+static void
+free_job_status_cache_ent(struct job_status_cache *ent)
+{
+	if (ent == NULL)
+		return;
+
+	if (ent->mtime != NULL)
+		free(ent->mtime);
+	if (ent->bs != NULL)
+		pbs_statfree(ent->bs);
+	free(ent);
+}
+
+/**
+ * @brief
+ *		can a job be served from its job status cache entry
+ *
+ * @par	mtime only has a resolution of a second.  A job changed in the
+ *		same second it was fetched (e.g. the comment we set at the end of
+ *		a short cycle) keeps the mtime we cached, so entries whose mtime is
+ *		that close to when they were fetched are always fetched again.
+ *
+ * @param[in]	ent	-	cache entry
+ * @param[in]	mtime	-	job's current mtime from the light query
+ *
+ * @return	int
+ * @retval	1	: the job has not changed since it was cached
+ * @retval	0	: it has or may have
+ */
+static int
+job_status_cache_current(struct job_status_cache *ent, char *mtime)
+{
+	if (ent == NULL || mtime == NULL || strcmp(ent->mtime, mtime))
+		return 0;
+
+	if ((time_t) strtol(mtime, NULL, 10) >= ent->cached_at - JSC_MTIME_SLOP)
+		return 0;
+
+	return 1;
+}
+
+/**
+ * @brief
+ *		add (or replace) a job's batch_status in the job status cache.
+ *		Jobs which are not in a cacheable state are removed from it.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	bs	-	job's batch_status (it is copied)
+ *
+ * @return	nothing
+ */
+static void
+cache_job_status(status *policy, struct batch_status *bs)
+{
+	struct job_status_cache *ent;
+	struct batch_status *nbs;
+	char *mtime;
+	char *state;
+
+	if (policy == NULL || bs == NULL)
+		return;
+
+	if (jsc_index == NULL) {
+		if ((jsc_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return;
+		}
+	}
+
+	mtime = find_bs_attr_value(bs, ATTR_mtime);
+	state = find_bs_attr_value(bs, ATTR_state);
+
+	ent = find_tree(jsc_index, bs->name);
+
+	/* job is in a state we don't cache; forget about it */
+	if (mtime == NULL || state == NULL || strpbrk(state, JSC_CACHE_STATES) == NULL) {
+		if (ent != NULL)
+			ent->seen = 0;	/* swept at the end of the cycle */
+		return;
+	}
+
+	if ((nbs = dup_job_status(bs)) == NULL)
+		return;
+
+	if (ent == NULL) {
+		if ((ent = calloc(1, sizeof(struct job_status_cache))) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			pbs_statfree(nbs);
+			return;
+		}
+		if (tree_add_del(jsc_index, nbs->name, ent, TREE_OP_ADD) != 0) {
+			free(ent);
+			pbs_statfree(nbs);
+			return;
+		}
+		ent->next = jsc_list;
+		jsc_list = ent;
+	} else {
+		if (ent->mtime != NULL)
+			free(ent->mtime);
+		if (ent->bs != NULL)
+			pbs_statfree(ent->bs);
+	}
+
+	ent->mtime = string_dup(mtime);
+	ent->bs = nbs;
+	ent->cached_at = policy->current_time;
+	ent->seen = policy->iteration;
+}
+
+/**
+ * @brief
+ *		create a batch_status from a job status cache entry.  Attributes
+ *		which change with time without the job's mtime changing are
+ *		brought up to date.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	ent	-	cache entry
+ *
+ * @return	struct batch_status *
+ * @retval	batch_status for the job
+ * @retval	NULL	: on error
+ */
+static struct batch_status *
+job_status_from_cache(status *policy, struct job_status_cache *ent)
+{
+	struct batch_status *nbs;
+	struct attrl *attrp;
+	char *accrue_type;
+	char timebuf[128];
+	time_t elig;
+
+	if (policy == NULL || ent == NULL)
+		return NULL;
+
+	if ((nbs = dup_job_status(ent->bs)) == NULL)
+		return NULL;
+
+	/* eligible_time is computed by the server when the job is stat'd.
+	 * If the job is accruing eligible time, add the time since we cached it.
+	 */
+	accrue_type = find_bs_attr_value(nbs, ATTR_accrue_type);
+	if (accrue_type != NULL && !strcmp(accrue_type, ACCRUE_ELIG) &&
+		policy->current_time > ent->cached_at) {
+		for (attrp = nbs->attribs; attrp != NULL; attrp = attrp->next) {
+			if (!strcmp(attrp->name, ATTR_eligible_time)) {
+				elig = (time_t) res_to_num(attrp->value, NULL);
+				elig += policy->current_time - ent->cached_at;
+				convert_duration_to_str(elig, timebuf, sizeof(timebuf));
+				free(attrp->value);
+				if ((attrp->value = string_dup(timebuf)) == NULL) {
+					pbs_statfree(nbs);
+					return NULL;
+				}
+				break;
+			}
+		}
+	}
+
+	return nbs;
+}
+
+/**
+ * @brief
+ *		free the job status cache
+ *
+ * @par	The next cycle will do a full job query.  Called when the
+ *		scheduler is (re)configured or when the cache can't be trusted.
+ *
+ * @return	nothing
+ */
+void
+reset_job_status_cache(void)
+{
+	struct job_status_cache *ent;
+	struct job_status_cache *next_ent;
+
+	for (ent = jsc_list; ent != NULL; ent = next_ent) {
+		next_ent = ent->next;
+		free_job_status_cache_ent(ent);
+	}
+	jsc_list = NULL;
+
+	if (jsc_index != NULL) {
+		avl_destroy_index(jsc_index);
+		free(jsc_index);
+		jsc_index = NULL;
+	}
+
+	jsc_last_query = 0;
+	jsc_cycles = 0;
+	jsc_resync = 1;
+}
+
+/**
+ * @brief
+ *		decide if this cycle's job queries can be served from the job
+ *		status cache or if a full query is needed.  Called at the start
+ *		of query_server()
+ *
+ * @param[in]	policy	-	policy info
+ *
+ * @return	nothing
+ */
+void
+prep_job_status_cache(status *policy)
+{
+	if (!conf.job_query_delta) {
+		if (jsc_list != NULL || jsc_index != NULL)
+			reset_job_status_cache();
+		return;
+	}
+
+	if (jsc_last_query == 0 ||
+		(conf.job_query_resync > 0 && jsc_cycles >= conf.job_query_resync)) {
+		jsc_resync = 1;
+		jsc_cycles = 0;
+	} else
+		jsc_resync = 0;
+}
+
+/**
+ * @brief
+ *		remove entries for jobs not seen this cycle from the job status
+ *		cache and remember when the cycle's queries were made.  Called
+ *		after query_server() has successfully queried all the jobs.
+ *
+ * @param[in]	policy	-	policy info
+ *
+ * @return	nothing
+ */
+void
+sweep_job_status_cache(status *policy)
+{
+	struct job_status_cache *ent;
+	struct job_status_cache *prev_ent = NULL;
+	struct job_status_cache *next_ent;
+
+	if (policy == NULL || !conf.job_query_delta)
+		return;
+
+	for (ent = jsc_list; ent != NULL; ent = next_ent) {
+		next_ent = ent->next;
+		if (ent->seen != policy->iteration) {
+			if (prev_ent == NULL)
+				jsc_list = next_ent;
+			else
+				prev_ent->next = next_ent;
+			tree_add_del(jsc_index, ent->bs->name, NULL, TREE_OP_DEL);
+			free_job_status_cache_ent(ent);
+		} else
+			prev_ent = ent;
+	}
+
+	jsc_last_query = policy->current_time;
+	jsc_cycles++;
+}
+
+/**
+ * @brief
+ *		query the jobs in a queue using the job status cache.  A light
+ *		query of every job's mtime and state is made.  Only jobs which
+ *		are not in the cache or whose mtime has changed are fully queried.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	pbs_sd	-	connection to pbs_server
+ * @param[in]	queue_name	-	the name of the queue to query
+ * @param[out]	err	-	set to 1 if a query failed
+ *
+ * @return	struct batch_status *
+ * @retval	list of the jobs in the queue (free with pbs_statfree())
+ * @retval	NULL	: no jobs or error (see err)
+ */
+static struct batch_status *
+stat_jobs_delta(status *policy, int pbs_sd, char *queue_name, int *err)
+{
+	struct attropl opl = { NULL, ATTR_q, NULL, NULL, EQ };
+	struct attropl opl_vol[2] = { { &opl_vol[1], ATTR_q, NULL, NULL, EQ },
+		{ NULL, ATTR_state, NULL, JSC_VOLATILE_STATES, EQ } };
+	struct attropl opl_chg[3] = { { &opl_chg[1], ATTR_q, NULL, NULL, EQ },
+		{ &opl_chg[2], ATTR_state, NULL, JSC_CACHE_STATES, EQ },
+		{ NULL, ATTR_mtime, NULL, NULL, GE } };
+	static struct attrl light_attrs[2] = { { &light_attrs[1], ATTR_mtime, NULL, NULL, SET },
+		{ NULL, ATTR_state, NULL, NULL, SET } };
+	struct batch_status *light;
+	struct batch_status *fetched[2] = { NULL, NULL };
+	struct batch_status **fetched_arr = NULL;
+	struct batch_status *head = NULL;
+	struct batch_status *tail = NULL;
+	struct batch_status *cur;
+	struct batch_status *nbs;
+	struct job_status_cache *ent;
+	AVL_IX_DESC *fetched_index = NULL;
+	char since[32];
+	char *mtime;
+	char *state;
+	int num_vol = 0;
+	int num_chg = 0;
+	int num_fetched = 0;
+	int num_cached = 0;
+	int num_arr = 0;
+	int i;
+
+	*err = 0;
+	opl.value = queue_name;
+	opl_vol[0].value = queue_name;
+	opl_chg[0].value = queue_name;
+
+	if ((light = pbs_selstat(pbs_sd, &opl, light_attrs, "S")) == NULL) {
+		if (pbs_errno > 0)
+			*err = 1;
+		return NULL;
+	}
+
+	for (cur = light; cur != NULL; cur = cur->next) {
+		mtime = find_bs_attr_value(cur, ATTR_mtime);
+		state = find_bs_attr_value(cur, ATTR_state);
+		if (state == NULL || strpbrk(state, JSC_CACHE_STATES) == NULL)
+			num_vol++;
+		else {
+			ent = jsc_index == NULL ? NULL : find_tree(jsc_index, cur->name);
+			if (!job_status_cache_current(ent, mtime))
+				num_chg++;
+		}
+	}
+
+	if (num_vol > 0) {
+		if ((fetched[0] = pbs_selstat(pbs_sd, opl_vol, NULL, "S")) == NULL && pbs_errno > 0)
+			goto delta_err;
+	}
+	if (num_chg > 0) {
+		sprintf(since, "%ld", (long) (jsc_last_query - JSC_MTIME_SLOP));
+		opl_chg[2].value = since;
+		if ((fetched[1] = pbs_selstat(pbs_sd, opl_chg, NULL, "S")) == NULL && pbs_errno > 0)
+			goto delta_err;
+	}
+
+	/* index the fetched jobs by name so we can merge them in order */
+	for (i = 0; i < 2; i++)
+		for (cur = fetched[i]; cur != NULL; cur = cur->next)
+			num_fetched++;
+
+	if (num_fetched > 0) {
+		if ((fetched_arr = malloc(num_fetched * sizeof(struct batch_status *))) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			goto delta_err;
+		}
+		if ((fetched_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			goto delta_err;
+		}
+		for (i = 0; i < 2; i++) {
+			for (cur = fetched[i]; cur != NULL; cur = nbs) {
+				nbs = cur->next;
+				cur->next = NULL;
+				fetched_arr[num_arr] = cur;
+				tree_add_del(fetched_index, cur->name, &fetched_arr[num_arr], TREE_OP_ADD);
+				num_arr++;
+			}
+			fetched[i] = NULL;
+		}
+	}
+
+	num_fetched = 0;
+	for (cur = light; cur != NULL; cur = cur->next) {
+		struct batch_status **slot = NULL;
+
+		nbs = NULL;
+		mtime = find_bs_attr_value(cur, ATTR_mtime);
+		state = find_bs_attr_value(cur, ATTR_state);
+		ent = jsc_index == NULL ? NULL : find_tree(jsc_index, cur->name);
+
+		if (fetched_index != NULL)
+			slot = find_tree(fetched_index, cur->name);
+
+		if (slot != NULL && *slot != NULL) {
+			nbs = *slot;
+			*slot = NULL;
+			cache_job_status(policy, nbs);
+			num_fetched++;
+		} else if (state != NULL && strpbrk(state, JSC_CACHE_STATES) != NULL &&
+			job_status_cache_current(ent, mtime)) {
+			if ((nbs = job_status_from_cache(policy, ent)) == NULL)
+				goto delta_err;
+			ent->seen = policy->iteration;
+			num_cached++;
+		} else {
+			/* job changed between our queries, ask for it directly */
+			if ((nbs = pbs_statjob(pbs_sd, cur->name, NULL, "S")) == NULL)
+				continue;	/* job has gone away */
+			cache_job_status(policy, nbs);
+			num_fetched++;
+		}
+
+		if (head == NULL)
+			head = nbs;
+		else
+			tail->next = nbs;
+		tail = nbs;
+		while (tail->next != NULL)
+			tail = tail->next;
+	}
+
+	/* jobs which arrived after the light query */
+	for (i = 0; i < num_arr; i++) {
+		if (fetched_arr[i] != NULL) {
+			cache_job_status(policy, fetched_arr[i]);
+			if (head == NULL)
+				head = fetched_arr[i];
+			else
+				tail->next = fetched_arr[i];
+			tail = fetched_arr[i];
+			fetched_arr[i] = NULL;
+			num_fetched++;
+		}
+	}
+
+	sprintf(log_buffer, "Delta job query: %d jobs from cache, %d jobs fetched",
+		num_cached, num_fetched);
+	schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_QUEUE, LOG_DEBUG, queue_name, log_buffer);
+
+	if (fetched_index != NULL) {
+		avl_destroy_index(fetched_index);
+		free(fetched_index);
+	}
+	free(fetched_arr);
+	pbs_statfree(light);
+
+	return head;
+
+delta_err:
+	*err = 1;
+	if (fetched_arr != NULL) {
+		for (i = 0; i < num_arr; i++)
+			if (fetched_arr[i] != NULL)
+				pbs_statfree(fetched_arr[i]);
+		free(fetched_arr);
+	}
+	if (fetched_index != NULL) {
+		avl_destroy_index(fetched_index);
+		free(fetched_index);
+	}
+	pbs_statfree(fetched[0]);
+	pbs_statfree(fetched[1]);
+	pbs_statfree(head);
+	pbs_statfree(light);
+	return NULL;
+}
+
+/**
+ * @brief
+ *		convert one job of a job_query.  Called by the thread pool.
+ *
+ * @param[in]	index	-	index of the job to convert
+ * @param[in]	arg	-	the job_query
+ *
+ * @return	nothing
+ * @par MT-safe: Yes
+ */
+static void
+query_job_in_pool(int index, void *arg)
+{
+	struct job_query *jq = (struct job_query *) arg;
+
+	jq->resresvs[index] = query_job(jq->jobs[index], jq->sinfo, jq->errs[index]);
+}
+
+/**
+ * @brief
+ *		free a job_query and any converted jobs which have not been
+ *		taken from it
+ *
+ * @param[in]	jq	-	the job_query to free
+ * @param[in]	num	-	number of jobs in jq
+ *
+ * @return	nothing
+ */
+static void
+free_job_query(struct job_query *jq, int num)
+{
+	int i;
+
+	if (jq == NULL)
+		return;
+
+	for (i = 0; i < num; i++) {
+		if (jq->resresvs != NULL && jq->resresvs[i] != NULL)
+			free_resource_resv(jq->resresvs[i]);
+		if (jq->errs != NULL && jq->errs[i] != NULL)
+			free_schd_error(jq->errs[i]);
+	}
+	free(jq->jobs);
+	free(jq->resresvs);
+	free(jq->errs);
+	free(jq);
+}
+
+/**
+ * @brief
+ *		convert a list of jobs from the server with conf.query_threads
+ *		threads.  The converted jobs are kept in the order of the list so
+ *		the result does not depend on the number of threads.
+ *
+ * @param[in]	jobs	-	batch_status list of the jobs
+ * @param[in]	num	-	number of jobs in the list
+ * @param[in]	sinfo	-	server the jobs belong to
+ *
+ * @return	struct job_query *
+ * @retval	the converted jobs and their errors
+ * @retval	NULL	: on error
+ * @par MT-safe: No
+ */
+static struct job_query *
+query_jobs_in_pool(struct batch_status *jobs, int num, server_info *sinfo)
+{
+	struct job_query *jq;
+	struct batch_status *cur_job;
+	int i;
+
+	if ((jq = calloc(1, sizeof(struct job_query))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	jq->sinfo = sinfo;
+	jq->jobs = malloc(num * sizeof(struct batch_status *));
+	jq->resresvs = calloc(num, sizeof(resource_resv *));
+	jq->errs = calloc(num, sizeof(schd_error *));
+	if (jq->jobs == NULL || jq->resresvs == NULL || jq->errs == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free_job_query(jq, num);
+		return NULL;
+	}
+
+	for (i = 0, cur_job = jobs; i < num && cur_job != NULL; i++, cur_job = cur_job->next) {
+		jq->jobs[i] = cur_job;
+		if ((jq->errs[i] = new_schd_error()) == NULL) {
+			free_job_query(jq, num);
+			return NULL;
+		}
+	}
+
+	run_in_thread_pool(conf.query_threads, num, query_job_in_pool, jq);
+
+	for (i = 0; i < num; i++) {
+		if (jq->resresvs[i] == NULL) {
+			free_job_query(jq, num);
+			return NULL;
+		}
+	}
+
+	return jq;
+}
+
 /**
  * @brief
  * 		create an array of jobs in a specified queue
@@ -552,7 +1260,11 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 
 	schd_error *err;
 
+	/* jobs converted by the thread pool */
+	struct job_query *jq = NULL;
+
 	int i;
+	int j;
 	/* used for pbs_geterrmsg() */
 	char *errmsg;
 
@@ -574,8 +1286,28 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 
 	server_time = qinfo->server->server_time;
 
-	/* get jobs from PBS server */
-	if ((jobs = pbs_selstat(pbs_sd, &opl, NULL, "S")) == NULL) {
+	/* get jobs from PBS server.  Local queues may be served from the job
+	 * status cache.  If the delta query fails, fall back to a full query.
+	 */
+	if (conf.job_query_delta && !jsc_resync && pjobs == NULL && !qinfo->is_peer_queue) {
+		int delta_err = 0;
+
+		jobs = stat_jobs_delta(policy, pbs_sd, queue_name, &delta_err);
+		if (delta_err) {
+			schdlog(PBSEVENT_DEBUG, PBS_EVENTCLASS_QUEUE, LOG_DEBUG, queue_name,
+				"Delta job query failed, querying all jobs");
+			jsc_resync = 1;
+		}
+		else if (jobs == NULL) {
+			snapshot_status("pbs_selstat", NULL);
+			return pjobs;
+		}
+	}
+	else
+		jobs = NULL;
+
+	if (jobs == NULL && (jobs = pbs_selstat(pbs_sd, &opl, NULL, "S")) == NULL) {
+		snapshot_status("pbs_selstat", NULL);
 		if (pbs_errno > 0) {
 			errmsg = pbs_geterrmsg(pbs_sd);
 			if (errmsg == NULL)
@@ -585,6 +1317,13 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 		}
 		return pjobs;
 	}
+	else if (conf.job_query_delta && jsc_resync && pjobs == NULL && !qinfo->is_peer_queue) {
+		for (cur_job = jobs; cur_job != NULL; cur_job = cur_job->next)
+			cache_job_status(policy, cur_job);
+	}
+
+	/* a delta query is captured as the full list of jobs it was merged into */
+	snapshot_status("pbs_selstat", jobs);
 
 	/* count the number of new jobs */
 	cur_job = jobs;
@@ -619,15 +1358,34 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 		return NULL;
 	}
 
+	/* Convert the jobs up front with a pool of threads when there are
+	 * enough of them.  The rest of the work below stays serial.
+	 */
+	if (conf.query_threads > 1 && num_jobs - num_prev_jobs >= MIN_PARALLEL_QUERY) {
+		jq = query_jobs_in_pool(jobs, num_jobs - num_prev_jobs, qinfo->server);
+		if (jq == NULL) {
+			free_schd_error(err);
+			pbs_statfree(jobs);
+			free_resource_resv_array(resresv_arr);
+			return NULL;
+		}
+	}
+
 	i = num_prev_jobs;
-	for (cur_job = jobs; cur_job != NULL; cur_job = cur_job->next) {
+	for (cur_job = jobs, j = 0; cur_job != NULL; cur_job = cur_job->next, j++) {
 		char *selectspec = NULL;
-		if ((resresv = query_job(cur_job, qinfo->server, err)) ==NULL) {
+		if (jq != NULL) {
+			resresv = jq->resresvs[j];
+			jq->resresvs[j] = NULL;
+			move_schd_error(err, jq->errs[j]);
+		}
+		else if ((resresv = query_job(cur_job, qinfo->server, err)) ==NULL) {
 			free_schd_error(err);
 			pbs_statfree(jobs);
 			free_resource_resv_array(resresv_arr);
 			return NULL;
 		}
+		resresv->rank = get_sched_rank();
 
 		/* do a validity check to see if the job is sane.  If we're peering and
 		 * we're not a manager at the remote host, we wont have necessary attribs
@@ -905,6 +1663,7 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
 	}
 	resresv_arr[i] = NULL;
 
+	free_job_query(jq, num_jobs - num_prev_jobs);
 	pbs_statfree(jobs);
 	free_schd_error(err);
 
@@ -923,6 +1682,8 @@ query_jobs(status *policy, int pbs_sd, queue_info *qinfo, resource_resv **pjobs,
  *	@return resource_resv
  *	@retval job (may be invalid, if so, err will report why)
  *	@retval  or NULL on error
+ *
+ *	@par MT-safe: Yes - the job's rank is assigned by query_jobs()
  */
 
 resource_resv *
@@ -943,7 +1704,6 @@ query_job(struct batch_status *job, server_info *sinfo, schd_error *err)
 	}
 
 	resresv->name = string_dup(job->name);
-	resresv->rank = get_sched_rank();
 
 	attrp = job->attribs;
 
@@ -980,12 +1740,16 @@ query_job(struct batch_status *job, server_info *sinfo, schd_error *err)
 					 sinfo->fairshare->root );
 					 */
 					/* localmod 034 */
+					LOCK_QUERY();
 					resresv->job->sh_info = site_find_alloc_share(sinfo,
 						attrp->value);
+					UNLOCK_QUERY();
 				}
 #else
+				LOCK_QUERY();
 				resresv->job->ginfo = find_alloc_ginfo(attrp->value,
 					sinfo->fairshare->root);
+				UNLOCK_QUERY();
 #endif /* localmod 059 */
 			}
 			else
@@ -1053,14 +1817,17 @@ query_job(struct batch_status *job, server_info *sinfo, schd_error *err)
 		}
 		else if (!strcmp(attrp->name, ATTR_comment))	/* job comment */
 			resresv->job->comment = string_dup(attrp->value);
-		else if (!strcmp(attrp->name, ATTR_released)) /* resources_released */
+		else if (!strcmp(attrp->name, ATTR_released)) { /* resources_released */
+			LOCK_QUERY();
 			resresv->job->resreleased = parse_execvnode(attrp->value, sinfo);
+			UNLOCK_QUERY();
+		}
 		else if (!strcmp(attrp->name, ATTR_euser))	/* account name */
-			resresv->user = string_dup(attrp->value);
+			resresv->user = intern_string(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_egroup))	/* group name */
-			resresv->group = string_dup(attrp->value);
+			resresv->group = intern_string(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_project))	/* project name */
-			resresv->project = string_dup(attrp->value);
+			resresv->project = intern_string(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_resv_ID))	/* reserve_ID */
 			resresv->job->resv_id = string_dup(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_altid))    /* vendor ID */
@@ -1106,7 +1873,9 @@ query_job(struct batch_status *job, server_info *sinfo, schd_error *err)
 			 * chunk.  The rest of the scheduler expects one nspec per vnode.
 			 * This combining of vnode chunks is the job of combine_nspec_array().
 			 */
+			LOCK_QUERY();
 			resresv->nspec_arr = parse_execvnode(attrp->value, sinfo);
+			UNLOCK_QUERY();
 			combine_nspec_array(resresv->nspec_arr);
 
 			if (resresv->nspec_arr != NULL)
@@ -1269,6 +2038,8 @@ new_job_info()
 
 
 	jinfo->formula_value = 0.0;
+	jinfo->sort_fp = 0;
+	jinfo->sort_fp_new = 0;
 
 #ifdef RESC_SPEC
 	jinfo->rspec = NULL;
@@ -1514,17 +2285,223 @@ update_job_attr(int pbs_sd, resource_resv *resresv, char *attr_name,
 
 /**
  * @brief
- * 		send delayed job attribute updates for job using send_attr_updates().
+ * 		log the failure to update a job's attributes on the server
+ *
+ * @param[in]	job_name	-	name of the job
+ * @param[in]	pattr	-	attrl list which failed to update
+ * @param[in]	err	-	PBS error code of the failure
+ * @param[in]	errbuf	-	error message of the failure
+ *
+ * @return	void
+ */
+static void
+log_attr_update_failure(char *job_name, struct attrl *pattr, int err, char *errbuf)
+{
+	char logbuf[MAX_LOG_SIZE];
+	int one_attr = 0;
+
+	if (pattr->next == NULL)
+		one_attr = 1;
+
+	if (is_finished_job(err) == 1) {
+		if (one_attr)
+			snprintf(logbuf, MAX_LOG_SIZE,
+				"Failed to update attr \'%s\' = %s, "
+				"Job already finished",
+				pattr->name, pattr->value);
+		else
+			snprintf(logbuf, MAX_LOG_SIZE,
+				"Failed to update job attributes, "
+				"Job already finished");
+		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO,
+			job_name, logbuf);
+		return;
+	}
+
+	if (errbuf == NULL)
+		errbuf = "";
+	if (one_attr)
+		snprintf(logbuf, MAX_LOG_SIZE,
+			"Failed to update attr \'%s\' = %s: %s (%d)",
+			pattr->name, pattr->value, errbuf, err);
+	else
+		snprintf(logbuf, MAX_LOG_SIZE,
+			"Failed to update job attributes: %s (%d)",
+			errbuf, err);
+
+	schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING,
+		job_name, logbuf);
+}
+
+/**
+ * @brief
+ * 		alter one job on the server with pbs_alterjob()
+ *
+ * @param[in]	pbs_sd	-	server connection descriptor
+ * @param[in]	job_name	-	name of job for pbs_alterjob()
+ * @param[in]	pattr	-	attrl list to update on the server
+ *
+ * @return	int
+ * @retval	1	success
+ * @retval	0	failure to update
+ */
+static int
+alter_one_job(int pbs_sd, char *job_name, struct attrl *pattr)
+{
+	if (pbs_alterjob(pbs_sd, job_name, pattr, NULL) == 0)
+		return 1;
+
+	log_attr_update_failure(job_name, pattr, pbs_errno, pbs_geterrmsg(pbs_sd));
+	return 0;
+}
+
+/**
+ * @brief
+ * 		queue a job's attribute updates to be sent by flush_job_updates()
+ *
+ * @param[in]	pbs_sd	-	server connection descriptor
+ * @param[in]	job_name	-	name of the job
+ * @param[in]	pattr	-	attrl list to update, the queue takes ownership
+ *
+ * @return	int
+ * @retval	1	success
+ * @retval	0	failure to update
+ */
+int
+queue_job_updates(int pbs_sd, char *job_name, struct attrl *pattr)
+{
+	char **tmp_names;
+	struct attrl **tmp_attrs;
+	char *name = NULL;
+	int rc;
+
+	if (job_name == NULL || pattr == NULL) {
+		free_attrl_list(pattr);
+		return 0;
+	}
+
+	if (pbs_sd == SIMULATE_SD) {
+		free_attrl_list(pattr);
+		return 1; /* simulation always successful */
+	}
+
+	if (pend_num > 0 && pbs_sd != pend_sd)
+		flush_job_updates();
+
+	if (pend_num == pend_size) {
+		int new_size = (pend_size == 0) ? 64 : pend_size * 2;
+
+		tmp_names = realloc(pend_names, new_size * sizeof(char *));
+		if (tmp_names != NULL) {
+			pend_names = tmp_names;
+			tmp_attrs = realloc(pend_attrs, new_size * sizeof(struct attrl *));
+			if (tmp_attrs != NULL) {
+				pend_attrs = tmp_attrs;
+				pend_size = new_size;
+			}
+		}
+	}
+
+	if (pend_num < pend_size)
+		name = string_dup(job_name);
+
+	if (name == NULL) {
+		/* can't queue the update, send it right away */
+		log_err(errno, __func__, MEM_ERR_MSG);
+		rc = send_attr_updates(pbs_sd, job_name, pattr);
+		free_attrl_list(pattr);
+		return rc;
+	}
+
+	pend_names[pend_num] = name;
+	pend_attrs[pend_num] = pattr;
+	pend_num++;
+	pend_sd = pbs_sd;
+
+	if (pend_num >= MAX_JOB_UPDATES_PER_REQ)
+		flush_job_updates();
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		send the job attribute updates queued by send_job_updates()
  *
  * @par
- * 		The main reason to use this function over a direct send_attr_update()
- *      call is so that the job's attr_updates list gets free'd and NULL'd.
+ * 		Updates are sent MAX_JOB_UPDATES_PER_REQ jobs at a time with
+ * 		pbs_alterjobs().  If the server doesn't know the Modify Jobs
+ * 		request, we fall back to one pbs_alterjob() per job.
+ *
+ * @return	void
+ */
+void
+flush_job_updates(void)
+{
+	int codes[MAX_JOB_UPDATES_PER_REQ];
+	char logbuf[MAX_LOG_SIZE];
+	char *errbuf;
+	int start;
+	int num;
+	int rc;
+	int i;
+
+	/* the updates may be for jobs we have asked to run */
+	flush_job_runs();
+
+	for (start = 0; start < pend_num && !got_sigpipe; start += num) {
+		num = pend_num - start;
+		if (num > MAX_JOB_UPDATES_PER_REQ)
+			num = MAX_JOB_UPDATES_PER_REQ;
+
+		if (!pend_unsupported) {
+			rc = pbs_alterjobs(pend_sd, num, &pend_names[start],
+				&pend_attrs[start], codes, NULL);
+			if (rc == 0) {
+				for (i = 0; i < num; i++) {
+					if (codes[i] != PBSE_NONE)
+						log_attr_update_failure(pend_names[start + i],
+							pend_attrs[start + i], codes[i], pbse_to_txt(codes[i]));
+				}
+				continue;
+			}
+			if (rc != PBSE_UNKREQ) {
+				errbuf = pbs_geterrmsg(pend_sd);
+				snprintf(logbuf, MAX_LOG_SIZE,
+					"Failed to update attributes of %d jobs: %s (%d)",
+					num, errbuf == NULL ? "" : errbuf, rc);
+				schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING,
+					"", logbuf);
+				continue;
+			}
+			pend_unsupported = 1;
+			schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_INFO, "",
+				"Server does not support Modify Jobs, updating jobs one at a time");
+		}
+		for (i = 0; i < num; i++)
+			alter_one_job(pend_sd, pend_names[start + i], pend_attrs[start + i]);
+	}
+
+	for (i = 0; i < pend_num; i++) {
+		free(pend_names[i]);
+		free_attrl_list(pend_attrs[i]);
+	}
+	pend_num = 0;
+}
+
+/**
+ * @brief
+ * 		queue delayed job attribute updates for job to be sent with
+ * 		flush_job_updates().
+ *
+ * @par
+ * 		The job's attr_updates list is handed to the queue and NULL'd.
  *      We don't want to send the attr updates multiple times
  *
  * @param[in]	pbs_sd	-	server connection descriptor
  * @param[in]	job	-	job to send attributes to
  *
- * @return	int(ret val from send_attr_updates)
+ * @return	int
  * @retval	1	- success
  * @retval	0	- failure to update
  */
@@ -1534,15 +2511,18 @@ int send_job_updates(int pbs_sd, resource_resv *job) {
 	if(job == NULL)
 		return 0;
 
-	rc = send_attr_updates(pbs_sd, job->name, job->job->attr_updates) ;
+	rc = queue_job_updates(pbs_sd, job->name, job->job->attr_updates);
 
-	free_attrl_list(job->job->attr_updates);
 	job->job->attr_updates = NULL;
 	return rc;
 	}
 /**
  * @brief
- * 		send delayed attributes to the server for a job
+ * 		send attributes to the server for a job right away
+ *
+ * @par
+ * 		Any queued updates are flushed first so updates reach the server
+ * 		in the order they were made.
  *
  * @param[in]	pbs_sd	-	server connection descriptor
  * @param[in]	job_name	-	name of job for pbs_alterjob()
@@ -1553,53 +2533,15 @@ int send_job_updates(int pbs_sd, resource_resv *job) {
  * @retval	0	failure to update
  */
 int send_attr_updates(int pbs_sd, char *job_name, struct attrl *pattr) {
-	char *errbuf;
-	char logbuf[MAX_LOG_SIZE];
-	int one_attr = 0;
-
 	if (job_name == NULL || pattr == NULL)
 		return 0;
 
 	if (pbs_sd == SIMULATE_SD)
 		return 1; /* simulation always successful */
 
-	if (pattr->next == NULL)
-		one_attr = 1;
-
-	if (pbs_alterjob(pbs_sd, job_name, pattr, NULL) == 0)
-		return 1;
-
-	if (is_finished_job(pbs_errno) == 1) {
-		if (one_attr)
-			snprintf(logbuf, MAX_LOG_SIZE,
-				"Failed to update attr \'%s\' = %s, "
-				"Job already finished",
-				pattr->name, pattr->value);
-		else
-			snprintf(logbuf, MAX_LOG_SIZE,
-				"Failed to update job attributes, "
-				"Job already finished");
-		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO,
-			job_name, logbuf);
-		return 0;
-	}
-
-	errbuf = pbs_geterrmsg(pbs_sd);
-	if (errbuf == NULL)
-		errbuf = "";
-	if (one_attr)
-		snprintf(logbuf, MAX_LOG_SIZE,
-			"Failed to update attr \'%s\' = %s: %s (%d)",
-			pattr->name, pattr->value, errbuf, pbs_errno);
-	else
-		snprintf(logbuf, MAX_LOG_SIZE,
-			"Failed to update job attributes: %s (%d)",
-			errbuf, pbs_errno);
-
-	schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING,
-		job_name, logbuf);
+	flush_job_updates();
 
-	return 0;
+	return alter_one_job(pbs_sd, job_name, pattr);
 }
 
 /**
@@ -2001,6 +2943,9 @@ new_resresv_set(void)
 	rset->qinfo = NULL;
 	rset->resresv_arr = NULL;
 	rset->num_resresvs = 0;
+	rset->keep_verdict = 0;
+	rset->lim_fp = 0;
+	rset->res_fp = 0;
 
 	return rset;
 }
@@ -2013,9 +2958,6 @@ free_resresv_set(resresv_set *rset) {
 		return;
 
 	free_schd_error(rset->err);
-	free(rset->user);
-	free(rset->group);
-	free(rset->project);
 	free(rset->partition);
 	free_selspec(rset->select_spec);
 	free_place(rset->place_spec);
@@ -2055,6 +2997,9 @@ dup_resresv_set(resresv_set *oset, server_info *nsinfo)
 		return NULL;
 
 	rset->can_not_run = oset->can_not_run;
+	rset->keep_verdict = oset->keep_verdict;
+	rset->lim_fp = oset->lim_fp;
+	rset->res_fp = oset->res_fp;
 
 	rset->err = dup_schd_error(oset->err);
 	if (oset->err != NULL && oset->err == NULL) {
@@ -2062,21 +3007,9 @@ dup_resresv_set(resresv_set *oset, server_info *nsinfo)
 		return NULL;
 	}
 
-	rset->user = string_dup(oset->user);
-	if (oset->user != NULL && rset->user == NULL) {
-		free_resresv_set(rset);
-		return NULL;
-	}
-	rset->group = string_dup(oset->group);
-	if (oset->group != NULL && rset->group == NULL) {
-		free_resresv_set(rset);
-		return NULL;
-	}
-	rset->project = string_dup(oset->project);
-	if (oset->project != NULL && rset->project == NULL) {
-		free_resresv_set(rset);
-		return NULL;
-	}
+	rset->user = oset->user;
+	rset->group = oset->group;
+	rset->project = oset->project;
 	rset->partition = string_dup(oset->partition);
 	if (oset->partition != NULL && rset->partition == NULL) {
 		free_resresv_set(rset);
@@ -2325,11 +3258,11 @@ create_resresv_set_by_resresv(status *policy, server_info *sinfo, resource_resv
 		return NULL;
 
 	if (resresv_set_use_user(sinfo))
-		rset->user = string_dup(resresv->user);
+		rset->user = resresv->user;
 	if (resresv_set_use_grp(sinfo))
-		rset->group = string_dup(resresv->group);
+		rset->group = resresv->group;
 	if (resresv_set_use_proj(sinfo))
-		rset->project = string_dup(resresv->project);
+		rset->project = resresv->project;
 
 	if (resresv->is_job && resresv->job != NULL) {
 		if (resresv->job->queue->partition != NULL)
@@ -2389,17 +3322,17 @@ find_resresv_set(status *policy, resresv_set **rsets, char *user, char *group, c
 			continue;
 		if ((user != NULL && rsets[i]->user == NULL) || (user == NULL && rsets[i]->user != NULL))
 			continue;
-		if (user != NULL && cstrcmp(user, rsets[i]->user) != 0)
+		if (user != rsets[i]->user)
 			continue;
 
 		if ((group != NULL && rsets[i]->group == NULL) || (group == NULL && rsets[i]->group != NULL))
 			continue;
-		if (group != NULL && cstrcmp(group, rsets[i]->group) != 0)
+		if (group != rsets[i]->group)
 			continue;
 
 		if ((project != NULL && rsets[i]->project == NULL) || (project == NULL && rsets[i]->project != NULL))
 			continue;
-		if (project != NULL && cstrcmp(project, rsets[i]->project) != 0)
+		if (project != rsets[i]->project)
 			continue;
 
 		if ((partition != NULL && rsets[i]->partition == NULL) || (partition == NULL && rsets[i]->partition != NULL))
@@ -2518,29 +3451,550 @@ create_resresv_sets(status *policy, server_info *sinfo)
 		} else
 			cur_rset = rsets[cur_ind];
 
-		cur_rset->resresv_arr[cur_rset->num_resresvs] = resresvs[i];
-		cur_rset->resresv_arr[++cur_rset->num_resresvs] = NULL;
-		resresvs[i]->ec_index = cur_ind;
+		cur_rset->resresv_arr[cur_rset->num_resresvs] = resresvs[i];
+		cur_rset->resresv_arr[++cur_rset->num_resresvs] = NULL;
+		resresvs[i]->ec_index = cur_ind;
+	}
+
+	/* tidy up */
+	for (i = 0; rsets[i] != NULL; i++) {
+		resource_resv **tmp_arr;
+		tmp_arr = realloc(rsets[i]->resresv_arr, (rsets[i]->num_resresvs + 1) * sizeof(resource_resv *));
+		if (tmp_arr != NULL)
+			rsets[i]->resresv_arr = tmp_arr;
+	}
+
+	tmp_rset_arr = realloc(rsets,(j + 1) * sizeof(resresv_set *));
+	if (tmp_rset_arr != NULL)
+		rsets = tmp_rset_arr;
+
+	if (i > 0) {
+		snprintf(log_buffer, sizeof(log_buffer), "Number of job equivalence classes: %d", i);
+		schdlog(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, log_buffer);
+	}
+
+	return rsets;
+}
+
+/*
+ * Cross-cycle cache of equivalence class "can not run" verdicts.  A verdict
+ * is reused by a later cycle if the class has the same signature and the
+ * state the verdict depends on has the same fingerprint.  Limit verdicts
+ * only depend on the limits and the running counts of the class's entities.
+ * Resource verdicts also depend on the nodes, reservations and server and
+ * queue resources.  Anything which frees what a verdict depends on changes
+ * its fingerprint, so the verdict is dropped.
+ */
+struct resresv_verdict
+{
+	char *sig;				/* signature of the resresv_set */
+	int kind;				/* RV_LIMIT or RV_RESOURCE */
+	unsigned long long fp;			/* fingerprint of the state for kind */
+	schd_error *err;			/* why the set can not run */
+	struct resresv_verdict *next;
+};
+
+enum { RV_NONE, RV_LIMIT, RV_RESOURCE };
+
+static AVL_IX_DESC *rvc_index = NULL;		/* signature -> verdict */
+static struct resresv_verdict *rvc_list = NULL;	/* all verdicts */
+
+/**
+ * @brief
+ *		free a resresv_verdict list
+ *
+ * @param[in]	list	-	list to free
+ *
+ * @return	nothing
+ */
+static void
+free_resresv_verdict_list(struct resresv_verdict *list)
+{
+	struct resresv_verdict *next;
+
+	for (; list != NULL; list = next) {
+		next = list->next;
+		free(list->sig);
+		free_schd_error(list->err);
+		free(list);
+	}
+}
+
+/**
+ * @brief
+ *		free the cross-cycle equivalence class verdict cache.  Called
+ *		when the scheduler is (re)configured since the verdicts refer
+ *		to resource definitions.
+ *
+ * @return	nothing
+ */
+void
+reset_resresv_verdict_cache(void)
+{
+	free_resresv_verdict_list(rvc_list);
+	rvc_list = NULL;
+
+	if (rvc_index != NULL) {
+		avl_destroy_index(rvc_index);
+		free(rvc_index);
+		rvc_index = NULL;
+	}
+}
+
+/**
+ * @brief
+ *		which kind of state an equivalence class verdict depends on.
+ *		Only verdicts which are decided by the limits or by the free
+ *		resources are kept across cycles.
+ *
+ * @param[in]	err	-	why the class can not run
+ *
+ * @return	int
+ * @retval	RV_LIMIT	: verdict depends on limits
+ * @retval	RV_RESOURCE	: verdict depends on limits and resources
+ * @retval	RV_NONE		: verdict can't be kept
+ */
+static int
+resresv_verdict_kind(schd_error *err)
+{
+	if (err == NULL)
+		return RV_NONE;
+
+	switch (err->error_code) {
+		case SERVER_JOB_LIMIT_REACHED:
+		case QUEUE_JOB_LIMIT_REACHED:
+		case SERVER_USER_LIMIT_REACHED:
+		case QUEUE_USER_LIMIT_REACHED:
+		case SERVER_GROUP_LIMIT_REACHED:
+		case QUEUE_GROUP_LIMIT_REACHED:
+		case SERVER_PROJECT_LIMIT_REACHED:
+		case QUEUE_PROJECT_LIMIT_REACHED:
+		case SERVER_USER_RES_LIMIT_REACHED:
+		case QUEUE_USER_RES_LIMIT_REACHED:
+		case SERVER_GROUP_RES_LIMIT_REACHED:
+		case QUEUE_GROUP_RES_LIMIT_REACHED:
+		case SERVER_PROJECT_RES_LIMIT_REACHED:
+		case QUEUE_PROJECT_RES_LIMIT_REACHED:
+		case SERVER_BYUSER_JOB_LIMIT_REACHED:
+		case QUEUE_BYUSER_JOB_LIMIT_REACHED:
+		case SERVER_BYGROUP_JOB_LIMIT_REACHED:
+		case QUEUE_BYGROUP_JOB_LIMIT_REACHED:
+		case SERVER_BYPROJECT_JOB_LIMIT_REACHED:
+		case QUEUE_BYPROJECT_JOB_LIMIT_REACHED:
+		case SERVER_BYUSER_RES_LIMIT_REACHED:
+		case QUEUE_BYUSER_RES_LIMIT_REACHED:
+		case SERVER_BYGROUP_RES_LIMIT_REACHED:
+		case QUEUE_BYGROUP_RES_LIMIT_REACHED:
+		case SERVER_BYPROJECT_RES_LIMIT_REACHED:
+		case QUEUE_BYPROJECT_RES_LIMIT_REACHED:
+		case SERVER_RESOURCE_LIMIT_REACHED:
+		case QUEUE_RESOURCE_LIMIT_REACHED:
+			return RV_LIMIT;
+
+		case INSUFFICIENT_RESOURCE:
+		case INSUFFICIENT_SERVER_RESOURCE:
+		case INSUFFICIENT_QUEUE_RESOURCE:
+		case NO_NODE_RESOURCES:
+		case NOT_ENOUGH_NODES_AVAIL:
+		case NO_FREE_NODES:
+			return RV_RESOURCE;
+
+		default:
+			return RV_NONE;
+	}
+}
+
+/**
+ * @brief
+ *		create the signature of a resresv_set.  Sets with the same
+ *		signature in different cycles would have been the same set
+ *		in one cycle.
+ *
+ * @param[in]	rset	-	the set
+ *
+ * @return	char *
+ * @retval	signature (to be freed by the caller)
+ * @retval	NULL	: error
+ */
+static char *
+create_resresv_set_sig(resresv_set *rset)
+{
+	char *sig = NULL;
+	int len = 0;
+	char buf[64];
+	resource_req *req;
+	int i;
+	int err = 0;
+
+	if (rset == NULL || rset->select_spec == NULL || rset->place_spec == NULL)
+		return NULL;
+
+	err |= pbs_strcat(&sig, &len, "q=") == NULL;
+	err |= pbs_strcat(&sig, &len, rset->qinfo != NULL ? rset->qinfo->name : "") == NULL;
+	err |= pbs_strcat(&sig, &len, "|u=") == NULL;
+	err |= pbs_strcat(&sig, &len, rset->user != NULL ? rset->user : "") == NULL;
+	err |= pbs_strcat(&sig, &len, "|g=") == NULL;
+	err |= pbs_strcat(&sig, &len, rset->group != NULL ? rset->group : "") == NULL;
+	err |= pbs_strcat(&sig, &len, "|p=") == NULL;
+	err |= pbs_strcat(&sig, &len, rset->project != NULL ? rset->project : "") == NULL;
+	err |= pbs_strcat(&sig, &len, "|pt=") == NULL;
+	err |= pbs_strcat(&sig, &len, rset->partition != NULL ? rset->partition : "") == NULL;
+
+	for (i = 0; rset->select_spec->chunks != NULL &&
+		rset->select_spec->chunks[i] != NULL; i++) {
+		snprintf(buf, sizeof(buf), "|c%d=", rset->select_spec->chunks[i]->num_chunks);
+		err |= pbs_strcat(&sig, &len, buf) == NULL;
+		err |= pbs_strcat(&sig, &len, rset->select_spec->chunks[i]->str_chunk) == NULL;
+	}
+
+	snprintf(buf, sizeof(buf), "|pl=%d%d%d%d%d%d%d:",
+		rset->place_spec->free, rset->place_spec->pack,
+		rset->place_spec->scatter, rset->place_spec->vscatter,
+		rset->place_spec->excl, rset->place_spec->exclhost,
+		rset->place_spec->share);
+	err |= pbs_strcat(&sig, &len, buf) == NULL;
+	err |= pbs_strcat(&sig, &len, rset->place_spec->group) == NULL;
+
+	for (req = rset->req; req != NULL; req = req->next) {
+		err |= pbs_strcat(&sig, &len, "|") == NULL;
+		err |= pbs_strcat(&sig, &len, req->name) == NULL;
+		err |= pbs_strcat(&sig, &len, "=") == NULL;
+		err |= pbs_strcat(&sig, &len, req->res_str) == NULL;
+	}
+
+	if (err) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free(sig);
+		return NULL;
+	}
+
+	return sig;
+}
+
+/**
+ * @brief
+ *		fold a resource list's available and assigned amounts into a
+ *		fingerprint
+ *
+ * @param[in]	fp	-	fingerprint so far
+ * @param[in]	res	-	resource list
+ *
+ * @return	the new fingerprint
+ */
+static unsigned long long
+res_list_fingerprint(unsigned long long fp, schd_resource *res)
+{
+	int i;
+
+	for (; res != NULL; res = res->next) {
+		fp = fingerprint_str(fp, res->name);
+		fp = fingerprint_bytes(fp, &res->avail, sizeof(res->avail));
+		fp = fingerprint_bytes(fp, &res->assigned, sizeof(res->assigned));
+		if (res->str_avail != NULL) {
+			for (i = 0; res->str_avail[i] != NULL; i++)
+				fp = fingerprint_str(fp, res->str_avail[i]);
+		}
+	}
+
+	return fp;
+}
+
+/**
+ * @brief
+ *		fold an entity's running and resource counts into a fingerprint
+ *
+ * @param[in]	fp	-	fingerprint so far
+ * @param[in]	cts_list	-	counts list
+ * @param[in]	name	-	entity name or NULL for the whole list
+ *
+ * @return	the new fingerprint
+ */
+static unsigned long long
+counts_fingerprint(unsigned long long fp, counts *cts_list, char *name)
+{
+	counts *cts;
+	resource_req *req;
+
+	if (name != NULL)
+		cts_list = find_counts(cts_list, name);
+
+	for (cts = cts_list; cts != NULL; cts = cts->next) {
+		fp = fingerprint_str(fp, cts->name);
+		fp = fingerprint_bytes(fp, &cts->running, sizeof(cts->running));
+		for (req = cts->rescts; req != NULL; req = req->next) {
+			fp = fingerprint_str(fp, req->name);
+			fp = fingerprint_bytes(fp, &req->amount, sizeof(req->amount));
+		}
+		if (name != NULL)
+			break;
+	}
+
+	return fp;
+}
+
+/**
+ * @brief
+ *		fingerprint of the state resource verdicts of all classes depend
+ *		on: the nodes, the reservations, the server's resources and the
+ *		time of day policy.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	sinfo	-	server info
+ *
+ * @return	the fingerprint
+ */
+static unsigned long long
+server_state_fingerprint(status *policy, server_info *sinfo)
+{
+	unsigned long long fp = FINGERPRINT_INIT;
+	node_info *ninfo;
+	resource_resv *resv;
+	int flags[20];
+	int i;
+	int j;
+
+	flags[0] = policy->is_prime;
+	flags[1] = policy->is_ded_time;
+	flags[2] = sinfo->node_group_enable;
+	fp = fingerprint_bytes(fp, flags, 3 * sizeof(int));
+	for (i = 0; sinfo->node_group_key != NULL && sinfo->node_group_key[i] != NULL; i++)
+		fp = fingerprint_str(fp, sinfo->node_group_key[i]);
+
+	fp = res_list_fingerprint(fp, sinfo->res);
+
+	for (i = 0; sinfo->nodes != NULL && sinfo->nodes[i] != NULL; i++) {
+		ninfo = sinfo->nodes[i];
+		j = 0;
+		flags[j++] = ninfo->is_down;
+		flags[j++] = ninfo->is_free;
+		flags[j++] = ninfo->is_offline;
+		flags[j++] = ninfo->is_unknown;
+		flags[j++] = ninfo->is_job_exclusive;
+		flags[j++] = ninfo->is_resv_exclusive;
+		flags[j++] = ninfo->is_busy;
+		flags[j++] = ninfo->is_job_busy;
+		flags[j++] = ninfo->is_stale;
+		flags[j++] = ninfo->is_provisioning;
+		flags[j++] = ninfo->is_sleeping;
+		flags[j++] = ninfo->no_multinode_jobs;
+		flags[j++] = ninfo->provision_enable;
+		flags[j++] = ninfo->sharing;
+		flags[j++] = ninfo->num_jobs;
+		flags[j++] = ninfo->num_run_resv;
+		flags[j++] = ninfo->num_susp_jobs;
+		flags[j++] = ninfo->max_running;
+		flags[j++] = ninfo->max_user_run;
+		flags[j++] = ninfo->max_group_run;
+		fp = fingerprint_str(fp, ninfo->name);
+		fp = fingerprint_bytes(fp, flags, j * sizeof(int));
+		fp = fingerprint_str(fp, ninfo->queue_name);
+		fp = fingerprint_str(fp, ninfo->partition);
+		fp = fingerprint_str(fp, ninfo->current_aoe);
+		fp = fingerprint_str(fp, ninfo->current_eoe);
+		if (policy->load_balancing)
+			fp = fingerprint_bytes(fp, &ninfo->loadave, sizeof(ninfo->loadave));
+		fp = res_list_fingerprint(fp, ninfo->res);
+	}
+
+	for (i = 0; sinfo->resvs != NULL && sinfo->resvs[i] != NULL; i++) {
+		resv = sinfo->resvs[i];
+		fp = fingerprint_str(fp, resv->name);
+		fp = fingerprint_bytes(fp, &resv->start, sizeof(resv->start));
+		fp = fingerprint_bytes(fp, &resv->end, sizeof(resv->end));
+		if (resv->resv != NULL)
+			fp = fingerprint_bytes(fp, &resv->resv->resv_state, sizeof(resv->resv->resv_state));
+	}
+
+	return fp;
+}
+
+/**
+ * @brief
+ *		fingerprint of the limits and running counts a resresv_set's
+ *		limit verdicts depend on
+ *
+ * @par
+ *		The counts of all jobs are only included when an overall limit is
+ *		set, so other users' jobs starting or ending don't change the
+ *		fingerprint.
+ *
+ * @param[in]	sinfo	-	server info
+ * @param[in]	rset	-	the set
+ * @param[in]	svr_lim_fp	-	fingerprint of the server's limits and,
+ *					if it has overall limits, its counts
+ *					of all jobs
+ *
+ * @return	the fingerprint
+ */
+static unsigned long long
+resresv_set_lim_fingerprint(server_info *sinfo, resresv_set *rset, unsigned long long svr_lim_fp)
+{
+	unsigned long long fp = svr_lim_fp;
+
+	if (rset->user != NULL)
+		fp = counts_fingerprint(fp, sinfo->user_counts, rset->user);
+	if (rset->group != NULL)
+		fp = counts_fingerprint(fp, sinfo->group_counts, rset->group);
+	if (rset->project != NULL)
+		fp = counts_fingerprint(fp, sinfo->project_counts, rset->project);
+
+	/* a set only has a queue if the queue matters (e.g., it has limits) */
+	if (rset->qinfo != NULL) {
+		fp = fingerprint_str(fp, rset->qinfo->name);
+		fp = lim_fingerprint(rset->qinfo->liminfo, fp);
+		if (has_overall_hardlimits(rset->qinfo->liminfo))
+			fp = counts_fingerprint(fp, rset->qinfo->alljobcounts, NULL);
+		if (rset->user != NULL)
+			fp = counts_fingerprint(fp, rset->qinfo->user_counts, rset->user);
+		if (rset->group != NULL)
+			fp = counts_fingerprint(fp, rset->qinfo->group_counts, rset->group);
+		if (rset->project != NULL)
+			fp = counts_fingerprint(fp, rset->qinfo->project_counts, rset->project);
+	}
+
+	return fp;
+}
+
+/**
+ * @brief
+ *		fingerprint the state of each equivalence class and mark the
+ *		classes whose cached verdict is still good as can_not_run.  Must
+ *		be called at the start of the cycle before any job is run.
+ *		Jobs of a marked class take the same path as the rest of a class
+ *		after its first job could not run.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	sinfo	-	server info
+ *
+ * @return	nothing
+ */
+void
+apply_resresv_verdict_cache(status *policy, server_info *sinfo)
+{
+	unsigned long long svr_fp;
+	unsigned long long svr_lim_fp;
+	struct resresv_verdict *rv;
+	resresv_set *rset;
+	char *sig;
+	int applied = 0;
+	int i;
+
+	if (policy == NULL || sinfo == NULL)
+		return;
+
+	if (!conf.equiv_verdict_cache) {
+		if (rvc_list != NULL || rvc_index != NULL)
+			reset_resresv_verdict_cache();
+		return;
+	}
+
+	if (sinfo->equiv_classes == NULL)
+		return;
+
+	svr_fp = server_state_fingerprint(policy, sinfo);
+	svr_lim_fp = lim_fingerprint(sinfo->liminfo, FINGERPRINT_INIT);
+	if (has_overall_hardlimits(sinfo->liminfo))
+		svr_lim_fp = counts_fingerprint(svr_lim_fp, sinfo->alljobcounts, NULL);
+
+	for (i = 0; sinfo->equiv_classes[i] != NULL; i++) {
+		rset = sinfo->equiv_classes[i];
+		rset->lim_fp = resresv_set_lim_fingerprint(sinfo, rset, svr_lim_fp);
+		rset->res_fp = svr_fp ^ rset->lim_fp;
+		if (rset->qinfo != NULL)
+			rset->res_fp = res_list_fingerprint(rset->res_fp, rset->qinfo->qres);
+
+		if (rvc_index == NULL || rset->can_not_run)
+			continue;
+
+		/* reservation jobs run on the reservation's copies of the nodes */
+		if (rset->qinfo != NULL && rset->qinfo->resv != NULL)
+			continue;
+
+		if ((sig = create_resresv_set_sig(rset)) == NULL)
+			continue;
+		rv = find_tree(rvc_index, sig);
+		free(sig);
+		if (rv == NULL)
+			continue;
+
+		if ((rv->kind == RV_LIMIT && rv->fp == rset->lim_fp) ||
+			(rv->kind == RV_RESOURCE && rv->fp == rset->res_fp)) {
+			rset->err = dup_schd_error(rv->err);
+			if (rset->err != NULL) {
+				rset->can_not_run = 1;
+				rset->keep_verdict = 1;
+				applied++;
+			}
+		}
 	}
 
-	/* tidy up */
-	for (i = 0; rsets[i] != NULL; i++) {
-		resource_resv **tmp_arr;
-		tmp_arr = realloc(rsets[i]->resresv_arr, (rsets[i]->num_resresvs + 1) * sizeof(resource_resv *));
-		if (tmp_arr != NULL)
-			rsets[i]->resresv_arr = tmp_arr;
+	if (applied > 0) {
+		snprintf(log_buffer, sizeof(log_buffer),
+			"Reused can't run verdicts of %d of %d job equivalence classes",
+			applied, i);
+		schdlog(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, log_buffer);
 	}
+}
 
-	tmp_rset_arr = realloc(rsets,(j + 1) * sizeof(resresv_set *));
-	if (tmp_rset_arr != NULL)
-		rsets = tmp_rset_arr;
+/**
+ * @brief
+ *		replace the verdict cache with the verdicts of this cycle's
+ *		equivalence classes.  Only verdicts reached before anything ran
+ *		(see resresv_set->keep_verdict) are kept, since they were decided
+ *		in the state fingerprinted by apply_resresv_verdict_cache().
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in]	sinfo	-	server info
+ *
+ * @return	nothing
+ */
+void
+save_resresv_verdict_cache(status *policy, server_info *sinfo)
+{
+	struct resresv_verdict *rv;
+	resresv_set *rset;
+	int kind;
+	int i;
 
-	if (i > 0) {
-		snprintf(log_buffer, sizeof(log_buffer), "Number of job equivalence classes: %d", i);
-		schdlog(PBSEVENT_DEBUG3, PBS_EVENTCLASS_SCHED, LOG_DEBUG, __func__, log_buffer);
+	if (policy == NULL || sinfo == NULL || !conf.equiv_verdict_cache)
+		return;
+
+	reset_resresv_verdict_cache();
+
+	if (sinfo->equiv_classes == NULL)
+		return;
+
+	if ((rvc_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return;
 	}
 
-	return rsets;
+	for (i = 0; sinfo->equiv_classes[i] != NULL; i++) {
+		rset = sinfo->equiv_classes[i];
+		if (!rset->can_not_run || !rset->keep_verdict)
+			continue;
+		if (rset->qinfo != NULL && rset->qinfo->resv != NULL)
+			continue;
+		if ((kind = resresv_verdict_kind(rset->err)) == RV_NONE)
+			continue;
+
+		if ((rv = malloc(sizeof(struct resresv_verdict))) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return;
+		}
+		rv->kind = kind;
+		rv->fp = kind == RV_LIMIT ? rset->lim_fp : rset->res_fp;
+		rv->sig = create_resresv_set_sig(rset);
+		rv->err = dup_schd_error(rset->err);
+		rv->next = NULL;
+		if (rv->sig == NULL || rv->err == NULL ||
+			tree_add_del(rvc_index, rv->sig, rv, TREE_OP_ADD) != 0) {
+			free_resresv_verdict_list(rv);
+			continue;
+		}
+		rv->next = rvc_list;
+		rvc_list = rv;
+	}
 }
 
 /**
@@ -2597,6 +4051,8 @@ dup_job_info(job_info *ojinfo, queue_info *nqinfo, server_info *nsinfo)
 	njinfo->job_id = ojinfo->job_id;
 	njinfo->est_start_time = ojinfo->est_start_time;
 	njinfo->formula_value = ojinfo->formula_value;
+	njinfo->sort_fp = ojinfo->sort_fp;
+	njinfo->sort_fp_new = ojinfo->sort_fp_new;
 	njinfo->est_execvnode = string_dup(ojinfo->est_execvnode);
 	njinfo->job_name = string_dup(ojinfo->job_name);
 	njinfo->comment = string_dup(ojinfo->comment);
@@ -2811,6 +4267,9 @@ preempt_job(status *policy, int pbs_sd, resource_resv *pjob, server_info *sinfo)
 	if (!pjob->job->is_running || pjob->ninfo_arr == NULL)
 		return 0;
 
+	/* the job may be one we have queued to run */
+	flush_job_runs();
+
 	po = get_preemption_order(pjob, sinfo);
 	for (i = 0; i < PREEMPT_METHOD_HIGH && pjob->job->is_running; i++) {
 		if (po->order[i] == PREEMPT_METHOD_SUSPEND &&
@@ -2895,7 +4354,7 @@ preempt_job(status *policy, int pbs_sd, resource_resv *pjob, server_info *sinfo)
 	} else {
 		/* we're prematurely ending a job.  We need to correct our calendar */
 		if (sinfo->calendar != NULL) {
-			te = find_timed_event(sinfo->calendar->events, pjob->name, TIMED_END_EVENT, 0);
+			te = find_calendar_event(sinfo->calendar, NULL, pjob->name, TIMED_END_EVENT, 0);
 			if (te != NULL) {
 				if (delete_event(sinfo, te, DE_NO_FLAGS) == 0)
 					schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO, pjob->name, "Failed to delete end event for job.");
@@ -3059,13 +4518,11 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 	int j = 0;
 	int has_lower_jobs = 0;	/* there are jobs of a lower preempt priority */
 	int prev_prio;		/* jinfo's preempt field before simulation */
-	server_info *nsinfo;
-	status *npolicy;
 	resource_resv **rjobs = NULL;	/* the running jobs to choose from */
 	resource_resv **pjobs = NULL;	/* jobs to preempt */
 	resource_resv **rjobs_subset = NULL;
 	int *pjobs_list = NULL;	/* list of job ids */
-	resource_resv *nhjob = NULL; /* pointer to high priority job from duplicated universe */
+	resource_resv *nhjob = NULL; /* high priority job (or the subjob of it) in the simulation */
 	resource_resv *pjob = NULL;
 	int rc = 0;
 	int retval = 0;
@@ -3073,6 +4530,7 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 	char *msgbuf;
 	nspec **ns_arr = NULL;
 	schd_error *err = NULL;
+	schd_error *chk_err = NULL;	/* error used to find candidates */
 
 	enum sched_error old_errorcode = SUCCESS;
 	resdef *old_rdef = NULL;
@@ -3087,7 +4545,10 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 	resource_req *preempt_targets_req = NULL;
 	char **preempt_targets_list = NULL;
 	resource_resv **prjobs = NULL;
+	resource_resv **cands = NULL;	/* the candidates on usable nodes */
 	int rjobs_count = 0;
+	char *preempt_nodes = NULL;	/* nodes usable by hjob from find_preempt_nodes() */
+	struct preempt_cand_filter cand_arg;
 
 
 	if (hjob == NULL || sinfo == NULL)
@@ -3203,51 +4664,92 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 		}
 	}
 
-	/* use locally dup'd copy of sinfo so we don't modify the original */
-	if ((nsinfo = dup_server_info(sinfo)) == NULL) {
+	/* Only jobs on nodes which could hold part of hjob are worth preempting.
+	 * Find those nodes once and use them to index the candidates.
+	 */
+	if ((preempt_nodes = find_preempt_nodes(policy, hjob, sinfo)) == NULL) {
 		free_schd_error_list(full_err);
 		free(pjobs);
 		free_string_array(preempt_targets_list);
 		return NULL;
 	}
-	npolicy = nsinfo->policy;
-	nhjob = find_resource_resv_by_indrank(nsinfo->jobs, hjob->rank, hjob->resresv_ind);
-	prev_prio = nhjob->job->preempt;
+	cand_arg.policy = policy;
+	cand_arg.hjob = hjob;
+	cand_arg.preempt_nodes = preempt_nodes;
 
-	if (nsinfo->preempt_targets_enable) {
-		if (preempt_targets_req != NULL) {
-			prjobs = resource_resv_filter(nsinfo->running_jobs,
-				count_array((void **) nsinfo->running_jobs),
-				preempt_job_set_filter,
-				(void *) preempt_targets_list, NO_FLAGS);
-			free_string_array(preempt_targets_list);
-		}
+	/* Look for preemption candidates before we start the simulation.
+	 * Filtering the candidates doesn't modify anything, so we only pay
+	 * for the simulation if it has something to preempt.
+	 */
+	if ((chk_err = dup_schd_error(full_err)) == NULL) {
+		free_schd_error_list(full_err);
+		free(pjobs);
+		free(preempt_nodes);
+		free_string_array(preempt_targets_list);
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
 	}
-
-	if (prjobs != NULL) {
+	if (preempt_targets_req != NULL) {
+		prjobs = resource_resv_filter(sinfo->running_jobs,
+			count_array((void **) sinfo->running_jobs),
+			preempt_job_set_filter,
+			(void *) preempt_targets_list, NO_FLAGS);
 		rjobs = prjobs;
-		rjobs_count = count_array((void **)prjobs);
-		if (rjobs_count > 0) {
+	}
+	else
+		rjobs = sinfo->running_jobs;
+	free_string_array(preempt_targets_list);
+
+	if (prjobs != NULL && prjobs[0] == NULL) {
+		sprintf(log_buf, "Limited running jobs used for preemption from %d to 0: No jobs to preempt",
+			sinfo->sc.running);
+		schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, hjob->name, log_buf);
+		rjobs_subset = NULL;
+	}
+	else {
+		if (prjobs != NULL) {
 			sprintf(log_buf, "Limited running jobs used for preemption from %d to %d",
-				nsinfo->sc.running, rjobs_count);
-			schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, nhjob->name, log_buf);
-		}
-		else {
-			sprintf(log_buf, "Limited running jobs used for preemption from %d to 0: No jobs to preempt",
-				nsinfo->sc.running);
-			schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, nhjob->name, log_buf);
-			free_server(nsinfo, 1);
-			free_schd_error_list(full_err);
-			free(pjobs);
-			free(prjobs);
-			return NULL;
+				sinfo->sc.running, count_array((void **) prjobs));
+			schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, hjob->name, log_buf);
 		}
+		cands = resource_resv_filter(rjobs, count_array((void **) rjobs),
+			preempt_candidate_filter, &cand_arg, NO_FLAGS);
+		if (cands == NULL || cands[0] == NULL ||
+			(rjobs_subset = filter_preemptable_jobs(cands, hjob, chk_err)) == NULL)
+			schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO, hjob->name, "Found no preemptable candidates");
+	}
 
+	free_schd_error(chk_err);
+	free(prjobs);
+	prjobs = NULL;
+	if (rjobs_subset == NULL) {
+		free_schd_error_list(full_err);
+		free(pjobs);
+		free(preempt_nodes);
+		free(cands);
+		return NULL;
 	}
-	else {
-		rjobs = nsinfo->running_jobs;
-		rjobs_count = nsinfo->sc.running;
+
+	/* The simulation runs on the real universe.  Every change it makes is
+	 * recorded in an undo log and undone by end_undo_log() before we return,
+	 * so we only pay for what the simulation touches.
+	 */
+	if (!start_undo_log(sinfo)) {
+		free_schd_error_list(full_err);
+		free(pjobs);
+		free(preempt_nodes);
+		free(cands);
+		free(rjobs_subset);
+		return NULL;
 	}
+	nhjob = hjob;
+	prev_prio = nhjob->job->preempt;
+
+	/* rjobs is sorted and searched below, and refiltered if the error changes */
+	prjobs = cands;
+	cands = NULL;
+	rjobs = prjobs;
+	rjobs_count = count_array((void **) prjobs);
 
 	/* sort jobs in ascending preemption priority and starttime... we want to preempt them
 	 * from lowest prio to highest
@@ -3255,6 +4757,8 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 	if (conf.preempt_min_wt_used) {
 		qsort(rjobs, rjobs_count, sizeof(job_info *),
 			cmp_preempt_stime_asc);
+		qsort(rjobs_subset, count_array((void **) rjobs_subset), sizeof(job_info *),
+			cmp_preempt_stime_asc);
 	}
 	else {
 		/* sort jobs in ascending preemption priority... we want to preempt them
@@ -3262,34 +4766,29 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 		 */
 		qsort(rjobs, rjobs_count, sizeof(job_info *),
 		cmp_preempt_priority_asc);
+		qsort(rjobs_subset, count_array((void **) rjobs_subset), sizeof(job_info *),
+		cmp_preempt_priority_asc);
 	}
 
 	err = dup_schd_error(full_err);	/* only first element */
 	if(err == NULL) {
 		free_schd_error_list(full_err);
-		free_server(nsinfo, 1);
+		end_undo_log(sinfo);
 		free(pjobs);
+		free(preempt_nodes);
 		free(prjobs);
+		free(rjobs_subset);
 		log_err(errno, __func__, MEM_ERR_MSG);
 		return NULL;
 	}
 
-	rjobs_subset = filter_preemptable_jobs(rjobs, nhjob, err);
-	if (rjobs_subset == NULL) {
-		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO, nhjob->name, "Found no preemptable candidates");
-		free_schd_error_list(full_err);
-		free_server(nsinfo, 1);
-		free(pjobs);
-		free(prjobs);
-		return NULL;
-	}
-
 	skipto=0;
-	while ((indexfound = select_index_to_preempt(npolicy, nhjob, rjobs_subset, skipto, err, fail_list)) != NO_JOB_FOUND) {
+	while ((indexfound = select_index_to_preempt(policy, nhjob, rjobs_subset, skipto, err, fail_list, preempt_nodes)) != NO_JOB_FOUND) {
 		if (indexfound == ERR_IN_SELECT) {
 			/* System error occurred, no need to proceed */
-			free_server(nsinfo, 1);
+			end_undo_log(sinfo);
 			free(pjobs);
+			free(preempt_nodes);
 			free(prjobs);
 			free_schd_error_list(full_err);
 			free_schd_error(err);
@@ -3300,15 +4799,20 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 		schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, pjob->name,
 			"Simulation: preempting job");
 
-		pjob->job->resreleased = create_res_released_array(npolicy, pjob);
-		pjob->job->resreq_rel = create_resreq_rel_list(npolicy, pjob);
+		undo_resource_resv(sinfo->undo, pjob);
+		undo_free_ptr(sinfo->undo, (void **) &pjob->job->resreleased,
+			(undo_func_t) free_nspecs);
+		undo_free_ptr(sinfo->undo, (void **) &pjob->job->resreq_rel,
+			(undo_func_t) free_resource_req_list);
+		pjob->job->resreleased = create_res_released_array(policy, pjob);
+		pjob->job->resreq_rel = create_resreq_rel_list(policy, pjob);
 
-		update_universe_on_end(npolicy, pjob,  "S", NO_ALLPART);
+		update_universe_on_end(policy, pjob,  "S", NO_ALLPART);
 		rjobs_count--;
-		if ( nsinfo->calendar != NULL ) {
-			te = find_timed_event(nsinfo->calendar->events, pjob->name, TIMED_END_EVENT, 0);
+		if ( sinfo->calendar != NULL ) {
+			te = find_calendar_event(sinfo->calendar, NULL, pjob->name, TIMED_END_EVENT, 0);
 			if (te != NULL) {
-				if (delete_event(nsinfo, te, DE_NO_FLAGS) == 0)
+				if (delete_event(sinfo, te, DE_NO_FLAGS) == 0)
 					schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO, pjob->name, "Failed to delete end event for job.");
 			}
 		}
@@ -3325,7 +4829,7 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 		}
 
 		clear_schd_error(err);
-		if ((ns_arr = is_ok_to_run(npolicy, nsinfo,
+		if ((ns_arr = is_ok_to_run(policy, sinfo,
 			nhjob->job->queue, nhjob, NO_ALLPART, err)) != NULL) {
 
 			/* Normally when running a subjob, we do not care about the subjob. We just care that it successfully runs.
@@ -3334,11 +4838,12 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 			 */
 			if (nhjob->job->is_array) {
 				resource_resv *nj;
-				nj = queue_subjob(nhjob, nsinfo, nhjob->job->queue);
+				nj = queue_subjob(nhjob, sinfo, nhjob->job->queue);
 
 				if (nj == NULL) {
-					free_server(nsinfo, 1);
+					end_undo_log(sinfo);
 					free(pjobs);
+					free(preempt_nodes);
 					free(prjobs);
 					free_schd_error_list(full_err);
 					free_schd_error(err);
@@ -3350,7 +4855,7 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 
 			schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG, nhjob->name,
 				"Simulation: Preempted enough work to run job");
-			rc = sim_run_update_resresv(npolicy, nhjob, ns_arr, NO_ALLPART);
+			rc = sim_run_update_resresv(policy, nhjob, ns_arr, NO_ALLPART);
 			break;
 		} else if (old_errorcode == err->error_code && err->rdef != NULL) {
 			/* If the error code matches, make sure the resource definition is also matching.
@@ -3377,8 +4882,9 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 			if (rjobs_subset == NULL) {
 				schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_JOB, LOG_INFO, nhjob->name, "Found no preemptable candidates");
 				free_schd_error_list(full_err);
-				free_server(nsinfo, 1);
+				end_undo_log(sinfo);
 				free(pjobs);
+				free(preempt_nodes);
 				free(prjobs);
 				free_schd_error(err);
 				return NULL;
@@ -3421,8 +4927,9 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 
 	if (rc > 0) {
 		if ((pjobs_list = calloc((j + 1), sizeof(int))) == NULL) {
-			free_server(nsinfo, 1);
+			end_undo_log(sinfo);
 			free(pjobs);
+			free(preempt_nodes);
 			free(prjobs);
 			free_schd_error_list(full_err);
 			free_schd_error(err);
@@ -3435,10 +4942,10 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 			clear_schd_error(err);
 			if (preemption_similarity(nhjob, pjobs[j], full_err) == 0) {
 				remove_job = 1;
-			} else if ((ns_arr = is_ok_to_run(npolicy, nsinfo,
+			} else if ((ns_arr = is_ok_to_run(policy, sinfo,
 				pjobs[j]->job->queue, pjobs[j], NO_ALLPART, err)) != NULL) {
 				remove_job = 1;
-				sim_run_update_resresv(npolicy, pjobs[j], ns_arr, NO_ALLPART);
+				sim_run_update_resresv(policy, pjobs[j], ns_arr, NO_ALLPART);
 			}
 
 
@@ -3461,8 +4968,9 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 		}
 	}
 
-	free_server(nsinfo, 1);
+	end_undo_log(sinfo);
 	free(pjobs);
+	free(preempt_nodes);
 	free(prjobs);
 	free_schd_error_list(full_err);
 	free_schd_error(err);
@@ -3471,6 +4979,222 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 	return pjobs_list;
 }
 
+/**
+ * @brief
+ *		the resources to check on a vnode of a multi-vnoded host when
+ *		looking for preemption candidates.  Consumable resources can't
+ *		be checked on those vnodes, since the rest of a chunk may come
+ *		from the other vnodes of the host.
+ *
+ * @param[in] policy - policy info
+ *
+ * @return resdef **
+ * @retval the non-consumable resources of policy->resdef_to_check
+ * @retval NULL : no resources to check or on error, all resources are checked
+ */
+static resdef **
+non_consumable_resdefs(status *policy)
+{
+	resdef **rdtc_non_consumable;
+	int max_resdefs;
+	int i;
+	int j = 0;
+
+	if (policy == NULL)
+		return NULL;
+
+	max_resdefs = count_array((void **) policy->resdef_to_check);
+	if (max_resdefs == 0)
+		return NULL;
+
+	rdtc_non_consumable = calloc(max_resdefs + 1, sizeof(resdef *));
+	if (rdtc_non_consumable == NULL)
+		return NULL;
+
+	for (i = 0; policy->resdef_to_check[i] != NULL; i++) {
+		if (policy->resdef_to_check[i]->type.is_non_consumable)
+			rdtc_non_consumable[j++] = policy->resdef_to_check[i];
+	}
+
+	return rdtc_non_consumable;
+}
+
+/**
+ * @brief
+ *		can a node hold a chunk of a high priority job if all the jobs
+ *		on it were preempted
+ *
+ * @param[in] hjob - the high priority job
+ * @param[in] node - the node
+ * @param[in] rdtc_non_consumable - resources to check on multi-vnoded hosts
+ * @param[in] err - scratch error structure
+ *
+ * @return int
+ * @retval 1 : the node can hold a chunk
+ * @retval 0 : it can't
+ */
+static int
+preempt_node_fits(resource_resv *hjob, node_info *node,
+	resdef **rdtc_non_consumable, schd_error *err)
+{
+	resdef **rdtc_here = NULL; /* at first assume all resources (including consumables) need to be checked */
+	long num_chunks_returned;
+	int k;
+
+	if (node->is_multivnoded)
+		rdtc_here = rdtc_non_consumable;
+
+	for (k = 0; hjob->select->chunks[k] != NULL; k++) {
+		/* if only non consumables are checked, infinite number of chunks can be satisfied,
+		 * and SCHD_INFINITY is negative, so don't be tempted to check on positive value
+		 */
+		clear_schd_error(err);
+		num_chunks_returned = check_avail_resources(node->res, hjob->select->chunks[k]->req,
+					COMPARE_TOTAL | CHECK_ALL_BOOLS | UNSET_RES_ZERO,
+					rdtc_here, INSUFFICIENT_RESOURCE, err);
+		if ((num_chunks_returned > 0) || (num_chunks_returned == SCHD_INFINITY))
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief
+ *		find the nodes a high priority job could use if the jobs running
+ *		on them were preempted.  A node's resources_available doesn't
+ *		change when jobs are preempted, so this is done once per high
+ *		priority job and the answer indexes the candidates by node.
+ *
+ * @param[in] policy - policy info
+ * @param[in] hjob - the high priority job
+ * @param[in] sinfo - the server
+ *
+ * @return char *
+ * @retval array indexed by node_ind, non-zero for usable nodes
+ * @retval NULL : error
+ *
+ * @par NOTE:	returned array is allocated with calloc() --  needs freeing
+ */
+char *
+find_preempt_nodes(status *policy, resource_resv *hjob, server_info *sinfo)
+{
+	char *preempt_nodes;
+	resdef **rdtc_non_consumable;
+	schd_error *err;
+	node_info *node;
+	int i;
+
+	if (hjob == NULL || hjob->select == NULL || sinfo == NULL)
+		return NULL;
+
+	if ((preempt_nodes = calloc(sinfo->num_nodes + 1, sizeof(char))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	if ((err = new_schd_error()) == NULL) {
+		free(preempt_nodes);
+		return NULL;
+	}
+
+	rdtc_non_consumable = non_consumable_resdefs(policy);
+
+	for (i = 0; sinfo->unordered_nodes[i] != NULL; i++) {
+		node = sinfo->unordered_nodes[i];
+		if (node->node_ind >= 0 && node->node_ind < sinfo->num_nodes)
+			preempt_nodes[node->node_ind] =
+				preempt_node_fits(hjob, node, rdtc_non_consumable, err);
+	}
+
+	free(rdtc_non_consumable);
+	free_schd_error(err);
+
+	return preempt_nodes;
+}
+
+/**
+ * @brief
+ *		is a node in the set of nodes from find_preempt_nodes()
+ *
+ * @par	Reservation vnodes are created before the server's nodes are indexed,
+ *	so they have no node_ind.  Those are checked directly.
+ *
+ * @param[in] policy - policy info
+ * @param[in] hjob - the high priority job
+ * @param[in] node - the node
+ * @param[in] preempt_nodes - from find_preempt_nodes()
+ *
+ * @return int
+ * @retval 1 : hjob could use the node
+ * @retval 0 : it can't
+ */
+static int
+preempt_node_usable(status *policy, resource_resv *hjob, node_info *node,
+	char *preempt_nodes)
+{
+	resdef **rdtc_non_consumable;
+	schd_error *err;
+	int usable;
+
+	if (node->node_ind >= 0)
+		return preempt_nodes[node->node_ind];
+
+	if ((err = new_schd_error()) == NULL)
+		return 0;
+	rdtc_non_consumable = non_consumable_resdefs(policy);
+	usable = preempt_node_fits(hjob, node, rdtc_non_consumable, err);
+	free(rdtc_non_consumable);
+	free_schd_error(err);
+
+	return usable;
+}
+
+/**
+ * @brief
+ * 		filter function used with resource_resv_filter to find the
+ *		running jobs which are preemption candidates for a high priority
+ *		job: jobs of a lower preemption priority which can be preempted
+ *		and run on at least one node from find_preempt_nodes().
+ *
+ * @see	resource_resv_filter()
+ *
+ * @param[in]	job	-	job to consider to include
+ * @param[in]	arg	-	struct preempt_cand_filter
+ *
+ * @retval	int
+ * @return	1	: job is a candidate
+ * @return	0	: job is not a candidate
+ */
+int
+preempt_candidate_filter(resource_resv *job, void *arg)
+{
+	struct preempt_cand_filter *inp;
+	node_info *node;
+	int usable = 0;
+	int i;
+
+	if (job == NULL || arg == NULL || job->job == NULL || job->ninfo_arr == NULL)
+		return 0;
+
+	inp = (struct preempt_cand_filter *) arg;
+
+	if (!job->job->is_running || job->job->is_provisioning ||
+		job->job->can_not_preempt || job->job->preempt >= inp->hjob->job->preempt)
+		return 0;
+
+	for (i = 0; job->ninfo_arr[i] != NULL; i++) {
+		node = job->ninfo_arr[i];
+		if (node->is_down || node->is_offline)
+			return 0;
+		if (!usable && preempt_node_usable(inp->policy, inp->hjob, node,
+			inp->preempt_nodes))
+			usable = 1;
+	}
+
+	return usable;
+}
+
 /**
  * @brief
  *		select a good candidate for preemption
@@ -3482,6 +5206,8 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
  * @param[in] err    - reason the high prio job isn't running
  * @param[in] fail_list - list of jobs to skip. They previously failed to be preempted.
  *			  Do not select them again.
+ * @param[in] preempt_nodes - usable nodes from find_preempt_nodes() or NULL to
+ *			  check the nodes of each job
  *
  * @return long
  * @retval index of the job to preempt
@@ -3491,9 +5217,9 @@ find_jobs_to_preempt(status *policy, resource_resv *hjob, server_info *sinfo, in
 long
 select_index_to_preempt(status *policy, resource_resv *hjob,
 	resource_resv **rjobs, long skipto, schd_error *err,
-	int *fail_list)
+	int *fail_list, char *preempt_nodes)
 {
-	int i, j, k;
+	int i, j;
 	int good = 1;		/* good boolean: Is job eligible to be preempted */
 	struct preempt_ordering *po;
 	resdef **rdtc_non_consumable = NULL;
@@ -3603,57 +5329,24 @@ select_index_to_preempt(status *policy, resource_resv *hjob,
 			schd_error *err;
 			node_good = 0;
 
-			err = new_schd_error();
-			if(err == NULL)
-				return NO_JOB_FOUND;
-
-			for (j = 0; rjobs[i]->ninfo_arr[j] != NULL && !node_good; j++) {
-				resdef **rdtc_here = NULL; /* at first assume all resources (including consumables) need to be checked */
-				node_info *node = rjobs[i]->ninfo_arr[j];
-				if (node->is_multivnoded) {
-					/* unsafe to consider vnodes from multivnoded hosts "no good" when "not enough" of some consumable
-					 * resource can be found in the vnode, since rest may be provided by other vnodes on the same host
-					 * restrict check on these vnodes to check only against non consumable resources
-					 */
-					if (rdtc_non_consumable == NULL) {
-						long max_resdefs = 0;
-						if (policy != NULL) {
-							max_resdefs = count_array( (void **) policy->resdef_to_check);
-						}
-						if (max_resdefs > 0)    {
-							rdtc_non_consumable = (resdef **) calloc(sizeof(resdef *),(size_t) max_resdefs + 1);
-							if (rdtc_non_consumable != NULL) {
-								long resdef_index = 0;
-								long rdtc_nc_index = 0;
-								for (; policy->resdef_to_check[resdef_index] != NULL; resdef_index++) {
-									if (policy->resdef_to_check[resdef_index]->type.is_non_consumable) {
-										rdtc_non_consumable[rdtc_nc_index] = policy->resdef_to_check[resdef_index];
-										rdtc_nc_index++;
-									}
-									rdtc_non_consumable[rdtc_nc_index] = NULL;
-								}
-							}
-						}
-					}
-					rdtc_here = rdtc_non_consumable;
-				}
-				for (k = 0; hjob->select->chunks[k] != NULL; k++) {
-					long num_chunks_returned = 0;
-					/* if only non consumables are checked, infinite number of chunks can be satisfied,
-					 * and SCHD_INFINITY is negative, so don't be tempted to check on positive value
-					 */
-					clear_schd_error(err);
-					num_chunks_returned = check_avail_resources(node->res, hjob->select->chunks[k]->req,
-								COMPARE_TOTAL | CHECK_ALL_BOOLS | UNSET_RES_ZERO,
-								rdtc_here, INSUFFICIENT_RESOURCE, err);
-					if ( (num_chunks_returned > 0) || (num_chunks_returned == SCHD_INFINITY) ) {
-						node_good = 1;
-						break;
-					}
+			if (preempt_nodes != NULL) {
+				for (j = 0; rjobs[i]->ninfo_arr[j] != NULL && !node_good; j++)
+					node_good = preempt_node_usable(policy, hjob,
+						rjobs[i]->ninfo_arr[j], preempt_nodes);
+			}
+			else {
+				err = new_schd_error();
+				if(err == NULL)
+					return NO_JOB_FOUND;
 
-				}
+				if (rdtc_non_consumable == NULL)
+					rdtc_non_consumable = non_consumable_resdefs(policy);
+
+				for (j = 0; rjobs[i]->ninfo_arr[j] != NULL && !node_good; j++)
+					node_good = preempt_node_fits(hjob, rjobs[i]->ninfo_arr[j],
+						rdtc_non_consumable, err);
+				free_schd_error(err);
 			}
-			free_schd_error(err);
 		}
 
 		if (node_good == 0)
@@ -3716,6 +5409,7 @@ set_preempt_prio(resource_resv *job, queue_info *qinfo, server_info *sinfo)
 	if (job == NULL || job->job == NULL || qinfo == NULL || sinfo == NULL)
 		return;
 
+	undo_resource_resv(sinfo->undo, job);
 	jinfo = job->job;
 
 	/* in the case of reseting the value, we need to clear them first */
@@ -4036,6 +5730,7 @@ queue_subjob(resource_resv *array, server_info *sinfo,
 	char *subjob_name;
 	resource_resv *rresv = NULL;
 	resource_resv **tmparr = NULL;
+	undo_log *ul;
 
 	if (array == NULL || array->job == NULL || sinfo == NULL || qinfo == NULL)
 		return NULL;
@@ -4043,6 +5738,8 @@ queue_subjob(resource_resv *array, server_info *sinfo,
 	if (!array->job->is_array)
 		return NULL;
 
+	ul = sinfo->undo;
+
 	subjob_index = range_next_value(array->job->queued_subjobs, -1);
 	if (subjob_index >= 0) {
 		subjob_name = create_subjob_name(array->name, subjob_index);
@@ -4052,11 +5749,19 @@ queue_subjob(resource_resv *array, server_info *sinfo,
 				/* Set tmparr to something so we're not considered an error */
 				tmparr = sinfo->jobs;
 				/* check of array parent is not set then set that here */
-				if (rresv->job->parent_job == NULL)
+				if (rresv->job->parent_job == NULL) {
+					undo_resource_resv(ul, rresv);
 					rresv->job->parent_job = array;
+				}
 			}
 			else if ((rresv = create_subjob_from_array(array, subjob_index,
 				subjob_name)) != NULL) {
+				undo_new(ul, rresv, (undo_func_t) free_resource_resv);
+				undo_save(ul, sinfo, sizeof(server_info));
+				undo_save(ul, qinfo, sizeof(queue_info));
+				undo_copy_array(ul, (void ***) &sinfo->jobs);
+				undo_copy_array(ul, (void ***) &sinfo->all_resresv);
+				undo_copy_array(ul, (void ***) &qinfo->jobs);
 				/* add_resresv_to_array calls realloc, so we need to treat this call
 				 * as a call to realloc.  Put it into a temp variable to check for NULL
 				 */
@@ -4065,10 +5770,13 @@ queue_subjob(resource_resv *array, server_info *sinfo,
 					sinfo->jobs = tmparr;
 					sinfo->sc.queued++;
 					sinfo->sc.total++;
+					add_resresv_to_index(sinfo, rresv);
 
 					tmparr = add_resresv_to_array(sinfo->all_resresv, rresv);
 					if (tmparr != NULL) {
 						sinfo->all_resresv = tmparr;
+						/* the subjob has its own slot, not the one of its array */
+						rresv->resresv_ind = count_array((void **) tmparr) - 1;
 
 						tmparr = add_resresv_to_array(qinfo->jobs, rresv);
 						if (tmparr != NULL) {
@@ -4093,8 +5801,8 @@ queue_subjob(resource_resv *array, server_info *sinfo,
 
 /**
  * @brief
- * 		evaluate a math formula for jobs based on their resources
- *		NOTE: currently done through embedded python interpreter
+ * 		evaluate a math formula for jobs through the embedded python
+ *		interpreter.  Used for formulas the native evaluator can't handle.
  *
  * @param[in]	formula	-	formula to evaluate
  * @param[in]	resresv	-	job for special case key words
@@ -4105,8 +5813,8 @@ queue_subjob(resource_resv *array, server_info *sinfo,
  */
 
 #ifdef PYTHON
-sch_resource_t
-formula_evaluate(char *formula, resource_resv *resresv, resource_req *resreq)
+static sch_resource_t
+formula_evaluate_python(char *formula, resource_resv *resresv, resource_req *resreq)
 {
 	char buf[1024];
 	char *globals;
@@ -4228,13 +5936,53 @@ formula_evaluate(char *formula, resource_resv *resresv, resource_req *resreq)
 	return ans;
 }
 #else
-sch_resource_t
-formula_evaluate(char *formula, resource_resv *resresv, resource_req *resreq)
+static sch_resource_t
+formula_evaluate_python(char *formula, resource_resv *resresv, resource_req *resreq)
 {
 	return 0;
 }
 #endif
 
+/**
+ * @brief
+ * 		evaluate a math formula for jobs based on their resources
+ *		NOTE: the formula is compiled once and evaluated natively.  Formulas
+ *		      the native evaluator doesn't handle go through python.
+ *
+ * @param[in]	formula	-	formula to evaluate
+ * @param[in]	resresv	-	job for special case key words
+ * @param[in]	resreq	-	resources to use when evaluating
+ *
+ * @return	evaluated formula answer or 0 on exception
+ *
+ */
+sch_resource_t
+formula_evaluate(char *formula, resource_resv *resresv, resource_req *resreq)
+{
+	formula_prog *prog;
+	sch_resource_t ans = 0;
+	const char *err = NULL;
+	char errbuf[MAX_LOG_SIZE];
+
+	if (formula == NULL || resresv == NULL ||
+		resresv->job == NULL || consres == NULL)
+		return 0;
+
+	if ((prog = find_compiled_formula(formula)) == NULL)
+		return formula_evaluate_python(formula, resresv, resreq);
+
+	if (eval_compiled_formula(prog, resresv, resreq, &ans, &err) == 0) {
+		snprintf(errbuf, sizeof(errbuf),
+			"Formula evaluation for job had an error.  Zero value will be used: %s",
+			err != NULL ? err : "");
+		schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_JOB, LOG_DEBUG,
+			resresv->name, errbuf);
+		return 0;
+	}
+
+	return ans;
+}
+
 /**
  * @brief
  * 		Set the job accrue type to eligible time.
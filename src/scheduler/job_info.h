@@ -79,10 +79,16 @@ int
 update_job_attr(int pbs_sd, resource_resv *resresv, char *attr_name,
 	char *attr_resc, char *attr_value, struct attrl *extra, unsigned int flags );
 
-/* send delayed job attribute updates for job using send_attr_updates() */
+/* queue delayed job attribute updates for job to be sent by flush_job_updates() */
 int send_job_updates(int pbs_sd, resource_resv *job);
 
-/* send delayed attributes to the server for a job */
+/* queue attribute updates for a job to be sent by flush_job_updates() */
+int queue_job_updates(int pbs_sd, char *job_name, struct attrl *pattr);
+
+/* send the queued job attribute updates to the server */
+void flush_job_updates(void);
+
+/* send attributes to the server for a job now */
 int send_attr_updates(int pbs_sd, char *job_name, struct attrl *pattr);
 
 
@@ -159,7 +165,20 @@ find_jobs_to_preempt(status *policy, resource_resv *jinfo,
 long
 select_index_to_preempt(status *policy, resource_resv *hjob,
 	resource_resv **rjobs, long skipto, schd_error *err,
-	int *fail_list);
+	int *fail_list, char *preempt_nodes);
+
+/*
+ *      find_preempt_nodes - find the nodes a high priority job could use
+ *                           if the jobs running on them were preempted
+ */
+char *find_preempt_nodes(status *policy, resource_resv *hjob, server_info *sinfo);
+
+/*
+ *      preempt_candidate_filter - filter function used with
+ *                                 resource_resv_filter to find the running
+ *                                 jobs which are preemption candidates
+ */
+int preempt_candidate_filter(resource_resv *job, void *arg);
 
 /*
  *      preempt_level - take a preemption priority and return a preemption
@@ -412,6 +431,24 @@ long extend_soft_walltime(resource_resv *resresv, time_t server_time);
 /* Returns a list of preemptable candidates */
 resource_resv **filter_preemptable_jobs(resource_resv **arr, resource_resv *job, schd_error *err);
 
+/* free the cross-cycle job status cache used by delta job queries */
+void reset_job_status_cache(void);
+
+/* decide if this cycle's job queries can use the job status cache */
+void prep_job_status_cache(status *policy);
+
+/* drop jobs from the job status cache which were not seen this cycle */
+void sweep_job_status_cache(status *policy);
+
+/* free the cross-cycle equivalence class verdict cache */
+void reset_resresv_verdict_cache(void);
+
+/* mark equivalence classes whose cached can't run verdict still holds */
+void apply_resresv_verdict_cache(status *policy, server_info *sinfo);
+
+/* remember this cycle's equivalence class verdicts for the next cycle */
+void save_resresv_verdict_cache(status *policy, server_info *sinfo);
+
 #ifdef	__cplusplus
 }
 #endif
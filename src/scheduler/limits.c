@@ -51,6 +51,8 @@
  * 	lim_setlimits()
  * 	has_hardlimits()
  * 	has_softlimits()
+ * 	lim_fingerprint()
+ * 	has_overall_hardlimits()
  * 	new_limcounts()
  * 	free_limcounts()
  * 	make_limcounts()
@@ -728,6 +730,81 @@ has_softlimits(void *p)
 	}
 	return (0);
 }
+/**
+ * @brief
+ * 		fold the hard resource and run limits of a limit info structure
+ * 		into a fingerprint.  Soft limits are left out because they only
+ * 		affect preemption, not whether a job can run.
+ *
+ * @param[in]	p	-	limit info structure
+ * @param[in]	fp	-	fingerprint so far
+ *
+ * @return	the new fingerprint
+ */
+unsigned long long
+lim_fingerprint(void *p, unsigned long long fp)
+{
+	struct limit_info	*lip = p;
+	pbs_entlim_key_t	*k = NULL;
+
+	if (lip == NULL)
+		return fp;
+
+	while ((k = entlim_get_next(k, LI2RESCTX(lip))) != NULL) {
+		fp = fingerprint_str(fp, k->key);
+		fp = fingerprint_str(fp, k->recptr);
+	}
+
+	/* run limits are currently kept in the same context */
+	if (LI2RUNCTX(lip) != LI2RESCTX(lip)) {
+		while ((k = entlim_get_next(k, LI2RUNCTX(lip))) != NULL) {
+			fp = fingerprint_str(fp, k->key);
+			fp = fingerprint_str(fp, k->recptr);
+		}
+	}
+
+	return fp;
+}
+/**
+ * @brief
+ * 		check whether the limit info structure has at least one hard
+ * 		overall (o:PBS_ALL) resource or run limit.  Only those limits
+ * 		depend on the running counts of all jobs.
+ *
+ * @param[in]	p	-	limit info structure
+ *
+ * @return	int
+ * @retval	1	: an overall hard limit is set
+ * @retval	0	: no overall hard limit is set
+ */
+int
+has_overall_hardlimits(void *p)
+{
+	struct limit_info	*lip = p;
+	pbs_entlim_key_t	*k = NULL;
+
+	if (lip == NULL)
+		return (0);
+
+	while ((k = entlim_get_next(k, LI2RESCTX(lip))) != NULL) {
+		if (k->key[0] == 'o') {
+			free(k);
+			return (1);
+		}
+	}
+
+	/* run limits are currently kept in the same context */
+	if (LI2RUNCTX(lip) != LI2RESCTX(lip)) {
+		while ((k = entlim_get_next(k, LI2RUNCTX(lip))) != NULL) {
+			if (k->key[0] == 'o') {
+				free(k);
+				return (1);
+			}
+		}
+	}
+
+	return (0);
+}
 /**
  * @brief
  *		create a new limit count structure and initialize it.
@@ -2596,7 +2673,7 @@ check_max_group_res(resource_resv *rr, counts *cts_list,
 		}
 
 		/* at this point, we know a generic or individual limit is set */
-		used = find_counts_elm(cts_list, group, res->name);
+		used = find_counts_elm(cts_list, group, res->def);
 		(void) sprintf(log_buffer, "%s group %s "
 			"max_*group_res.%s (%.1lf, %.1lf), used %.1lf",
 			rr->name, group,
@@ -2679,7 +2756,7 @@ check_max_group_res_soft(resource_resv *rr, counts *cts_list, void *limitctx)
 		}
 
 		/* at this point, we know a generic or individual limit is set */
-		used = find_counts_elm(cts_list, group, res->name);
+		used = find_counts_elm(cts_list, group, res->def);
 		(void) sprintf(log_buffer,
 			"%s group %s "
 			"max_*group_res_soft.%s (%.1lf, %.1lf), used %.1lf",
@@ -2762,7 +2839,7 @@ check_max_user_res(resource_resv *rr, counts *cts_list, resdef **rdef,
 		}
 
 		/* at this point, we know a generic or individual limit is set */
-		used = find_counts_elm(cts_list, user, res->name);
+		used = find_counts_elm(cts_list, user, res->def);
 		(void) sprintf(log_buffer,
 			"%s user %s "
 			"max_*user_res.%s (%.1lf, %.1lf), used %.1lf",
@@ -2848,7 +2925,7 @@ check_max_user_res_soft(resource_resv **rr_arr, resource_resv *rr,
 		}
 
 		/* at this point, we know a generic or individual limit is set */
-		used = find_counts_elm(cts_list, user, res->name);
+		used = find_counts_elm(cts_list, user, res->def);
 		(void) sprintf(log_buffer,
 			"%s user %s "
 			"max_*user_res_soft (%.1lf, %.1lf), used %.1lf",
@@ -3424,7 +3501,7 @@ check_max_project_res(resource_resv *rr, counts *cts_list,
 		}
 
 		/* at this point, we know a generic or individual limit is set */
-		used = find_counts_elm(cts_list, project, res->name);
+		used = find_counts_elm(cts_list, project, res->def);
 		(void) sprintf(log_buffer, "%s project %s "
 			"max_*project_res.%s (%.1lf, %.1lf), used %.1lf",
 			rr->name, project,
@@ -3508,7 +3585,7 @@ check_max_project_res_soft(resource_resv *rr, counts *cts_list, void *limitctx)
 		}
 
 		/* at this point, we know a generic or individual limit is set */
-		used = find_counts_elm(cts_list, project, res->name);
+		used = find_counts_elm(cts_list, project, res->def);
 		(void) sprintf(log_buffer,
 			"%s project %s "
 			"max_*project_res_soft.%s (%.1lf, %.1lf), used %.1lf",
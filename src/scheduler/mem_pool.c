@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+/**
+ * @file    mem_pool.c
+ *
+ * @brief
+ * 		mem_pool.c - This file contains pools of fixed size objects used
+ *		for the small structures the scheduler allocates and frees by
+ *		the million each cycle (e.g. resource_reqs).  Objects are carved
+ *		out of large slabs so objects allocated together sit together in
+ *		memory.  Freed objects go on a free list and are handed out again
+ *		by the next allocation.  Slabs are kept between cycles, so a
+ *		cycle's teardown and the next cycle's query reuse the same memory
+ *		instead of going through malloc() and free() for every object.
+ *
+ *		Objects allocated from a thread pool worker (see thread_pool.c)
+ *		are malloc()'d instead, so the pools themselves are only touched
+ *		by the main thread.  When such an object is freed by the main
+ *		thread it joins the pool's free list.
+ *
+ * Functions included are:
+ * 	pool_alloc()
+ * 	pool_free()
+ * 	log_mem_pool_stats()
+ *
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <log.h>
+#include "mem_pool.h"
+#include "thread_pool.h"
+#include "constant.h"
+#include "misc.h"
+
+/* size of the slabs pooled objects are carved from */
+#define POOL_SLAB_SIZE (64 * 1024)
+
+/* thread pool workers change mt_in_use, so the main thread reads it atomically */
+#ifndef WIN32
+#define POOL_MT_IN_USE(pool) __sync_fetch_and_add(&(pool)->mt_in_use, 0)
+#else
+#define POOL_MT_IN_USE(pool) ((pool)->mt_in_use)
+#endif
+
+/* a slab of objects */
+struct pool_slab
+{
+	struct pool_slab *next;
+	union pool_align objs[1];	/* the objects start here */
+};
+
+/* all the pools which have been used, for logging their statistics */
+static mem_pool *all_pools = NULL;
+
+/**
+ * @brief
+ * 		allocate a zeroed object from a pool
+ *
+ * @param[in]	pool	-	the pool to allocate from
+ *
+ * @return	the new object
+ * @retval	NULL	: malloc failed
+ *
+ * @par MT-Safe:	yes - from the main thread or a thread pool worker
+ */
+void *
+pool_alloc(mem_pool *pool)
+{
+	struct pool_slab *slab;
+	void *obj;
+	long in_use;
+
+#ifndef WIN32
+	if (in_thread_pool_worker()) {
+		if ((obj = calloc(1, pool->obj_size)) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return NULL;
+		}
+		__sync_fetch_and_add(&pool->mt_in_use, 1);
+		__sync_fetch_and_add(&pool->mt_allocs, 1);
+		return obj;
+	}
+#endif /* WIN32 */
+
+	if (pool->free_list != NULL) {
+		obj = pool->free_list;
+		pool->free_list = *(void **) obj;
+	} else {
+		if (pool->unused == pool->unused_end) {
+			if (pool->objs_per_slab == 0) {
+				pool->objs_per_slab = (POOL_SLAB_SIZE -
+					sizeof(struct pool_slab)) / pool->obj_size;
+				if (pool->objs_per_slab < 1)
+					pool->objs_per_slab = 1;
+				pool->next = all_pools;
+				all_pools = pool;
+			}
+			slab = malloc(offsetof(struct pool_slab, objs) +
+				pool->objs_per_slab * pool->obj_size);
+			if (slab == NULL) {
+				log_err(errno, __func__, MEM_ERR_MSG);
+				return NULL;
+			}
+			slab->next = pool->slabs;
+			pool->slabs = slab;
+			pool->num_slabs++;
+			pool->unused = (char *) slab->objs;
+			pool->unused_end = pool->unused + pool->objs_per_slab * pool->obj_size;
+		}
+		obj = pool->unused;
+		pool->unused += pool->obj_size;
+	}
+
+	memset(obj, 0, pool->obj_size);
+
+	pool->cycle_allocs++;
+	in_use = ++pool->in_use + POOL_MT_IN_USE(pool);
+	if (in_use > pool->high_water)
+		pool->high_water = in_use;
+
+	return obj;
+}
+
+/**
+ * @brief
+ * 		return an object to the pool it was allocated from.  A thread
+ *		pool worker may only free objects it allocated itself.
+ *
+ * @param[in]	pool	-	the pool the object was allocated from
+ * @param[in]	obj	-	the object to free
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	yes - from the main thread or a thread pool worker
+ */
+void
+pool_free(mem_pool *pool, void *obj)
+{
+	if (obj == NULL)
+		return;
+
+#ifndef WIN32
+	if (in_thread_pool_worker()) {
+		free(obj);
+		__sync_fetch_and_sub(&pool->mt_in_use, 1);
+		return;
+	}
+#endif /* WIN32 */
+
+	*(void **) obj = pool->free_list;
+	pool->free_list = obj;
+	pool->in_use--;
+}
+
+/**
+ * @brief
+ * 		log the statistics of every pool and start counting a new cycle
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+log_mem_pool_stats(void)
+{
+	mem_pool *pool;
+
+	for (pool = all_pools; pool != NULL; pool = pool->next) {
+		snprintf(log_buffer, sizeof(log_buffer),
+			"Pool %s: %ld allocations this cycle, %ld in use, "
+			"%ld high water, %ld slabs (%ld KB)",
+			pool->name, pool->cycle_allocs + pool->mt_allocs,
+			pool->in_use + POOL_MT_IN_USE(pool),
+			pool->high_water,
+			pool->num_slabs,
+			pool->num_slabs * (long) (offsetof(struct pool_slab, objs) +
+			pool->objs_per_slab * pool->obj_size) / 1024);
+		schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG,
+			"mem_pool", log_buffer);
+		pool->cycle_allocs = 0;
+		pool->mt_allocs = 0;
+	}
+}
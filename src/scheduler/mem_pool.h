@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+#ifndef	_MEM_POOL_H
+#define	_MEM_POOL_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/* alignment of every pooled object */
+union pool_align
+{
+	long long ll;
+	double d;
+	void *p;
+};
+
+/* size of a pooled object of size sz */
+#define POOL_OBJ_SIZE(sz) \
+	(((sz) + sizeof(union pool_align) - 1) / sizeof(union pool_align) * \
+	sizeof(union pool_align))
+
+/* a pool of fixed size objects.  Pools are static and live for the life of
+ * the scheduler.  Declare them with MEM_POOL_INITIALIZER.
+ */
+typedef struct mem_pool mem_pool;
+struct mem_pool
+{
+	const char *name;		/* name used when logging the pool's statistics */
+	size_t obj_size;		/* object size, rounded up for alignment */
+	int objs_per_slab;		/* 0 until the first slab is allocated */
+	void *free_list;		/* freed objects, linked through their first word */
+	struct pool_slab *slabs;
+	char *unused;			/* next never used object in the newest slab */
+	char *unused_end;		/* end of the newest slab */
+	long num_slabs;
+	long in_use;			/* main thread allocations less frees */
+	long high_water;		/* most objects allocated at once */
+	long cycle_allocs;		/* allocations since the stats were last logged */
+	long mt_in_use;			/* worker thread allocations less frees */
+	long mt_allocs;			/* worker allocations since the stats were logged */
+	mem_pool *next;			/* list of all pools */
+};
+
+#define MEM_POOL_INITIALIZER(name, size) { (name), POOL_OBJ_SIZE(size) }
+
+/*
+ *	pool_alloc - allocate a zeroed object from a pool
+ */
+void *pool_alloc(mem_pool *pool);
+
+/*
+ *	pool_free - return an object to the pool it was allocated from
+ */
+void pool_free(mem_pool *pool, void *obj);
+
+/*
+ *	log_mem_pool_stats - log the statistics of every pool and start
+ *			     counting a new cycle
+ */
+void log_mem_pool_stats(void);
+
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* _MEM_POOL_H */
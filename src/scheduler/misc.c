@@ -44,6 +44,7 @@
  *
  * Functions included are:
  * 		string_dup()
+ * 		intern_string()
  * 		concat_str()
  * 		add_str_to_unique_array()
  * 		add_str_to_array()
@@ -82,6 +83,8 @@
  * 		res_to_str_c()
  * 		res_to_str_r()
  * 		res_to_str_re()
+ * 		fingerprint_bytes()
+ * 		fingerprint_str()
  *
  */
 #include <pbs_config.h>
@@ -93,6 +96,9 @@
 #include <string.h>
 #include <errno.h>
 #include <math.h>
+#ifndef WIN32
+#include <pthread.h>
+#endif
 #include <pbs_ifl.h>
 #include <pbs_internal.h>
 #include <pbs_error.h>
@@ -136,6 +142,58 @@ string_dup(char *str)
 	return newstr;
 }
 
+/**
+ * @brief
+ *		intern_string - return the one shared copy of a string.  Names
+ *		which are repeated across many objects (e.g. the user, group and
+ *		project of each job) are interned so each distinct name is stored
+ *		once and two interned names can be compared by pointer.
+ *
+ * @param[in]	str	-	string to intern
+ *
+ * @return	the interned copy of str.  It lives for the life of the
+ *		scheduler and must not be freed or modified.
+ * @retval	NULL	: str is NULL or on error
+ *
+ * @par MT-Safe:	yes
+ */
+char *
+intern_string(char *str)
+{
+	static AVL_IX_DESC *intern_index = NULL;
+#ifndef WIN32
+	static pthread_mutex_t intern_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+	char *istr;
+
+	if (str == NULL)
+		return NULL;
+
+#ifndef WIN32
+	pthread_mutex_lock(&intern_lock);
+#endif
+	if (intern_index == NULL)
+		intern_index = create_tree(AVL_NO_DUP_KEYS, 0);
+
+	if (intern_index == NULL)
+		istr = NULL;
+	else if ((istr = find_tree(intern_index, str)) == NULL) {
+		if ((istr = string_dup(str)) != NULL &&
+			tree_add_del(intern_index, istr, istr, TREE_OP_ADD) != 0) {
+			free(istr);
+			istr = NULL;
+		}
+	}
+#ifndef WIN32
+	pthread_mutex_unlock(&intern_lock);
+#endif
+
+	if (istr == NULL)
+		log_err(errno, __func__, MEM_ERR_MSG);
+
+	return istr;
+}
+
 /**
  * @brief
  *		concat_str - contactenate up to three strings together in newly
@@ -1704,3 +1762,47 @@ res_to_str_re(void *p, enum resource_fields fld, char **buf,
 	return *buf;
 }
 
+/**
+ * @brief
+ * 		fold a buffer into a fingerprint (64 bit FNV-1a).  Fingerprints
+ * 		are used to notice when state has changed between cycles.
+ *
+ * @param[in]	fp	-	fingerprint so far (start with FINGERPRINT_INIT)
+ * @param[in]	buf	-	buffer to add
+ * @param[in]	len	-	length of buf
+ *
+ * @return	the new fingerprint
+ */
+unsigned long long
+fingerprint_bytes(unsigned long long fp, const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		fp ^= p[i];
+		fp *= 1099511628211ULL;
+	}
+
+	return fp;
+}
+
+/**
+ * @brief
+ * 		fold a string into a fingerprint.  The terminating NUL is added
+ * 		so consecutive strings can't run together.  A NULL string is
+ * 		added as a single marker byte.
+ *
+ * @param[in]	fp	-	fingerprint so far
+ * @param[in]	str	-	string to add
+ *
+ * @return	the new fingerprint
+ */
+unsigned long long
+fingerprint_str(unsigned long long fp, const char *str)
+{
+	if (str == NULL)
+		return fingerprint_bytes(fp, "\377", 1);
+
+	return fingerprint_bytes(fp, str, strlen(str) + 1);
+}
@@ -51,6 +51,12 @@ extern "C" {
  */
 char *string_dup(char *str);
 
+/*
+ *	intern_string - return the one shared copy of a string
+ *			the copy must not be freed
+ */
+char *intern_string(char *str);
+
 /*
  *	concat_str - contactenate up to three strings together in newly
  *		     allocated memory
@@ -296,6 +302,18 @@ add_str_to_array(char ***str_arr, char *str);
 int
 add_str_to_unique_array(char ***str_arr, char *str);
 
+/*
+ * fold a buffer into a fingerprint
+ */
+unsigned long long
+fingerprint_bytes(unsigned long long fp, const void *buf, size_t len);
+
+/*
+ * fold a string into a fingerprint
+ */
+unsigned long long
+fingerprint_str(unsigned long long fp, const char *str);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -44,6 +44,8 @@
  *
  * Functions included are:
  * 	query_nodes()
+ * 	query_node_in_pool()
+ * 	query_nodes_in_pool()
  * 	query_node_info()
  * 	new_node_info()
  * 	free_nodes()
@@ -52,7 +54,13 @@
  * 	set_node_info_state()
  * 	remove_node_state()
  * 	add_node_state()
- * 	talk_with_mom()
+ * 	free_mom_answers()
+ * 	age_mom_answers()
+ * 	find_alloc_mom_answers()
+ * 	apply_mom_answers()
+ * 	read_mom_answers()
+ * 	mom_failed()
+ * 	talk_with_moms()
  * 	node_filter()
  * 	find_node_info()
  * 	find_node_by_host()
@@ -137,6 +145,7 @@
 #include "job_info.h"
 #include "misc.h"
 #include "globals.h"
+#include "snapshot.h"
 #include "check.h"
 #include "constant.h"
 #include "config.h"
@@ -149,14 +158,99 @@
 #include "server_info.h"
 #include "pbs_share.h"
 #include "pbs_bitmap.h"
+#include "thread_pool.h"
+#include "mem_pool.h"
+#include "cycle_stats.h"
+#include "undo_log.h"
 #ifdef NAS
 #include "site_code.h"
 #endif
 
 
+/* pool nspecs are allocated from */
+static mem_pool nspec_pool = MEM_POOL_INITIALIZER("nspec", sizeof(nspec));
+
 /* name of the last node a job ran on - used in smp_dist = round robin */
 static char last_node_name[PBS_MAXSVRJOBID];
 
+/* the vnodes of one query_nodes() call being converted by the thread pool */
+struct node_query
+{
+	struct batch_status **nodes;	/* batch_status of each vnode */
+	server_info *sinfo;		/* server the vnodes belong to */
+	node_info **ninfos;		/* converted vnodes, in the order of nodes */
+};
+
+/**
+ * @brief
+ *		convert one vnode of a node_query.  Called by the thread pool.
+ *
+ * @param[in]	index	-	index of the vnode to convert
+ * @param[in]	arg	-	the node_query
+ *
+ * @return	nothing
+ * @par MT-safe: Yes
+ */
+static void
+query_node_in_pool(int index, void *arg)
+{
+	struct node_query *nq = (struct node_query *) arg;
+
+	nq->ninfos[index] = query_node_info(nq->nodes[index], nq->sinfo);
+}
+
+/**
+ * @brief
+ *		convert a list of vnodes from the server with conf.query_threads
+ *		threads.  The vnodes are returned in the order of the list.
+ *
+ * @param[in]	nodes	-	batch_status list of the vnodes
+ * @param[in]	num	-	number of vnodes in the list
+ * @param[in]	sinfo	-	server the vnodes belong to
+ *
+ * @return	node_info **
+ * @retval	array of num converted vnodes (not NULL terminated)
+ * @retval	NULL	: on error
+ * @par MT-safe: No
+ */
+static node_info **
+query_nodes_in_pool(struct batch_status *nodes, int num, server_info *sinfo)
+{
+	struct node_query nq;
+	struct batch_status *cur_node;
+	int failed = 0;
+	int i;
+
+	nq.sinfo = sinfo;
+	nq.nodes = malloc(num * sizeof(struct batch_status *));
+	nq.ninfos = calloc(num, sizeof(node_info *));
+	if (nq.nodes == NULL || nq.ninfos == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free(nq.nodes);
+		free(nq.ninfos);
+		return NULL;
+	}
+
+	for (i = 0, cur_node = nodes; i < num && cur_node != NULL; i++, cur_node = cur_node->next)
+		nq.nodes[i] = cur_node;
+
+	run_in_thread_pool(conf.query_threads, num, query_node_in_pool, &nq);
+	free(nq.nodes);
+
+	for (i = 0; i < num; i++)
+		if (nq.ninfos[i] == NULL)
+			failed = 1;
+
+	if (failed) {
+		for (i = 0; i < num; i++)
+			free_node_info(nq.ninfos[i]);
+		free(nq.ninfos);
+		return NULL;
+	}
+
+	return nq.ninfos;
+}
+
 /**
  * @brief
  *      query_nodes - query all the nodes associated with a server
@@ -174,6 +268,7 @@ query_nodes(int pbs_sd, server_info *sinfo)
 	struct batch_status *cur_node;	/* used to cycle through nodes */
 	node_info **ninfo_arr;		/* array of nodes for scheduler's use */
 	node_info *ninfo;			/* used to set up a node */
+	node_info **parsed = NULL;		/* vnodes converted by the thread pool */
 	char errbuf[256];
 	char *err;				/* used with pbs_geterrmsg() */
 	int num_nodes = 0;			/* the number of nodes */
@@ -181,7 +276,9 @@ query_nodes(int pbs_sd, server_info *sinfo)
 	int nidx;
 
 	/* get nodes from PBS server */
-	if ((nodes = pbs_statvnode(pbs_sd, NULL, NULL, NULL)) == NULL) {
+	nodes = pbs_statvnode(pbs_sd, NULL, NULL, NULL);
+	snapshot_status("pbs_statvnode", nodes);
+	if (nodes == NULL) {
 		err = pbs_geterrmsg(pbs_sd);
 		sprintf(errbuf, "Error getting nodes: %s", err);
 		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_NODE, LOG_INFO, "", errbuf);
@@ -210,15 +307,33 @@ query_nodes(int pbs_sd, server_info *sinfo)
 	}
 #endif /* localmod 049 */
 
+	/* convert the vnodes up front with a pool of threads if there are many */
+	if (conf.query_threads > 1 && num_nodes >= MIN_PARALLEL_QUERY) {
+		if ((parsed = query_nodes_in_pool(nodes, num_nodes, sinfo)) == NULL) {
+			pbs_statfree(nodes);
+			free_nodes(ninfo_arr);
+			return NULL;
+		}
+	}
+
 	cur_node = nodes;
 	for (i = 0, nidx = 0; cur_node != NULL; i++) {
 		/* get node info from server */
-		if ((ninfo = query_node_info(cur_node, sinfo)) == NULL) {
+		if (parsed != NULL) {
+			ninfo = parsed[i];
+			parsed[i] = NULL;
+		}
+		else if ((ninfo = query_node_info(cur_node, sinfo)) == NULL) {
 			pbs_statfree(nodes);
 			free_nodes(ninfo_arr);
 			return NULL;
 		}
 
+		if (ninfo->lic_lock)
+			sinfo->has_nonCPU_licenses = 1;
+		if (ninfo->is_multivnoded)
+			sinfo->has_multi_vnode = 1;
+
 #ifdef NAS /* localmod 049 */
 		ninfo->NASrank = i;
 		sinfo->nodes_by_NASrank[i] = ninfo;
@@ -226,14 +341,6 @@ query_nodes(int pbs_sd, server_info *sinfo)
 
 		if (node_in_partition(ninfo, sinfo->partitions)) {
 			ninfo->rank = get_sched_rank();
-			/* get node info from mom */
-			if (talk_with_mom(ninfo)) {
-				/* failed to get information from node, mark it not free for this cycle */
-				ninfo->is_free = 0;
-				ninfo->is_offline = 1;
-				schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_NODE, LOG_INFO, ninfo->name,
-					"Failed to talk with mom, marking node offline");
-			}
 			ninfo_arr[nidx++] = ninfo;
 		} else
 			free_node_info(ninfo);
@@ -241,6 +348,7 @@ query_nodes(int pbs_sd, server_info *sinfo)
 		cur_node = cur_node->next;
 	}
 	ninfo_arr[nidx] = NULL;
+	free(parsed);
 	if (nidx == 0) {
 		snprintf(log_buffer, sizeof(log_buffer), "No nodes found in partitions serviced by scheduler");
 		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SERVER, LOG_INFO, __func__, log_buffer);
@@ -248,6 +356,13 @@ query_nodes(int pbs_sd, server_info *sinfo)
 		return NULL;
 	}
 
+	/* get node info from the moms */
+	if (talk_with_moms(ninfo_arr)) {
+		pbs_statfree(nodes);
+		free_nodes(ninfo_arr);
+		return NULL;
+	}
+
 	if (update_mom_resources(ninfo_arr) == 0) {
 		pbs_statfree(nodes);
 		free_nodes(ninfo_arr);
@@ -269,10 +384,11 @@ query_nodes(int pbs_sd, server_info *sinfo)
  *      put it in a node_info struct for easier access
  *
  * @param[in]	node	-	a node returned from a pbs_statvnode() call
- * @param[in,out]	sinfo	-	server information
+ * @param[in]	sinfo	-	server information
  *
  * @return	a node_info filled with information from node
  *
+ * @par MT-safe: Yes - server wide flags are set by query_nodes()
  */
 node_info *
 query_node_info(struct batch_status *node, server_info *sinfo)
@@ -374,7 +490,6 @@ query_node_info(struct batch_status *node, server_info *sinfo)
 			switch (attrp->value[0]) {
 				case ND_LIC_TYPE_locked:
 					ninfo->lic_lock = 1;
-					sinfo->has_nonCPU_licenses = 1;
 					break;
 				default:
 					sprintf(logbuf, "Unknown license type: %c", attrp->value[0]);
@@ -442,8 +557,6 @@ query_node_info(struct batch_status *node, server_info *sinfo)
 				count = strtol(attrp->value, &endp, 10);
 				if (*endp == '\0')
 					ninfo->is_multivnoded = count;
-				if ((!sinfo->has_multi_vnode) && (count != 0))
-					sinfo->has_multi_vnode = 1;
 			}
 		} else if  (!strcmp(attrp->name, ATTR_NODE_last_state_change_time)) {
 			count = strtol(attrp->value, &endp, 10);
@@ -691,8 +804,9 @@ int
 set_node_info_state(node_info *ninfo, char *state)
 {
 	char errbuf[256];
-	char statebuf[256];			/* used to strtok() node states */
-	char *tok;				/* used with strtok() */
+	char statebuf[256];			/* used to strtok_r() node states */
+	char *tok;				/* used with strtok_r() */
+	char *saveptr;
 
 	if (ninfo != NULL && state != NULL) {
 		/* clear all states */
@@ -703,7 +817,7 @@ set_node_info_state(node_info *ninfo, char *state)
 		ninfo->is_sleeping = 0;
 
 		strcpy(statebuf, state);
-		tok = strtok(statebuf, ",");
+		tok = strtok_r(statebuf, ",", &saveptr);
 
 		while (tok != NULL) {
 			while (isspace((int) *tok))
@@ -715,7 +829,7 @@ set_node_info_state(node_info *ninfo, char *state)
 					ninfo->name, errbuf);
 			}
 
-			tok = strtok(NULL, ",");
+			tok = strtok_r(NULL, ",", &saveptr);
 		}
 		return 0;
 	}
@@ -865,53 +979,186 @@ add_node_state(node_info *ninfo, char *state)
 	return 0;
 }
 
+/* the answers of a mom to the queries made by talk_with_moms(), kept
+ * between cycles so a mom is only asked again every mom_resources_refresh
+ * seconds, or when it doesn't answer in time.  A mom's answers are shared
+ * by all the vnodes it serves.
+ */
+struct mom_answers
+{
+	char *name;			/* mom host:port */
+	char **answers;			/* res_to_get answers, then conf.dyn_res_to_get answers */
+	time_t answer_time;		/* when the mom answered */
+	int last_used;			/* mom_cycle of the last lookup */
+	int failed;			/* no usable answers this cycle */
+	struct mom_answers *next;
+};
+
+/* a query to a mom made by talk_with_moms() */
+struct mom_query
+{
+	node_info *ninfo;		/* the first vnode of the mom */
+	int mom_sd;			/* connection to the mom or -1 when done */
+	struct mom_answers *ma;		/* cached answers of the mom */
+};
+
+static AVL_IX_DESC *mom_index = NULL;		/* mom host:port -> answers */
+static struct mom_answers *mom_list = NULL;	/* all cached answers */
+static int mom_cycle = 0;			/* advanced by age_mom_answers() */
+static char *mom_answers_reqs = NULL;		/* conf.dyn_res_to_get the answers are for */
+
 /**
  * @brief
- *      talk_with_mom - talk to mom and get resources
+ *		free a cached mom_answers entry
  *
- * @param[in,out]	ninfo	-	the node to to talk to its mom
+ * @param[in]	ma	-	the entry to free
  *
- * @return	int
- * @return	1	: on error
- * @return	0	: on success
+ * @return	nothing
+ */
+static void
+free_mom_answers(struct mom_answers *ma)
+{
+	if (ma == NULL)
+		return;
+
+	free(ma->name);
+	free_string_array(ma->answers);
+	free(ma);
+}
+
+/**
+ * @brief
+ *		start a new cycle of the mom answers cache: drop the answers of
+ *		the moms which were not talked to in the last cycle.  All the
+ *		answers are dropped if mom_resources has changed.
+ *
+ * @return	nothing
  *
+ * @par MT-Safe:	no
  */
-int
-talk_with_mom(node_info *ninfo)
+static void
+age_mom_answers(void)
 {
-	int mom_sd;			/* connection descriptor to mom */
-	int ret = 0;			/* return code of this function */
-	char *mom_ans = NULL;		/* the answer from mom - getreq() */
-	char *endp;			/* used with strtol() */
-	double testd;			/* used to convert string->double */
-	schd_resource *res;                /* used for dynamic resources from mom */
-	int ncpus = 1;		/* used as a default for loads */
-	char errbuf[MAX_LOG_SIZE];
+	struct mom_answers *ma;
+	struct mom_answers *prev = NULL;
+	struct mom_answers *next;
+	char *reqs = NULL;
+	int size = 0;
+	int flush;
 	int i;
 
-	if (!should_talk_with_mom(ninfo))
-		return 0;
+	if (conf.dyn_res_to_get != NULL) {
+		for (i = 0; conf.dyn_res_to_get[i] != NULL; i++)
+			if (pbs_strcat(&reqs, &size, conf.dyn_res_to_get[i]) == NULL ||
+				pbs_strcat(&reqs, &size, ",") == NULL)
+				break;
+	}
+	flush = reqs == NULL || mom_answers_reqs == NULL ?
+		reqs != mom_answers_reqs : strcmp(reqs, mom_answers_reqs) != 0;
+	free(mom_answers_reqs);
+	mom_answers_reqs = reqs;
 
-	schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_NODE, LOG_DEBUG, ninfo->name,
-		"Initiating communication with mom");
-	if ((mom_sd = openrm(ninfo->mom, ninfo->port)) < 0) {
-		schdlog(PBSEVENT_SYSTEM, PBS_EVENTCLASS_REQUEST, LOG_INFO, ninfo->name,
-			"Cannot open connection to mom");
-		return 1;
+	mom_cycle++;
+
+	for (ma = mom_list; ma != NULL; ma = next) {
+		next = ma->next;
+		if (!flush && ma->last_used >= mom_cycle - 1) {
+			prev = ma;
+			continue;
+		}
+
+		if (prev == NULL)
+			mom_list = next;
+		else
+			prev->next = next;
+
+		if (mom_index != NULL)
+			tree_add_del(mom_index, ma->name, NULL, TREE_OP_DEL);
+		free_mom_answers(ma);
 	}
+}
 
-	for (i = 0; i < num_resget; i++)
-		addreq(mom_sd, (char *) res_to_get[i]);
+/**
+ * @brief
+ *		find the cached answers of a mom, adding an empty entry if there
+ *		are none
+ *
+ * @param[in]	mom	-	host of the mom
+ * @param[in]	port	-	port of the mom
+ *
+ * @return	struct mom_answers *
+ * @retval	the cached answers
+ * @retval	NULL	: on error
+ *
+ * @par MT-Safe:	no
+ */
+static struct mom_answers *
+find_alloc_mom_answers(char *mom, unsigned int port)
+{
+	struct mom_answers *ma;
+	char *name;
 
-	if (conf.dyn_res_to_get) {
-		for (i = 0; conf.dyn_res_to_get[i]; i++)
-			addreq(mom_sd, (char *) conf.dyn_res_to_get[i]);
+	if (mom_index == NULL) {
+		if ((mom_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return NULL;
+		}
+	}
+
+	if ((name = malloc(strlen(mom) + 12)) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	sprintf(name, "%s:%u", mom, port);
+
+	ma = find_tree(mom_index, name);
+	if (ma == NULL) {
+		if ((ma = calloc(1, sizeof(struct mom_answers))) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			free(name);
+			return NULL;
+		}
+		ma->name = name;
+		if (tree_add_del(mom_index, ma->name, ma, TREE_OP_ADD) != 0) {
+			free_mom_answers(ma);
+			return NULL;
+		}
+		ma->next = mom_list;
+		mom_list = ma;
 	}
+	else
+		free(name);
+
+	return ma;
+}
+
+/**
+ * @brief
+ *		set the loads and mom_resources of a node from its mom's answers
+ *
+ * @param[in,out]	ninfo	-	the node
+ * @param[in]	answers	-	res_to_get answers, then conf.dyn_res_to_get answers
+ *
+ * @return	int
+ * @retval	1	: on error
+ * @retval	0	: on success
+ */
+static int
+apply_mom_answers(node_info *ninfo, char **answers)
+{
+	char *mom_ans;			/* the answer from mom */
+	char *endp;			/* used with strtol() */
+	double testd;			/* used to convert string->double */
+	schd_resource *res;                /* used for dynamic resources from mom */
+	int ncpus = 1;		/* used as a default for loads */
+	char errbuf[MAX_LOG_SIZE];
+	int i;
 
 	if ((res = find_resource(ninfo->res, getallres(RES_NCPUS))))
 		ncpus = res->avail;
 
-	for (i = 0; i < num_resget && (mom_ans = getreq(mom_sd)); i++) {
+	for (i = 0; i < num_resget; i++) {
+		mom_ans = answers[i];
 		if (!strcmp(res_to_get[i], "max_load")) {
 			testd = strtod(mom_ans, &endp);
 			if (*endp == '\0')
@@ -938,29 +1185,18 @@ talk_with_mom(node_info *ninfo)
 			schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_NODE, LOG_INFO,
 				ninfo->name, errbuf);
 		}
-		free(mom_ans);
-		mom_ans = NULL;
 	}
 
-	/* getreq() returned NULL and we bailed out of the loop */
-	if (i < num_resget) {
-		ret = 1;
-		schdlog(PBSEVENT_SYSTEM, PBS_EVENTCLASS_REQUEST, LOG_INFO, ninfo->name,
-			"Communications problem talking with mom.");
-	}
-
-	if (mom_ans)
-		free(mom_ans);
-	mom_ans = NULL;
-
-	if (ret == 0 && conf.dyn_res_to_get) {
-		for (i = 0; conf.dyn_res_to_get[i] && (mom_ans = getreq(mom_sd));  i++) {
+	if (conf.dyn_res_to_get) {
+		for (i = 0; conf.dyn_res_to_get[i]; i++) {
+			mom_ans = answers[num_resget + i];
 			res = find_alloc_resource_by_str(ninfo->res, conf.dyn_res_to_get[i]);
 			if (res != NULL) {
 				if (mom_ans[0] != '?') {
 					if (set_resource(res, mom_ans, RF_AVAIL) == 0) {
-						ret = 1;
-						break;
+						schdlog(PBSEVENT_SYSTEM, PBS_EVENTCLASS_REQUEST, LOG_INFO,
+							ninfo->name, "Communications problem talking with mom.");
+						return 1;
 					}
 				}
 				else if (res->avail == SCHD_INFINITY)
@@ -971,23 +1207,254 @@ talk_with_mom(node_info *ninfo)
 				schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_NODE, LOG_DEBUG,
 					"mom_resources", errbuf);
 			}
-			free(mom_ans);
-			mom_ans = NULL;
 		}
-		if (conf.dyn_res_to_get[i]) {
-			ret = 1;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief
+ *		read the answers to the queries sent to a mom
+ *
+ * @param[in]	mom_sd	-	connection to the mom
+ * @param[in]	num	-	number of answers
+ *
+ * @return	char **
+ * @retval	NULL terminated array of the answers
+ * @retval	NULL	: on error
+ */
+static char **
+read_mom_answers(int mom_sd, int num)
+{
+	char **answers;
+	int i;
+
+	if ((answers = calloc(num + 1, sizeof(char *))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	for (i = 0; i < num; i++) {
+		if ((answers[i] = getreq(mom_sd)) == NULL) {
+			free_string_array(answers);
+			return NULL;
+		}
+	}
+
+	return answers;
+}
+
+/**
+ * @brief
+ *		mark a node whose mom we failed to talk to not free for the cycle
+ *
+ * @param[in,out]	ninfo	-	the node
+ *
+ * @return	nothing
+ */
+static void
+mom_failed(node_info *ninfo)
+{
+	ninfo->is_free = 0;
+	ninfo->is_offline = 1;
+	schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_NODE, LOG_INFO, ninfo->name,
+		"Failed to talk with mom, marking node offline");
+}
+
+/**
+ * @brief
+ *      talk_with_moms - talk to the moms of nodes and get resources.
+ *	Each mom is asked once, and its answers are used for all the vnodes
+ *	it serves.  The queries are sent to all the moms before any answers
+ *	are read, so the moms answer concurrently.  Answers are cached and a
+ *	mom is only asked again after mom_resources_refresh seconds.  Moms
+ *	which don't answer within mom_resources_timeout seconds are given up
+ *	on for the cycle and their cached answers are used.  A node is marked
+ *	offline for the cycle if its mom can't be talked to and it has no
+ *	cached answers.
+ *
+ * @param[in,out]	ninfo_arr	-	the nodes to talk to the moms of
+ *
+ * @return	int
+ * @return	1	: on error
+ * @return	0	: on success
+ *
+ * @par MT-Safe:	no
+ */
+int
+talk_with_moms(node_info **ninfo_arr)
+{
+	struct mom_query *queries;
+	struct mom_query *q;
+	struct mom_answers **node_ma;	/* the answers of each node's mom */
+	struct mom_answers *ma;
+	node_info *ninfo;
+	char **answers;
+	int num_answers = num_resget;
+	int num_queries = 0;
+	int pending;
+	int mom_sd;
+	long long deadline = 0;
+	long long remaining;
+	time_t now;
+	int rc;
+	int i;
+	int j;
+
+	if (ninfo_arr == NULL)
+		return 1;
+
+	age_mom_answers();
+
+	if (conf.dyn_res_to_get) {
+		for (i = 0; conf.dyn_res_to_get[i]; i++)
+			num_answers++;
+	}
+
+	for (i = 0; ninfo_arr[i] != NULL; i++)
+		;
+	if ((queries = malloc((i + 1) * sizeof(struct mom_query))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return 1;
+	}
+	if ((node_ma = calloc(i + 1, sizeof(struct mom_answers *))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free(queries);
+		return 1;
+	}
+
+	/* send one query to each mom whose cached answers are too old */
+	now = time(NULL);
+	for (i = 0; ninfo_arr[i] != NULL; i++) {
+		ninfo = ninfo_arr[i];
+		if (!should_talk_with_mom(ninfo))
+			continue;
+
+		if (ninfo->mom == NULL ||
+			(ma = find_alloc_mom_answers(ninfo->mom, ninfo->port)) == NULL) {
 			schdlog(PBSEVENT_SYSTEM, PBS_EVENTCLASS_REQUEST, LOG_INFO, ninfo->name,
+				"Cannot open connection to mom");
+			mom_failed(ninfo);
+			continue;
+		}
+		node_ma[i] = ma;
+
+		/* another vnode of the mom was already seen this cycle */
+		if (ma->last_used == mom_cycle)
+			continue;
+		ma->last_used = mom_cycle;
+		ma->failed = 0;
+
+		if (ma->answers != NULL &&
+			now - ma->answer_time < conf.mom_resources_refresh)
+			continue;
+
+		schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_NODE, LOG_DEBUG, ninfo->mom,
+			"Initiating communication with mom");
+		if ((mom_sd = openrm(ninfo->mom, ninfo->port)) < 0) {
+			schdlog(PBSEVENT_SYSTEM, PBS_EVENTCLASS_REQUEST, LOG_INFO, ninfo->mom,
+				"Cannot open connection to mom");
+			ma->failed = 1;
+			continue;
+		}
+
+		/* a failed addreq() closes the connection */
+		rc = 0;
+		for (j = 0; j < num_resget && rc == 0; j++)
+			rc = addreq(mom_sd, (char *) res_to_get[j]);
+
+		if (conf.dyn_res_to_get) {
+			for (j = 0; conf.dyn_res_to_get[j] && rc == 0; j++)
+				rc = addreq(mom_sd, (char *) conf.dyn_res_to_get[j]);
+		}
+		if (rc != 0) {
+			schdlog(PBSEVENT_SYSTEM, PBS_EVENTCLASS_REQUEST, LOG_INFO, ninfo->mom,
+				"Communications problem talking with mom.");
+			ma->failed = 1;
+			continue;
+		}
+
+		q = &queries[num_queries++];
+		q->ninfo = ninfo;
+		q->mom_sd = mom_sd;
+		q->ma = ma;
+	}
+
+	if (conf.mom_resources_timeout > 0)
+		deadline = now_usec() + (long long) conf.mom_resources_timeout * 1000000;
+
+	/* read the answers in the order they arrive */
+	for (pending = num_queries; pending > 0; ) {
+		remaining = -1;
+		if (deadline > 0) {
+			remaining = (deadline - now_usec()) / 1000;
+			if (remaining <= 0)
+				break;
+		}
+		if ((mom_sd = pollreq((int) remaining)) < 0)
+			break;
+
+		for (i = 0; i < num_queries && queries[i].mom_sd != mom_sd; i++)
+			;
+		if (i == num_queries)
+			continue;
+		q = &queries[i];
+
+		answers = read_mom_answers(mom_sd, num_answers);
+		closerm(mom_sd);
+		q->mom_sd = -1;
+		pending--;
+		schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_NODE, LOG_DEBUG, q->ninfo->mom,
+			"Ended communication with mom");
+
+		if (answers == NULL) {
+			schdlog(PBSEVENT_SYSTEM, PBS_EVENTCLASS_REQUEST, LOG_INFO, q->ninfo->mom,
 				"Communications problem talking with mom.");
+			q->ma->failed = 1;
+			continue;
+		}
+
+		free_string_array(q->ma->answers);
+		q->ma->answers = answers;
+		q->ma->answer_time = time(NULL);
+	}
+
+	/* the moms which didn't answer in time */
+	for (i = 0; i < num_queries; i++) {
+		q = &queries[i];
+		if (q->mom_sd == -1)
+			continue;
+
+		closerm(q->mom_sd);
+		q->mom_sd = -1;
+		if (q->ma->answers != NULL) {
+			snprintf(log_buffer, sizeof(log_buffer),
+				"Mom did not answer in time, using its answers from %ld seconds ago",
+				(long) (time(NULL) - q->ma->answer_time));
+			schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_NODE, LOG_INFO,
+				q->ninfo->mom, log_buffer);
+		}
+		else {
+			schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_NODE, LOG_INFO,
+				q->ninfo->mom, "Mom did not answer in time");
+			q->ma->failed = 1;
 		}
 	}
-	if (mom_ans)
-		free(mom_ans);
-	mom_ans = NULL;
 
-	closerm(mom_sd);
-	schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_NODE, LOG_DEBUG, ninfo->name,
-		"Ended communication with mom");
-	return (ret);
+	/* every vnode gets its mom's answers */
+	for (i = 0; ninfo_arr[i] != NULL; i++) {
+		ma = node_ma[i];
+		if (ma == NULL)
+			continue;
+		if (ma->failed || ma->answers == NULL ||
+			apply_mom_answers(ninfo_arr[i], ma->answers))
+			mom_failed(ninfo_arr[i]);
+	}
+
+	free(node_ma);
+	free(queries);
+	return 0;
 }
 /**
  * @brief
@@ -1050,15 +1517,25 @@ node_filter(node_info **nodes, int size,
  * @return	the node
  * @retval	NULL	: if not found
  *
+ * @note
+ * 		If ninfo_arr is the server's node array, the server's node index
+ * 		is used instead of a linear search.
+ *
  */
 node_info *
 find_node_info(node_info **ninfo_arr, char *nodename)
 {
 	int i;
+	server_info *sinfo;
 
 	if (nodename == NULL || ninfo_arr == NULL)
 		return NULL;
 
+	if (ninfo_arr[0] != NULL && (sinfo = ninfo_arr[0]->server) != NULL &&
+		sinfo->node_index != NULL &&
+		(ninfo_arr == sinfo->nodes || ninfo_arr == sinfo->unordered_nodes))
+		return find_tree(sinfo->node_index, nodename);
+
 	for (i = 0; ninfo_arr[i] != NULL &&
 		strcmp(nodename, ninfo_arr[i]->name) ; i++)
 		;
@@ -1077,16 +1554,27 @@ find_node_info(node_info **ninfo_arr, char *nodename)
  * @return	found node
  * @retval	NULL	: not found
  *
+ * @note
+ * 		If ninfo_arr is the server's node array, the server's host index
+ * 		is used and the first vnode the server reported for the host is
+ * 		returned.
+ *
  */
 node_info *
 find_node_by_host(node_info **ninfo_arr, char *host)
 {
 	int i;
 	schd_resource *res;
+	server_info *sinfo;
 
 	if (ninfo_arr == NULL || host == NULL)
 		return NULL;
 
+	if (ninfo_arr[0] != NULL && (sinfo = ninfo_arr[0]->server) != NULL &&
+		sinfo->host_index != NULL &&
+		(ninfo_arr == sinfo->nodes || ninfo_arr == sinfo->unordered_nodes))
+		return find_node_by_host_index(sinfo, host);
+
 	for (i = 0; ninfo_arr[i] != NULL; i++) {
 		res = find_resource(ninfo_arr[i]->res, getallres(RES_HOST));
 		if (res != NULL) {
@@ -1457,6 +1945,7 @@ collect_jobs_on_nodes(node_info **ninfo_arr, resource_resv **resresv_arr, int si
 	node_info *node;	/* used to store pointer of node in ninfo_arr */
 	char logbuf[MAX_LOG_SIZE];
 	resource_resv **temp_ninfo_arr = NULL;
+	AVL_IX_DESC *job_index = NULL;	/* job name -> job in resresv_arr */
 
 	if (ninfo_arr == NULL || ninfo_arr[0] == NULL)
 		return 0;
@@ -1468,6 +1957,15 @@ collect_jobs_on_nodes(node_info **ninfo_arr, resource_resv **resresv_arr, int si
 		ninfo_arr[i]->job_arr[0] = NULL;
 	}
 
+	/* resresv_arr is usually a filtered copy of the server's jobs, so index
+	 * it ourselves rather than searching it once per job on every node
+	 */
+	if (resresv_arr != NULL && (job_index = create_tree(AVL_NO_DUP_KEYS, 0)) != NULL) {
+		for (i = 0; resresv_arr[i] != NULL; i++)
+			if (find_tree(job_index, resresv_arr[i]->name) == NULL)
+				tree_add_del(job_index, resresv_arr[i]->name, resresv_arr[i], TREE_OP_ADD);
+	}
+
 	for (i = 0; ninfo_arr[i] != NULL; i++) {
 		if (ninfo_arr[i]->jobs != NULL) {
 			for (j = 0, k = 0; ninfo_arr[i]->jobs[j] != NULL && k < size; j++) {
@@ -1479,7 +1977,10 @@ collect_jobs_on_nodes(node_info **ninfo_arr, resource_resv **resresv_arr, int si
 				if (ptr != NULL)
 					*ptr = '\0';
 
-				job = find_resource_resv(resresv_arr, ninfo_arr[i]->jobs[j]);
+				if (job_index != NULL)
+					job = find_tree(job_index, ninfo_arr[i]->jobs[j]);
+				else
+					job = find_resource_resv(resresv_arr, ninfo_arr[i]->jobs[j]);
 				if ((job != NULL) && (job->nspec_arr != NULL)) {
 					/* if a distributed job has more then one instance on this node
 					 * it'll show up more then once.  If this is the case, we only
@@ -1527,6 +2028,11 @@ collect_jobs_on_nodes(node_info **ninfo_arr, resource_resv **resresv_arr, int si
 		}
 	}
 
+	if (job_index != NULL) {
+		avl_destroy_index(job_index);
+		free(job_index);
+	}
+
 	for (i = 0; ninfo_arr[i] != NULL; i++) {
 		temp_ninfo_arr = realloc(
 			ninfo_arr[i]->job_arr,
@@ -1588,6 +2094,7 @@ update_node_on_run(nspec *ns, resource_resv *resresv, char *job_state)
 	resource_resv **tmp_arr;
 	node_info *ninfo;
 	timed_event *te;
+	undo_log *ul;
 
 	if (ns == NULL || resresv == NULL)
 		return;
@@ -1598,9 +2105,13 @@ update_node_on_run(nspec *ns, resource_resv *resresv, char *job_state)
 	if (ninfo->is_offline || ninfo->is_down)
 		return;
 
+	ul = ninfo->server->undo;
+	undo_save(ul, ninfo, sizeof(node_info));
+
 	if (resresv->is_job) {
 		ninfo->num_jobs++;
 		if (find_resource_resv_by_indrank(ninfo->job_arr, resresv->rank, resresv->resresv_ind) == NULL) {
+			undo_copy_array(ul, (void ***) &ninfo->job_arr);
 			tmp_arr = add_resresv_to_array(ninfo->job_arr, resresv);
 			if (tmp_arr == NULL)
 				return;
@@ -1612,6 +2123,7 @@ update_node_on_run(nspec *ns, resource_resv *resresv, char *job_state)
 	else if (resresv->is_resv) {
 		ninfo->num_run_resv++;
 		if (find_resource_resv_by_indrank(ninfo->run_resvs_arr, resresv->rank, resresv->resresv_ind) == NULL) {
+			undo_copy_array(ul, (void ***) &ninfo->run_resvs_arr);
 			tmp_arr = add_resresv_to_array(ninfo->run_resvs_arr, resresv);
 			if (tmp_arr == NULL)
 				return;
@@ -1638,13 +2150,16 @@ update_node_on_run(nspec *ns, resource_resv *resresv, char *job_state)
 				if (res->indirect_res != NULL)
 					res = res->indirect_res;
 
+				undo_resource(ul, res);
 				res->assigned += resreq->amount;
 
 				if (res->def  == getallres(RES_NCPUS)) {
 					ncpusres = res;
 					ninfo->loadave += resreq->amount;
-					if (!ninfo->lic_lock)
+					if (!ninfo->lic_lock) {
+						undo_save(ul, &ninfo->server->flt_lic, sizeof(ninfo->server->flt_lic));
 						ninfo->server->flt_lic -= resreq->amount;
+					}
 				}
 			}
 		}
@@ -1652,18 +2167,10 @@ update_node_on_run(nspec *ns, resource_resv *resresv, char *job_state)
 	}
 
 	if (ninfo->has_hard_limit && resresv->is_job) {
-		cts = find_alloc_counts(ninfo->group_counts, resresv->group);
-
-		if (ninfo->group_counts == NULL)
-			ninfo->group_counts = cts;
-
+		cts = find_alloc_counts_undo(ul, &ninfo->group_counts, resresv->group);
 		update_counts_on_run(cts, ns->resreq);
 
-		cts = find_alloc_counts(ninfo->user_counts, resresv->user);
-
-		if (ninfo->user_counts == NULL)
-			ninfo->user_counts = cts;
-
+		cts = find_alloc_counts_undo(ul, &ninfo->user_counts, resresv->user);
 		update_counts_on_run(cts, ns->resreq);
 	}
 
@@ -1684,16 +2191,20 @@ update_node_on_run(nspec *ns, resource_resv *resresv, char *job_state)
 			/* for jobs inside reservation, update the server's node info as well */
 			if (resresv->job != NULL && resresv->job->resv != NULL &&
 				ninfo->svr_node != NULL) {
+				undo_save(ul, ninfo->svr_node, sizeof(node_info));
 				set_node_info_state(ninfo->svr_node, ND_prov);
 			}
 
 
+			undo_free_ptr(ul, (void **) &ninfo->current_aoe, free);
 			set_current_aoe(ninfo, resresv->aoename);
 		}
 
 		/* if job has eoe setting this node gets current_eoe set */
-		if (resresv->is_job && resresv->eoename != NULL)
+		if (resresv->is_job && resresv->eoename != NULL) {
+			undo_free_ptr(ul, (void **) &ninfo->current_eoe, free);
 			set_current_eoe(ninfo, resresv->eoename);
+		}
 
 		if (is_excl(resresv->place_spec, ninfo->sharing)) {
 			if (resresv->is_resv) {
@@ -1701,8 +2212,10 @@ update_node_on_run(nspec *ns, resource_resv *resresv, char *job_state)
 			}
 			else {
 				add_node_state(ninfo, ND_job_exclusive);
-				if (ninfo->svr_node != NULL)
+				if (ninfo->svr_node != NULL) {
+					undo_save(ul, ninfo->svr_node, sizeof(node_info));
 					add_node_state(ninfo->svr_node, ND_job_exclusive);
+				}
 			}
 		}
 	}
@@ -1714,12 +2227,19 @@ update_node_on_run(nspec *ns, resource_resv *resresv, char *job_state)
 		}
 	}
 
-	remove_te_list(&ninfo->node_events, te);
+	if (te != NULL && ninfo->node_events != NULL) {
+		undo_copy_ptr(ul, (void **) &ninfo->node_events,
+			(undo_copy_func_t) copy_te_list, (undo_func_t) free_te_list);
+		remove_te_list(&ninfo->node_events, te);
+	}
 
 	if (ninfo->node_ind != -1 && ninfo->bucket_ind != -1) {
 		node_bucket *bkt = ninfo->server->buckets[ninfo->bucket_ind];
 		int ind = ninfo->node_ind;
 
+		undo_bucket_bit(ul, bkt->free_pool, ind);
+		undo_bucket_bit(ul, bkt->busy_later_pool, ind);
+		undo_bucket_bit(ul, bkt->busy_pool, ind);
 		if (pbs_bitmap_get_bit(bkt->free_pool->truth, ind)) {
 			pbs_bitmap_bit_off(bkt->free_pool->truth, ind);
 			bkt->free_pool->truth_ct--;
@@ -1759,6 +2279,7 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, char *job_state)
 	char logbuf[MAX_LOG_SIZE];
 	int ind;
 	int i;
+	undo_log *ul;
 
 	if (ninfo == NULL || resresv == NULL || resresv->nspec_arr == NULL)
 		return;
@@ -1767,11 +2288,15 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, char *job_state)
 	if (ninfo->is_offline || ninfo->is_down)
 		return;
 
+	ul = ninfo->server->undo;
+	undo_save(ul, ninfo, sizeof(node_info));
+
 	if (resresv->is_job) {
 		ninfo->num_jobs--;
 		if (ninfo->num_jobs < 0)
 			ninfo->num_jobs = 0;
 
+		undo_copy_array(ul, (void ***) &ninfo->job_arr);
 		remove_resresv_from_array(ninfo->job_arr, resresv);
 	}
 	else if (resresv->is_resv) {
@@ -1779,6 +2304,7 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, char *job_state)
 		if (ninfo->num_run_resv < 0)
 			ninfo->num_run_resv = 0;
 
+		undo_copy_array(ul, (void ***) &ninfo->run_resvs_arr);
 		remove_resresv_from_array(ninfo->run_resvs_arr, resresv);
 	}
 
@@ -1789,8 +2315,10 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, char *job_state)
 			remove_node_state(ninfo, ND_resv_exclusive);
 		else {
 			remove_node_state(ninfo, ND_job_exclusive);
-			if (ninfo->svr_node != NULL)
+			if (ninfo->svr_node != NULL) {
+				undo_save(ul, ninfo->svr_node, sizeof(node_info));
 				remove_node_state(ninfo->svr_node, ND_job_exclusive);
+			}
 		}
 	}
 
@@ -1812,6 +2340,7 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, char *job_state)
 					if (res != NULL) {
 						if (res->indirect_res != NULL)
 							res = res->indirect_res;
+						undo_resource(ul, res);
 						res->assigned -= resreq->amount;
 						if (res->assigned < 0) {
 							snprintf(logbuf, MAX_LOG_SIZE,
@@ -1825,8 +2354,10 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, char *job_state)
 							if (ninfo->loadave < 0)
 								ninfo->loadave = 0;
 
-							if (!ninfo->lic_lock)
+							if (!ninfo->lic_lock) {
+								undo_save(ul, &ninfo->server->flt_lic, sizeof(ninfo->server->flt_lic));
 								ninfo->server->flt_lic += resreq->amount;
+							}
 						}
 					}
 				}
@@ -1834,12 +2365,12 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, char *job_state)
 			}
 			/* no soft limits on nodes... just hard limits */
 			if (ninfo->has_hard_limit && resresv->is_job) {
-				cts = find_counts(ninfo->group_counts, resresv->group);
+				cts = find_counts_undo(ul, ninfo->group_counts, resresv->group);
 
 				if (cts != NULL)
 					update_counts_on_end(cts, ns->resreq);
 
-				cts = find_counts(ninfo->user_counts, resresv->user);
+				cts = find_counts_undo(ul, ninfo->user_counts, resresv->user);
 
 				if (cts != NULL)
 					update_counts_on_end(cts, ns->resreq);
@@ -1851,6 +2382,9 @@ update_node_on_end(node_info *ninfo, resource_resv *resresv, char *job_state)
 	if (ind != -1 && ninfo->bucket_ind != -1) {
 		node_bucket *bkt = ninfo->server->buckets[ninfo->bucket_ind];
 
+		undo_bucket_bit(ul, bkt->free_pool, ind);
+		undo_bucket_bit(ul, bkt->busy_later_pool, ind);
+		undo_bucket_bit(ul, bkt->busy_pool, ind);
 		if (ninfo->node_events == NULL) {
 			pbs_bitmap_bit_on(bkt->free_pool->truth, ind);
 			bkt->free_pool->truth_ct++;
@@ -1935,10 +2469,8 @@ new_nspec()
 {
 	nspec *ns;
 
-	if ((ns = (nspec *) malloc(sizeof(nspec))) == NULL) {
-		log_err(errno, "new_nspec", MEM_ERR_MSG);
+	if ((ns = pool_alloc(&nspec_pool)) == NULL)
 		return NULL;
-	}
 
 	ns->end_of_chunk = 0;
 	ns->seq_num = 0;
@@ -1968,7 +2500,7 @@ free_nspec(nspec *ns)
 	if (ns->resreq != NULL)
 		free_resource_req_list(ns->resreq);
 
-	free(ns);
+	pool_free(&nspec_pool, ns);
 }
 
 /**
@@ -2060,6 +2592,52 @@ dup_nspecs(nspec **onspecs, node_info **ninfo_arr)
 	return nnspecs;
 }
 
+/**
+ * @brief
+ * 		copy_nspec_array - copy an array of nspecs on the same nodes
+ *
+ * @param[in]	onspecs	-	the nspecs to copy
+ *
+ * @return	nspec **
+ * @retval	copied nspec array
+ * @retval	NULL	: on error
+ *
+ */
+nspec **
+copy_nspec_array(nspec **onspecs)
+{
+	nspec **nnspecs;
+	int num_ns;
+	int i;
+
+	if (onspecs == NULL)
+		return NULL;
+
+	num_ns = count_array((void **) onspecs);
+
+	if ((nnspecs = (nspec **) calloc(num_ns + 1, sizeof(nspec *))) == NULL)
+		return NULL;
+
+	for (i = 0; i < num_ns; i++) {
+		if ((nnspecs[i] = new_nspec()) == NULL) {
+			free_nspecs(nnspecs);
+			return NULL;
+		}
+		nnspecs[i]->end_of_chunk = onspecs[i]->end_of_chunk;
+		nnspecs[i]->seq_num = onspecs[i]->seq_num;
+		nnspecs[i]->sub_seq_num = onspecs[i]->sub_seq_num;
+		nnspecs[i]->go_provision = onspecs[i]->go_provision;
+		nnspecs[i]->ninfo = onspecs[i]->ninfo;
+		if (onspecs[i]->resreq != NULL &&
+			(nnspecs[i]->resreq = dup_resource_req_list(onspecs[i]->resreq)) == NULL) {
+			free_nspecs(nnspecs);
+			return NULL;
+		}
+	}
+
+	return nnspecs;
+}
+
 /**
  * @brief
  *		empty_nspec_array - free the contents of an nspec array but not
@@ -2280,8 +2858,8 @@ eval_selspec(status *policy, selspec *spec, place *placespec,
 			rc = eval_placement(policy, spec, nodepart[i]->ninfo_arr, pl,
 				resresv, pass_flags, nspec_arr, err);
 			if (rc > 0) {
-				if (resresv->nodepart_name != NULL)
-					free(resresv->nodepart_name);
+				undo_free_ptr(undo_owner(resresv->server->undo, resresv),
+					(void **) &resresv->nodepart_name, free);
 				resresv->nodepart_name = string_dup(nodepart[i]->name);
 				can_fit = 1;
 				if (nodepart[i]->excl)
@@ -2966,6 +3544,160 @@ eval_complex_selspec(status *policy, selspec *spec, node_info **ninfo_arr, place
 	return eval_complex_selspec(policy, spec, ninfo_arr, pl, resresv, flags, nspec_arr, err);
 }
 
+/* eligibility of each vnode of an array, checked by the thread pool */
+struct vnode_verdicts
+{
+	node_info **ninfo_arr;
+	resource_req *specreq;		/* non-consumable chunk resources */
+	resource_resv *resresv;
+	place *pl;			/* NULL to check chunk eligibility */
+	char *eligible;			/* 1 if the vnode is eligible */
+	schd_error *errs;		/* why the vnode is not eligible */
+};
+
+/**
+ * @brief
+ * 		check one vnode of a vnode_verdicts.  Run from the thread pool.
+ *		If pl is set, this is is_vnode_eligible(), otherwise it is
+ *		is_vnode_eligible_chunk().  Vnodes which the serial loops skip
+ *		are not checked.
+ *
+ * @param[in]	i	-	index of the vnode
+ * @param[in]	arg	-	the vnode_verdicts
+ *
+ * @par MT-Safe: yes - only reads the vnode and writes its own verdict
+ *
+ * @return void
+ */
+static void
+check_vnode_verdict(int i, void *arg)
+{
+	struct vnode_verdicts *vv = arg;
+	node_info *node = vv->ninfo_arr[i];
+	schd_error *err = &vv->errs[i];
+
+	set_schd_error_codes(err, SCHD_UNKWN, SUCCESS);
+	vv->eligible[i] = 1;
+
+	if (node->nscr.ineligible)
+		return;
+
+	if (vv->pl != NULL)
+		vv->eligible[i] = is_vnode_eligible(node, vv->resresv, vv->pl, err);
+	else if (!node->nscr.visited && !node->nscr.scattered)
+		vv->eligible[i] = is_vnode_eligible_chunk(vv->specreq, node,
+			vv->resresv, err);
+}
+
+/**
+ * @brief
+ * 		free a vnode_verdicts
+ *
+ * @param[in]	vv	-	vnode_verdicts to free
+ *
+ * @return void
+ */
+static void
+free_vnode_verdicts(struct vnode_verdicts *vv)
+{
+	int i;
+
+	if (vv == NULL)
+		return;
+
+	if (vv->errs != NULL) {
+		for (i = 0; vv->ninfo_arr[i] != NULL; i++)
+			clear_schd_error(&vv->errs[i]);
+		free(vv->errs);
+	}
+	free(vv->eligible);
+	free(vv);
+}
+
+/**
+ * @brief
+ * 		check the eligibility of all the vnodes of an array in parallel
+ *		using node_eval_threads threads.  The serial loops still walk
+ *		the vnodes in order and take each vnode's verdict with
+ *		use_vnode_verdict() rather than checking it themselves.  This
+ *		keeps node allocation exactly as it is without threads.
+ *
+ * @param[in]	ninfo_arr	-	vnodes to check
+ * @param[in]	specreq	-	non-consumable chunk resources
+ * @param[in]	resresv	-	the job or reservation being placed
+ * @param[in]	pl	-	place spec for is_vnode_eligible() or
+ *				NULL for is_vnode_eligible_chunk()
+ *
+ * @return	struct vnode_verdicts *
+ * @retval	NULL	: the vnodes should be checked serially
+ *
+ * @par MT-Safe: no
+ */
+static struct vnode_verdicts *
+check_vnodes_in_parallel(node_info **ninfo_arr, resource_req *specreq,
+	resource_resv *resresv, place *pl)
+{
+	struct vnode_verdicts *vv;
+	int num;
+
+	if (conf.node_eval_threads <= 1 || ninfo_arr == NULL)
+		return NULL;
+
+	num = count_array((void **) ninfo_arr);
+	if (num < MIN_PARALLEL_NODE_EVAL)
+		return NULL;
+
+	if ((vv = calloc(1, sizeof(struct vnode_verdicts))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	vv->ninfo_arr = ninfo_arr;
+	vv->specreq = specreq;
+	vv->resresv = resresv;
+	vv->pl = pl;
+	vv->eligible = malloc(num);
+	vv->errs = calloc(num, sizeof(schd_error));
+	if (vv->eligible == NULL || vv->errs == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free(vv->eligible);
+		free(vv->errs);
+		free(vv);
+		return NULL;
+	}
+
+	/* the shared unset resources are created on first use */
+	if (false_res() == NULL || zero_res() == NULL || unset_str_res() == NULL) {
+		free_vnode_verdicts(vv);
+		return NULL;
+	}
+
+	run_in_thread_pool(conf.node_eval_threads, num, check_vnode_verdict, vv);
+
+	return vv;
+}
+
+/**
+ * @brief
+ * 		take the verdict of a vnode checked by check_vnodes_in_parallel()
+ *
+ * @param[in]	vv	-	the verdicts
+ * @param[in]	i	-	index of the vnode
+ * @param[out]	err	-	why the vnode is not eligible
+ *
+ * @return	int
+ * @retval	1	: eligible
+ * @retval	0	: not eligible
+ */
+static int
+use_vnode_verdict(struct vnode_verdicts *vv, int i, schd_error *err)
+{
+	if (vv->eligible[i])
+		return 1;
+
+	copy_schd_error(err, &vv->errs[i]);
+	return 0;
+}
+
 /**
  * @brief
  * 		eval a non-plused select spec for satisfiability
@@ -3012,6 +3744,8 @@ eval_simple_selspec(status *policy, chunk *chk, node_info **pninfo_arr,
 	char		*str_chunk = NULL;	/* ptr to after the number of chunks in the str_chunk */
 
 	node_info	**ninfo_arr = NULL;
+	struct vnode_verdicts *vv = NULL;	/* vnodes checked in parallel */
+	int		eligible;
 
 	static schd_error *failerr = NULL;
 
@@ -3115,6 +3849,8 @@ eval_simple_selspec(status *policy, chunk *chk, node_info **pninfo_arr,
 	cur_flt_lic = flt_lic;
 	nsa = *nspec_arr;
 
+	vv = check_vnodes_in_parallel(ninfo_arr, specreq_noncons, resresv, NULL);
+
 	for (i = 0, j = 0; ninfo_arr[i] != NULL && chunks_found == 0; i++) {
 		if (ninfo_arr[i]->nscr.visited || ninfo_arr[i]->nscr.scattered  ||
 			ninfo_arr[i]->nscr.ineligible)
@@ -3132,6 +3868,7 @@ eval_simple_selspec(status *policy, chunk *chk, node_info **pninfo_arr,
 						free_resource_req_list(specreq_cons);
 					if (specreq_noncons != NULL)
 						free_resource_req_list(specreq_noncons);
+					free_vnode_verdicts(vv);
 					if (flags & EVAL_OKBREAK)
 						free_nodes(ninfo_arr);
 					set_schd_error_codes(err, NOT_RUN, SCHD_ERROR);
@@ -3143,8 +3880,13 @@ eval_simple_selspec(status *policy, chunk *chk, node_info **pninfo_arr,
 				nspecs_allocated++;
 			}
 
-			if (is_vnode_eligible_chunk(specreq_noncons, ninfo_arr[i], resresv,
-					err)) {
+			if (vv != NULL)
+				eligible = use_vnode_verdict(vv, i, err);
+			else
+				eligible = is_vnode_eligible_chunk(specreq_noncons, ninfo_arr[i],
+					resresv, err);
+
+			if (eligible) {
 				if (!ninfo_arr[i]->lic_lock) {
 					ncpusreq = find_resource_req(specreq_cons, getallres(RES_NCPUS));
 					if (ncpusreq != NULL)
@@ -3266,6 +4008,7 @@ eval_simple_selspec(status *policy, chunk *chk, node_info **pninfo_arr,
 
 	nsa[j] = NULL;
 
+	free_vnode_verdicts(vv);
 	if (specreq_cons != NULL)
 		free_resource_req_list(specreq_cons);
 	if (specreq_noncons != NULL)
@@ -4105,13 +4848,7 @@ parse_placespec(char *place_str)
 selspec *
 parse_selspec(char *select_spec)
 {
-	/* select specs can be large.  We need to allocate a buffer large enough
-	 * to handle the spec.  We'll keep it around so we don't have to allocate
-	 * it on every call
-	 */
-	static char *specbuf = NULL;
-	static int specbuf_size = 0;
-	int s;
+	char *specbuf;
 	char *tmpptr;
 
 	selspec *spec;
@@ -4128,7 +4865,8 @@ parse_selspec(char *select_spec)
 	int invalid = 0;
 
 	int num_kv;
-	struct key_value_pair *kv;
+	int kv_size = 0;
+	struct key_value_pair *kv = NULL;
 
 	int num_chunks;
 	int num_cpus = 0;
@@ -4155,28 +4893,21 @@ parse_selspec(char *select_spec)
 		free_selspec(spec);
 	}
 
-	s = strlen(select_spec);
-	if (s > specbuf_size) {
-		tmpptr = realloc(specbuf, s * 2 + 1);
-		if (tmpptr == NULL) {
-			log_err(errno, "parse_selspec", MEM_ERR_MSG);
-			return 0;
-		}
-		specbuf_size = s * 2;
-		specbuf = tmpptr;
+	/* parse a copy so the spec can be parsed from several threads at once */
+	if ((specbuf = string_dup(select_spec)) == NULL) {
+		free_selspec(spec);
+		return NULL;
 	}
 
-	strcpy(specbuf, select_spec);
-
 	tok = string_token(specbuf, "+", &endp);
 
 	tmpptr = NULL;
 	while (tok != NULL && !invalid) {
 		tmpptr = string_dup(tok);
 #ifdef NAS /* localmod 082 */
-		ret = parse_chunk(tok, 0, &num_chunks, &num_kv, &kv, NULL);
+		ret = parse_chunk_r(tok, 0, &num_chunks, &num_kv, &kv_size, &kv, NULL);
 #else
-		ret = parse_chunk(tok, &num_chunks, &num_kv, &kv, NULL);
+		ret = parse_chunk_r(tok, &num_chunks, &num_kv, &kv_size, &kv, NULL);
 #endif /* localmod 082 */
 
 		if (!ret) {
@@ -4235,6 +4966,9 @@ parse_selspec(char *select_spec)
 		seq_num++;
 	}
 
+	free(specbuf);
+	free(kv);
+
 	if (invalid) {
 		free_selspec(spec);
 		if (tmpptr != NULL)
@@ -5369,17 +6103,20 @@ node_up_event(node_info *node, void *arg)
 	if (node == NULL)
 		return 0;
 
+	sinfo = node->server;
+	undo_save(sinfo->undo, node, sizeof(node_info));
+
 	/* Preserve the resv-exclusive state when previously set */
 	if (node->is_resv_exclusive)
 		set_node_info_state(node, ND_resv_exclusive);
 	else
 		set_node_info_state(node, ND_free);
 
-	sinfo = node->server;
 	if (sinfo->node_group_enable && sinfo->node_group_key != NULL) {
 		node_info *arr[2];
 		arr[0] = node;
 		arr[1] = NULL;
+		undo_node_partitions(sinfo->undo, sinfo->nodepart, sinfo->num_parts);
 		node_partition_update_array(sinfo->policy, sinfo->nodepart, (node_info **) arr);
 		qsort(sinfo->nodepart, sinfo->num_parts,
 			sizeof(node_partition *), cmp_placement_sets);
@@ -5415,6 +6152,7 @@ node_down_event(node_info *node, void *arg)
 		return 0;
 
 	sinfo = node->server;
+	undo_save(sinfo->undo, node, sizeof(node_info));
 	if (node->job_arr != NULL) {
 		for (i = 0; node->job_arr[i] != NULL; i++) {
 			if (node->job_arr[i]->job->can_requeue)
@@ -5431,6 +6169,7 @@ node_down_event(node_info *node, void *arg)
 		node_info *arr[2];
 		arr[0] = node;
 		arr[1] = NULL;
+		undo_node_partitions(sinfo->undo, sinfo->nodepart, sinfo->num_parts);
 		node_partition_update_array(sinfo->policy, sinfo->nodepart, (node_info **) arr);
 		qsort(sinfo->nodepart, sinfo->num_parts,
 			sizeof(node_partition *), cmp_placement_sets);
@@ -5783,6 +6522,8 @@ void
 check_node_array_eligibility(node_info **ninfo_arr, resource_resv *resresv, place *pl, schd_error *err)
 {
 	int i, j;
+	int eligible;
+	struct vnode_verdicts *vv;			/* vnodes checked in parallel */
 	static char exclerr_buf[MAX_LOG_SIZE] = {0};
 	static schd_error *misc_err = NULL;		/* used to keep err */
 
@@ -5800,12 +6541,17 @@ check_node_array_eligibility(node_info **ninfo_arr, resource_resv *resresv, plac
 	}
 	clear_schd_error(misc_err);
 
+	vv = check_vnodes_in_parallel(ninfo_arr, NULL, resresv, pl);
 
 	/* Pre-mark all ineligible nodes so we don't need to look at them later */
 	for (i = 0; ninfo_arr[i] != NULL; i++) {
 		if ((!ninfo_arr[i]->nscr.ineligible)) {
 			clear_schd_error(err);
-			if (is_vnode_eligible(ninfo_arr[i], resresv, pl, err) == 0) {
+			if (vv != NULL)
+				eligible = use_vnode_verdict(vv, i, err);
+			else
+				eligible = is_vnode_eligible(ninfo_arr[i], resresv, pl, err);
+			if (eligible == 0) {
 				ninfo_arr[i]->nscr.ineligible = 1;
 				if (err->status_code != SCHD_UNKWN) {
 					if (misc_err->status_code == SCHD_UNKWN)
@@ -5828,6 +6574,8 @@ check_node_array_eligibility(node_info **ninfo_arr, resource_resv *resresv, plac
 			}
 		}
 	}
+	free_vnode_verdicts(vv);
+
 	/* If the last node we checked was eligible, err->error_code will be 0.
 	 * If a node was previously ineligible, we want to make note of that and
 	 * return that err
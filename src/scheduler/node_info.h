@@ -92,9 +92,9 @@ int remove_node_state(node_info *ninfo, char *state);
 int add_node_state(node_info *ninfo, char *state);
 
 /*
- *      talk_with_mom - talk to mom and get resources
+ *      talk_with_moms - talk to the moms of nodes and get resources
  */
-int talk_with_mom(node_info *ninfo);
+int talk_with_moms(node_info **ninfo_arr);
 
 /*
  *      node_filter - filter a node array and return a new filterd array
@@ -249,6 +249,11 @@ nspec **dup_nspecs(nspec **onspecs, node_info **ninfo_arr, server_info *sinfo);
 nspec **dup_nspecs(nspec **onspecs, node_info **ninfo_arr);
 #endif /* localmod 049 */
 
+/*
+ *      copy_nspec_array - copy an array of nspecs on the same nodes
+ */
+nspec **copy_nspec_array(nspec **onspecs);
+
 /*
  *	empty_nspec_array - free the contents of an nspec array but not
  *			    the array itself
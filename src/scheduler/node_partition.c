@@ -88,6 +88,7 @@
 #include "globals.h"
 #include "sort.h"
 #include "buckets.h"
+#include "undo_log.h"
 
 
 /**
@@ -580,6 +581,11 @@ update_buckets_for_node_array(node_bucket **bkts, node_info **ninfo_arr) {
 		for (j = 0; bkts[j] != NULL; j++) {
 			int node_ind = ninfo_arr[i]->node_ind;
 			if (pbs_bitmap_get_bit(bkts[j]->bkt_nodes, node_ind)) {
+				undo_log *ul = ninfo_arr[i]->server->undo;
+
+				undo_bucket_bit(ul, bkts[j]->free_pool, node_ind);
+				undo_bucket_bit(ul, bkts[j]->busy_later_pool, node_ind);
+				undo_bucket_bit(ul, bkts[j]->busy_pool, node_ind);
 				if (ninfo_arr[i]->num_jobs > 0 || ninfo_arr[i]->num_run_resv > 0) {
 					if (pbs_bitmap_get_bit(bkts[j]->free_pool->truth, node_ind)) {
 						pbs_bitmap_bit_off(bkts[j]->free_pool->truth, node_ind);
@@ -1269,6 +1275,7 @@ update_all_nodepart(status *policy, server_info *sinfo, resource_resv *resresv,
 	queue_info *qinfo;
 	int update_allpart = 1;
 	int i;
+	undo_log *ul;
 
 	if (sinfo == NULL || sinfo->queues == NULL || resresv == NULL)
 		return;
@@ -1276,7 +1283,10 @@ update_all_nodepart(status *policy, server_info *sinfo, resource_resv *resresv,
 	if(sinfo->allpart == NULL)
 		return;
 
+	ul = sinfo->undo;
+
 	if (sinfo->node_group_enable && sinfo->node_group_key != NULL) {
+		undo_node_partitions(ul, sinfo->nodepart, sinfo->num_parts);
 		node_partition_update_array(policy, sinfo->nodepart, resresv->ninfo_arr);
 		qsort(sinfo->nodepart, sinfo->num_parts,
 			sizeof(node_partition *), cmp_placement_sets);
@@ -1287,18 +1297,22 @@ update_all_nodepart(status *policy, server_info *sinfo, resource_resv *resresv,
 		qinfo = sinfo->queues[i];
 
 		if (sinfo->node_group_enable && qinfo->node_group_key != NULL) {
+			undo_node_partitions(ul, qinfo->nodepart, qinfo->num_parts);
 			node_partition_update_array(policy, qinfo->nodepart, resresv->ninfo_arr);
 
 			qsort(qinfo->nodepart, qinfo->num_parts,
 			   sizeof(node_partition *), cmp_placement_sets);
 		}
 		if ((flags & NO_ALLPART) == 0) {
-			if(qinfo->allpart != NULL && qinfo->allpart->res == NULL)
+			if(qinfo->allpart != NULL && qinfo->allpart->res == NULL) {
+				undo_node_partition(ul, qinfo->allpart);
 				node_partition_update(policy, qinfo->allpart);
+			}
 		}
 	}
 
 	/* Update and resort the hostsets */
+	undo_node_partitions(ul, sinfo->hostsets, sinfo->num_hostsets);
 	node_partition_update_array(policy, sinfo->hostsets, NULL);
 	if (policy->node_sort[0].res_name != NULL &&
 	    conf.node_sort_unused && sinfo->hostsets != NULL) {
@@ -1317,8 +1331,10 @@ update_all_nodepart(status *policy, server_info *sinfo, resource_resv *resresv,
 		}
 
 		/* Otherwise, update the server's allpart */
-		if (update_allpart || sinfo->allpart->res == NULL)
+		if (update_allpart || sinfo->allpart->res == NULL) {
+			undo_node_partition(ul, sinfo->allpart);
 			node_partition_update(policy, sinfo->allpart);
+		}
 	}
 
 }
@@ -271,6 +271,33 @@ parse_config(char *fname)
 				else if (!strcmp(config_name, PARSE_UPDATE_COMMENTS)) {
 					conf.update_comments = num ? 1 : 0;
 				}
+				else if (!strcmp(config_name, PARSE_JOB_QUERY_DELTA)) {
+					conf.job_query_delta = num ? 1 : 0;
+				}
+				else if (!strcmp(config_name, PARSE_JOB_QUERY_RESYNC)) {
+					if (num < 0)
+						error = 1;
+					else
+						conf.job_query_resync = num;
+				}
+				else if (!strcmp(config_name, PARSE_EQUIV_VERDICT_CACHE)) {
+					conf.equiv_verdict_cache = num ? 1 : 0;
+				}
+				else if (!strcmp(config_name, PARSE_CYCLE_STATS_JOB_DETAIL)) {
+					conf.cycle_stats_job_detail = num ? 1 : 0;
+				}
+				else if (!strcmp(config_name, PARSE_NODE_EVAL_THREADS)) {
+					if (num < 1 || num > MAX_NODE_EVAL_THREADS)
+						error = 1;
+					else
+						conf.node_eval_threads = num;
+				}
+				else if (!strcmp(config_name, PARSE_QUERY_THREADS)) {
+					if (num < 1 || num > MAX_QUERY_THREADS)
+						error = 1;
+					else
+						conf.query_threads = num;
+				}
 				else if (!strcmp(config_name, PARSE_BACKFILL_PRIME)) {
 					if (prime == PRIME || prime == ALL)
 						conf.prime_bp = num ? 1 : 0;
@@ -347,6 +374,40 @@ parse_config(char *fname)
 				}
 				else if (!strcmp(config_name, PARSE_FAIRSHARE_RES))
 					conf.fairshare_res = string_dup(config_value);
+				else if (!strcmp(config_name, PARSE_CYCLE_STATS_FILE))
+					conf.cycle_stats_file = string_dup(config_value);
+				else if (!strcmp(config_name, PARSE_SNAPSHOT_FILE))
+					conf.snapshot_file = string_dup(config_value);
+				else if (!strcmp(config_name, PARSE_SNAPSHOT_MIN_DURATION)) {
+					if (num < 0)
+						error = 1;
+					else
+						conf.snapshot_min_duration = num;
+				}
+				else if (!strcmp(config_name, PARSE_SERVER_DYN_RES_TTL)) {
+					if (num < 0)
+						error = 1;
+					else
+						conf.server_dyn_res_ttl = num;
+				}
+				else if (!strcmp(config_name, PARSE_SERVER_DYN_RES_TIMEOUT)) {
+					if (num < 0)
+						error = 1;
+					else
+						conf.server_dyn_res_timeout = num;
+				}
+				else if (!strcmp(config_name, PARSE_MOM_RESOURCES_REFRESH)) {
+					if (num < 0)
+						error = 1;
+					else
+						conf.mom_resources_refresh = num;
+				}
+				else if (!strcmp(config_name, PARSE_MOM_RESOURCES_TIMEOUT)) {
+					if (num < 0)
+						error = 1;
+					else
+						conf.mom_resources_timeout = num;
+				}
 				else if (!strcmp(config_name, PARSE_FAIRSHARE_ENT)) {
 					if (strcmp(config_value, ATTR_euser) &&
 						strcmp(config_value, ATTR_egroup) &&
@@ -1068,6 +1129,15 @@ init_config()
 	conf.max_preempt_attempts = SCHD_INFINITY;
 	conf.max_jobs_to_check = SCHD_INFINITY;
 
+	/* full job query every 10 cycles when job_query_delta is on */
+	conf.job_query_resync = 10;
+
+	/* evaluate vnodes in the main thread only */
+	conf.node_eval_threads = 1;
+
+	/* convert queried jobs and vnodes in the main thread only */
+	conf.query_threads = 1;
+
 	/* default value for ignore_res is the pseudo resources */
 	conf.ignore_res = ignore;
 
@@ -42,6 +42,71 @@
 #include "pbs_bitmap.h"
 
 #define BYTES_TO_BITS(x) ((x) * 8)
+#define BITS_PER_LONG BYTES_TO_BITS(sizeof(unsigned long))
+
+/*
+ * The bulk operations below work a long at a time.  Their loops are kept
+ * simple so the compiler can vectorize them.  The compiler's population
+ * count and trailing zero builtins are used where they exist.
+ */
+
+/**
+ * @brief count the on bits in a long
+ * @param w - the long
+ * @return int
+ * @retval number of on bits
+ */
+static int
+long_count_on_bits(unsigned long w)
+{
+#ifdef __GNUC__
+	return __builtin_popcountl(w);
+#else
+	int ct = 0;
+
+	for (; w != 0; w &= w - 1)
+		ct++;
+	return ct;
+#endif
+}
+
+/**
+ * @brief find the lowest on bit in a long
+ * @param w - the long, must not be 0
+ * @return int
+ * @retval the number of the lowest on bit
+ */
+static int
+long_first_on_bit(unsigned long w)
+{
+#ifdef __GNUC__
+	return __builtin_ctzl(w);
+#else
+	int i = 0;
+
+	for (; (w & 1UL) == 0; w >>= 1)
+		i++;
+	return i;
+#endif
+}
+
+/**
+ * @brief mask of the bits of a long from first_bit through last_bit
+ * @param first_bit - first bit of the mask (0 to BITS_PER_LONG - 1)
+ * @param last_bit - last bit of the mask (first_bit to BITS_PER_LONG - 1)
+ * @return unsigned long
+ * @retval the mask
+ */
+static unsigned long
+long_range_mask(long first_bit, long last_bit)
+{
+	unsigned long mask;
+
+	mask = ~0UL << first_bit;
+	if (last_bit < BITS_PER_LONG - 1)
+		mask &= ~(~0UL << (last_bit + 1));
+	return mask;
+}
 
 
 /**
@@ -71,14 +136,8 @@ pbs_bitmap_alloc(pbs_bitmap *pbm, long num_bits)
 		bm = pbm;
 	
 	/* shrinking bitmap, clear previously used bits */
-	if (num_bits < bm->num_bits) {
-		int i;
-		i = num_bits / BYTES_TO_BITS(sizeof(unsigned long)) + 1;
-		for ( ; i < bm->num_longs; i++)
-			bm->bits[i] = 0;
-		for (i = pbs_bitmap_next_on_bit(bm, num_bits); i != -1; i = pbs_bitmap_next_on_bit(bm, i))
-			pbs_bitmap_bit_off(bm, i);
-	}
+	if (num_bits < bm->num_bits)
+		pbs_bitmap_clear_range(bm, num_bits, bm->num_bits - 1);
 
 	/* If we have enough unused bits available, we don't need to allocate */
 	if (bm->num_longs * BYTES_TO_BITS(sizeof(unsigned long)) >= num_bits) {
@@ -215,7 +274,7 @@ pbs_bitmap_next_on_bit(pbs_bitmap *pbm, long start_bit)
 {
 	long long_ind;
 	long bit;
-	int i;
+	unsigned long w;
 	
 	if (pbm == NULL)
 		return -1;
@@ -223,36 +282,27 @@ pbs_bitmap_next_on_bit(pbs_bitmap *pbm, long start_bit)
 	if (start_bit >= pbm->num_bits)
 		return -1;
 	
-	long_ind = start_bit / BYTES_TO_BITS(sizeof(unsigned long));
-	bit = start_bit % BYTES_TO_BITS(sizeof(unsigned long));
-
-	/* special case - look at first long that contains start_bit */
-	if (pbm->bits[long_ind] != 0) {
-		for (i = bit + 1; i < BYTES_TO_BITS(sizeof(unsigned long)); i++) {
-			if (pbm->bits[long_ind] & (1UL << i)) {
-				return (long_ind * BYTES_TO_BITS(sizeof(unsigned long)) + i);
-			}
-		}
+	if (start_bit < 0) {
+		long_ind = 0;
+		w = pbm->bits[0];
+	} else {
+		long_ind = start_bit / BITS_PER_LONG;
+		bit = start_bit % BITS_PER_LONG;
 
-		/* didn't find an on bit after start_bit_index in the long that contained start_bit */
-		if (long_ind < pbm->num_longs) {
-			long_ind++;
-		}
+		/* special case - look at the bits after start_bit in its long */
+		if (bit == BITS_PER_LONG - 1)
+			w = 0;
+		else
+			w = pbm->bits[long_ind] & (~0UL << (bit + 1));
 	}
 
-	for( ; long_ind < pbm->num_longs && pbm->bits[long_ind] == 0; long_ind++)
-		;
-
-	if (long_ind == pbm->num_longs)
-		return -1;
-
-	for (i = 0 ; i < BYTES_TO_BITS(sizeof(unsigned long)) ; i++) {
-		if (pbm->bits[long_ind] & (1UL << i)) {
-			return (long_ind * BYTES_TO_BITS(sizeof(unsigned long)) + i);
-		}
+	while (w == 0) {
+		if (++long_ind >= pbm->num_longs)
+			return -1;
+		w = pbm->bits[long_ind];
 	}
 
-	return -1;
+	return (long_ind * BITS_PER_LONG + long_first_on_bit(w));
 }
 
 /**
@@ -332,3 +382,248 @@ pbs_bitmap_is_equal(pbs_bitmap *L, pbs_bitmap *R)
 	
 	return 1;
 }
+
+/**
+ * @brief make sure L has room for all of R's longs
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+static int
+bitmap_fit(pbs_bitmap *L, pbs_bitmap *R)
+{
+	if (R->num_longs > L->num_longs)
+		if (pbs_bitmap_alloc(L, BYTES_TO_BITS(R->num_longs * sizeof(unsigned long))) == NULL)
+			return 0;
+	if (R->num_bits > L->num_bits)
+		L->num_bits = R->num_bits;
+	return 1;
+}
+
+/**
+ * @brief pbs_bitmap version of L &= R
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+int
+pbs_bitmap_and(pbs_bitmap *L, pbs_bitmap *R)
+{
+	unsigned long *l;
+	unsigned long *r;
+	long n;
+	long i;
+
+	if (L == NULL || R == NULL)
+		return 0;
+
+	l = L->bits;
+	r = R->bits;
+	n = (L->num_longs < R->num_longs) ? L->num_longs : R->num_longs;
+	for (i = 0; i < n; i++)
+		l[i] &= r[i];
+	for (; i < L->num_longs; i++)
+		l[i] = 0;
+
+	return 1;
+}
+
+/**
+ * @brief pbs_bitmap version of L |= R
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+int
+pbs_bitmap_or(pbs_bitmap *L, pbs_bitmap *R)
+{
+	unsigned long *l;
+	unsigned long *r;
+	long i;
+
+	if (L == NULL || R == NULL)
+		return 0;
+
+	if (!bitmap_fit(L, R))
+		return 0;
+
+	l = L->bits;
+	r = R->bits;
+	for (i = 0; i < R->num_longs; i++)
+		l[i] |= r[i];
+
+	return 1;
+}
+
+/**
+ * @brief pbs_bitmap version of L &= ~R
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+int
+pbs_bitmap_andnot(pbs_bitmap *L, pbs_bitmap *R)
+{
+	unsigned long *l;
+	unsigned long *r;
+	long n;
+	long i;
+
+	if (L == NULL || R == NULL)
+		return 0;
+
+	l = L->bits;
+	r = R->bits;
+	n = (L->num_longs < R->num_longs) ? L->num_longs : R->num_longs;
+	for (i = 0; i < n; i++)
+		l[i] &= ~r[i];
+
+	return 1;
+}
+
+/**
+ * @brief count the on bits of a bitmap
+ * @param pbm - the bitmap
+ * @return long
+ * @retval number of on bits
+ */
+long
+pbs_bitmap_count_on_bits(pbs_bitmap *pbm)
+{
+	long ct = 0;
+	long i;
+
+	if (pbm == NULL)
+		return 0;
+
+	for (i = 0; i < pbm->num_longs; i++)
+		ct += long_count_on_bits(pbm->bits[i]);
+
+	return ct;
+}
+
+/**
+ * @brief find the nth on bit of a bitmap
+ * @param pbm - the bitmap
+ * @param n - which on bit to find, starting at 1
+ * @return long
+ * @retval the number of the nth on bit
+ * @retval -1 if the bitmap has fewer than n on bits
+ */
+long
+pbs_bitmap_nth_on_bit(pbs_bitmap *pbm, long n)
+{
+	unsigned long w;
+	long ct;
+	long i;
+
+	if (pbm == NULL || n <= 0)
+		return -1;
+
+	for (i = 0; i < pbm->num_longs; i++) {
+		w = pbm->bits[i];
+		ct = long_count_on_bits(w);
+		if (ct < n) {
+			n -= ct;
+			continue;
+		}
+		/* the bit is in this long, drop the n - 1 lower on bits */
+		for (; n > 1; n--)
+			w &= w - 1;
+		return (i * BITS_PER_LONG + long_first_on_bit(w));
+	}
+
+	return -1;
+}
+
+/**
+ * @brief turn off the bits of a bitmap from first_bit through last_bit
+ * @param pbm - the bitmap
+ * @param first_bit - first bit to turn off
+ * @param last_bit - last bit to turn off
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+int
+pbs_bitmap_clear_range(pbs_bitmap *pbm, long first_bit, long last_bit)
+{
+	long first_ind;
+	long last_ind;
+	long i;
+
+	if (pbm == NULL || first_bit < 0 || last_bit < first_bit)
+		return 0;
+
+	if (last_bit >= pbm->num_longs * BITS_PER_LONG)
+		last_bit = pbm->num_longs * BITS_PER_LONG - 1;
+	if (first_bit > last_bit)
+		return 1;
+
+	first_ind = first_bit / BITS_PER_LONG;
+	last_ind = last_bit / BITS_PER_LONG;
+	if (first_ind == last_ind) {
+		pbm->bits[first_ind] &= ~long_range_mask(first_bit % BITS_PER_LONG, last_bit % BITS_PER_LONG);
+		return 1;
+	}
+
+	pbm->bits[first_ind] &= ~long_range_mask(first_bit % BITS_PER_LONG, BITS_PER_LONG - 1);
+	for (i = first_ind + 1; i < last_ind; i++)
+		pbm->bits[i] = 0;
+	pbm->bits[last_ind] &= ~long_range_mask(0, last_bit % BITS_PER_LONG);
+
+	return 1;
+}
+
+/**
+ * @brief pbs_bitmap version of L |= R for the bits from first_bit
+ *        through last_bit.  The other bits of L are left alone.
+ * @param L - bitmap lvalue
+ * @param R - bitmap rvalue
+ * @param first_bit - first bit to copy
+ * @param last_bit - last bit to copy
+ * @return int
+ * @retval 1 success
+ * @retval 0 failure
+ */
+int
+pbs_bitmap_or_range(pbs_bitmap *L, pbs_bitmap *R, long first_bit, long last_bit)
+{
+	long first_ind;
+	long last_ind;
+	long i;
+
+	if (L == NULL || R == NULL || first_bit < 0 || last_bit < first_bit)
+		return 0;
+
+	if (last_bit >= R->num_longs * BITS_PER_LONG)
+		last_bit = R->num_longs * BITS_PER_LONG - 1;
+	if (first_bit > last_bit)
+		return 1;
+
+	if (!bitmap_fit(L, R))
+		return 0;
+
+	first_ind = first_bit / BITS_PER_LONG;
+	last_ind = last_bit / BITS_PER_LONG;
+	if (first_ind == last_ind) {
+		L->bits[first_ind] |= R->bits[first_ind] &
+			long_range_mask(first_bit % BITS_PER_LONG, last_bit % BITS_PER_LONG);
+		return 1;
+	}
+
+	L->bits[first_ind] |= R->bits[first_ind] & long_range_mask(first_bit % BITS_PER_LONG, BITS_PER_LONG - 1);
+	for (i = first_ind + 1; i < last_ind; i++)
+		L->bits[i] |= R->bits[i];
+	L->bits[last_ind] |= R->bits[last_ind] & long_range_mask(0, last_bit % BITS_PER_LONG);
+
+	return 1;
+}
@@ -78,6 +78,23 @@ int pbs_bitmap_assign(pbs_bitmap *L, pbs_bitmap *R);
 /* pbs_bitmap's version of L == R */
 int pbs_bitmap_is_equal(pbs_bitmap *L, pbs_bitmap *R);
 
+/* pbs_bitmap's version of L &= R, L |= R, and L &= ~R */
+int pbs_bitmap_and(pbs_bitmap *L, pbs_bitmap *R);
+int pbs_bitmap_or(pbs_bitmap *L, pbs_bitmap *R);
+int pbs_bitmap_andnot(pbs_bitmap *L, pbs_bitmap *R);
+
+/* Count the on bits in a bitmap */
+long pbs_bitmap_count_on_bits(pbs_bitmap *pbm);
+
+/* Get the nth on bit in a bitmap */
+long pbs_bitmap_nth_on_bit(pbs_bitmap *pbm, long n);
+
+/* Turn off a range of bits */
+int pbs_bitmap_clear_range(pbs_bitmap *pbm, long first_bit, long last_bit);
+
+/* pbs_bitmap's version of L |= R over a range of bits */
+int pbs_bitmap_or_range(pbs_bitmap *L, pbs_bitmap *R, long first_bit, long last_bit);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+/**
+ * @file    pbs_sched_replay.c
+ *
+ * @brief
+ * 		pbs_sched_replay.c - replays the scheduling cycles captured with the
+ *		snapshot_file sched_config option without a server.  The IFL calls
+ *		the scheduler makes are answered from the snapshot, and runs,
+ *		preemptions and reservation confirmations are printed instead of
+ *		being sent.  The time of each cycle is printed, so policy and
+ *		performance changes can be measured on a captured workload.
+ *
+ *		usage: pbs_sched_replay [-d sched_priv] [-n repeats] [-l] snapshot
+ *
+ *		The sched_config, holidays, dedicated time and fairshare usage are
+ *		read from the sched_priv directory (PBS_HOME/sched_priv by
+ *		default).  Each cycle runs at the time it was captured.
+ *		server_dyn_res, mom_resources and peer queues are not replayed.
+ *
+ * Functions included are:
+ *	record()
+ *	pbs_statserver()
+ *	pbs_statsched()
+ *	pbs_statrsc()
+ *	pbs_statque()
+ *	pbs_statvnode()
+ *	pbs_statresv()
+ *	pbs_selstat()
+ *	pbs_statjob()
+ *	pbs_statfree()
+ *	pbs_geterrmsg()
+ *	pbs_disconnect()
+ *	pbs_connect_noblk()
+ *	pbs_manager()
+ *	pbs_alterjob()
+ *	pbs_alterjobs()
+ *	pbs_runjob()
+ *	pbs_asyrunjob()
+ *	pbs_asyrunjobs()
+ *	pbs_movejob()
+ *	pbs_sigjob()
+ *	pbs_holdjob()
+ *	pbs_rlsjob()
+ *	pbs_rerunjob()
+ *	pbs_confirmresv()
+ *	pbs_defschreply()
+ *	main()
+ *
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include "libpbs.h"
+#include "pbs_ifl.h"
+#include "pbs_internal.h"
+#include "pbs_share.h"
+#include "ifl_internal.h"
+#include "log.h"
+#include "sched_cmds.h"
+#include "data_types.h"
+#include "constant.h"
+#include "fifo.h"
+#include "globals.h"
+#include "snapshot.h"
+
+/* the descriptor handed to the scheduler in place of a server connection */
+#define REPLAY_SD 0
+
+/* Variables the scheduler library expects from the daemon */
+struct connect_handle connection[NCONNECTS];
+int connector = REPLAY_SD;
+int server_sock = -1;
+int second_connection = -1;
+int pbs_rm_port;
+int got_sigpipe = 0;
+
+static int num_decisions;	/* decisions printed in the current cycle */
+
+/**
+ * @brief
+ * 		print a decision the scheduler sent to the server
+ *
+ * @param[in]	fmt	-	printf() format of the decision
+ *
+ * @return	void
+ */
+static void
+record(char *fmt, ...)
+{
+	va_list ap;
+
+	va_start(ap, fmt);
+	fputs("  ", stdout);
+	vprintf(fmt, ap);
+	fputc('\n', stdout);
+	va_end(ap);
+	num_decisions++;
+}
+
+/*
+ * The IFL calls below replace the libpbs ones.  Status calls are answered
+ * from the snapshot, requests which change the server are printed and
+ * succeed.
+ */
+
+struct batch_status *
+pbs_statserver(int c, struct attrl *attrib, char *extend)
+{
+	return next_snapshot_reply("pbs_statserver");
+}
+
+struct batch_status *
+pbs_statsched(int c, struct attrl *attrib, char *extend)
+{
+	return next_snapshot_reply("pbs_statsched");
+}
+
+struct batch_status *
+pbs_statrsc(int c, char *id, struct attrl *attrib, char *extend)
+{
+	return next_snapshot_reply("pbs_statrsc");
+}
+
+struct batch_status *
+pbs_statque(int c, char *id, struct attrl *attrib, char *extend)
+{
+	return next_snapshot_reply("pbs_statque");
+}
+
+struct batch_status *
+pbs_statvnode(int c, char *id, struct attrl *attrib, char *extend)
+{
+	return next_snapshot_reply("pbs_statvnode");
+}
+
+struct batch_status *
+pbs_statresv(int c, char *id, struct attrl *attrib, char *extend)
+{
+	return next_snapshot_reply("pbs_statresv");
+}
+
+struct batch_status *
+pbs_selstat(int c, struct attropl *attrib, struct attrl *rattrib, char *extend)
+{
+	return next_snapshot_reply("pbs_selstat");
+}
+
+/* single jobs are only queried by job_query_delta and checkpointing */
+struct batch_status *
+pbs_statjob(int c, char *id, struct attrl *attrib, char *extend)
+{
+	return NULL;
+}
+
+void
+pbs_statfree(struct batch_status *bsp)
+{
+	__pbs_statfree(bsp);
+}
+
+char *
+pbs_geterrmsg(int c)
+{
+	return NULL;
+}
+
+int
+pbs_disconnect(int c)
+{
+	return 0;
+}
+
+int
+pbs_connect_noblk(char *server, int tout)
+{
+	return -1;
+}
+
+int
+pbs_manager(int c, int command, int objtype, char *objname,
+	struct attropl *attrib, char *extend)
+{
+	return 0;
+}
+
+int
+pbs_alterjob(int c, char *jobid, struct attrl *attrib, char *extend)
+{
+	return 0;
+}
+
+int
+pbs_alterjobs(int c, int num, char **jobids, struct attrl **attribs,
+	int *rcs, char *extend)
+{
+	memset(rcs, 0, num * sizeof(int));
+	return 0;
+}
+
+int
+pbs_runjob(int c, char *jobid, char *location, char *extend)
+{
+	record("run %s %s", jobid, location != NULL ? location : "");
+	return 0;
+}
+
+int
+pbs_asyrunjob(int c, char *jobid, char *location, char *extend)
+{
+	record("run %s %s", jobid, location != NULL ? location : "");
+	return 0;
+}
+
+int
+pbs_asyrunjobs(int c, int num, char **jobids, char **locations,
+	int *rcs, char *extend)
+{
+	int i;
+
+	for (i = 0; i < num; i++) {
+		record("run %s %s", jobids[i], locations[i] != NULL ? locations[i] : "");
+		rcs[i] = 0;
+	}
+	return 0;
+}
+
+int
+pbs_movejob(int c, char *jobid, char *destin, char *extend)
+{
+	record("move %s %s", jobid, destin != NULL ? destin : "");
+	return 0;
+}
+
+int
+pbs_sigjob(int c, char *jobid, char *sig, char *extend)
+{
+	record("signal %s %s", jobid, sig);
+	return 0;
+}
+
+int
+pbs_holdjob(int c, char *jobid, char *holdtype, char *extend)
+{
+	record("hold %s %s", jobid, holdtype);
+	return 0;
+}
+
+int
+pbs_rlsjob(int c, char *jobid, char *holdtype, char *extend)
+{
+	record("release %s %s", jobid, holdtype);
+	return 0;
+}
+
+int
+pbs_rerunjob(int c, char *jobid, char *extend)
+{
+	record("requeue %s", jobid);
+	return 0;
+}
+
+int
+pbs_confirmresv(int c, char *resvid, char *location, unsigned long start,
+	char *extend)
+{
+	record("confirm %s %s %lu", resvid, location, start);
+	return 0;
+}
+
+int
+pbs_defschreply(int c, int cmd, char *id, int err, char *txt, char *extend)
+{
+	return 0;
+}
+
+/**
+ * @brief
+ * 		the entry point of pbs_sched_replay
+ */
+int
+main(int argc, char *argv[])
+{
+	char *sched_priv = NULL;
+	char *snapfile;
+	char *name = NULL;
+	char path[MAXPATHLEN + 1];
+	FILE *fp;
+	time_t cycle_time;
+	struct timeval start;
+	struct timeval end;
+	int repeats = 1;
+	int logstderr = 0;
+	int cycle = 0;
+	int errflg = 0;
+	int rc;
+	int c;
+	int i;
+
+	while ((c = getopt(argc, argv, "d:n:l")) != -1) {
+		switch (c) {
+			case 'd':
+				sched_priv = optarg;
+				break;
+			case 'n':
+				repeats = atoi(optarg);
+				if (repeats < 1)
+					errflg = 1;
+				break;
+			case 'l':
+				logstderr = 1;
+				break;
+			default:
+				errflg = 1;
+		}
+	}
+	if (errflg || optind != argc - 1) {
+		fprintf(stderr, "usage: %s [-d sched_priv] [-n repeats] [-l] snapshot\n", argv[0]);
+		exit(1);
+	}
+	snapfile = argv[optind];
+
+	/* set single threaded mode */
+	pbs_client_thread_set_single_threaded_mode();
+
+	/* initialize the thread context */
+	if (pbs_client_thread_init_thread_context() != 0) {
+		fprintf(stderr, "%s: Unable to initialize thread context\n", argv[0]);
+		exit(1);
+	}
+
+	if ((fp = fopen(snapfile, "r")) == NULL) {
+		perror(snapfile);
+		exit(1);
+	}
+
+	if (sched_priv == NULL) {
+		if (pbs_loadconf(0) == 0 || pbs_conf.pbs_home_path == NULL) {
+			fprintf(stderr, "%s: no PBS_HOME, use -d\n", argv[0]);
+			exit(1);
+		}
+		snprintf(path, sizeof(path), "%s/sched_priv", pbs_conf.pbs_home_path);
+		sched_priv = path;
+	}
+	if (chdir(sched_priv) == -1) {
+		perror(sched_priv);
+		exit(1);
+	}
+
+	sc_name = PBS_DFLT_SCHED_NAME;
+	dflt_sched = 1;
+	if (schedinit() != 0) {
+		fprintf(stderr, "%s: scheduler initialization failed\n", argv[0]);
+		exit(1);
+	}
+
+	/* the snapshot holds full job lists and no dynamic resources or peers */
+	conf.job_query_delta = 0;
+	conf.dyn_res_to_get = NULL;
+	conf.dynamic_res[0].res = NULL;
+	conf.peer_queues[0].local_queue = NULL;
+	conf.snapshot_file = NULL;
+	if (logstderr)
+		conf.logstderr = 1;
+
+	while ((rc = read_snapshot_cycle(fp, &cycle_time, &name)) == 1) {
+		cycle++;
+		sc_name = name;
+		dflt_sched = !strcmp(name, PBS_DFLT_SCHED_NAME);
+		replay_time = cycle_time;
+
+		for (i = 0; i < repeats; i++) {
+			rewind_snapshot_cycle();
+			num_decisions = 0;
+			printf("cycle %d (time %ld) run %d:\n", cycle, (long) cycle_time, i + 1);
+			gettimeofday(&start, NULL);
+			scheduling_cycle(REPLAY_SD, NULL);
+			gettimeofday(&end, NULL);
+			printf("cycle %d run %d: %d decisions, %.3f seconds\n", cycle, i + 1,
+				num_decisions, (end.tv_sec - start.tv_sec) +
+				(end.tv_usec - start.tv_usec) / 1000000.0);
+		}
+		sc_name = PBS_DFLT_SCHED_NAME;
+		free(name);
+	}
+
+	fclose(fp);
+	free_snapshot_cycle();
+
+	if (rc == -1) {
+		fprintf(stderr, "%s: %s is malformed after cycle %d\n", argv[0], snapfile, cycle);
+		exit(1);
+	}
+
+	return 0;
+}
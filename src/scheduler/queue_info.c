@@ -74,6 +74,7 @@
 #include "check.h"
 #include "config.h"
 #include "globals.h"
+#include "snapshot.h"
 #include "node_info.h"
 #include "sort.h"
 #include "resource_resv.h"
@@ -86,6 +87,7 @@
 #include "limits_if.h"
 #include "pbs_internal.h"
 #include "fifo.h"
+#include "undo_log.h"
 
 /**
  * @brief
@@ -148,7 +150,9 @@ query_queues(status *policy, int pbs_sd, server_info *sinfo)
 		return NULL;
 
 	/* get queue info from PBS server */
-	if ((queues = pbs_statque(pbs_sd, NULL, NULL, NULL)) == NULL) {
+	queues = pbs_statque(pbs_sd, NULL, NULL, NULL);
+	snapshot_status("pbs_statque", queues);
+	if (queues == NULL) {
 		errmsg = pbs_geterrmsg(pbs_sd);
 		if (errmsg == NULL)
 			errmsg = "";
@@ -641,6 +645,7 @@ update_queue_on_run(queue_info *qinfo, resource_resv *resresv, char *job_state)
 	schd_resource *res;
 	counts *cts;
 	counts *allcts;
+	undo_log *ul;
 
 	if (qinfo == NULL || resresv == NULL)
 		return;
@@ -648,6 +653,9 @@ update_queue_on_run(queue_info *qinfo, resource_resv *resresv, char *job_state)
 	if (resresv->is_job &&  resresv->job == NULL)
 		return;
 
+	ul = qinfo->server->undo;
+	undo_save(ul, qinfo, sizeof(queue_info));
+
 	if (resresv->is_job) {
 		qinfo->sc.running++;
 		/* note: if job is suspended, counts will get off.
@@ -659,9 +667,11 @@ update_queue_on_run(queue_info *qinfo, resource_resv *resresv, char *job_state)
 	}
 
 	if (cstat.node_sort[0].res_name != NULL &&
-		conf.node_sort_unused && qinfo->nodes != NULL)
+		conf.node_sort_unused && qinfo->nodes != NULL) {
+		undo_save(ul, qinfo->nodes, qinfo->num_nodes * sizeof(node_info *));
 		qsort(qinfo->nodes, qinfo->num_nodes, sizeof(node_info *),
 			multi_node_sort);
+	}
 
 
 	if ((job_state != NULL) && (*job_state == 'S'))
@@ -672,12 +682,14 @@ update_queue_on_run(queue_info *qinfo, resource_resv *resresv, char *job_state)
 	while (req != NULL) {
 		res = find_resource(qinfo->qres, req->def);
 
-		if (res != NULL)
+		if (res != NULL) {
+			undo_resource(ul, res);
 			res->assigned += req->amount;
+		}
 
 		req = req->next;
 	}
-	free(qinfo->running_jobs);
+	undo_free_ptr(ul, (void **) &qinfo->running_jobs, free);
 	qinfo->running_jobs = resource_resv_filter(qinfo->jobs, qinfo->sc.total,
 		check_run_job, NULL, 0);
 
@@ -686,32 +698,16 @@ update_queue_on_run(queue_info *qinfo, resource_resv *resresv, char *job_state)
 		if (resresv->is_job && resresv->job !=NULL) {
 			update_total_counts(NULL, qinfo, resresv, QUEUE);
 
-			cts = find_alloc_counts(qinfo->group_counts, resresv->group);
-
-			if (qinfo->group_counts == NULL)
-				qinfo->group_counts = cts;
-
+			cts = find_alloc_counts_undo(ul, &qinfo->group_counts, resresv->group);
 			update_counts_on_run(cts, resresv->resreq);
 
-			cts = find_alloc_counts(qinfo->project_counts, resresv->project);
-
-			if (qinfo->project_counts == NULL)
-				qinfo->project_counts = cts;
-
+			cts = find_alloc_counts_undo(ul, &qinfo->project_counts, resresv->project);
 			update_counts_on_run(cts, resresv->resreq);
 
-			cts = find_alloc_counts(qinfo->user_counts, resresv->user);
-
-			if (qinfo->user_counts == NULL)
-				qinfo->user_counts = cts;
-
+			cts = find_alloc_counts_undo(ul, &qinfo->user_counts, resresv->user);
 			update_counts_on_run(cts, resresv->resreq);
 
-			allcts = find_alloc_counts(qinfo->alljobcounts, "o:" PBS_ALL_ENTITY);
-
-			if (qinfo->alljobcounts == NULL)
-				qinfo->alljobcounts = allcts;
-
+			allcts = find_alloc_counts_undo(ul, &qinfo->alljobcounts, "o:" PBS_ALL_ENTITY);
 			update_counts_on_run(allcts, resresv->resreq);
 		}
 	}
@@ -742,6 +738,7 @@ update_queue_on_end(queue_info *qinfo, resource_resv *resresv,
 	resource_req *req = NULL;			/* resource request from job */
 	counts *cts;					/* update user/group counts */
 	char logbuf[MAX_LOG_SIZE] = {0};
+	undo_log *ul;
 
 	if (qinfo == NULL || resresv == NULL)
 		return;
@@ -749,9 +746,13 @@ update_queue_on_end(queue_info *qinfo, resource_resv *resresv,
 	if (resresv->is_job && resresv->job ==NULL)
 		return;
 
+	ul = qinfo->server->undo;
+	undo_save(ul, qinfo, sizeof(queue_info));
+
 	if (resresv->is_job) {
 		if (resresv->job->is_running) {
 			qinfo->sc.running--;
+			undo_copy_array(ul, (void ***) &qinfo->running_jobs);
 			remove_resresv_from_array(qinfo->running_jobs, resresv);
 		}
 		else if (resresv->job->is_exiting)
@@ -769,6 +770,7 @@ update_queue_on_end(queue_info *qinfo, resource_resv *resresv,
 		res = find_resource(qinfo->qres, req->def);
 
 		if (res != NULL) {
+			undo_resource(ul, res);
 			res->assigned -= req->amount;
 
 			if (res->assigned < 0) {
@@ -785,22 +787,22 @@ update_queue_on_end(queue_info *qinfo, resource_resv *resresv,
 	if (qinfo->has_soft_limit || qinfo->has_hard_limit) {
 		if (is_resresv_running(resresv)) {
 			update_total_counts_on_end(NULL, qinfo, resresv , QUEUE);
-			cts = find_counts(qinfo->group_counts, resresv->group);
+			cts = find_counts_undo(ul, qinfo->group_counts, resresv->group);
 
 			if (cts != NULL)
 				update_counts_on_end(cts, resresv->resreq);
 
-			cts = find_counts(qinfo->project_counts, resresv->project);
+			cts = find_counts_undo(ul, qinfo->project_counts, resresv->project);
 
 			if (cts != NULL)
 				update_counts_on_end(cts, resresv->resreq);
 
-			cts = find_counts(qinfo->user_counts, resresv->user);
+			cts = find_counts_undo(ul, qinfo->user_counts, resresv->user);
 
 			if (cts != NULL)
 				update_counts_on_end(cts, resresv->resreq);
 
-			cts = find_alloc_counts(qinfo->alljobcounts, "o:" PBS_ALL_ENTITY);
+			cts = find_counts_undo(ul, qinfo->alljobcounts, "o:" PBS_ALL_ENTITY);
 
 			if (cts != NULL)
 				update_counts_on_end(cts, resresv->resreq);
@@ -1006,15 +1008,24 @@ dup_queue_info(queue_info *oqinfo, server_info *nsinfo)
  * @return	the found queue
  * @retval	NULL	: error.
  *
+ * @note
+ * 		If qinfo_arr is the server's queue array, the server's queue
+ * 		index is used instead of a linear search.
+ *
  */
 queue_info *
 find_queue_info(queue_info **qinfo_arr, char *name)
 {
 	int i;
+	server_info *sinfo;
 
 	if (qinfo_arr == NULL)
 		return NULL;
 
+	if (qinfo_arr[0] != NULL && (sinfo = qinfo_arr[0]->server) != NULL &&
+		sinfo->queue_index != NULL && qinfo_arr == sinfo->queues && name != NULL)
+		return find_tree(sinfo->queue_index, name);
+
 	for (i = 0; qinfo_arr[i] != NULL && strcmp(name, qinfo_arr[i]->name); i++)
 		;
 
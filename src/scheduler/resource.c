@@ -85,11 +85,14 @@
 #include "data_types.h"
 #include "misc.h"
 #include "globals.h"
+#include "snapshot.h"
 #include "resource_resv.h"
 #include "pbs_internal.h"
 #include "limits_if.h"
 #include "sort.h"
 #include "parse.h"
+#include "formula.h"
+#include "buckets.h"
 #include "limits_if.h"
 
 
@@ -126,7 +129,9 @@ query_resources(int pbs_sd)
 	char *errmsg;
 	int error = 0;
 
-	if ((bs = pbs_statrsc(pbs_sd, NULL, NULL, "p")) == NULL) {
+	bs = pbs_statrsc(pbs_sd, NULL, NULL, "p");
+	snapshot_resources(bs);
+	if (bs == NULL) {
 		errmsg = pbs_geterrmsg(pbs_sd);
 		if (errmsg == NULL)
 			errmsg = "";
@@ -223,6 +228,11 @@ query_resources(int pbs_sd)
 		free_resdef_array(defarr);
 		return NULL;
 	}
+
+	/* resource lists are indexed by a definition's place in the array */
+	for (i = 0; defarr[i] != NULL; i++)
+		defarr[i]->ord = i;
+
 	return defarr;
 }
 
@@ -329,6 +339,7 @@ new_resdef(void)
 	}
 
 	newdef->name = NULL;
+	newdef->ord = -1;
 	/* calloc will have zeroed flags and the type structure */
 
 	return newdef;
@@ -578,6 +589,10 @@ reset_global_resource_ptrs(void)
 		free(boolres);
 		boolres = NULL;
 	}
+	/* compiled formulas refer to the consumable resources */
+	reset_formula_cache();
+	/* node bucket definitions refer to the resource definitions */
+	reset_node_bucket_cache();
 	update_sorting_defs(SD_FREE);
 
 	/* The above references into this array.  We now free the memory */
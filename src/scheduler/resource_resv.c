@@ -114,6 +114,11 @@
 #include "check.h"
 #include "fifo.h"
 #include "range.h"
+#include "mem_pool.h"
+#include "undo_log.h"
+
+/* pool resource_reqs are allocated from */
+static mem_pool resreq_pool = MEM_POOL_INITIALIZER("resource_req", sizeof(resource_req));
 
 
 /**
@@ -233,14 +238,7 @@ free_resource_resv(resource_resv *resresv)
 	if (resresv->name != NULL)
 		free(resresv->name);
 
-	if (resresv->user != NULL)
-		free(resresv->user);
-
-	if (resresv->group != NULL)
-		free(resresv->group);
-
-	if (resresv->project != NULL)
-		free(resresv->project);
+	/* user, group and project are interned and not freed */
 
 	if (resresv->nodepart_name != NULL)
 		free(resresv->nodepart_name);
@@ -369,9 +367,9 @@ dup_resource_resv(resource_resv *oresresv,
 	nresresv->server = nsinfo;
 
 	nresresv->name = string_dup(oresresv->name);
-	nresresv->user = string_dup(oresresv->user);
-	nresresv->group = string_dup(oresresv->group);
-	nresresv->project = string_dup(oresresv->project);
+	nresresv->user = oresresv->user;
+	nresresv->group = oresresv->group;
+	nresresv->project = oresresv->project;
 
 	nresresv->nodepart_name = string_dup(oresresv->nodepart_name);
 	nresresv->select = dup_selspec(oresresv->select);
@@ -491,14 +489,36 @@ dup_resource_resv(resource_resv *oresresv,
  * @retval	resource_resv if found
  * @retval	NULL	: if not found or on error
  *
+ * @note
+ * 		If resresv_arr is one of the server's job, reservation or
+ * 		all_resresv arrays, the server's name index is used instead
+ * 		of a linear search.
+ *
  */
 resource_resv *
 find_resource_resv(resource_resv **resresv_arr, char *name)
 {
 	int i;
+	server_info *sinfo;
+	resource_resv *resresv;
+
 	if (resresv_arr == NULL || name == NULL)
 		return NULL;
 
+	if (resresv_arr[0] != NULL && (sinfo = resresv_arr[0]->server) != NULL &&
+		sinfo->resresv_index != NULL) {
+		if (resresv_arr == sinfo->all_resresv)
+			return find_tree(sinfo->resresv_index, name);
+		if (resresv_arr == sinfo->jobs) {
+			resresv = find_tree(sinfo->resresv_index, name);
+			return (resresv != NULL && resresv->is_job) ? resresv : NULL;
+		}
+		if (resresv_arr == sinfo->resvs) {
+			resresv = find_tree(sinfo->resresv_index, name);
+			return (resresv != NULL && resresv->is_resv) ? resresv : NULL;
+		}
+	}
+
 	for (i = 0; resresv_arr[i] != NULL && strcmp(resresv_arr[i]->name, name);i++)
 		;
 
@@ -547,14 +567,25 @@ find_resource_resv_by_indrank(resource_resv **resresv_arr, int rank, int index)
  * @retval	resource_resv	: if found
  * @retval	NULL	: if not found or on error
  *
+ * @note
+ * 		The server's name index is tried first.  The occurrences of a
+ * 		standing reservation share a name, so on a mismatched start time
+ * 		the array is searched.
+ *
  */
 resource_resv *
 find_resource_resv_by_time(resource_resv **resresv_arr, char *name, time_t start_time)
 {
 	int i;
+	resource_resv *resresv;
+
 	if (resresv_arr == NULL || name == NULL)
 		return NULL;
 
+	resresv = find_resource_resv(resresv_arr, name);
+	if (resresv != NULL && resresv->start == start_time)
+		return resresv;
+
 	for (i = 0; resresv_arr[i] != NULL;i++) {
 		if ((strcmp(resresv_arr[i]->name, name) == 0) && (resresv_arr[i]->start == start_time))
 			break;
@@ -837,12 +868,10 @@ new_resource_req()
 {
 	resource_req *resreq;
 
-	if ((resreq = (resource_req *) calloc(1, sizeof(resource_req))) == NULL) {
-		log_err(errno, "new_resource_req", MEM_ERR_MSG);
+	if ((resreq = pool_alloc(&resreq_pool)) == NULL)
 		return NULL;
-	}
 
-	/* member type zero'd by calloc() */
+	/* member type zero'd by pool_alloc() */
 
 	resreq->name = NULL;
 	resreq->res_str = NULL;
@@ -1098,7 +1127,7 @@ free_resource_req(resource_req *req)
 	if (req->res_str != NULL)
 		free(req->res_str);
 
-	free(req);
+	pool_free(&resreq_pool, req);
 }
 
 /**
@@ -1193,14 +1222,22 @@ update_resresv_on_run(resource_resv *resresv, nspec **nspec_arr)
 	queue_info *resv_queue;
 	int ret;
 	int i;
+	undo_log *ul;
+	undo_log *rr_ul;	/* NULL if resresv was created by the simulation */
 
 	if (resresv == NULL || nspec_arr == NULL)
 		return;
 
+	ul = resresv->server->undo;
+	rr_ul = undo_owner(ul, resresv);
+	undo_resource_resv(ul, resresv);
+
 	if (resresv->is_job) {
 		if (resresv->job->is_suspended) {
-			for (ns_size = 0; nspec_arr[ns_size] != NULL; ns_size++)
+			for (ns_size = 0; nspec_arr[ns_size] != NULL; ns_size++) {
+				undo_save(ul, nspec_arr[ns_size]->ninfo, sizeof(node_info));
 				nspec_arr[ns_size]->ninfo->num_susp_jobs--;
+			}
 		}
 
 		set_job_state("R", resresv->job);
@@ -1222,6 +1259,8 @@ update_resresv_on_run(resource_resv *resresv, nspec **nspec_arr)
 			char *selectspec;
 			selectspec = create_select_from_nspec(nspec_arr);
 			if (selectspec != NULL) {
+				undo_own(rr_ul, (void **) &resresv->execselect,
+					(undo_func_t) free_selspec);
 				resresv->execselect = parse_selspec(selectspec);
 				free(selectspec);
 			}
@@ -1233,6 +1272,7 @@ update_resresv_on_run(resource_resv *resresv, nspec **nspec_arr)
 		resv_queue = find_queue_info(resresv->server->queues,
 			resresv->resv->queuename);
 		if (resv_queue != NULL) {
+			undo_save(ul, resv_queue, sizeof(queue_info));
 			/* reservation queues are stopped before the reservation is started */
 			resv_queue->is_started = 1;
 			/* because the reservation queue was previously stopped, we need to
@@ -1245,8 +1285,10 @@ update_resresv_on_run(resource_resv *resresv, nspec **nspec_arr)
 				resv_queue->is_ok_to_run = 0;
 		}
 	}
-	if (resresv->ninfo_arr == NULL)
+	if (resresv->ninfo_arr == NULL) {
+		undo_own(rr_ul, (void **) &resresv->ninfo_arr, free);
 		resresv->ninfo_arr = create_node_array_from_nspec(nspec_arr);
+	}
 }
 
 /**
@@ -1269,10 +1311,16 @@ update_resresv_on_end(resource_resv *resresv, char *job_state)
 	char logbuf[MAX_LOG_SIZE];
 	int ret;
 	int i;
+	undo_log *ul;
+	undo_log *rr_ul;	/* NULL if resresv was created by the simulation */
 
 	if (resresv == NULL)
 		return;
 
+	ul = resresv->server->undo;
+	rr_ul = undo_owner(ul, resresv);
+	undo_resource_resv(ul, resresv);
+
 	/* now that it isn't running, it might be runnable again */
 	resresv->can_not_run = 0;
 
@@ -1293,26 +1341,24 @@ update_resresv_on_end(resource_resv *resresv, char *job_state)
 #endif /* localmod 005 */
 			nspec **ns = resresv->nspec_arr;
 			resresv->job->is_susp_sched = 1;
-			for (i = 0; ns[i] != NULL; i++)
+			for (i = 0; ns[i] != NULL; i++) {
+				undo_save(ul, ns[i]->ninfo, sizeof(node_info));
 				ns[i]->ninfo->num_susp_jobs++;
+			}
 		}
 
 		resresv->job->is_provisioning = 0;
 
 		/* free resources allocated to job since it's now been requeued */
 		if (resresv->job->is_queued && !resresv->job->is_checkpointed) {
-			free(resresv->ninfo_arr);
-			resresv->ninfo_arr = NULL;
-			free_nspecs(resresv->nspec_arr);
-			resresv->nspec_arr = NULL;
-			free_resource_req_list(resresv->job->resused);
-			resresv->job->resused = NULL;
-			if (resresv->nodepart_name != NULL) {
-				free(resresv->nodepart_name);
-				resresv->nodepart_name = NULL;
-			}
-			free_selspec(resresv->execselect);
-			resresv->execselect = NULL;
+			undo_free_ptr(rr_ul, (void **) &resresv->ninfo_arr, free);
+			undo_free_ptr(rr_ul, (void **) &resresv->nspec_arr,
+				(undo_func_t) free_nspecs);
+			undo_free_ptr(rr_ul, (void **) &resresv->job->resused,
+				(undo_func_t) free_resource_req_list);
+			undo_free_ptr(rr_ul, (void **) &resresv->nodepart_name, free);
+			undo_free_ptr(rr_ul, (void **) &resresv->execselect,
+				(undo_func_t) free_selspec);
 		}
 	}
 	else if (resresv->is_resv && resresv->resv !=NULL) {
@@ -1321,6 +1367,7 @@ update_resresv_on_end(resource_resv *resresv, char *job_state)
 		resv_queue = find_queue_info(resresv->server->queues,
 			resresv->resv->queuename);
 		if (resv_queue != NULL) {
+			undo_save(ul, resv_queue, sizeof(queue_info));
 			resv_queue->is_started = 0;
 			ret = is_ok_to_run_queue(resresv->server->policy, resv_queue);
 			if (ret == SUCCESS)
@@ -1341,8 +1388,10 @@ update_resresv_on_end(resource_resv *resresv, char *job_state)
 						if (next_occr != NULL) {
 							if (resv_queue->jobs != NULL) {
 								for (i = 0; resv_queue->jobs[i] != NULL; i++) {
-									if (in_runnable_state(resv_queue->jobs[i]))
+									if (in_runnable_state(resv_queue->jobs[i])) {
+										undo_resource_resv(ul, resv_queue->jobs[i]);
 										resv_queue->jobs[i]->job->resv = next_occr;
+									}
 								}
 							}
 						}
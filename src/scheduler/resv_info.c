@@ -50,12 +50,15 @@
  *	new_resv_info()
  *	free_resv_info()
  *	dup_resv_info()
+ *	add_resv_occurrences()
  *	check_new_reservations()
  *	disable_reservation_occurrence()
  *	confirm_reservation()
  *	check_vnodes_down()
  *	release_nodes()
  *	create_resv_nodes()
+ *	get_occurrence_times()
+ *	age_occurrence_times()
  *
  */
 #include <pbs_config.h>
@@ -76,6 +79,7 @@
 #include "misc.h"
 #include "sort.h"
 #include "globals.h"
+#include "snapshot.h"
 #include "node_info.h"
 #include "resource_resv.h"
 #include "resource.h"
@@ -85,6 +89,8 @@
 #include "constant.h"
 #include "node_partition.h"
 #include "pbs_internal.h"
+#include "avltree.h"
+#include "undo_log.h"
 
 
 /**
@@ -103,7 +109,9 @@ stat_resvs(int pbs_sd)
 	char *errmsg;
 
 	/* get the reservation info from the PBS server */
-	if ((resvs = pbs_statresv(pbs_sd, NULL, NULL, NULL)) == NULL) {
+	resvs = pbs_statresv(pbs_sd, NULL, NULL, NULL);
+	snapshot_status("pbs_statresv", resvs);
+	if (resvs == NULL) {
 		if (pbs_errno) {
 			errmsg = pbs_geterrmsg(pbs_sd);
 			if (errmsg == NULL)
@@ -167,6 +175,8 @@ query_reservations(server_info *sinfo, struct batch_status *resvs)
 
 	char logmsg[MAX_LOG_SIZE];
 
+	age_occurrence_times();
+
 	if (resvs == NULL)
 		return NULL;
 
@@ -383,6 +393,7 @@ query_reservations(server_info *sinfo, struct batch_status *resvs)
 				resource_resv **tmp = NULL;
 				time_t dtstart;
 				time_t next;
+				time_t *occr_times;
 				char *rrule = NULL;
 				char *tz = NULL;
 				struct tm* loc_time;
@@ -463,6 +474,9 @@ query_reservations(server_info *sinfo, struct batch_status *resvs)
 					resresv->resv->retry_time <= sinfo->server_time)
 					resresv->resv->retry_time = (sinfo->server_time) + 1;
 
+				occr_times = get_occurrence_times(resresv->name, rrule, dtstart, tz,
+					count - occr_idx + 1);
+
 				/* Add each occurrence to the universe's view by duplicating the
 				 * parent reservation and resetting start and end times and the
 				 * execvnode on which the occurrence is confirmed to run.
@@ -475,7 +489,10 @@ query_reservations(server_info *sinfo, struct batch_status *resvs)
 					 * The last argument (j+1) indicates the occurrence index from dtstart
 					 * starting at 1. Returns dtstart if it's an advance reservation.
 					 */
-					next = get_occurrence(rrule, dtstart, tz, j + 1);
+					if (occr_times != NULL)
+						next = occr_times[j];
+					else
+						next = get_occurrence(rrule, dtstart, tz, j + 1);
 
 					/* Duplicate the "master" resv only for subsequent occurrences */
 					if (j == 0)
@@ -608,9 +625,9 @@ query_resv(struct batch_status *resv, server_info *sinfo)
 
 	while (attrp != NULL) {
 		if (!strcmp(attrp->name, ATTR_resv_owner))
-			advresv->user = string_dup(attrp->value);
+			advresv->user = intern_string(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_egroup))
-			advresv->group = string_dup(attrp->value);
+			advresv->group = intern_string(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_queue))
 			advresv->resv->queuename = string_dup(attrp->value);
 		else if (!strcmp(attrp->name, ATTR_SchedSelect)) {
@@ -869,6 +886,131 @@ dup_resv_info(resv_info *rinfo, server_info *sinfo)
 	return nrinfo;
 }
 
+/**
+ * @brief
+ * 		add the occurrences of a confirmed reservation to a universe
+ *
+ * @param[in]	sinfo	-	the universe
+ * @param[in]	resv	-	the reservation, which is its first occurrence
+ * @param[in]	degraded	-	the reservation was reconfirmed, its occurrences
+ * 								are already in the universe
+ * @param[in]	occr_count	-	number of occurrences
+ * @param[in]	occr_start_arr	-	start time of each occurrence
+ * @param[in]	occr_execvnodes_arr	-	execvnode of each occurrence
+ *
+ * @return	int
+ * @retval	number of occurrences added
+ */
+static int
+add_resv_occurrences(server_info *sinfo, resource_resv *resv, int degraded,
+	int occr_count, time_t *occr_start_arr, char **occr_execvnodes_arr)
+{
+	resource_resv	*nresv_copy = NULL;
+	resource_resv	**tmp_resresv = NULL;
+	int		j;
+
+	for (j = 0; j < occr_count; j++) {
+		/* On first occurrence, the reservation is the "parent" reservation */
+		if (j == 0) {
+			nresv_copy = resv;
+		}
+		/* Subsequent occurrences need to be either modified or created
+		 * depending on whether the reservation is to be reconfirmed or
+		 * is getting confirmed for the first time.
+		 */
+		else {
+			/* For a degraded reservation, it had already been confirmed in a
+			 * previous scheduling cycle. We retrieve the existing object from
+			 * the all_resresv list
+			 */
+			if (degraded) {
+				nresv_copy = find_resource_resv_by_time(sinfo->all_resresv,
+					nresv_copy->name, occr_start_arr[j]);
+				if (nresv_copy == NULL) {
+					schdlog(PBSEVENT_RESV, PBS_EVENTCLASS_RESV,
+						LOG_INFO, resv->name,
+						"Error determining if reservation can be confirmed: "
+						"Could not find reservation by time.");
+					break;
+				}
+			}
+			else {
+				/* For a new, unconfirmed, reservation, we duplicate the parent
+				 * reservation
+				 */
+				nresv_copy = dup_resource_resv(nresv_copy, sinfo, NULL);
+				if (nresv_copy == NULL)
+					break;
+			}
+			/* Duplication deep-copies node info array. This array gets
+			 * overwritten and needs to be freed. This is an alternative
+			 * to creating another duplication function that only duplicates
+			 * the required fields.
+			 */
+			release_nodes(nresv_copy);
+			nresv_copy->nspec_arr = parse_execvnode(occr_execvnodes_arr[j],
+				sinfo);
+			nresv_copy->ninfo_arr = create_node_array_from_nspec(
+				nresv_copy->nspec_arr);
+			nresv_copy->resv->resv_nodes = create_resv_nodes(
+				nresv_copy->nspec_arr, sinfo);
+		}
+
+		/* Note that the sequence of occurrence dates and time are determined
+		 * during confirm_reservation
+		 */
+		nresv_copy->start = occr_start_arr[j];
+
+		/* update start time, duration, and execvnodes of the occurrence */
+		nresv_copy->end = nresv_copy->start + nresv_copy->duration ;
+
+		/* Only add the occurrence to the universe if we are not
+		 * processing a degraded reservation as otherwise, the resources
+		 * had already been added to the universe in query_reservations
+		 */
+		if (nresv_copy->resv->resv_substate != RESV_DEGRADED) {
+			timed_event *te_start;
+			timed_event *te_end;
+			te_start = create_event(TIMED_RUN_EVENT, nresv_copy->start,
+				nresv_copy, NULL, NULL);
+			if (te_start == NULL)
+				break;
+			te_end = create_event(TIMED_END_EVENT, nresv_copy->end,
+				nresv_copy, NULL, NULL);
+			if (te_end == NULL) {
+				free_timed_event(te_start);
+				break;
+			}
+			add_event(sinfo->calendar, te_start);
+			add_event(sinfo->calendar, te_end);
+
+			if (j > 0) {
+				tmp_resresv = add_resresv_to_array(sinfo->resvs, nresv_copy);
+				if (tmp_resresv == NULL)
+					break;
+				sinfo->resvs = tmp_resresv;
+				sinfo->num_resvs++;
+
+				/* the occurrence has its own slot, not the one of its parent */
+				nresv_copy->resresv_ind = count_array((void **) sinfo->all_resresv);
+				tmp_resresv = add_resresv_to_array(sinfo->all_resresv, nresv_copy);
+				if (tmp_resresv == NULL)
+					break;
+				sinfo->all_resresv = tmp_resresv;
+				add_resresv_to_index(sinfo, nresv_copy);
+			}
+		}
+
+		/* Confirm the reservation such that it is not looked at again in the
+		 * main loop of check_new_reservations().
+		 */
+		nresv_copy->resv->resv_state = RESV_CONFIRMED;
+		nresv_copy->resv->resv_substate = RESV_CONFIRMED;
+	}
+
+	return j;
+}
+
 /**
  * @brief
  * 		check for new reservations and handle them
@@ -884,6 +1026,11 @@ dup_resv_info(resv_info *rinfo, server_info *sinfo)
  * 		for it. If it fails then we inform the server that the reconfirmation has
  * 		failed. If it succeeds, then the previously allocated resources are freed
  * 		from the real universe and replaced by the newly allocated resources.
+ * @par
+ * 		All reservations are simulated in one copy of the real universe.  The
+ * 		simulation of a reservation is recorded in an undo log and undone once
+ * 		the reservation is handled.  Only what a confirmation adds to the real
+ * 		universe is also added to the copy.
  *
  * @param[in]	policy	-	policy info
  * @param[in]	pbs_sd	-	communication descriptor to PBS server
@@ -904,11 +1051,13 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
 	server_info	*nsinfo = NULL;
 	resource_resv	*nresv = NULL;
 	resource_resv	*nresv_copy = NULL;
-	resource_resv	**tmp_resresv = NULL;
 
 	char		**occr_execvnodes_arr = NULL;
 	char		**tofree = NULL;
+	char		*execvnodes_seq = NULL;
+	time_t		*occr_start_arr = NULL;
 	int		occr_count =1;
+	int		degraded;
 	int		i;
 	int		j;
 
@@ -936,13 +1085,16 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
 		 * respectively confirmed and reconfirmed.
 		 */
 		if (will_confirm(sinfo->resvs[i], sinfo->server_time)) {
-			/* Clone the real universe for simulation scratch work. This universe
-			 * will be garbage collected after simulation completes.
+			/* Clone the real universe for simulation scratch work.  The clone
+			 * is shared by all reservations and garbage collected once they
+			 * have been handled.
 			 */
-			nsinfo = dup_server_info(sinfo);
+			if (nsinfo == NULL) {
+				nsinfo = dup_server_info(sinfo);
 
-			if (nsinfo == NULL)
-				return -1;
+				if (nsinfo == NULL)
+					return -1;
+			}
 
 			/* Resource reservations are ordered by event time, in the case of a
 			 * standing reservation, the first to be found will be the "parent"
@@ -958,12 +1110,26 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
 				return -1;
 			}
 
+			if (!start_undo_log(nsinfo)) {
+				free_server(nsinfo, 1);
+				return -1;
+			}
+
 			/* Attempt to confirm the reservation. For a standing reservation,
 			 * each occurrence is unrolled and attempted to be confirmed within the
 			 * function.
 			 */
 			pbsrc = confirm_reservation(policy, pbs_sd, nresv , nsinfo);
 
+			/* Keep what the confirmation found and undo its simulation */
+			degraded = nresv->resv->resv_substate == RESV_DEGRADED;
+			occr_count = nresv->resv->count;
+			occr_start_arr = nresv->resv->occr_start_arr;
+			nresv->resv->occr_start_arr = NULL;
+			if (pbsrc == RESV_CONFIRM_SUCCESS)
+				execvnodes_seq = string_dup(nresv->resv->execvnodes_seq);
+			end_undo_log(nsinfo);
+
 			/* confirm_reservation only returns success if all occurrences were
 			 * confirmed and the communication with the server returned no error
 			 */
@@ -973,12 +1139,9 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
 				 * universe. These resources will be replaced by the newly allocated
 				 * ones from the simulated server universe.
 				 */
-				if (nresv->resv->resv_substate == RESV_DEGRADED)
+				if (degraded)
 					release_nodes(sinfo->resvs[i]);
 
-				/* the number of occurrences is set during the confirmation process */
-				occr_count = nresv->resv->count;
-
 				/* Now deal with updating the "real" server universe */
 
 				/* If a standing reservation, unroll the string representation of the
@@ -987,12 +1150,13 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
 					/* "tofree" is a pointer array to a list of unique execvnodes. It is
 					 * safely freed exclusively by calling free_execvnode_seq
 					 */
-					occr_execvnodes_arr = unroll_execvnode_seq(
-						nresv->resv->execvnodes_seq, &tofree);
+					occr_execvnodes_arr = unroll_execvnode_seq(execvnodes_seq, &tofree);
 					if (occr_execvnodes_arr == NULL) {
 						schdlog(PBSEVENT_RESV, PBS_EVENTCLASS_RESV, LOG_INFO,
 							sinfo->resvs[i]->name,
 							"Error unrolling standing reservation.");
+						free(occr_start_arr);
+						free(execvnodes_seq);
 						free_server(nsinfo, 1);
 						return -1;
 					}
@@ -1004,111 +1168,37 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
 					 */
 					occr_execvnodes_arr = malloc(sizeof(char *));
 					if (occr_execvnodes_arr == NULL) {
+						free(occr_start_arr);
+						free(execvnodes_seq);
 						free_server(nsinfo, 1);
 						log_err(errno, "check_new_reservations", MEM_ERR_MSG);
 						return -1;
 					}
-					*occr_execvnodes_arr = nresv->resv->execvnodes_seq;
+					*occr_execvnodes_arr = execvnodes_seq;
 				}
 
 				/* Iterate over all occurrences (would be 1 for advance reservations)
 				 * and copy the information collected during simulation back into the
 				 * real universe
 				 */
-				for (j = 0; j < occr_count; j++) {
-					/* On first occurrence, the reservation is the "parent" reservation */
-					if (j == 0) {
-						nresv_copy = sinfo->resvs[i];
-					}
-					/* Subsequent occurrences need to be either modified or created
-					 * depending on whether the reservation is to be reconfirmed or
-					 * is getting confirmed for the first time.
-					 */
-					else {
-						/* For a degraded reservation, it had already been confirmed in a
-						 * previous scheduling cycle. We retrieve the existing object from
-						 * the all_resresv list
-						 */
-						if (nresv->resv->resv_substate == RESV_DEGRADED) {
-							nresv_copy = find_resource_resv_by_time(sinfo->all_resresv,
-								nresv_copy->name, nresv->resv->occr_start_arr[j]);
-							if (nresv_copy == NULL) {
-								schdlog(PBSEVENT_RESV, PBS_EVENTCLASS_RESV,
-									LOG_INFO, nresv->name,
-									"Error determining if reservation can be confirmed: "
-									"Could not find reservation by time.");
-								break;
-							}
-						}
-						else {
-							/* For a new, unconfirmed, reservation, we duplicate the parent
-							 * reservation
-							 */
-							nresv_copy = dup_resource_resv(nresv_copy, sinfo, NULL);
-							if (nresv_copy == NULL)
-								break;
-						}
-						/* Duplication deep-copies node info array. This array gets
-						 * overwritten and needs to be freed. This is an alternative
-						 * to creating another duplication function that only duplicates
-						 * the required fields.
-						 */
-						release_nodes(nresv_copy);
-						nresv_copy->nspec_arr = parse_execvnode(occr_execvnodes_arr[j],
-							sinfo);
-						nresv_copy->ninfo_arr = create_node_array_from_nspec(
-							nresv_copy->nspec_arr);
-						nresv_copy->resv->resv_nodes = create_resv_nodes(
-							nresv_copy->nspec_arr, sinfo);
-					}
-
-					/* Note that the sequence of occurrence dates and time are determined
-					 * during confirm_reservation and set to the reservation in the
-					 * simulated server
-					 */
-					nresv_copy->start = nresv->resv->occr_start_arr[j];
+				j = add_resv_occurrences(sinfo, sinfo->resvs[i], degraded,
+					occr_count, occr_start_arr, occr_execvnodes_arr);
 
-					/* update start time, duration, and execvnodes of the occurrence */
-					nresv_copy->end = nresv_copy->start + nresv_copy->duration ;
-
-					/* Only add the occurrence to the real universe if we are not
-					 * processing a degraded reservation as otherwise, the resources
-					 * had already been added to the real universe in query_reservations
-					 */
-					if (nresv_copy->resv->resv_substate != RESV_DEGRADED) {
-						timed_event *te_start;
-						timed_event *te_end;
-						te_start = create_event(TIMED_RUN_EVENT, nresv_copy->start,
-							nresv_copy, NULL, NULL);
-						if (te_start == NULL)
-							break;
-						te_end = create_event(TIMED_END_EVENT, nresv_copy->end,
-							nresv_copy, NULL, NULL);
-						if (te_end == NULL) {
-							free_timed_event(te_start);
-							break;
-						}
-						add_event(sinfo->calendar, te_start);
-						add_event(sinfo->calendar, te_end);
-
-						if (j > 0) {
-							tmp_resresv = add_resresv_to_array(sinfo->resvs, nresv_copy);
-							if (tmp_resresv == NULL)
-								break;
-							sinfo->resvs = tmp_resresv;
-							sinfo->num_resvs++;
-						}
-					}
-
-					/* Confirm the reservation such that it is not looked at again in the
-					 * main loop of this function.
-					 */
-					nresv_copy->resv->resv_state = RESV_CONFIRMED;
-					nresv_copy->resv->resv_substate = RESV_CONFIRMED;
-				}
 				/* increment the count if we successfully processed all occurrences */
 				if (j == occr_count)
 					count++;
+
+				/* Do the same to the clone so the next reservations are simulated
+				 * with this one.  If that fails, the next reservation starts over
+				 * with a new clone.
+				 */
+				if (degraded)
+					release_nodes(nresv);
+				if (add_resv_occurrences(nsinfo, nresv, degraded,
+					occr_count, occr_start_arr, occr_execvnodes_arr) != j) {
+					free_server(nsinfo, 1);
+					nsinfo = NULL;
+				}
 			}
 			else if (pbsrc == RESV_CONFIRM_FAIL) {
 				/* For a degraded reservation, it had already been confirmed in a
@@ -1116,13 +1206,13 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
 				 * the all_resresv list and update the retry_time to break out of
 				 * the main loop that checks for reservations that need confirmation
 				 */
-				if (nresv->resv->resv_substate == RESV_DEGRADED) {
-					for (j = 0; j < nresv->resv->count; j++) {
+				if (degraded && occr_start_arr != NULL) {
+					for (j = 0; j < occr_count; j++) {
 						nresv_copy = find_resource_resv_by_time(sinfo->all_resresv,
-							nresv->name, nresv->resv->occr_start_arr[j]);
+							sinfo->resvs[i]->name, occr_start_arr[j]);
 						if (nresv_copy == NULL) {
 							schdlog(PBSEVENT_RESV, PBS_EVENTCLASS_RESV,
-								LOG_INFO, nresv->name,
+								LOG_INFO, sinfo->resvs[i]->name,
 								"Error determining if reservation can be confirmed: "
 								"Could not find reservation by time.");
 							break;
@@ -1144,21 +1234,25 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
 				}
 			}
 			/* clean up */
-			free(nresv->resv->occr_start_arr);
-			nresv->resv->occr_start_arr = NULL;
+			free(occr_start_arr);
+			occr_start_arr = NULL;
+			free(execvnodes_seq);
+			execvnodes_seq = NULL;
 			free_execvnode_seq(tofree);
 			tofree = NULL;
 			free(occr_execvnodes_arr);
 			occr_execvnodes_arr = NULL;
-
-			/* Clean up simulated server info */
-			free_server(nsinfo, 1);
 		}
 		/* Something went wrong with reservation confirmation, retry later */
-		if (pbsrc == RESV_CONFIRM_RETRY)
+		if (pbsrc == RESV_CONFIRM_RETRY) {
+			free_server(nsinfo, 1);
 			return -1;
+		}
 	}
 
+	/* Clean up simulated server info */
+	free_server(nsinfo, 1);
+
 	return count;
 }
 
@@ -1167,7 +1261,7 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
  * 		mark the timed event associated to a resource reservation at a given time as
  * 		disabled.
  *
- * @param[in]	events	-	the event which to be disabled in the calendar.
+ * @param[in]	calendar	-	the calendar which holds the events to disable.
  * @param[in]	resv	-	the resource reservation being disabled
  *
  * @return	int
@@ -1175,20 +1269,24 @@ check_new_reservations(status *policy, int pbs_sd, resource_resv **resvs, server
  * @retval	0	: on failure
  */
 static int
-disable_reservation_occurrence(timed_event *events,
+disable_reservation_occurrence(event_list *calendar,
 	resource_resv *resv)
 {
 	timed_event *te;
 
-	te = find_timed_event(events, resv->name, TIMED_RUN_EVENT, resv->start);
-	if (te != NULL)
+	te = find_calendar_event(calendar, NULL, resv->name, TIMED_RUN_EVENT, resv->start);
+	if (te != NULL) {
+		undo_save(resv->server->undo, te, sizeof(timed_event));
 		set_timed_event_disabled(te, 1);
+	}
 	else
 		return 0;
 
-	te = find_timed_event(events, resv->name, TIMED_END_EVENT, resv->end);
-	if (te != NULL)
+	te = find_calendar_event(calendar, NULL, resv->name, TIMED_END_EVENT, resv->end);
+	if (te != NULL) {
+		undo_save(resv->server->undo, te, sizeof(timed_event));
 		set_timed_event_disabled(te, 1);
+	}
 	else
 		return 0;
 
@@ -1202,7 +1300,8 @@ disable_reservation_occurrence(timed_event *events,
  * @param[in]	policy	-	policy info
  * @param[in]	pbs_sd	-	connection to server
  * @param[in]	unconf_resv	-	the reservation to confirm
- * @param[in]	nsinfo	-	the simulated server info universe
+ * @param[in]	nsinfo	-	the simulated server info universe, its changes
+ * 							are recorded in its undo log
  *
  * @return	int
  * @retval	RESV_CONFIRM_SUCCESS
@@ -1246,6 +1345,7 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 	 */
 	time_t resv_start_time = 0;       /* estimated start time for resv */
 	time_t *occr_start_arr = NULL;   /* an array of occurrence start times */
+	time_t *occr_times;	/* cached occurrence times, see get_occurrence_times() */
 
 	char *execvnodes = NULL;
 	char *short_xc = NULL;
@@ -1259,8 +1359,12 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 	int occr_count = nresv->resv->count;
 	int ridx = nresv->resv->resv_idx - 1;
 
+	undo_log *ul = nsinfo->undo;
+
 	logmsg[0] = logmsg2[0] = '\0';
 
+	undo_resource_resv(ul, nresv_parent);
+
 	err = new_schd_error();
 	if (err == NULL)
 		return RESV_CONFIRM_FAIL;
@@ -1288,6 +1392,7 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 		return RESV_CONFIRM_FAIL;
 	}
 
+	occr_times = get_occurrence_times(nresv->name, rrule, dtstart, tz, occr_count);
 
 	/* Each reservation attempts to confirm a set of nodes on which to run for
 	 * a given start and end time. When handling an advance reservation,
@@ -1299,8 +1404,8 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 	 * in a deep copy of the server info,and is done by simulating events just
 	 * as if the server were processing them.
 	 *
-	 * At the end of the simulation, this cloned server info is completely
-	 * wiped and a fresh version is created from the recorded 'sinfo' state.
+	 * At the end of the simulation, the changes recorded in the undo log of
+	 * the cloned server info are undone so it matches the 'sinfo' state again.
 	 *
 	 * It's critical that when handling a standing reservation, each occurrence
 	 * be added to the server info such that the duplicated server info has up to
@@ -1312,7 +1417,10 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 		 * See call to same function in query_reservations for a more in-depth
 		 * description.
 		 */
-		next = get_occurrence(rrule, dtstart, tz, j+1);
+		if (occr_times != NULL)
+			next = occr_times[j];
+		else
+			next = get_occurrence(rrule, dtstart, tz, j+1);
 		/* keep track of each occurrence's start time */
 		occr_start_arr[j] = next;
 
@@ -1339,6 +1447,7 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 					break;
 				}
 				nresv = nresv_copy;
+				undo_resource_resv(ul, nresv);
 			}
 			else {
 				nresv_copy = dup_resource_resv(nresv, nsinfo, NULL);
@@ -1348,26 +1457,28 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 					break;
 				}
 				nresv = nresv_copy;
+				/* the copy is garbage collected when the simulation is undone */
+				undo_new(ul, nresv, (undo_func_t) free_resource_resv);
 
-				/* add it to the simulated universe of reservations.
-				 * Also add it to the reservation list (resvs) to be garbage collected
-				 */
+				/* add it to the simulated universe of reservations */
+				undo_copy_array(ul, (void ***) &nsinfo->resvs);
 				tmp_resresv = add_resresv_to_array(nsinfo->resvs, nresv);
 				if (tmp_resresv == NULL) {
-					free_resource_resv(nresv);
 					rconf = RESV_CONFIRM_FAIL;
 					break;
 				}
 				nsinfo->resvs = tmp_resresv;
 
+				undo_copy_array(ul, (void ***) &nsinfo->all_resresv);
 				tmp_resresv = add_resresv_to_array(nsinfo->all_resresv, nresv);
 				if (tmp_resresv == NULL) {
-					free_resource_resv(nresv);
 					rconf = RESV_CONFIRM_FAIL;
 					break;
 				}
 				nsinfo->all_resresv = tmp_resresv;
+				undo_save(ul, &nsinfo->num_resvs, sizeof(nsinfo->num_resvs));
 				nsinfo->num_resvs++;
+				add_resresv_to_index(nsinfo, nresv);
 			}
 			/* Concatenate the execvnode to a Token separator */
 			tmp = (char *) concat_str(execvnodes, TOKEN_SEPARATOR, NULL, 1);
@@ -1375,7 +1486,6 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 				schdlog(PBSEVENT_RESV, PBS_EVENTCLASS_RESV, LOG_INFO, nresv->name,
 					"Error determining if reservation can be confirmed: "
 					"String concatenation failed.");
-				free_resource_resv(nresv);
 				rconf = RESV_CONFIRM_FAIL;
 				break;
 			}
@@ -1434,7 +1544,7 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 				}
 				continue;
 			}
-			if (disable_reservation_occurrence(nsinfo->calendar->events, nresv)
+			if (disable_reservation_occurrence(nsinfo->calendar, nresv)
 				!= 1) {
 				schdlog(PBSEVENT_RESV, PBS_EVENTCLASS_RESV, LOG_INFO, nresv->name,
 					"Error determining if reservation can be confirmed: "
@@ -1590,7 +1700,10 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 			 * so we only care about the remaining ones
 			 */
 			for (; cur_count < occr_count; cur_count++) {
-				next = get_occurrence(rrule, dtstart, tz, cur_count + 1);
+				if (occr_times != NULL)
+					next = occr_times[cur_count];
+				else
+					next = get_occurrence(rrule, dtstart, tz, cur_count + 1);
 				occr_start_arr[cur_count] = next;
 			}
 		}
@@ -1606,7 +1719,7 @@ confirm_reservation(status *policy, int pbs_sd, resource_resv *unconf_resv, serv
 		/* If handling a degraded reservation or while altering a standing reservation
 		 * we recreate a new execvnode sequence string, so the old should be cleared.
 		 */
-		free(nresv_parent->resv->execvnodes_seq);
+		undo_free_ptr(ul, (void **) &nresv_parent->resv->execvnodes_seq, free);
 
 		/* set or update (for reconfirmation) the sequence of execvnodes */
 		nresv_parent->resv->execvnodes_seq = short_xc;
@@ -1695,16 +1808,13 @@ check_vnodes_down(node_info **ninfo_arr, int *tot_vnodes, char *names_of_down_vn
 void
 release_nodes(resource_resv *resresv)
 {
-	free_nodes(resresv->resv->resv_nodes);
-	resresv->resv->resv_nodes = NULL;
-	free(resresv->ninfo_arr);
-	resresv->ninfo_arr = NULL;
-	free_nspecs(resresv->nspec_arr);
-	resresv->nspec_arr = NULL;
-	if (resresv->nodepart_name != NULL) {
-		free(resresv->nodepart_name);
-		resresv->nodepart_name = NULL;
-	}
+	undo_log *ul;
+
+	ul = undo_owner(resresv->server->undo, resresv);
+	undo_free_ptr(ul, (void **) &resresv->resv->resv_nodes, (undo_func_t) free_nodes);
+	undo_free_ptr(ul, (void **) &resresv->ninfo_arr, free);
+	undo_free_ptr(ul, (void **) &resresv->nspec_arr, (undo_func_t) free_nspecs);
+	undo_free_ptr(ul, (void **) &resresv->nodepart_name, free);
 }
 
 /**
@@ -1831,3 +1941,186 @@ int will_confirm(resource_resv *resv, time_t server_time) {
 
 	return 0;
 }
+
+/*
+ * Cross-cycle cache of the start times of reservation occurrences.
+ * get_occurrence() walks a recurrence rule from its start for every index,
+ * so unrolling a standing reservation each cycle was quadratic in its
+ * number of occurrences.  The times only depend on the rule, its start and
+ * its timezone; an entry is recomputed when one of them changes and is
+ * dropped once its reservation has not been seen for a cycle.
+ */
+struct occr_times
+{
+	char *name;			/* name of the reservation */
+	char *rrule;			/* recurrence rule (NULL: advance reservation) */
+	char *tz;			/* timezone of the rule */
+	time_t dtstart;			/* start the rule is unrolled from */
+	int count;			/* number of times in occr_arr */
+	time_t *occr_arr;		/* occr_arr[i]: start of occurrence i+1 */
+	int last_used;			/* occr_cycle of the last lookup */
+	struct occr_times *next;
+};
+
+static AVL_IX_DESC *occr_index = NULL;		/* reservation name -> times */
+static struct occr_times *occr_list = NULL;	/* all cached times */
+static int occr_cycle = 0;			/* advanced by age_occurrence_times() */
+
+/**
+ * @brief
+ *		compare two possibly NULL strings for equality
+ *
+ * @return	int
+ * @retval	1	: equal
+ * @retval	0	: not equal
+ */
+static int
+occr_str_eq(char *s1, char *s2)
+{
+	if (s1 == NULL || s2 == NULL)
+		return s1 == s2;
+
+	return strcmp(s1, s2) == 0;
+}
+
+/**
+ * @brief
+ *		free a cached occr_times entry
+ *
+ * @param[in]	ot	-	the entry to free
+ *
+ * @return	nothing
+ */
+static void
+free_occr_times(struct occr_times *ot)
+{
+	if (ot == NULL)
+		return;
+
+	free(ot->name);
+	free(ot->rrule);
+	free(ot->tz);
+	free(ot->occr_arr);
+	free(ot);
+}
+
+/**
+ * @brief
+ *		get the start times of the first count occurrences of a
+ *		reservation from the cross-cycle cache, unrolling its recurrence
+ *		rule in one pass if the cached times are missing or stale.
+ *
+ * @param[in]	name	-	name of the reservation
+ * @param[in]	rrule	-	recurrence rule (NULL for an advance reservation)
+ * @param[in]	dtstart	-	start to unroll the rule from
+ * @param[in]	tz	-	timezone of the rule
+ * @param[in]	count	-	number of occurrences needed
+ *
+ * @return	time_t *
+ * @retval	array where [i] is get_occurrence(rrule, dtstart, tz, i+1).
+ *		It belongs to the cache and is good until the next call.
+ * @retval	NULL	: on error - use get_occurrence()
+ *
+ * @par MT-Safe:	no
+ */
+time_t *
+get_occurrence_times(char *name, char *rrule, time_t dtstart, char *tz, int count)
+{
+	struct occr_times *ot;
+	time_t *occr_arr;
+
+	if (name == NULL || count <= 0)
+		return NULL;
+
+	if (occr_index == NULL) {
+		if ((occr_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return NULL;
+		}
+	}
+
+	ot = find_tree(occr_index, name);
+	if (ot == NULL) {
+		if ((ot = calloc(1, sizeof(struct occr_times))) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return NULL;
+		}
+		if ((ot->name = string_dup(name)) == NULL ||
+			tree_add_del(occr_index, ot->name, ot, TREE_OP_ADD) != 0) {
+			free_occr_times(ot);
+			return NULL;
+		}
+		ot->next = occr_list;
+		occr_list = ot;
+	}
+	ot->last_used = occr_cycle;
+
+	if (ot->occr_arr != NULL && ot->count >= count && ot->dtstart == dtstart &&
+		occr_str_eq(ot->rrule, rrule) && occr_str_eq(ot->tz, tz))
+		return ot->occr_arr;
+
+	/* the reservation changed or more occurrences are needed */
+	if ((occr_arr = malloc(count * sizeof(time_t))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+	if (get_occurrences(rrule, dtstart, tz, count, occr_arr) != 0) {
+		free(occr_arr);
+		return NULL;
+	}
+
+	free(ot->rrule);
+	free(ot->tz);
+	free(ot->occr_arr);
+	ot->rrule = string_dup(rrule);
+	ot->tz = string_dup(tz);
+	ot->dtstart = dtstart;
+	ot->occr_arr = occr_arr;
+	ot->count = count;
+	if ((rrule != NULL && ot->rrule == NULL) || (tz != NULL && ot->tz == NULL)) {
+		/* don't match against a partial key next time */
+		free(ot->occr_arr);
+		ot->occr_arr = NULL;
+		ot->count = 0;
+		return NULL;
+	}
+
+	return ot->occr_arr;
+}
+
+/**
+ * @brief
+ *		start a new cycle of the occurrence times cache: drop the times
+ *		of the reservations which were not looked up in the last cycle.
+ *		Called once a cycle before the reservations are queried.
+ *
+ * @return	nothing
+ *
+ * @par MT-Safe:	no
+ */
+void
+age_occurrence_times(void)
+{
+	struct occr_times *ot;
+	struct occr_times *prev = NULL;
+	struct occr_times *next;
+
+	occr_cycle++;
+
+	for (ot = occr_list; ot != NULL; ot = next) {
+		next = ot->next;
+		if (ot->last_used >= occr_cycle - 1) {
+			prev = ot;
+			continue;
+		}
+
+		if (prev == NULL)
+			occr_list = next;
+		else
+			prev->next = next;
+
+		if (occr_index != NULL)
+			tree_add_del(occr_index, ot->name, NULL, TREE_OP_DEL);
+		free_occr_times(ot);
+	}
+}
@@ -116,6 +116,12 @@ void adjust_alter_resv_nodes(resource_resv **all_resvs, node_info **all_nodes);
 /* Will we try and confirm this reservation in this cycle */
 int will_confirm(resource_resv *resv, time_t server_time);
 
+/* cached start times of the first count occurrences of a reservation */
+time_t *get_occurrence_times(char *name, char *rrule, time_t dtstart, char *tz, int count);
+
+/* drop cached occurrence times of reservations not seen in the last cycle */
+void age_occurrence_times(void);
+
 #ifdef	__cplusplus
 }
 #endif
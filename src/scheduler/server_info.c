@@ -45,6 +45,9 @@
  * Functions included are:
  * 	query_server()
  * 	query_server_info()
+ * 	dyn_res_helper()
+ * 	start_dyn_res_run()
+ * 	get_dyn_res_value()
  * 	query_server_dyn_res()
  * 	query_sched_obj()
  * 	find_alloc_resource()
@@ -54,6 +57,7 @@
  * 	free_server_info()
  * 	free_resource_list()
  * 	free_resource()
+ * 	free_res_ord_index()
  * 	new_server_info()
  * 	new_resource()
  * 	create_resource()
@@ -80,6 +84,7 @@
  * 	new_counts()
  * 	free_counts()
  * 	free_counts_list()
+ * 	index_counts_list()
  * 	dup_counts()
  * 	dup_counts_list()
  * 	find_counts()
@@ -105,6 +110,12 @@
  * 	add_queue_to_list()
  * 	find_queue_list_by_priority()
  * 	append_to_queue_list()
+ * 	index_server_nodes()
+ * 	index_server_queues()
+ * 	index_server_resresvs()
+ * 	add_resresv_to_index()
+ * 	find_node_by_host_index()
+ * 	free_server_indexes()
  *
  */
 #include <pbs_config.h>
@@ -114,6 +125,15 @@
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#ifndef WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
 #include <pbs_ifl.h>
 #include <pbs_error.h>
 #include <log.h>
@@ -127,6 +147,7 @@
 #include "config.h"
 #include "node_info.h"
 #include "globals.h"
+#include "snapshot.h"
 #include "resv_info.h"
 #include "sort.h"
 #include "resource_resv.h"
@@ -143,10 +164,17 @@
 #include "pbs_sched.h"
 #include "fifo.h"
 #include "buckets.h"
+#include "formula.h"
+#include "mem_pool.h"
+#include "cycle_stats.h"
+#include "undo_log.h"
 #ifdef NAS
 #include "site_code.h"
 #endif
 
+/* pool schd_resources are allocated from */
+static mem_pool resource_pool = MEM_POOL_INITIALIZER("schd_resource", sizeof(schd_resource));
+
 
 /**
  *	@brief
@@ -196,7 +224,9 @@ query_server(status *pol, int pbs_sd)
 	}
 
 	/* get server information from pbs server */
-	if ((server = pbs_statserver(pbs_sd, NULL, NULL)) == NULL) {
+	server = pbs_statserver(pbs_sd, NULL, NULL);
+	snapshot_status("pbs_statserver", server);
+	if (server == NULL) {
 		errmsg = pbs_geterrmsg(pbs_sd);
 		if (errmsg == NULL)
 			errmsg = "";
@@ -226,6 +256,7 @@ query_server(status *pol, int pbs_sd)
 	}
 
 	all_sched = pbs_statsched(pbs_sd, NULL, NULL);
+	snapshot_status("pbs_statsched", all_sched);
 	sched = bs_find(all_sched, sc_name);
 
 	if (sched == NULL) {
@@ -269,6 +300,7 @@ query_server(status *pol, int pbs_sd)
 		free_server(sinfo, 0);
 		return NULL;
 	}
+	index_server_nodes(sinfo);
 
 	/* sort the nodes before we filter them down to more useful lists */
 	if (policy->node_sort[0].res_name != NULL)
@@ -276,12 +308,15 @@ query_server(status *pol, int pbs_sd)
 			multi_node_sort);
 
 	/* get the queues */
+	prep_job_status_cache(policy);
 	if ((sinfo->queues = query_queues(policy, pbs_sd, sinfo)) == NULL) {
 		pbs_statfree(server);
 		sinfo->fairshare = NULL;
 		free_server(sinfo, 0);
 		return NULL;
 	}
+	sweep_job_status_cache(policy);
+	index_server_queues(sinfo);
 
 	if (sinfo->has_nodes_assoc_queue)
 		sinfo->unassoc_nodes =
@@ -334,6 +369,7 @@ query_server(status *pol, int pbs_sd)
 		free_server(sinfo, 1);
 		return NULL;
 	}
+	index_server_resresvs(sinfo);
 #ifdef NAS /* localmod 050 */
 	/* Give site a chance to tweak values before jobs are sorted */
 	if (site_tidy_server(sinfo) == 0) {
@@ -677,6 +713,386 @@ query_server_info(status *pol, struct batch_status *server)
 	return sinfo;
 }
 
+#ifndef WIN32
+/* a server_dyn_res program and the last value it returned.  Each run of
+ * the program is made by a helper thread, so a run can outlive the cycle
+ * which started it.  Protected by dyn_res_lock.
+ */
+static struct dyn_res_run
+{
+	char *program;		/* the program */
+	int running;		/* a helper thread is running the program */
+	int killed;		/* the run timed out and is to be killed */
+	pid_t pid;		/* the running program, once started */
+	long long started;	/* when the run started (usec) */
+	int done;		/* a run finished and hasn't been collected */
+	char out[256];		/* first line of output of the finished run */
+	int out_err;		/* errno if the finished run failed */
+	long long latency;	/* how long the finished run took (usec) */
+	time_t out_time;	/* when the finished run finished */
+	int have_value;		/* a run has been collected */
+	char value[256];	/* first line of output of the collected run */
+	int value_err;		/* errno if the collected run failed */
+	time_t value_time;	/* when the collected run finished */
+	long long value_latency;/* how long the collected run took (usec) */
+} dyn_res_runs[MAX_SERVER_DYN_RES];
+
+static pthread_mutex_t dyn_res_lock = PTHREAD_MUTEX_INITIALIZER;
+/* signaled when a helper thread finishes a run */
+static pthread_cond_t dyn_res_cond = PTHREAD_COND_INITIALIZER;
+
+/* how often (ms) a helper thread reading a program's output checks if
+ * the run was killed
+ */
+#define DYN_RES_KILL_POLL	500
+
+/**
+ * @brief
+ * 		read the first line of a server_dyn_res program's output.
+ *		Gives up once the run is killed: a child of the program which
+ *		left its process group may still hold the pipe open.
+ *
+ * @param[in]	run	-	the dyn_res_run being read
+ * @param[in]	fd	-	read end of the program's stdout
+ * @param[out]	buf	-	the line read, with its newline
+ * @param[in]	len	-	size of buf
+ *
+ * @par MT-Safe: yes
+ *
+ * @return	int
+ * @retval	0	: success (buf is empty if there was no output)
+ * @retval	errno	: read failed
+ */
+static int
+read_dyn_res_line(struct dyn_res_run *run, int fd, char *buf, int len)
+{
+	struct pollfd pfd;
+	int n = 0;
+	int rc;
+	int killed;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	while (n < len - 1) {
+		rc = poll(&pfd, 1, DYN_RES_KILL_POLL);
+		if (rc == -1 && errno != EINTR) {
+			buf[0] = '\0';
+			return errno;
+		}
+		if (rc <= 0) {
+			pthread_mutex_lock(&dyn_res_lock);
+			killed = run->killed;
+			pthread_mutex_unlock(&dyn_res_lock);
+			if (killed)
+				break;
+			continue;
+		}
+		if ((rc = read(fd, buf + n, 1)) == -1) {
+			if (errno == EINTR)
+				continue;
+			buf[0] = '\0';
+			return errno;
+		}
+		if (rc == 0 || buf[n++] == '\n')
+			break;
+	}
+	buf[n] = '\0';
+
+	return 0;
+}
+
+/**
+ * @brief
+ * 		helper thread: run a server_dyn_res program and read the first
+ *		line of its output.  The program is run in its own process
+ *		group so it can be killed with its children if it times out.
+ *
+ * @param[in]	arg	-	the dyn_res_run to run
+ *
+ * @par MT-Safe: yes
+ *
+ * @return NULL
+ */
+static void *
+dyn_res_helper(void *arg)
+{
+	struct dyn_res_run *run = arg;
+	char *program;
+	char buf[256];
+	int fds[2];
+	int err = 0;
+	int sig;
+	sigset_t emptyset;
+	pid_t pid;
+
+	pthread_mutex_lock(&dyn_res_lock);
+	program = run->program;
+	pthread_mutex_unlock(&dyn_res_lock);
+
+	buf[0] = '\0';
+	/* close-on-exec, so other programs forked meanwhile don't hold the
+	 * write end open past this program's exit
+	 */
+	if (pipe2(fds, O_CLOEXEC) == -1)
+		err = errno;
+	else if ((pid = fork()) == -1) {
+		err = errno;
+		close(fds[0]);
+		close(fds[1]);
+	}
+	else if (pid == 0) {
+		/* the thread was created with every signal blocked, and the
+		 * scheduler ignores some; give the program a clean slate
+		 */
+		for (sig = 1; sig < NSIG; sig++)
+			signal(sig, SIG_DFL);
+		sigemptyset(&emptyset);
+		sigprocmask(SIG_SETMASK, &emptyset, NULL);
+
+		setpgid(0, 0);
+		if (fds[1] == STDOUT_FILENO)
+			fcntl(STDOUT_FILENO, F_SETFD, 0);
+		else
+			dup2(fds[1], STDOUT_FILENO);
+		execl("/bin/sh", "sh", "-c", program, (char *) NULL);
+		_exit(127);
+	}
+	else {
+		close(fds[1]);
+		pthread_mutex_lock(&dyn_res_lock);
+		run->pid = pid;
+		if (run->killed) {
+			kill(-pid, SIGKILL);
+			kill(pid, SIGKILL);
+		}
+		pthread_mutex_unlock(&dyn_res_lock);
+
+		err = read_dyn_res_line(run, fds[0], buf, sizeof(buf));
+		close(fds[0]);
+		while (waitpid(pid, NULL, 0) == -1 && errno == EINTR)
+			;
+	}
+
+	pthread_mutex_lock(&dyn_res_lock);
+	run->pid = 0;
+	run->running = 0;
+	/* the cycle which killed the run has already used the last value */
+	if (!run->killed) {
+		strcpy(run->out, buf);
+		run->out_err = err;
+		run->latency = now_usec() - run->started;
+		run->out_time = time(NULL);
+		run->done = 1;
+	}
+	pthread_cond_broadcast(&dyn_res_cond);
+	pthread_mutex_unlock(&dyn_res_lock);
+
+	return NULL;
+}
+
+/**
+ * @brief
+ * 		start a helper thread running the i'th server_dyn_res program
+ *		if its last value is older than server_dyn_res_ttl.  The runs
+ *		for a cycle are all started before any are waited for, so the
+ *		programs run concurrently.
+ *
+ * @param[in]	i	-	index into conf.dynamic_res
+ *
+ * @par MT-Safe: no
+ *
+ * @return void
+ */
+static void
+start_dyn_res_run(int i)
+{
+	struct dyn_res_run *run = &dyn_res_runs[i];
+	char *program = conf.dynamic_res[i].program;
+	sigset_t allsigs;
+	sigset_t oldsigs;
+	pthread_t tid;
+	pthread_attr_t attr;
+	time_t now;
+	int rc;
+
+	pthread_mutex_lock(&dyn_res_lock);
+
+	/* the program was changed by a reconfigure */
+	if (run->program == NULL || strcmp(run->program, program) != 0) {
+		if (run->running) {
+			run->killed = 1;
+			if (run->pid > 0) {
+				kill(-run->pid, SIGKILL);
+				kill(run->pid, SIGKILL);
+			}
+			while (run->running)
+				pthread_cond_wait(&dyn_res_cond, &dyn_res_lock);
+		}
+		free(run->program);
+		memset(run, 0, sizeof(struct dyn_res_run));
+		if ((run->program = string_dup(program)) == NULL) {
+			pthread_mutex_unlock(&dyn_res_lock);
+			return;
+		}
+	}
+
+	now = time(NULL);
+	if (!run->running && !run->done &&
+		(!run->have_value || now - run->value_time >= conf.server_dyn_res_ttl)) {
+		run->running = 1;
+		run->killed = 0;
+		run->started = now_usec();
+
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		sigfillset(&allsigs);
+		pthread_sigmask(SIG_SETMASK, &allsigs, &oldsigs);
+		rc = pthread_create(&tid, &attr, dyn_res_helper, run);
+		pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+		pthread_attr_destroy(&attr);
+		if (rc != 0) {
+			run->running = 0;
+			run->done = 1;
+			run->out[0] = '\0';
+			run->out_err = rc;
+			run->latency = 0;
+			run->out_time = now;
+		}
+	}
+
+	pthread_mutex_unlock(&dyn_res_lock);
+}
+
+/**
+ * @brief
+ * 		get the value of the i'th server_dyn_res program started by
+ *		start_dyn_res_run().  The cycle only waits for the run if
+ *		server_dyn_res_ttl is 0 or the program has never returned a
+ *		value.  A run which takes longer than server_dyn_res_timeout is
+ *		killed without waiting for it to go away, and the last value is
+ *		used.
+ *
+ * @param[in]	i	-	index into conf.dynamic_res
+ * @param[out]	buf	-	first line of output of the program
+ * @param[out]	pipe_err	-	errno if the program couldn't be run
+ *
+ * @par MT-Safe: no
+ *
+ * @return	int
+ * @retval	length of the output in buf
+ * @retval	0	: the program failed
+ */
+static int
+get_dyn_res_value(int i, char *buf, int *pipe_err)
+{
+	struct dyn_res_run *run = &dyn_res_runs[i];
+	char *program = conf.dynamic_res[i].program;
+	struct timespec deadline;
+	long long timeout = (long long) conf.server_dyn_res_timeout * 1000000;
+	long long remaining;
+	long age;
+	int fresh = 0;
+	int stale;
+	int timed_out = 0;
+
+	pthread_mutex_lock(&dyn_res_lock);
+
+	if (run->program == NULL || strcmp(run->program, program) != 0) {
+		pthread_mutex_unlock(&dyn_res_lock);
+		*pipe_err = ENOMEM;
+		return 0;
+	}
+
+	/* wait for the run if we have nothing else to use */
+	if (run->running && !run->killed &&
+		(!run->have_value || conf.server_dyn_res_ttl == 0)) {
+		if (timeout > 0) {
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			remaining = run->started + timeout - now_usec();
+			if (remaining < 0)
+				remaining = 0;
+			deadline.tv_sec += remaining / 1000000;
+			deadline.tv_nsec += (remaining % 1000000) * 1000;
+			if (deadline.tv_nsec >= 1000000000) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000;
+			}
+			while (run->running &&
+				pthread_cond_timedwait(&dyn_res_cond, &dyn_res_lock, &deadline) != ETIMEDOUT)
+				;
+		}
+		else {
+			while (run->running)
+				pthread_cond_wait(&dyn_res_cond, &dyn_res_lock);
+		}
+	}
+
+	/* Kill a run which timed out, but don't wait for it to go away.  The
+	 * helper thread finishes in the background and the run's output is
+	 * thrown away.
+	 */
+	if (run->running && (run->killed ||
+		(timeout > 0 && now_usec() - run->started >= timeout))) {
+		if (!run->killed) {
+			run->killed = 1;
+			if (run->pid > 0) {
+				kill(-run->pid, SIGKILL);
+				kill(run->pid, SIGKILL);
+			}
+		}
+		timed_out = 1;
+		if (!run->have_value) {
+			run->value[0] = '\0';
+			run->value_err = 0;
+			run->value_time = time(NULL);
+			run->value_latency = now_usec() - run->started;
+			run->have_value = 1;
+			fresh = 1;
+		}
+	}
+
+	if (run->done) {
+		strcpy(run->value, run->out);
+		run->value_err = run->out_err;
+		run->value_time = run->out_time;
+		run->value_latency = run->latency;
+		run->have_value = 1;
+		fresh = 1;
+		run->done = 0;
+	}
+
+	strcpy(buf, run->value);
+	*pipe_err = run->value_err;
+	age = (long) (time(NULL) - run->value_time);
+	stale = !fresh && (timed_out || conf.server_dyn_res_ttl == 0 ||
+		age > 2 * conf.server_dyn_res_ttl);
+
+	if (timed_out) {
+		snprintf(log_buffer, sizeof(log_buffer), "Script %s timed out after %ld seconds",
+			program, (long) conf.server_dyn_res_timeout);
+		schdlog(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG,
+			"server_dyn_res", log_buffer);
+	}
+	else if (fresh) {
+		snprintf(log_buffer, sizeof(log_buffer), "Script %s took %.3f seconds",
+			program, (double) run->value_latency / 1000000);
+		schdlog(PBSEVENT_DEBUG2, PBS_EVENTCLASS_SERVER, LOG_DEBUG,
+			"server_dyn_res", log_buffer);
+	}
+	if (stale) {
+		snprintf(log_buffer, sizeof(log_buffer),
+			"Using stale value of script %s from %ld seconds ago", program, age);
+		schdlog(PBSEVENT_DEBUG, PBS_EVENTCLASS_SERVER, LOG_DEBUG,
+			"server_dyn_res", log_buffer);
+	}
+	add_dyn_res_stats(conf.dynamic_res[i].res, run->value_latency, age, stale);
+
+	pthread_mutex_unlock(&dyn_res_lock);
+
+	return strlen(buf);
+}
+#endif /* WIN32 */
+
 /**
  * @brief
  * 		execute all configured server_dyn_res scripts
@@ -694,10 +1110,12 @@ query_server_dyn_res(server_info *sinfo)
 	char res_zero[] = "0";	/* dynamic res failure implies resource <-0 */
 	char buf[256];		/* buffer for reading from pipe */
 	schd_resource *res;		/* used for updating node resources */
-	FILE *fp;			/* for popen() for res_assn */
 #ifdef WIN32
 	struct  pio_handles	  pio;  /* for win_popen() for res_assn */
 	char			  cmd_line[512];
+#else
+	for (i = 0; i < MAX_SERVER_DYN_RES && conf.dynamic_res[i].res != NULL; i++)
+		start_dyn_res_run(i);
 #endif
 
 	for (i = 0; i < MAX_SERVER_DYN_RES && conf.dynamic_res[i].res != NULL; i ++) {
@@ -722,15 +1140,7 @@ query_server_dyn_res(server_info *sinfo)
 			if (pio.hReadPipe_out != INVALID_HANDLE_VALUE) /* did win_popen() succeed? */
 				win_pclose(&pio);
 #else
-			if (((fp = popen(conf.dynamic_res[i].program, "r")) == NULL) ||
-				(fgets(buf, 256, fp) == NULL)) {
-				pipe_err = errno;
-				k = 0;
-			}
-			else
-				k = strlen(buf);
-			if (fp != NULL)
-				pclose(fp);
+			k = get_dyn_res_value(i, buf, &pipe_err);
 #endif
 			if (k > 0) {
 				buf[k] = '\0';
@@ -882,21 +1292,26 @@ find_alloc_resource(schd_resource *resplist, resdef *def)
 	if (def == NULL)
 		return NULL;
 
-	for (resp = resplist; resp != NULL && resp->def != def; resp = resp->next) {
-		prev = resp;
-	}
+	if ((resp = find_resource(resplist, def)) != NULL)
+		return resp;
 
-	if (resp == NULL) {
-		if ((resp = new_resource()) == NULL)
-			return NULL;
+	/* the index knows where the end of the list was */
+	if (resplist != NULL && resplist->ord_index != NULL)
+		prev = resplist->ord_index->tail;
+	else
+		prev = resplist;
+	for (; prev != NULL && prev->next != NULL; prev = prev->next)
+		;
 
-		resp->def = def;
-		resp->type = def->type;
-		resp->name = def->name;
+	if ((resp = new_resource()) == NULL)
+		return NULL;
 
-		if (prev != NULL)
-			prev->next = resp;
-	}
+	resp->def = def;
+	resp->type = def->type;
+	resp->name = def->name;
+
+	if (prev != NULL)
+		prev->next = resp;
 
 	return resp;
 }
@@ -966,6 +1381,61 @@ find_resource_by_str(schd_resource *reslist, const char *name)
 
 	return resp;
 }
+/**
+ * @brief
+ * 		bring the ordinal index of a resource list up to date with the
+ *		resources added to the end of the list since it was last updated.
+ *		The index is created if the list doesn't have one yet.
+ *
+ * @param[in]	reslist	-	head of the resource list
+ *
+ * @return	the list's index
+ * @retval	NULL	: malloc failed - search the list instead
+ *
+ * @par MT-Safe:	no
+ */
+static res_ord_index *
+update_res_ord_index(schd_resource *reslist)
+{
+	res_ord_index *idx;
+	schd_resource *resp;
+	schd_resource **tmp;
+	int size;
+
+	if ((idx = reslist->ord_index) == NULL) {
+		if ((idx = calloc(1, sizeof(res_ord_index))) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return NULL;
+		}
+		reslist->ord_index = idx;
+	}
+
+	for (resp = (idx->tail == NULL) ? reslist : idx->tail->next;
+		resp != NULL; resp = resp->next) {
+		if (resp->def != NULL && resp->def->ord >= 0) {
+			if (resp->def->ord >= idx->size) {
+				size = resp->def->ord + 1;
+				if (size < idx->size * 2)
+					size = idx->size * 2;
+				if ((tmp = realloc(idx->res, size * sizeof(schd_resource *))) == NULL) {
+					log_err(errno, __func__, MEM_ERR_MSG);
+					free_res_ord_index(reslist);
+					return NULL;
+				}
+				memset(tmp + idx->size, 0, (size - idx->size) * sizeof(schd_resource *));
+				idx->res = tmp;
+				idx->size = size;
+			}
+			/* like a search of the list, the first resource wins */
+			if (idx->res[resp->def->ord] == NULL)
+				idx->res[resp->def->ord] = resp;
+		}
+		idx->tail = resp;
+	}
+
+	return idx;
+}
+
 /**
  * @brief
  * 		find resource by resource definition
@@ -980,10 +1450,19 @@ schd_resource *
 find_resource(schd_resource *reslist, resdef *def)
 {
 	schd_resource *resp;
+	res_ord_index *idx;
 
 	if (reslist == NULL || def == NULL)
 		return NULL;
 
+	if (def->ord >= 0) {
+		idx = reslist->ord_index;
+		if (idx == NULL || idx->tail->next != NULL)
+			idx = update_res_ord_index(reslist);
+		if (idx != NULL)
+			return (def->ord < idx->size) ? idx->res[def->ord] : NULL;
+	}
+
 	resp = reslist;
 
 	while (resp != NULL && resp->def != def)
@@ -1072,6 +1551,7 @@ free_server_info(server_info *sinfo)
 	
 	if(sinfo->unordered_nodes != NULL)
 		free(sinfo->unordered_nodes);
+	free_server_indexes(sinfo);
 
 	free_resource_list(sinfo->res);
 #ifdef NAS
@@ -1137,7 +1617,30 @@ free_resource(schd_resource *resp)
 	if (resp->str_assigned != NULL)
 		free(resp->str_assigned);
 
-	free(resp);
+	free_res_ord_index(resp);
+
+	pool_free(&resource_pool, resp);
+}
+
+/**
+ * @brief
+ * 		free the resdef ordinal index of a resource list
+ *
+ * @param[in]	reslist	-	head of the resource list
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+free_res_ord_index(schd_resource *reslist)
+{
+	if (reslist == NULL || reslist->ord_index == NULL)
+		return;
+
+	free(reslist->ord_index->res);
+	free(reslist->ord_index);
+	reslist->ord_index = NULL;
 }
 
 /**
@@ -1222,6 +1725,11 @@ new_server_info(int limallocflag)
 	sinfo->equiv_classes = NULL;
 	sinfo->buckets = NULL;
 	sinfo->unordered_nodes = NULL;
+	sinfo->node_index = NULL;
+	sinfo->host_index = NULL;
+	sinfo->queue_index = NULL;
+	sinfo->resresv_index = NULL;
+	sinfo->undo = NULL;
 	sinfo->num_queues = 0;
 	sinfo->num_nodes = 0;
 	sinfo->num_resvs = 0;
@@ -1258,12 +1766,10 @@ new_resource()
 {
 	schd_resource *resp;		/* the new resource */
 
-	if ((resp = calloc(1,  sizeof(schd_resource))) == NULL) {
-		log_err(errno, "new_resource", MEM_ERR_MSG);
+	if ((resp = pool_alloc(&resource_pool)) == NULL)
 		return NULL;
-	}
 
-	/* member type zero'd by calloc() */
+	/* member type zero'd by pool_alloc() */
 
 	resp->name = NULL;
 	resp->next = NULL;
@@ -1425,7 +1931,6 @@ add_resource_list(status *policy, schd_resource *r1, schd_resource *r2, unsigned
 						nres = false_res();
 						if (nres == NULL)
 							return 0;
-						nres->name = boolres[i]->name;
 						(void)add_resource_bool(cur_r1, nres);
 					}
 				}
@@ -1603,6 +2108,7 @@ update_server_on_run(status *policy, server_info *sinfo,
 	counts *cts;			/* used in updating project/group/user counts */
 	int num_unassoc;		/* number of unassociated nodes */
 	counts *allcts;			/* used in updating counts for all jobs */
+	undo_log *ul;
 
 	if (sinfo == NULL || resresv == NULL)
 		return;
@@ -1614,6 +2120,8 @@ update_server_on_run(status *policy, server_info *sinfo,
 			return;
 	}
 
+	ul = sinfo->undo;
+	undo_save(ul, sinfo, sizeof(server_info));
 
 	/*
 	 * Update the server level resources 
@@ -1630,8 +2138,10 @@ update_server_on_run(status *policy, server_info *sinfo,
 			if (req->type.is_consumable) {
 				res = find_resource(sinfo->res, req->def);
 
-				if (res)
+				if (res) {
+					undo_resource(ul, res);
 					res->assigned += req->amount;
+				}
 			}
 			req = req->next;
 		}
@@ -1655,15 +2165,18 @@ update_server_on_run(status *policy, server_info *sinfo,
 
 				resv_nodes = resresv->job->resv->resv->resv_nodes;
 				num_resv_nodes = count_array((void **) resv_nodes);
+				undo_save(ul, resv_nodes, num_resv_nodes * sizeof(node_info *));
 				qsort(resv_nodes, num_resv_nodes, sizeof(node_info *),
 					multi_node_sort);
 			}
 			else {
+				undo_save(ul, sinfo->nodes, sinfo->num_nodes * sizeof(node_info *));
 				qsort(sinfo->nodes, sinfo->num_nodes, sizeof(node_info *),
 					multi_node_sort);
 
 				if (sinfo->nodes != sinfo->unassoc_nodes) {
 					num_unassoc = count_array((void **) sinfo->unassoc_nodes);
+					undo_save(ul, sinfo->unassoc_nodes, num_unassoc * sizeof(node_info *));
 					qsort(sinfo->unassoc_nodes, num_unassoc, sizeof(node_info *),
 						multi_node_sort);
 				}
@@ -1673,14 +2186,11 @@ update_server_on_run(status *policy, server_info *sinfo,
 		/* We're running a job or reservation, which will affect the cached data.
 		 * We'll flush the cache and rebuild it if needed
 		 */
-		if (sinfo->npc_arr != NULL) {
-			free_np_cache_array(sinfo->npc_arr);
-			sinfo->npc_arr = NULL;
-		}
+		undo_free_ptr(ul, (void **) &sinfo->npc_arr, (undo_func_t) free_np_cache_array);
 
 
 		/* a new job has been run, recreate running jobs array */
-		free(sinfo->running_jobs);
+		undo_free_ptr(ul, (void **) &sinfo->running_jobs, free);
 		sinfo->running_jobs = resource_resv_filter(
 			sinfo->jobs, sinfo->sc.total, check_run_job, NULL, 0);
 	}
@@ -1689,32 +2199,16 @@ update_server_on_run(status *policy, server_info *sinfo,
 		if (resresv->is_job) {
 			update_total_counts(sinfo, NULL , resresv, SERVER);
 
-			cts = find_alloc_counts(sinfo->group_counts, resresv->group);
-
-			if (sinfo->group_counts == NULL)
-				sinfo->group_counts = cts;
-
+			cts = find_alloc_counts_undo(ul, &sinfo->group_counts, resresv->group);
 			update_counts_on_run(cts, resresv->resreq);
 
-			cts = find_alloc_counts(sinfo->project_counts, resresv->project);
-
-			if (sinfo->project_counts == NULL)
-				sinfo->project_counts = cts;
-
+			cts = find_alloc_counts_undo(ul, &sinfo->project_counts, resresv->project);
 			update_counts_on_run(cts, resresv->resreq);
 
-			cts = find_alloc_counts(sinfo->user_counts, resresv->user);
-
-			if (sinfo->user_counts == NULL)
-				sinfo->user_counts = cts;
-
+			cts = find_alloc_counts_undo(ul, &sinfo->user_counts, resresv->user);
 			update_counts_on_run(cts, resresv->resreq);
 
-			allcts = find_alloc_counts(sinfo->alljobcounts, "o:" PBS_ALL_ENTITY);
-
-			if (sinfo->alljobcounts == NULL)
-				sinfo->alljobcounts = allcts;
-
+			allcts = find_alloc_counts_undo(ul, &sinfo->alljobcounts, "o:" PBS_ALL_ENTITY);
 			update_counts_on_run(allcts, resresv->resreq);
 		}
 	}
@@ -1748,6 +2242,7 @@ update_server_on_end(status *policy, server_info *sinfo, queue_info *qinfo,
 	resource_req *req;		/* resource request from job */
 	schd_resource *res;		/* resource on server */
 	int i;
+	undo_log *ul;
 
 	if (sinfo == NULL ||  resresv == NULL)
 		return;
@@ -1758,13 +2253,18 @@ update_server_on_end(status *policy, server_info *sinfo, queue_info *qinfo,
 			return;
 	}
 
+	ul = sinfo->undo;
+	undo_save(ul, sinfo, sizeof(server_info));
+
 	if (resresv->is_job) {
 		if (resresv->job->is_running) {
 			sinfo->sc.running--;
+			undo_copy_array(ul, (void ***) &sinfo->running_jobs);
 			remove_resresv_from_array(sinfo->running_jobs, resresv);
 		}
 		else if (resresv->job->is_exiting) {
 			sinfo->sc.exiting--;
+			undo_copy_array(ul, (void ***) &sinfo->exiting_jobs);
 			remove_resresv_from_array(sinfo->exiting_jobs, resresv);
 		}
 		state_count_add(&(sinfo->sc), job_state, 1);
@@ -1785,6 +2285,7 @@ update_server_on_end(status *policy, server_info *sinfo, queue_info *qinfo,
 			res = find_resource(sinfo->res, req->def);
 
 			if (res != NULL) {
+				undo_resource(ul, res);
 				res->assigned -= req->amount;
 
 				if (res->assigned < 0) {
@@ -1804,32 +2305,29 @@ update_server_on_end(status *policy, server_info *sinfo, queue_info *qinfo,
 	/* We're ending a job or reservation, which will affect the cached data.
 	 * We'll flush the cache and rebuild it if needed
 	 */
-	if (sinfo->npc_arr != NULL) {
-		free_np_cache_array(sinfo->npc_arr);
-		sinfo->npc_arr = NULL;
-	}
+	undo_free_ptr(ul, (void **) &sinfo->npc_arr, (undo_func_t) free_np_cache_array);
 
 	if (sinfo->has_soft_limit || sinfo->has_hard_limit) {
 		if (resresv->is_job && resresv->job->is_running) {
 			counts *cts;			/* update user/group/project counts */
 
 			update_total_counts_on_end(sinfo, NULL, resresv, SERVER);
-			cts = find_counts(sinfo->group_counts, resresv->group);
+			cts = find_counts_undo(ul, sinfo->group_counts, resresv->group);
 
 			if (cts != NULL)
 				update_counts_on_end(cts, resresv->resreq);
 
-			cts = find_counts(sinfo->project_counts, resresv->project);
+			cts = find_counts_undo(ul, sinfo->project_counts, resresv->project);
 
 			if (cts != NULL)
 				update_counts_on_end(cts, resresv->resreq);
 
-			cts = find_counts(sinfo->user_counts, resresv->user);
+			cts = find_counts_undo(ul, sinfo->user_counts, resresv->user);
 
 			if (cts != NULL)
 				update_counts_on_end(cts, resresv->resreq);
 
-			cts = find_alloc_counts(sinfo->alljobcounts, "o:" PBS_ALL_ENTITY);
+			cts = find_counts_undo(ul, sinfo->alljobcounts, "o:" PBS_ALL_ENTITY);
 
 			if (cts != NULL)
 				update_counts_on_end(cts, resresv->resreq);
@@ -2220,6 +2718,8 @@ dup_server_info(server_info *osinfo)
 		nsinfo->unassoc_nodes = nsinfo->nodes;
 	
 	nsinfo->unordered_nodes = dup_unordered_nodes(osinfo->unordered_nodes, nsinfo->nodes);
+	if (osinfo->node_index != NULL)
+		index_server_nodes(nsinfo);
 
 	/* dup the reservations */
 	nsinfo->resvs = dup_resource_resv_array(osinfo->resvs, nsinfo, NULL);
@@ -2235,6 +2735,8 @@ dup_server_info(server_info *osinfo)
 		free_server(nsinfo, 0);
 		return NULL;
 	}
+	if (osinfo->queue_index != NULL)
+		index_server_queues(nsinfo);
 
 	if (osinfo->queue_list != NULL) {
 		int ret_val;
@@ -2260,6 +2762,8 @@ dup_server_info(server_info *osinfo)
 #else
 	copy_server_arrays(nsinfo, osinfo);
 #endif /* localmod 054 */
+	if (osinfo->resresv_index != NULL)
+		index_server_resresvs(nsinfo);
 
 	nsinfo->equiv_classes = dup_resresv_set_array(osinfo->equiv_classes, nsinfo);
 
@@ -2338,7 +2842,7 @@ dup_server_info(server_info *osinfo)
 			copy_resresv_array(osinfo->nodes[i]->run_resvs_arr,
 			nsinfo->resvs);
 		if(nsinfo->calendar != NULL)
-			nsinfo->nodes[i]->node_events = dup_te_lists(osinfo->nodes[i]->node_events, nsinfo->calendar->next_event);
+			nsinfo->nodes[i]->node_events = dup_te_lists(osinfo->nodes[i]->node_events, nsinfo->calendar);
 
 	}
 	nsinfo->buckets = dup_node_bucket_array(osinfo->buckets, nsinfo);
@@ -2572,6 +3076,8 @@ new_counts(void)
 	cts->name = NULL;
 	cts->running = 0;
 	cts->rescts = NULL;
+	cts->name_index = NULL;
+	cts->tail = NULL;
 	cts->next = NULL;
 
 	return cts;
@@ -2593,12 +3099,14 @@ free_counts(counts *cts)
 	if (cts == NULL)
 		return;
 
-	if (cts->name != NULL)
-		free(cts->name);
-
 	if (cts->rescts != NULL)
 		free_resource_req_list(cts->rescts);
 
+	if (cts->name_index != NULL) {
+		avl_destroy_index(cts->name_index);
+		free(cts->name_index);
+	}
+
 	cts->next = NULL;
 
 	free(cts);
@@ -2628,6 +3136,49 @@ free_counts_list(counts *ctslist)
 	}
 }
 
+/**
+ * @brief
+ * 		index_counts_list - index a counts list by entity name.  The head
+ *		of the list owns the index and keeps track of the list's tail
+ *		so find_alloc_counts() can append without walking the list.
+ *
+ * @param[in,out]	ctslist	- the counts list to index
+ *
+ * @return	int
+ * @retval	1	: the list is indexed
+ * @retval	0	: the index could not be created; the list is unchanged
+ *
+ * @par MT-Safe:	no
+ */
+int
+index_counts_list(counts *ctslist)
+{
+	counts *cur;
+
+	if (ctslist == NULL)
+		return 0;
+
+	if (ctslist->name_index != NULL)
+		return 1;
+
+	if ((ctslist->name_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return 0;
+	}
+
+	for (cur = ctslist; cur != NULL; cur = cur->next) {
+		if (tree_add_del(ctslist->name_index, cur->name, cur, TREE_OP_ADD) != 0) {
+			avl_destroy_index(ctslist->name_index);
+			free(ctslist->name_index);
+			ctslist->name_index = NULL;
+			return 0;
+		}
+		ctslist->tail = cur;
+	}
+
+	return 1;
+}
+
 /**
  * @brief
  * 		dup_counts - duplicate a counts structure
@@ -2647,8 +3198,7 @@ dup_counts(counts *octs)
 	ncts = new_counts();
 
 	if (ncts != NULL) {
-		if (octs->name != NULL)
-			ncts->name = string_dup(octs->name);
+		ncts->name = octs->name;
 
 		ncts->running = octs->running;
 
@@ -2712,14 +3262,24 @@ counts *
 find_counts(counts *ctslist, char *name)
 {
 	counts *cur;
+	int len = 0;
 
 	if (ctslist == NULL || name == NULL)
 		return NULL;
 
+	if (ctslist->name_index != NULL)
+		return find_tree(ctslist->name_index, name);
+
 	cur = ctslist;
 
-	while (cur != NULL && strcmp(cur->name, name))
+	while (cur != NULL && strcmp(cur->name, name)) {
 		cur = cur->next;
+		len++;
+	}
+
+	/* long lists are searched once per limit per job, index them */
+	if (len >= MIN_COUNTS_INDEX)
+		index_counts_list(ctslist);
 
 	return cur;
 }
@@ -2746,26 +3306,172 @@ find_alloc_counts(counts *ctslist, char *name)
 	if (name == NULL)
 		return NULL;
 
-	prev = cur = ctslist;
+	if ((cur = find_counts(ctslist, name)) != NULL)
+		return cur;
 
-	while (cur != NULL && strcmp(cur->name, name)) {
-		prev = cur;
-		cur = cur->next;
+	if ((new = new_counts()) == NULL)
+		return NULL;
+
+	if ((new->name = intern_string(name)) == NULL) {
+		free_counts(new);
+		return NULL;
 	}
 
-	if (cur == NULL) {
-		new = new_counts();
+	if (ctslist == NULL)
+		return new;
 
-		if (new != NULL)
-			new->name = string_dup(name);
+	if (ctslist->name_index != NULL) {
+		if (tree_add_del(ctslist->name_index, new->name, new, TREE_OP_ADD) != 0) {
+			free_counts(new);
+			return NULL;
+		}
+		prev = ctslist->tail;
+		ctslist->tail = new;
+	} else
+		for (prev = ctslist; prev->next != NULL; prev = prev->next)
+			;
 
-		if (prev != NULL)
-			prev->next = new;
+	prev->next = new;
 
-		return new;
+	return new;
+}
+
+/* counts added to an indexed counts list by a simulation */
+struct counts_undo_arg {
+	counts *head;
+	counts *cts;
+};
+
+/**
+ * @brief
+ * 		remove counts added by a simulation from its list's name index.
+ *		Called when the simulation is undone.
+ *
+ * @param[in]	arg	-	struct counts_undo_arg (freed)
+ *
+ * @return	void
+ */
+static void
+unindex_counts(void *arg)
+{
+	struct counts_undo_arg *cua = arg;
+
+	if (cua->head->name_index != NULL &&
+		find_tree(cua->head->name_index, cua->cts->name) == cua->cts)
+		tree_add_del(cua->head->name_index, cua->cts->name, NULL, TREE_OP_DEL);
+	free(cua);
+}
+
+/**
+ * @brief
+ * 		find_counts_undo - find_counts() for a counts structure which
+ *		is about to be updated.  The counts found is saved in the
+ *		universe's undo log.
+ *
+ * @param[in]	ul	-	undo log of the universe (may be NULL)
+ * @param[in]	ctslist -	the counts list to search
+ * @param[in]	name	-	the name to find
+ *
+ * @return	found counts structure
+ * @retval	NULL	: not found
+ *
+ * @par MT-Safe:	no
+ */
+counts *
+find_counts_undo(undo_log *ul, counts *ctslist, char *name)
+{
+	counts *cts;
+
+	cts = find_counts(ctslist, name);
+	undo_counts(ul, cts);
+
+	return cts;
+}
+
+/**
+ * @brief
+ * 		find_alloc_counts_undo - find_alloc_counts() for a counts list
+ *		which is about to be updated.  If the list is empty, the new
+ *		counts becomes its head.  The counts returned is saved in the
+ *		universe's undo log, and a counts added to the list is removed
+ *		from it when the simulation is undone.
+ *
+ * @param[in]	ul	-	undo log of the universe (may be NULL)
+ * @param[in,out]	ctslist -	the counts list to search
+ * @param[in]	name	-	the name to find
+ *
+ * @return	found or newly-allocated counts structure
+ * @retval	NULL	: error
+ *
+ * @par MT-Safe:	no
+ */
+counts *
+find_alloc_counts_undo(undo_log *ul, counts **ctslist, char *name)
+{
+	counts *head;
+	counts *cts;
+	counts *last;
+	struct counts_undo_arg *cua;
+
+	if (ctslist == NULL || name == NULL)
+		return NULL;
+
+	head = *ctslist;
+	if (ul == NULL) {
+		cts = find_alloc_counts(head, name);
+		if (head == NULL)
+			*ctslist = cts;
+		return cts;
 	}
+
+	if ((cts = find_counts(head, name)) != NULL) {
+		undo_counts(ul, cts);
+		return cts;
+	}
+
+	/* a list created by the simulation is freed as a whole on undo */
+	if (head == NULL) {
+		if ((cts = find_alloc_counts(NULL, name)) == NULL)
+			return NULL;
+		undo_save(ul, ctslist, sizeof(counts *));
+		*ctslist = cts;
+		undo_new(ul, cts, (undo_func_t) free_counts_list);
+		return cts;
+	}
+	if (undo_is_new(ul, head))
+		return find_alloc_counts(head, name);
+
+	/* Index the list first, so the index is never built from counts
+	 * which will be freed on undo.
+	 */
+	index_counts_list(head);
+	if (head->name_index != NULL)
+		last = head->tail;
 	else
-		return cur;
+		for (last = head; last->next != NULL; last = last->next)
+			;
+	undo_save(ul, &head->tail, sizeof(counts *));
+	if (!undo_is_new(ul, last))
+		undo_save(ul, &last->next, sizeof(counts *));
+
+	if ((cts = find_alloc_counts(head, name)) == NULL)
+		return NULL;
+
+	if (head->name_index != NULL) {
+		if ((cua = malloc(sizeof(struct counts_undo_arg))) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			avl_destroy_index(head->name_index);
+			free(head->name_index);
+			head->name_index = NULL;
+		} else {
+			cua->head = head;
+			cua->cts = cts;
+			undo_call(ul, unindex_counts, cua);
+		}
+	}
+	undo_new(ul, cts, (undo_func_t) free_counts);
+
+	return cts;
 }
 
 /**
@@ -2878,14 +3584,13 @@ counts_max(counts *cmax, counts *new)
 	for (cur = new; cur != NULL; cur = cur->next) {
 		cur_fmax = find_counts(cmax, cur->name);
 		if (cur_fmax == NULL) {
-			cur_fmax = dup_counts(cur);
+			cur_fmax = find_alloc_counts(cmax_head, cur->name);
 			if (cur_fmax == NULL) {
 				free_counts_list(cmax_head);
 				return NULL;
 			}
-
-			cur_fmax->next = cmax_head;
-			cmax_head = cur_fmax;
+			cur_fmax->running = cur->running;
+			cur_fmax->rescts = dup_resource_req_list(cur->rescts);
 		}
 		else {
 			if (cur->running > cur_fmax->running)
@@ -2934,6 +3639,7 @@ update_universe_on_end(status *policy, resource_resv *resresv, char *job_state,
 	int i;
 	server_info *sinfo = NULL;
 	queue_info *qinfo = NULL;
+	undo_log *ul;
 
 
 	if (resresv == NULL)
@@ -2946,6 +3652,7 @@ update_universe_on_end(status *policy, resource_resv *resresv, char *job_state,
 		return;
 
 	sinfo = resresv->server;
+	ul = sinfo->undo;
 
 	if (resresv->is_job) {
 		qinfo = resresv->job->queue;
@@ -2954,6 +3661,7 @@ update_universe_on_end(status *policy, resource_resv *resresv, char *job_state,
 			int need_metadata_update = 0;
 			for (i = 0; resresv->execselect->defs[i] != NULL;i++) {
 				if (!resdef_exists_in_array(policy->resdef_to_check, resresv->execselect->defs[i])) {
+					undo_copy_array(ul, (void ***) &policy->resdef_to_check);
 					add_resdef_to_array(&(policy->resdef_to_check), resresv->execselect->defs[i]);
 					need_metadata_update = 1;
 				}
@@ -2963,16 +3671,14 @@ update_universe_on_end(status *policy, resource_resv *resresv, char *job_state,
 				/* Since a new resource was added to resdef_to_check, the meta data needs to be recreated.
 				 * This will happen on the next call to node_partition_update()
 				 */
-				if (sinfo->allpart != NULL) {
-					free_resource_list(sinfo->allpart->res);
-					sinfo->allpart->res = NULL;
-				}
+				if (sinfo->allpart != NULL)
+					undo_free_ptr(ul, (void **) &sinfo->allpart->res,
+						(undo_func_t) free_resource_list);
 				for (j = 0; sinfo->queues[j] != NULL; j++) {
 					queue_info *q = sinfo->queues[j];
-					if (q->allpart != NULL) {
-						free_resource_list(q->allpart->res);
-						q->allpart->res = NULL;
-					}
+					if (q->allpart != NULL)
+						undo_free_ptr(ul, (void **) &q->allpart->res,
+							(undo_func_t) free_resource_list);
 				}
 			}
 		}
@@ -3254,14 +3960,15 @@ update_preemption_on_run(server_info *sinfo, resource_resv *resresv)
 							sinfo->jobs[i]->job->queue, sinfo);
 				}
 			}
-			qsort(sinfo->jobs, sinfo->sc.total,
-				sizeof(resource_resv *), cmp_sort);
+			undo_copy_array(sinfo->undo, (void ***) &sinfo->jobs);
+			sort_job_array(sinfo->jobs, sinfo->sc.total);
 			for (i = 0; sinfo->queues[i] != NULL; i++) {
-				qsort(sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total,
-					sizeof(resource_resv *), cmp_sort);
+				undo_copy_array(sinfo->undo, (void ***) &sinfo->queues[i]->jobs);
+				sort_job_array(sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total);
 			}
 
 			/* now that we've set all the preempt levels, we need to count them */
+			undo_save(sinfo->undo, sinfo->preempt_count, sizeof(sinfo->preempt_count));
 			memset(sinfo->preempt_count, 0, NUM_PPRIO * sizeof(int));
 			for (i = 0; sinfo->running_jobs[i] != NULL; i++)
 				if (!sinfo->running_jobs[i]->job->can_not_preempt)
@@ -3333,6 +4040,10 @@ read_formula(void)
 		form[strlen(form) - 1] = '\0';
 
 	fclose(fp);
+
+	/* compile the formula now rather than when the first job is sorted */
+	find_compiled_formula(form);
+
 	return form;
 }
 
@@ -3467,6 +4178,36 @@ void
 create_total_counts(server_info *sinfo, queue_info * qinfo,
 	resource_resv *resresv, int mode)
 {
+	counts **totals[8];	/* total lists created in a simulation */
+	int num_totals = 0;
+	undo_log *ul;
+	int i;
+
+	if (sinfo != NULL)
+		ul = sinfo->undo;
+	else
+		ul = qinfo->server != NULL ? qinfo->server->undo : NULL;
+	if (ul != NULL) {
+		if (mode == SERVER || mode == ALL) {
+			totals[num_totals++] = &sinfo->total_group_counts;
+			totals[num_totals++] = &sinfo->total_user_counts;
+			totals[num_totals++] = &sinfo->total_project_counts;
+			totals[num_totals++] = &sinfo->total_alljobcounts;
+		}
+		if (mode == QUEUE || mode == ALL) {
+			totals[num_totals++] = &qinfo->total_group_counts;
+			totals[num_totals++] = &qinfo->total_user_counts;
+			totals[num_totals++] = &qinfo->total_project_counts;
+			totals[num_totals++] = &qinfo->total_alljobcounts;
+		}
+		for (i = 0; i < num_totals; i++) {
+			if (*totals[i] != NULL)
+				totals[i] = NULL;
+			else
+				undo_save(ul, totals[i], sizeof(counts *));
+		}
+	}
+
 	if (mode == SERVER || mode == ALL) {
 		if (sinfo->total_group_counts == NULL) {
 			if (sinfo->group_counts != NULL)
@@ -3533,6 +4274,10 @@ create_total_counts(server_info *sinfo, queue_info * qinfo,
 					qinfo->total_alljobcounts, "o:" PBS_ALL_ENTITY);
 		}
 	}
+
+	for (i = 0; i < num_totals; i++)
+		if (totals[i] != NULL && *totals[i] != NULL)
+			undo_new(ul, *totals[i], (undo_func_t) free_counts_list);
 	return;
 }
 
@@ -3555,28 +4300,36 @@ update_total_counts(server_info *si, queue_info* qi,
 	resource_resv *rr, int mode)
 {
 	counts *cts = NULL;
+	undo_log *ul;
+
 	create_total_counts(si, qi, rr, mode);
+	if (si != NULL)
+		ul = si->undo;
+	else
+		ul = qi->server != NULL ? qi->server->undo : NULL;
 	if (((mode == SERVER) || (mode == ALL)) &&
 		((si != NULL) && si->has_hard_limit)) {
-		cts = si->total_group_counts;
-		update_counts_on_run(find_alloc_counts(cts, rr->group), rr->resreq);
-		cts = si->total_project_counts;
-		update_counts_on_run(find_alloc_counts(cts, rr->project), rr->resreq);
+		cts = find_alloc_counts_undo(ul, &si->total_group_counts, rr->group);
+		update_counts_on_run(cts, rr->resreq);
+		cts = find_alloc_counts_undo(ul, &si->total_project_counts, rr->project);
+		update_counts_on_run(cts, rr->resreq);
 		cts = si->total_alljobcounts;
+		undo_counts(ul, cts);
+		update_counts_on_run(cts, rr->resreq);
+		cts = find_alloc_counts_undo(ul, &si->total_user_counts, rr->user);
 		update_counts_on_run(cts, rr->resreq);
-		cts = si->total_user_counts;
-		update_counts_on_run(find_alloc_counts(cts, rr->user), rr->resreq);
 	}
 	else if (((mode == QUEUE) || (mode == ALL)) &&
 		((qi != NULL) && qi->has_hard_limit)) {
-		cts = qi->total_group_counts;
-		update_counts_on_run(find_alloc_counts(cts, rr->group), rr->resreq);
-		cts = qi->total_project_counts;
-		update_counts_on_run(find_alloc_counts(cts, rr->project), rr->resreq);
+		cts = find_alloc_counts_undo(ul, &qi->total_group_counts, rr->group);
+		update_counts_on_run(cts, rr->resreq);
+		cts = find_alloc_counts_undo(ul, &qi->total_project_counts, rr->project);
+		update_counts_on_run(cts, rr->resreq);
 		cts = qi->total_alljobcounts;
+		undo_counts(ul, cts);
+		update_counts_on_run(cts, rr->resreq);
+		cts = find_alloc_counts_undo(ul, &qi->total_user_counts, rr->user);
 		update_counts_on_run(cts, rr->resreq);
-		cts = qi->total_user_counts;
-		update_counts_on_run(find_alloc_counts(cts, rr->user), rr->resreq);
 	}
 }
 
@@ -3599,28 +4352,36 @@ update_total_counts_on_end(server_info *si, queue_info* qi,
 	resource_resv *rr, int mode)
 {
 	counts *cts = NULL;
+	undo_log *ul;
+
 	create_total_counts(si, qi, rr, mode);
+	if (si != NULL)
+		ul = si->undo;
+	else
+		ul = qi->server != NULL ? qi->server->undo : NULL;
 	if (((mode == SERVER) || (mode == ALL)) &&
 		((si != NULL) && si->has_hard_limit)) {
-		cts = si->total_group_counts;
-		update_counts_on_end(find_alloc_counts(cts, rr->group), rr->resreq);
-		cts = si->total_project_counts;
-		update_counts_on_end(find_alloc_counts(cts, rr->project), rr->resreq);
+		cts = find_alloc_counts_undo(ul, &si->total_group_counts, rr->group);
+		update_counts_on_end(cts, rr->resreq);
+		cts = find_alloc_counts_undo(ul, &si->total_project_counts, rr->project);
+		update_counts_on_end(cts, rr->resreq);
 		cts = si->total_alljobcounts;
+		undo_counts(ul, cts);
+		update_counts_on_end(cts, rr->resreq);
+		cts = find_alloc_counts_undo(ul, &si->total_user_counts, rr->user);
 		update_counts_on_end(cts, rr->resreq);
-		cts = si->total_user_counts;
-		update_counts_on_end(find_alloc_counts(cts, rr->user), rr->resreq);
 	}
 	else if (((mode == QUEUE) || (mode == ALL)) &&
 		((qi != NULL) &&  qi->has_hard_limit)) {
-		cts = qi->total_group_counts;
-		update_counts_on_end(find_alloc_counts(cts, rr->group), rr->resreq);
-		cts = qi->total_project_counts;
-		update_counts_on_end(find_alloc_counts(cts, rr->project), rr->resreq);
+		cts = find_alloc_counts_undo(ul, &qi->total_group_counts, rr->group);
+		update_counts_on_end(cts, rr->resreq);
+		cts = find_alloc_counts_undo(ul, &qi->total_project_counts, rr->project);
+		update_counts_on_end(cts, rr->resreq);
 		cts = qi->total_alljobcounts;
+		undo_counts(ul, cts);
+		update_counts_on_end(cts, rr->resreq);
+		cts = find_alloc_counts_undo(ul, &qi->total_user_counts, rr->user);
 		update_counts_on_end(cts, rr->resreq);
-		cts = qi->total_user_counts;
-		update_counts_on_end(find_alloc_counts(cts, rr->user), rr->resreq);
 	}
 }
 
@@ -3957,3 +4718,262 @@ dup_unordered_nodes(node_info **old_unordered_nodes, node_info **nnodes)
 
 	return new_unordered_nodes;
 }
+
+/**
+ * @brief
+ *		free an index created with create_tree()
+ *
+ * @param[in]	idx	-	index to free
+ *
+ * @return	void
+ */
+static void
+free_name_index(AVL_IX_DESC *idx)
+{
+	if (idx == NULL)
+		return;
+
+	avl_destroy_index(idx);
+	free(idx);
+}
+
+/**
+ * @brief
+ *		create the key used in the host index.  Hosts are compared
+ *		without regard to case.
+ *
+ * @param[in]	host	-	host name
+ * @param[out]	buf	-	buffer of size PBS_MAXHOSTNAME + 1 for the key
+ *
+ * @return	int
+ * @retval	1	: key created
+ * @retval	0	: host name is too long
+ */
+static int
+make_host_key(char *host, char *buf)
+{
+	int i;
+
+	for (i = 0; host[i] != '\0'; i++) {
+		if (i == PBS_MAXHOSTNAME)
+			return 0;
+		buf[i] = tolower((unsigned char) host[i]);
+	}
+	buf[i] = '\0';
+
+	return 1;
+}
+
+/**
+ * @brief
+ *		create the node name and host indexes of a server.  Must be called
+ *		once sinfo->nodes is complete.  Lookups fall back to a linear
+ *		search if the indexes can't be created.
+ *
+ * @param[in]	sinfo	-	server to index
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+int
+index_server_nodes(server_info *sinfo)
+{
+	schd_resource *res;
+	char hostbuf[PBS_MAXHOSTNAME + 1];
+	int i;
+	int j;
+
+	if (sinfo == NULL || sinfo->nodes == NULL)
+		return 0;
+
+	free_name_index(sinfo->node_index);
+	free_name_index(sinfo->host_index);
+	sinfo->node_index = create_tree(AVL_NO_DUP_KEYS, 0);
+	sinfo->host_index = create_tree(AVL_NO_DUP_KEYS, 0);
+	if (sinfo->node_index == NULL || sinfo->host_index == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free_server_indexes(sinfo);
+		return 0;
+	}
+
+	for (i = 0; sinfo->nodes[i] != NULL; i++) {
+		/* duplicate names are rejected, so the first node wins like a linear search */
+		tree_add_del(sinfo->node_index, sinfo->nodes[i]->name, sinfo->nodes[i], TREE_OP_ADD);
+
+		res = find_resource(sinfo->nodes[i]->res, getallres(RES_HOST));
+		if (res == NULL || res->str_avail == NULL)
+			continue;
+		for (j = 0; res->str_avail[j] != NULL; j++) {
+			if (!make_host_key(res->str_avail[j], hostbuf))
+				continue;
+			if (find_tree(sinfo->host_index, hostbuf) == NULL)
+				tree_add_del(sinfo->host_index, hostbuf, sinfo->nodes[i], TREE_OP_ADD);
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief
+ *		create the queue name index of a server
+ *
+ * @param[in]	sinfo	-	server to index
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+int
+index_server_queues(server_info *sinfo)
+{
+	int i;
+
+	if (sinfo == NULL || sinfo->queues == NULL)
+		return 0;
+
+	free_name_index(sinfo->queue_index);
+	if ((sinfo->queue_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return 0;
+	}
+
+	for (i = 0; sinfo->queues[i] != NULL; i++)
+		tree_add_del(sinfo->queue_index, sinfo->queues[i]->name, sinfo->queues[i], TREE_OP_ADD);
+
+	return 1;
+}
+
+/**
+ * @brief
+ *		create the job and reservation name index of a server.  Must be
+ *		called once sinfo->all_resresv is complete.
+ *
+ * @param[in]	sinfo	-	server to index
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+int
+index_server_resresvs(server_info *sinfo)
+{
+	int i;
+
+	if (sinfo == NULL || sinfo->all_resresv == NULL)
+		return 0;
+
+	free_name_index(sinfo->resresv_index);
+	if ((sinfo->resresv_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return 0;
+	}
+
+	for (i = 0; sinfo->all_resresv[i] != NULL; i++)
+		tree_add_del(sinfo->resresv_index, sinfo->all_resresv[i]->name,
+			sinfo->all_resresv[i], TREE_OP_ADD);
+
+	return 1;
+}
+
+/**
+ * @brief
+ *		undo function which removes a resresv added by a simulation
+ *		from its server's name index
+ *
+ * @param[in]	arg	-	the resresv
+ *
+ * @return	void
+ */
+static void
+unindex_resresv(void *arg)
+{
+	resource_resv *resresv = arg;
+	server_info *sinfo = resresv->server;
+
+	if (sinfo->resresv_index != NULL &&
+		find_tree(sinfo->resresv_index, resresv->name) == resresv)
+		tree_add_del(sinfo->resresv_index, resresv->name, NULL, TREE_OP_DEL);
+}
+
+/**
+ * @brief
+ *		add a job or reservation which was added to the server's arrays
+ *		after the server was indexed to the name index
+ *
+ * @param[in]	sinfo	-	server of the resresv
+ * @param[in]	resresv	-	resresv to add
+ *
+ * @return	void
+ */
+void
+add_resresv_to_index(server_info *sinfo, resource_resv *resresv)
+{
+	if (sinfo == NULL || resresv == NULL || sinfo->resresv_index == NULL)
+		return;
+
+	/* like a linear search, the first resresv added with a name is found
+	 * (e.g. the first occurrence of a standing reservation)
+	 */
+	if (find_tree(sinfo->resresv_index, resresv->name) != NULL)
+		return;
+
+	if (tree_add_del(sinfo->resresv_index, resresv->name, resresv, TREE_OP_ADD) != 0) {
+		/* can't keep the index correct, fall back to linear searches */
+		undo_free_ptr(sinfo->undo, (void **) &sinfo->resresv_index,
+			(undo_func_t) free_name_index);
+	}
+	else
+		undo_call(sinfo->undo, unindex_resresv, resresv);
+}
+
+/**
+ * @brief
+ *		find the first vnode of a host using the host index.  The
+ *		other vnodes of the host are in the vnode's hostset.
+ *
+ * @param[in]	sinfo	-	server to search
+ * @param[in]	host	-	host to find
+ *
+ * @return	node_info *
+ * @retval	first vnode of the host (in the order the server reported them)
+ * @retval	NULL	: not found or no index
+ */
+node_info *
+find_node_by_host_index(server_info *sinfo, char *host)
+{
+	char hostbuf[PBS_MAXHOSTNAME + 1];
+
+	if (sinfo == NULL || host == NULL || sinfo->host_index == NULL)
+		return NULL;
+
+	if (!make_host_key(host, hostbuf))
+		return NULL;
+
+	return find_tree(sinfo->host_index, hostbuf);
+}
+
+/**
+ * @brief
+ *		free all the name indexes of a server
+ *
+ * @param[in]	sinfo	-	server whose indexes to free
+ *
+ * @return	void
+ */
+void
+free_server_indexes(server_info *sinfo)
+{
+	if (sinfo == NULL)
+		return;
+
+	free_name_index(sinfo->node_index);
+	sinfo->node_index = NULL;
+	free_name_index(sinfo->host_index);
+	sinfo->host_index = NULL;
+	free_name_index(sinfo->queue_index);
+	sinfo->queue_index = NULL;
+	free_name_index(sinfo->resresv_index);
+	sinfo->resresv_index = NULL;
+}
@@ -224,6 +224,11 @@ void free_resource_list(schd_resource *reslist);
  */
 void free_resource(schd_resource *resp);
 
+/*
+ *      free_res_ord_index - free the resdef ordinal index of a resource list
+ */
+void free_res_ord_index(schd_resource *reslist);
+
 /*
  *      update_server_on_end - update a server structure when a job has
  *                             finished running
@@ -263,6 +268,11 @@ counts *dup_counts(counts *octs);
  */
 counts *dup_counts_list(counts *ctslist);
 
+/*
+ *      index_counts_list - index a counts list by entity name
+ */
+int index_counts_list(counts *ctslist);
+
 /*
  *      find_counts - find a counts structure by name
  */
@@ -274,6 +284,19 @@ counts *find_counts(counts *ctslist, char *name);
  */
 counts *find_alloc_counts(counts *ctslist, char *name);
 
+/*
+ *      find_counts_undo - find_counts() for a counts structure about to be
+ *                         updated.  It is saved in the undo log.
+ */
+counts *find_counts_undo(undo_log *ul, counts *ctslist, char *name);
+
+/*
+ *      find_alloc_counts_undo - find_alloc_counts() for a counts list about
+ *                               to be updated.  Changes are recorded in the
+ *                               undo log.
+ */
+counts *find_alloc_counts_undo(undo_log *ul, counts **ctslist, char *name);
+
 /*
  *      update_counts_on_run - update a counts struct on the running of a job
  */
@@ -475,6 +498,24 @@ int compare_resource_avail(schd_resource *r1, schd_resource *r2);
 
 node_info **dup_unordered_nodes(node_info **old_unordered_nodes, node_info **nnodes);
 
+/* create the node name and host indexes of a server */
+int index_server_nodes(server_info *sinfo);
+
+/* create the queue name index of a server */
+int index_server_queues(server_info *sinfo);
+
+/* create the job and reservation name index of a server */
+int index_server_resresvs(server_info *sinfo);
+
+/* add a job or reservation created mid-cycle to the server's name index */
+void add_resresv_to_index(server_info *sinfo, resource_resv *resresv);
+
+/* find the first vnode of a host using the server's host index */
+node_info *find_node_by_host_index(server_info *sinfo, char *host);
+
+/* free all the name indexes of a server */
+void free_server_indexes(server_info *sinfo);
+
 
 
 #ifdef	__cplusplus
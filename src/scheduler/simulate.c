@@ -53,9 +53,17 @@
  * 	find_prev_timed_event()
  * 	set_timed_event_disabled()
  * 	find_timed_event()
+ * 	find_calendar_event()
  * 	perform_event()
  * 	exists_run_event()
  * 	calc_run_time()
+ * 	node_free_amount()
+ * 	count_node_chunks()
+ * 	new_node_res_profile()
+ * 	update_node_res_profile()
+ * 	update_node_res_profile_events()
+ * 	node_res_profile_fits()
+ * 	free_node_res_profile()
  * 	create_event_list()
  * 	create_events()
  * 	new_event_list()
@@ -107,6 +115,8 @@
 #include "globals.h"
 #include "check.h"
 #include "buckets.h"
+#include "resource.h"
+#include "undo_log.h"
 #ifdef NAS /* localmod 030 */
 #include "site_code.h"
 #endif /* localmod 030 */
@@ -130,6 +140,636 @@ static const struct policy_change_func_name policy_change_func_name[] =
 	{NULL, NULL}
 };
 
+/* highest level of an event time index - 4^16 distinct times is plenty */
+#define EVENT_INDEX_MAX_LEVEL 16
+
+/** @struct	event_time_node
+ *
+ * @brief
+ * 		one distinct time in a calendar along with the span of
+ * 		calendar events which happen at that time
+ */
+struct event_time_node
+{
+	time_t event_time;
+	timed_event *first;		/* [reference] first event at event_time */
+	timed_event *last;		/* [reference] last event at event_time */
+	struct event_time_node *forward[1];	/* skip list links - sized to node's level */
+};
+
+/** @struct	event_time_index
+ *
+ * @brief
+ * 		skip list of the distinct event times of a calendar.  It lets us
+ * 		find where an event belongs without walking the whole calendar.
+ */
+struct event_time_index
+{
+	int level;			/* highest level in use */
+	unsigned int seed;		/* state to pick the level of new nodes */
+	struct event_time_node *head;	/* sentinel of EVENT_INDEX_MAX_LEVEL levels */
+};
+
+static int add_resresv_events(event_list *elist, server_info *sinfo);
+
+/**
+ * @brief
+ * 		event_time_node constructor
+ *
+ * @param[in]	event_time - time of the node
+ * @param[in]	level      - number of skip list levels the node is in
+ *
+ * @return	new node
+ * @retval	NULL	: malloc failed
+ */
+static struct event_time_node *
+new_event_time_node(time_t event_time, int level)
+{
+	struct event_time_node *etn;
+
+	etn = malloc(sizeof(struct event_time_node) +
+		(level - 1) * sizeof(struct event_time_node *));
+	if (etn == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	etn->event_time = event_time;
+	etn->first = NULL;
+	etn->last = NULL;
+	memset(etn->forward, 0, level * sizeof(struct event_time_node *));
+
+	return etn;
+}
+
+/**
+ * @brief
+ * 		event_time_index constructor
+ *
+ * @return	new empty index
+ * @retval	NULL	: malloc failed
+ */
+static struct event_time_index *
+new_event_time_index(void)
+{
+	struct event_time_index *eti;
+
+	if ((eti = malloc(sizeof(struct event_time_index))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	eti->head = new_event_time_node(0, EVENT_INDEX_MAX_LEVEL);
+	if (eti->head == NULL) {
+		free(eti);
+		return NULL;
+	}
+	eti->level = 1;
+	eti->seed = 0x9e3779b9;
+
+	return eti;
+}
+
+/**
+ * @brief
+ * 		event_time_index destructor
+ *
+ * @param[in]	eti	-	index to free
+ */
+static void
+free_event_time_index(struct event_time_index *eti)
+{
+	struct event_time_node *etn;
+	struct event_time_node *etn_next;
+
+	if (eti == NULL)
+		return;
+
+	for (etn = eti->head; etn != NULL; etn = etn_next) {
+		etn_next = etn->forward[0];
+		free(etn);
+	}
+	free(eti);
+}
+
+/**
+ * @brief
+ * 		search an event time index for a time
+ *
+ * @param[in]	eti        - index to search
+ * @param[in]	event_time - time to search for
+ * @param[out]	update     - if not NULL, filled with the last node before
+ *			     event_time on each level in use
+ *
+ * @return	the node for event_time
+ * @retval	NULL	: there are no events at event_time
+ */
+static struct event_time_node *
+search_event_time_index(struct event_time_index *eti, time_t event_time,
+	struct event_time_node **update)
+{
+	struct event_time_node *etn;
+	int i;
+
+	etn = eti->head;
+	for (i = eti->level - 1; i >= 0; i--) {
+		while (etn->forward[i] != NULL && etn->forward[i]->event_time < event_time)
+			etn = etn->forward[i];
+		if (update != NULL)
+			update[i] = etn;
+	}
+
+	etn = etn->forward[0];
+	if (etn != NULL && etn->event_time == event_time)
+		return etn;
+
+	return NULL;
+}
+
+/**
+ * @brief
+ * 		insert a node for a new time into an event time index
+ *
+ * @param[in]	eti        - index to insert into
+ * @param[in]	event_time - time of the new node
+ * @param[in]	update     - predecessors filled by search_event_time_index()
+ *
+ * @return	the new node
+ * @retval	NULL	: malloc failed
+ */
+static struct event_time_node *
+insert_event_time_node(struct event_time_index *eti, time_t event_time,
+	struct event_time_node **update)
+{
+	struct event_time_node *etn;
+	unsigned int r;
+	int level = 1;
+	int i;
+
+	/* xorshift - each level is a quarter the size of the one below it */
+	eti->seed ^= eti->seed << 13;
+	eti->seed ^= eti->seed >> 17;
+	eti->seed ^= eti->seed << 5;
+	for (r = eti->seed; (r & 3) == 0 && level < EVENT_INDEX_MAX_LEVEL; r >>= 2)
+		level++;
+
+	if ((etn = new_event_time_node(event_time, level)) == NULL)
+		return NULL;
+
+	for (i = eti->level; i < level; i++)
+		update[i] = eti->head;
+	if (level > eti->level)
+		eti->level = level;
+
+	for (i = 0; i < level; i++) {
+		etn->forward[i] = update[i]->forward[i];
+		update[i]->forward[i] = etn;
+	}
+
+	return etn;
+}
+
+/**
+ * @brief
+ * 		remove and free a node of an event time index
+ *
+ * @param[in]	eti    - index to remove from
+ * @param[in]	etn    - node to remove
+ * @param[in]	update - predecessors filled by search_event_time_index()
+ */
+static void
+remove_event_time_node(struct event_time_index *eti, struct event_time_node *etn,
+	struct event_time_node **update)
+{
+	int i;
+
+	for (i = 0; i < eti->level && update[i]->forward[i] == etn; i++)
+		update[i]->forward[i] = etn->forward[i];
+
+	while (eti->level > 1 && eti->head->forward[eti->level - 1] == NULL)
+		eti->level--;
+
+	free(etn);
+}
+
+/**
+ * @brief
+ * 		add an event to a calendar's name index.  The index maps an
+ *		event name to a te_list of all events with that name.
+ *
+ * @param[in]	calendar - calendar whose name index to add to
+ * @param[in]	te       - event to add
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+static int
+add_event_name_index(event_list *calendar, timed_event *te)
+{
+	AVL_IX_DESC *name_index = calendar->name_index;
+	te_list *head;
+	te_list *tel;
+	size_t len;
+
+	if (te->name == NULL)
+		return 1;
+
+	if ((tel = new_te_list()) == NULL)
+		return 0;
+	tel->event = te;
+
+	/* keep the head in place so the tree entry doesn't need to change */
+	head = find_tree(name_index, te->name);
+	if (head != NULL) {
+		tel->next = head->next;
+		head->next = tel;
+	} else if (tree_add_del(name_index, te->name, tel, TREE_OP_ADD) != 0) {
+		free(tel);
+		return 0;
+	}
+
+	if ((len = strlen(te->name)) > calendar->name_keylen)
+		calendar->name_keylen = len;
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		remove an event from a calendar's name index
+ *
+ * @param[in]	name_index - name index to remove from
+ * @param[in]	te         - event to remove
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: failure
+ */
+static int
+remove_event_name_index(AVL_IX_DESC *name_index, timed_event *te)
+{
+	te_list *head;
+	te_list *tel;
+	te_list *prev_tel = NULL;
+
+	if (te->name == NULL)
+		return 1;
+
+	if ((head = find_tree(name_index, te->name)) == NULL)
+		return 0;
+
+	for (tel = head; tel != NULL && tel->event != te; prev_tel = tel, tel = tel->next)
+		;
+	if (tel == NULL)
+		return 0;
+
+	if (prev_tel != NULL) {
+		prev_tel->next = tel->next;
+		free(tel);
+		return 1;
+	}
+
+	/* removing the head - the tree entry moves to the next te_list */
+	if (tree_add_del(name_index, te->name, NULL, TREE_OP_DEL) != 0)
+		return 0;
+	if (head->next != NULL &&
+		tree_add_del(name_index, te->name, head->next, TREE_OP_ADD) != 0) {
+		head->next = NULL;
+		free(head);
+		return 0;
+	}
+	free(head);
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		free the indexes of a calendar.  The calendar falls back to
+ *		walking the list of events for all of its operations.
+ *
+ * @param[in]	calendar - calendar whose indexes to free
+ */
+static void
+free_event_list_index(event_list *calendar)
+{
+	AVL_IX_REC *pe;
+
+	if (calendar->name_index != NULL) {
+		/* The event names belong to the jobs and reservations, which may
+		 * already be freed.  Walk the index itself rather than the events.
+		 * avl_next_key() copies each key into pe, so size it for the
+		 * longest name in the index.
+		 */
+		if ((pe = calloc(1, sizeof(AVL_IX_REC) + calendar->name_keylen + 1)) != NULL) {
+			avl_first_key(calendar->name_index);
+			while (avl_next_key(pe, calendar->name_index) == AVL_IX_OK)
+				free_te_list(pe->recptr);
+			free(pe);
+		}
+		avl_destroy_index(calendar->name_index);
+		free(calendar->name_index);
+		calendar->name_index = NULL;
+	}
+	calendar->name_keylen = 0;
+
+	free_event_time_index(calendar->time_index);
+	calendar->time_index = NULL;
+}
+
+/**
+ * @brief
+ * 		link an event into a calendar's sorted list of events using
+ *		the calendar's time index.  All end events at a time come first.
+ *
+ * @param[in]	calendar - calendar with a time index
+ * @param[in]	te       - event to link in
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: malloc failed - calendar is not modified
+ */
+static int
+link_indexed_event(event_list *calendar, timed_event *te)
+{
+	struct event_time_node *update[EVENT_INDEX_MAX_LEVEL];
+	struct event_time_node *etn;
+	timed_event *before = NULL;	/* te goes right before this event */
+	timed_event *after = NULL;	/* te goes right after this event */
+
+	etn = search_event_time_index(calendar->time_index, te->event_time, update);
+	if (etn != NULL) {
+		if (te->event_type == TIMED_END_EVENT) {
+			before = etn->first;
+			etn->first = te;
+		} else {
+			after = etn->last;
+			etn->last = te;
+		}
+	} else {
+		etn = insert_event_time_node(calendar->time_index, te->event_time, update);
+		if (etn == NULL)
+			return 0;
+		etn->first = te;
+		etn->last = te;
+		/* update[0] is the latest time before ours or the sentinel */
+		if (update[0] != calendar->time_index->head)
+			after = update[0]->last;
+		else
+			before = calendar->events;
+	}
+
+	if (after != NULL) {
+		te->prev = after;
+		te->next = after->next;
+		if (after->next != NULL)
+			after->next->prev = te;
+		after->next = te;
+	} else {
+		te->prev = NULL;
+		te->next = before;
+		if (before != NULL) {
+			te->prev = before->prev;
+			if (before->prev != NULL)
+				before->prev->next = te;
+			before->prev = te;
+		}
+		if (te->prev == NULL)
+			calendar->events = te;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		unlink an event from a calendar with a time index
+ *
+ * @param[in]	calendar - calendar with a time index
+ * @param[in]	te       - event to unlink
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: te is not in the calendar
+ */
+static int
+unlink_indexed_event(event_list *calendar, timed_event *te)
+{
+	struct event_time_node *update[EVENT_INDEX_MAX_LEVEL];
+	struct event_time_node *etn;
+	timed_event *cur_e;
+
+	etn = search_event_time_index(calendar->time_index, te->event_time, update);
+	if (etn == NULL)
+		return 0;
+
+	/* make sure te is really ours before touching the list */
+	for (cur_e = etn->first; cur_e != te && cur_e != etn->last; cur_e = cur_e->next)
+		;
+	if (cur_e != te)
+		return 0;
+
+	if (etn->first == te && etn->last == te)
+		remove_event_time_node(calendar->time_index, etn, update);
+	else if (etn->first == te)
+		etn->first = te->next;
+	else if (etn->last == te)
+		etn->last = te->prev;
+
+	if (te->prev != NULL)
+		te->prev->next = te->next;
+	else
+		calendar->events = te->next;
+	if (te->next != NULL)
+		te->next->prev = te->prev;
+
+	te->next = NULL;
+	te->prev = NULL;
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		index the events of a calendar by time and by name.  If the
+ *		indexes can't be created, the calendar works without them.
+ *
+ * @param[in]	calendar - calendar to index
+ *
+ * @return	int
+ * @retval	1	: calendar is indexed
+ * @retval	0	: calendar is not indexed
+ */
+static int
+index_event_list(event_list *calendar)
+{
+	struct event_time_node *update[EVENT_INDEX_MAX_LEVEL];
+	struct event_time_node *etn = NULL;
+	timed_event *te;
+	timed_event *prev_te = NULL;
+	int i;
+
+	free_event_list_index(calendar);
+
+	if ((calendar->time_index = new_event_time_index()) == NULL)
+		return 0;
+	if ((calendar->name_index = create_tree(AVL_NO_DUP_KEYS, 0)) == NULL) {
+		free_event_list_index(calendar);
+		return 0;
+	}
+
+	/* the list is already sorted, so each new time goes on the end */
+	for (i = 0; i < EVENT_INDEX_MAX_LEVEL; i++)
+		update[i] = calendar->time_index->head;
+
+	for (te = calendar->events; te != NULL; prev_te = te, te = te->next) {
+		te->prev = prev_te;
+		if (etn == NULL || etn->event_time != te->event_time) {
+			etn = insert_event_time_node(calendar->time_index, te->event_time, update);
+			if (etn == NULL) {
+				free_event_list_index(calendar);
+				return 0;
+			}
+			for (i = 0; i < calendar->time_index->level && update[i]->forward[i] == etn; i++)
+				update[i] = etn;
+			etn->first = te;
+		}
+		etn->last = te;
+
+		if (add_event_name_index(calendar, te) == 0) {
+			free_event_list_index(calendar);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		start recording the changes to the events of a calendar whose
+ *		server has an undo log.  The indexes are put aside until the
+ *		changes are undone, and the simulation walks the list of events
+ *		instead.  Only the events which are relinked need to be saved.
+ *
+ * @param[in]	calendar - calendar about to be changed
+ *
+ * @return	undo_log *
+ * @retval	the undo log to record the changes in
+ * @retval	NULL	: the changes aren't recorded
+ */
+static undo_log *
+undo_calendar(event_list *calendar)
+{
+	undo_log *ul;
+
+	if (calendar->server == NULL || (ul = calendar->server->undo) == NULL)
+		return NULL;
+
+	if (undo_is_new(ul, calendar))
+		return NULL;
+
+	undo_save(ul, calendar, sizeof(event_list));
+	calendar->time_index = NULL;
+	calendar->name_index = NULL;
+
+	return ul;
+}
+
+/**
+ * @brief
+ * 		find where an event goes in a sorted list of events.
+ *		All end events at a time come first.
+ *
+ * @param[in]	events - sorted list of events
+ * @param[in]	te     - event to add
+ *
+ * @return	timed_event *
+ * @retval	the event te goes right after
+ * @retval	NULL	: te goes at the head of the list
+ */
+static timed_event *
+find_event_insert_point(timed_event *events, timed_event *te)
+{
+	timed_event *eloop;
+	timed_event *eloop_prev = NULL;
+
+	for (eloop = events; eloop != NULL; eloop = eloop->next) {
+		if (eloop->event_time > te->event_time)
+			break;
+		if (eloop->event_time == te->event_time &&
+			te->event_type == TIMED_END_EVENT) {
+			break;
+		}
+
+		eloop_prev = eloop;
+	}
+
+	return eloop_prev;
+}
+
+/**
+ * @brief
+ * 		link an event into the sorted list of events of a calendar.
+ *		The calendar's indexes are used and kept up to date if it has them.
+ *
+ * @param[in]	calendar - calendar to link into
+ * @param[in]	te       - event to link in
+ */
+static void
+link_event(event_list *calendar, timed_event *te)
+{
+	undo_log *ul;
+	timed_event *prev_te;
+
+	if ((ul = undo_calendar(calendar)) != NULL) {
+		undo_new(ul, te, (undo_func_t) free_timed_event);
+		prev_te = find_event_insert_point(calendar->events, te);
+		if (prev_te != NULL) {
+			undo_save(ul, prev_te, sizeof(timed_event));
+			if (prev_te->next != NULL)
+				undo_save(ul, prev_te->next, sizeof(timed_event));
+		} else if (calendar->events != NULL)
+			undo_save(ul, calendar->events, sizeof(timed_event));
+	}
+
+	if (calendar->time_index != NULL && link_indexed_event(calendar, te)) {
+		if (add_event_name_index(calendar, te) == 0)
+			free_event_list_index(calendar);
+		return;
+	}
+
+	free_event_list_index(calendar);
+	calendar->events = add_timed_event(calendar->events, te);
+}
+
+/**
+ * @brief
+ * 		is an event at or after another event in calendar order
+ *
+ * @param[in]	te  - event to check
+ * @param[in]	ref - reference event
+ *
+ * @return	int
+ * @retval	1	: te is ref or comes after it
+ * @retval	0	: te comes before ref
+ */
+static int
+is_event_at_or_after(timed_event *te, timed_event *ref)
+{
+	timed_event *cur_e;
+
+	if (te->event_time != ref->event_time)
+		return te->event_time > ref->event_time;
+
+	for (cur_e = ref; cur_e != NULL && cur_e->event_time == ref->event_time; cur_e = cur_e->next)
+		if (cur_e == te)
+			return 1;
+
+	return 0;
+}
+
 
 /**
  * @brief
@@ -171,6 +811,10 @@ simulate_events(status *policy, server_info *sinfo,
 
 	calendar = sinfo->calendar;
 
+	/* the policy is changed by prime and dedicated time events */
+	undo_save(sinfo->undo, calendar->current_time, sizeof(time_t));
+	undo_save(sinfo->undo, sinfo->policy, sizeof(status));
+
 	event = next_event(sinfo, DONT_ADVANCE);
 
 	if (event == NULL)
@@ -294,6 +938,7 @@ next_event(server_info *sinfo, int advance)
 		return NULL;
 
 	calendar = sinfo->calendar;
+	undo_calendar(calendar);
 
 	if (advance)
 		te = find_next_timed_event(calendar->next_event,
@@ -519,7 +1164,56 @@ find_timed_event(timed_event *te_list, char *name,
 			break;
 	}
 
-	return te;
+	return te;
+}
+
+/**
+ * @brief
+ * 		find an event in a calendar.  If the calendar is indexed, the
+ *		events with the name are looked up instead of walking the calendar.
+ *
+ * @param[in]	calendar   - calendar to search in
+ * @param[in]	start      - event to start the search at or NULL for the
+ *			     start of the calendar
+ * @param[in]	name       - name of timed_event to search or NULL to ignore
+ * @param[in]	event_type - event_type or TIMED_NOEVENT to ignore
+ * @param[in]	event_time - time or 0 to ignore
+ *
+ * @return	first matching timed_event at or after start
+ * @retval	NULL	: no event found
+ */
+timed_event *
+find_calendar_event(event_list *calendar, timed_event *start, char *name,
+	enum timed_event_types event_type, time_t event_time)
+{
+	te_list *tel;
+	timed_event *te;
+	timed_event *found = NULL;
+
+	if (calendar == NULL)
+		return NULL;
+
+	if (start == NULL)
+		start = calendar->events;
+	if (start == NULL)
+		return NULL;
+
+	if (name == NULL || calendar->name_index == NULL)
+		return find_timed_event(start, name, event_type, event_time);
+
+	for (tel = find_tree(calendar->name_index, name); tel != NULL; tel = tel->next) {
+		te = tel->event;
+		if (event_type != TIMED_NOEVENT && te->event_type != event_type)
+			continue;
+		if (event_time != 0 && te->event_time != event_time)
+			continue;
+		if (!is_event_at_or_after(te, start))
+			continue;
+		if (found == NULL || is_event_at_or_after(found, te))
+			found = te;
+	}
+
+	return found;
 }
 /**
  * @brief
@@ -708,6 +1402,8 @@ calc_run_time(char *name, server_info *sinfo, int flags)
 	nspec **ns = NULL;
 	unsigned int ok_flags = NO_ALLPART;
 	queue_info *qinfo = NULL;
+	node_res_profile *nrp = NULL;
+	timed_event *te;
 
 	if (name == NULL || sinfo == NULL)
 		return (time_t) -1;
@@ -731,6 +1427,12 @@ calc_run_time(char *name, server_info *sinfo, int flags)
 	if(err == NULL)
 		return (time_t) 0;
 
+	/* The bucket code path tracks node usage on its own, so only the
+	 * node by node search is screened by the summed free resources
+	 */
+	if (resresv->is_job && resresv->job->resv == NULL && !(ok_flags & USE_BUCKETS))
+		nrp = new_node_res_profile(sinfo, resresv);
+
 	do {
 		/* policy is used from sinfo instead of being passed into calc_run_time()
 		 * because it's being simulated/updated in simulate_events()
@@ -739,11 +1441,15 @@ calc_run_time(char *name, server_info *sinfo, int flags)
 		desc = describe_simret(ret);
 		if (desc > 0 || (desc == 0 && policy_change_info(sinfo, resresv))) {
 			clear_schd_error(err);
-			ns = is_ok_to_run(sinfo->policy, sinfo, qinfo, resresv, ok_flags, err);
+			if (node_res_profile_fits(nrp, err))
+				ns = is_ok_to_run(sinfo->policy, sinfo, qinfo, resresv, ok_flags, err);
 		}
 
-		if (ns == NULL) /* event can not run */
+		if (ns == NULL) { /* event can not run */
+			te = get_next_event(calendar);
 			ret = simulate_events(sinfo->policy, sinfo, SIM_NEXT_EVENT, &(sinfo->opt_backfill_fuzzy_time), &event_time);
+			update_node_res_profile_events(nrp, te, get_next_event(calendar));
+		}
 
 #ifdef NAS /* localmod 030 */
 		if (check_for_cycle_interrupt(0)) {
@@ -752,6 +1458,8 @@ calc_run_time(char *name, server_info *sinfo, int flags)
 #endif /* localmod 030 */
 	} while (ns == NULL && !(ret & (TIMED_NOEVENT|TIMED_ERROR)));
 
+	free_node_res_profile(nrp);
+
 #ifdef NAS /* localmod 030 */
 	if (check_for_cycle_interrupt(0) || (ret & TIMED_ERROR)) {
 #else
@@ -809,6 +1517,383 @@ calc_run_time(char *name, server_info *sinfo, int flags)
 	return event_time;
 }
 
+/**
+ * @brief
+ * 		the free amount of a consumable resource on a node
+ *
+ * @param[in]	node	-	the node
+ * @param[in]	def	-	the resource
+ *
+ * @return	sch_resource_t
+ * @retval	free amount of the resource
+ * @retval	SCHD_INFINITY	: the resource is unset, infinite or indirect
+ *
+ */
+sch_resource_t
+node_free_amount(node_info *node, resdef *def)
+{
+	schd_resource *res;
+
+	if (node == NULL || def == NULL)
+		return SCHD_INFINITY;
+
+	res = find_resource(node->res, def);
+	if (res == NULL || res->orig_str_avail == NULL ||
+		res->indirect_vnode_name != NULL || res->indirect_res != NULL)
+		return SCHD_INFINITY;
+
+	return dynamic_avail(res);
+}
+
+/**
+ * @brief
+ * 		count how many of a chunk fit into a node's free resources
+ *		as recorded in a node_res_profile
+ *
+ * @param[in]	nrp	-	the profile
+ * @param[in]	ind	-	node_ind of the node
+ * @param[in]	chk	-	the chunk
+ *
+ * @return	long long
+ * @retval	number of chunks
+ * @retval	-1	: none of the chunk's resources are checked
+ *
+ */
+static long long
+count_node_chunks(node_res_profile *nrp, int ind, chunk *chk)
+{
+	resource_req *req;
+	long long num = -1;
+	long long n;
+	int j;
+
+	for (req = chk->req; req != NULL; req = req->next) {
+		for (j = 0; j < nrp->num_res && nrp->defs[j] != req->def; j++)
+			;
+		if (j == nrp->num_res || nrp->need[j] == 0 || req->amount <= 0)
+			continue;
+
+		n = (long long) (nrp->node_free[ind * nrp->num_res + j] / req->amount);
+		if (num == -1 || n < num)
+			num = n;
+	}
+
+	return num;
+}
+
+/**
+ * @brief
+ * 		build a node_res_profile for a job: the free amounts of the
+ *		consumable resources it requests summed over all the server's nodes
+ *		and, if no host has more than one vnode, how many of each of its
+ *		chunks the nodes can hold.
+ *
+ * @par
+ *		A job can not run unless the sums cover its request and the
+ *		nodes can hold each of its chunks, so while calc_run_time() simulates
+ *		the calendar the profile tells it when calling is_ok_to_run() is
+ *		pointless.  Resources which are unbounded on any node are not checked.
+ *
+ * @param[in]	sinfo	-	the server
+ * @param[in]	resresv	-	the job
+ *
+ * @return	node_res_profile *
+ * @retval	the profile
+ * @retval	NULL	: no resources to check or on error
+ *
+ */
+node_res_profile *
+new_node_res_profile(server_info *sinfo, resource_resv *resresv)
+{
+	node_res_profile *nrp;
+	resource_req *req;
+	resdef **checklist;
+	int num_checked = 0;
+	int i, j, k;
+
+	if (sinfo == NULL || resresv == NULL || resresv->select == NULL ||
+		resresv->select->chunks == NULL || sinfo->unordered_nodes == NULL ||
+		sinfo->policy == NULL || sinfo->policy->resdef_to_check == NULL)
+		return NULL;
+
+	checklist = sinfo->policy->resdef_to_check;
+
+	if ((nrp = calloc(1, sizeof(node_res_profile))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	nrp->nodes = sinfo->unordered_nodes;
+	nrp->num_nodes = count_array((void **) sinfo->unordered_nodes);
+	nrp->chunks = resresv->select->chunks;
+	k = count_array((void **) checklist);
+
+	nrp->defs = calloc(k + 1, sizeof(resdef *));
+	nrp->need = calloc(k + 1, sizeof(sch_resource_t));
+	nrp->total = calloc(k + 1, sizeof(sch_resource_t));
+	if (nrp->defs == NULL || nrp->need == NULL || nrp->total == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free_node_res_profile(nrp);
+		return NULL;
+	}
+
+	/* float resources are left out so the sums stay exact */
+	for (i = 0; nrp->chunks[i] != NULL; i++) {
+		for (req = nrp->chunks[i]->req; req != NULL; req = req->next) {
+			if (!req->type.is_consumable || req->type.is_float ||
+				req->amount <= 0 || !resdef_exists_in_array(checklist, req->def))
+				continue;
+
+			for (j = 0; j < nrp->num_res && nrp->defs[j] != req->def; j++)
+				;
+			if (j == nrp->num_res) {
+				if (j == k)
+					continue;
+				nrp->defs[j] = req->def;
+				nrp->num_res++;
+			}
+			nrp->need[j] += req->amount * nrp->chunks[i]->num_chunks;
+		}
+	}
+
+	if (nrp->num_res == 0 || nrp->num_nodes == 0) {
+		free_node_res_profile(nrp);
+		return NULL;
+	}
+
+	nrp->node_free = calloc(nrp->num_nodes * nrp->num_res, sizeof(sch_resource_t));
+	if (nrp->node_free == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free_node_res_profile(nrp);
+		return NULL;
+	}
+
+	for (j = 0; j < nrp->num_res; j++) {
+		for (i = 0; i < nrp->num_nodes; i++) {
+			sch_resource_t amount;
+
+			amount = node_free_amount(nrp->nodes[i], nrp->defs[j]);
+			if (amount == SCHD_INFINITY) {
+				nrp->need[j] = 0;
+				break;
+			}
+			nrp->node_free[i * nrp->num_res + j] = amount;
+			nrp->total[j] += amount;
+		}
+		if (nrp->need[j] > 0)
+			num_checked++;
+	}
+
+	if (num_checked == 0) {
+		free_node_res_profile(nrp);
+		return NULL;
+	}
+
+	/* a chunk can only be broken across the vnodes of a multi-vnoded host */
+	if (!sinfo->has_multi_vnode) {
+		nrp->num_chunks = count_array((void **) nrp->chunks);
+		nrp->chunk_total = calloc(nrp->num_chunks, sizeof(long long));
+		nrp->node_chunks = calloc(nrp->num_nodes * nrp->num_chunks, sizeof(long long));
+		if (nrp->chunk_total == NULL || nrp->node_chunks == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			free_node_res_profile(nrp);
+			return NULL;
+		}
+
+		for (k = 0; k < nrp->num_chunks; k++) {
+			for (i = 0; i < nrp->num_nodes; i++) {
+				long long n;
+
+				n = count_node_chunks(nrp, i, nrp->chunks[k]);
+				if (n == -1) {
+					nrp->chunk_total[k] = -1;
+					break;
+				}
+				nrp->node_chunks[i * nrp->num_chunks + k] = n;
+				nrp->chunk_total[k] += n;
+			}
+		}
+	}
+
+	return nrp;
+}
+
+/**
+ * @brief
+ * 		refresh a node's contribution to a node_res_profile
+ *
+ * @param[in,out]	nrp	-	the profile
+ * @param[in]	node	-	the node (any copy of it - the server's node
+ *				with the same node_ind is read)
+ *
+ * @return	void
+ *
+ */
+void
+update_node_res_profile(node_res_profile *nrp, node_info *node)
+{
+	node_info *snode;
+	int ind;
+	int j;
+
+	if (nrp == NULL || node == NULL)
+		return;
+
+	ind = node->node_ind;
+	if (ind < 0 || ind >= nrp->num_nodes)
+		return;
+
+	snode = nrp->nodes[ind];
+
+	for (j = 0; j < nrp->num_res; j++) {
+		sch_resource_t *node_free;
+		sch_resource_t amount;
+
+		if (nrp->need[j] == 0)
+			continue;
+
+		node_free = &nrp->node_free[ind * nrp->num_res + j];
+		amount = node_free_amount(snode, nrp->defs[j]);
+		if (amount == SCHD_INFINITY) {
+			/* can't happen in a simulation, but don't trust the profile */
+			nrp->num_res = 0;
+			nrp->num_chunks = 0;
+			return;
+		}
+		nrp->total[j] += amount - *node_free;
+		*node_free = amount;
+	}
+
+	for (j = 0; j < nrp->num_chunks; j++) {
+		long long *node_chunks;
+		long long n;
+
+		if (nrp->chunk_total[j] == -1)
+			continue;
+
+		node_chunks = &nrp->node_chunks[ind * nrp->num_chunks + j];
+		n = count_node_chunks(nrp, ind, nrp->chunks[j]);
+		nrp->chunk_total[j] += n - *node_chunks;
+		*node_chunks = n;
+	}
+}
+
+/**
+ * @brief
+ * 		refresh a node_res_profile after events have been simulated.
+ *		Only run and end events change the resources on nodes, and only
+ *		on the nodes of the event's resresv.
+ *
+ * @param[in,out]	nrp	-	the profile
+ * @param[in]	from	-	the first event performed
+ * @param[in]	to	-	the first event not performed (NULL: end of calendar)
+ *
+ * @return	void
+ *
+ */
+void
+update_node_res_profile_events(node_res_profile *nrp, timed_event *from, timed_event *to)
+{
+	timed_event *te;
+	resource_resv *resresv;
+	int i;
+
+	if (nrp == NULL)
+		return;
+
+	for (te = from; te != NULL && te != to; te = te->next) {
+		if (te->event_type != TIMED_RUN_EVENT && te->event_type != TIMED_END_EVENT)
+			continue;
+
+		resresv = (resource_resv *) te->event_ptr;
+		if (resresv == NULL)
+			continue;
+
+		if (resresv->ninfo_arr != NULL) {
+			for (i = 0; resresv->ninfo_arr[i] != NULL; i++)
+				update_node_res_profile(nrp, resresv->ninfo_arr[i]);
+		}
+		if (resresv->nspec_arr != NULL) {
+			for (i = 0; resresv->nspec_arr[i] != NULL; i++)
+				update_node_res_profile(nrp, resresv->nspec_arr[i]->ninfo);
+		}
+	}
+}
+
+/**
+ * @brief
+ * 		check if the free resources in a node_res_profile can hold the
+ *		job's request
+ *
+ * @param[in]	nrp	-	the profile
+ * @param[out]	err	-	why the job can not fit
+ *
+ * @return	int
+ * @retval	1	: the job might fit
+ * @retval	0	: the job can not fit
+ *
+ */
+int
+node_res_profile_fits(node_res_profile *nrp, schd_error *err)
+{
+	char reqbuf[MAX_LOG_SIZE];
+	char availbuf[MAX_LOG_SIZE];
+	char buf[(MAX_LOG_SIZE * 2) + 16];
+	int j;
+
+	if (nrp == NULL)
+		return 1;
+
+	for (j = 0; j < nrp->num_res; j++) {
+		if (nrp->need[j] > 0 && nrp->total[j] < nrp->need[j]) {
+			if (err != NULL) {
+				set_schd_error_codes(err, NOT_RUN, INSUFFICIENT_RESOURCE);
+				err->rdef = nrp->defs[j];
+				res_to_str_c(nrp->need[j], nrp->defs[j], RF_REQUEST, reqbuf, sizeof(reqbuf));
+				res_to_str_c(nrp->total[j], nrp->defs[j], RF_AVAIL, availbuf, sizeof(availbuf));
+				snprintf(buf, sizeof(buf), "(R: %s A: %s)", reqbuf, availbuf);
+				set_schd_error_arg(err, ARG1, buf);
+			}
+			return 0;
+		}
+	}
+
+	for (j = 0; j < nrp->num_chunks; j++) {
+		if (nrp->chunk_total[j] != -1 &&
+			nrp->chunk_total[j] < nrp->chunks[j]->num_chunks) {
+			if (err != NULL)
+				set_schd_error_codes(err, NOT_RUN, NO_NODE_RESOURCES);
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+ * @brief
+ * 		free a node_res_profile
+ *
+ * @param[in]	nrp	-	the profile to free
+ *
+ * @return	void
+ *
+ */
+void
+free_node_res_profile(node_res_profile *nrp)
+{
+	if (nrp == NULL)
+		return;
+
+	free(nrp->defs);
+	free(nrp->need);
+	free(nrp->total);
+	free(nrp->node_free);
+	free(nrp->chunk_total);
+	free(nrp->node_chunks);
+	free(nrp);
+}
+
 /**
  * @brief
  * 		create an event_list from running jobs and confirmed resvs
@@ -827,10 +1912,11 @@ create_event_list(server_info *sinfo)
 	if (elist == NULL)
 		return NULL;
 
-	elist->events = create_events(sinfo);
+	add_resresv_events(elist, sinfo);
 
 	elist->next_event = elist->events;
 	elist->current_time = &sinfo->server_time;
+	elist->server = sinfo;
 	add_dedtime_events(elist, sinfo->policy);
 
 	return elist;
@@ -838,18 +1924,19 @@ create_event_list(server_info *sinfo)
 
 /**
  * @brief
- *		create_events - creates an timed_event list from running jobs
- *			    and confirmed reservations
- *
- * @param[in] sinfo - server universe to act upon
+ *		add the events of running jobs, confirmed reservations and
+ *		sleeping nodes to an event list
  *
- * @return	timed_event list
+ * @param[in,out] elist - event list to add to
+ * @param[in]     sinfo - server universe to act upon
  *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: malloc error - events already added are freed
  */
-timed_event *
-create_events(server_info *sinfo)
+static int
+add_resresv_events(event_list *elist, server_info *sinfo)
 {
-	timed_event	*events = NULL;
 	timed_event	*te = NULL;
 	resource_resv	**all = NULL;
 	int		errflag = 0;
@@ -877,7 +1964,7 @@ create_events(server_info *sinfo)
 				errflag++;
 				break;
 			}
-			events = add_timed_event(events, te);
+			link_event(elist, te);
 		}
 
 		if (sinfo->use_hard_duration)
@@ -889,27 +1976,62 @@ create_events(server_info *sinfo)
 			errflag++;
 			break;
 		}
-		events = add_timed_event(events, te);
+		link_event(elist, te);
 	}
 
 	/* for nodes that are in state=sleep add a timed event */
-	for (i = 0; sinfo->nodes[i] != NULL; i++) {
+	for (i = 0; errflag == 0 && sinfo->nodes[i] != NULL; i++) {
 	        node_info *node = sinfo->nodes[i];
 		if (node->is_sleeping) {
 			te = create_event(TIMED_NODE_UP_EVENT, sinfo->server_time + PROVISION_DURATION,
 					(event_ptr_t *) node, (event_func_t) node_up_event, NULL);
-			if (te == NULL)
-				return 0;
-			events = add_timed_event(events, te);
+			if (te == NULL) {
+				errflag++;
+				break;
+			}
+			link_event(elist, te);
 		}
 	}
 
 	/* A malloc error was encountered, free all allocated memory and return */
 	if (errflag > 0) {
-		free_timed_event_list(events);
+		free_event_list_index(elist);
+		free_timed_event_list(elist->events);
+		elist->events = NULL;
+		index_event_list(elist);
 		return 0;
 	}
 
+	return 1;
+}
+
+/**
+ * @brief
+ *		create_events - creates an timed_event list from running jobs
+ *			    and confirmed reservations
+ *
+ * @param[in] sinfo - server universe to act upon
+ *
+ * @return	timed_event list
+ *
+ */
+timed_event *
+create_events(server_info *sinfo)
+{
+	event_list	*elist;
+	timed_event	*events = NULL;
+
+	if ((elist = new_event_list()) == NULL)
+		return NULL;
+
+	if (add_resresv_events(elist, sinfo)) {
+		/* hand the bare list back to the caller */
+		free_event_list_index(elist);
+		events = elist->events;
+		elist->events = NULL;
+	}
+	free_event_list(elist);
+
 	return events;
 }
 
@@ -934,6 +2056,13 @@ new_event_list()
 	elist->events = NULL;
 	elist->next_event = NULL;
 	elist->current_time = NULL;
+	elist->time_index = NULL;
+	elist->name_index = NULL;
+	elist->name_keylen = 0;
+	elist->server = NULL;
+
+	/* without an index the calendar still works, just slower */
+	index_event_list(elist);
 
 	return elist;
 }
@@ -963,17 +2092,20 @@ dup_event_list(event_list *oelist, server_info *nsinfo)
 
 	nelist->eol = oelist->eol;
 	nelist->current_time = &nsinfo->server_time;
+	nelist->server = nsinfo;
 
 	if (oelist->events != NULL) {
+		free_event_list_index(nelist);
 		nelist->events = dup_timed_event_list(oelist->events, nsinfo);
 		if (nelist->events == NULL) {
 			free_event_list(nelist);
 			return NULL;
 		}
+		index_event_list(nelist);
 	}
 
 	if (oelist->next_event != NULL) {
-		nelist->next_event = find_timed_event(nelist->events,
+		nelist->next_event = find_calendar_event(nelist, NULL,
 			oelist->next_event->name,
 			oelist->next_event->event_type,
 			oelist->next_event->event_time);
@@ -1001,6 +2133,7 @@ free_event_list(event_list *elist)
 	if (elist == NULL)
 		return;
 
+	free_event_list_index(elist);
 	free_timed_event_list(elist->events);
 	free(elist);
 }
@@ -1116,23 +2249,23 @@ free_te_list(te_list *tel) {
 /*
  * @brief te_list copy constructor
  * @param[in] ote - te_list to copy
- * @param[in] new_timed_even_list - new timed events
+ * @param[in] ncalendar - new calendar - events are searched from its next event
  * 
  * @return copied te_list
  */
 te_list *
-dup_te_list(te_list *ote, timed_event *new_timed_event_list)
+dup_te_list(te_list *ote, event_list *ncalendar)
 {
 	te_list *nte;
 
-	if(ote == NULL || new_timed_event_list == NULL)
+	if(ote == NULL || ncalendar == NULL || ncalendar->next_event == NULL)
 		return NULL;
 
 	nte = new_te_list();
 	if(nte == NULL)
 		return NULL;
 	
-	nte->event = find_timed_event(new_timed_event_list, ote->event->name, ote->event->event_type, ote->event->event_time);
+	nte->event = find_calendar_event(ncalendar, ncalendar->next_event, ote->event->name, ote->event->event_type, ote->event->event_time);
 	
 	return nte;
 }
@@ -1140,23 +2273,23 @@ dup_te_list(te_list *ote, timed_event *new_timed_event_list)
 /*
  * @brief copy constructor for a list of te_list structures
  * @param[in] ote - te_list to copy
- * @param[in] new_timed_even_list - new timed events
+ * @param[in] ncalendar - new calendar - events are searched from its next event
  * 
  * @return copied te_list list
  */
 
 te_list *
-dup_te_lists(te_list *ote, timed_event *new_timed_event_list) {
+dup_te_lists(te_list *ote, event_list *ncalendar) {
 	te_list *nte;
 	te_list *end_te = NULL;
 	te_list *cur;
 	te_list *nte_head = NULL;
 
-	if (ote == NULL || new_timed_event_list == NULL)
+	if (ote == NULL || ncalendar == NULL || ncalendar->next_event == NULL)
 		return NULL;
 	
 	for(cur = ote; cur != NULL; cur = cur->next) {
-		nte = dup_te_list(cur, new_timed_event_list);
+		nte = dup_te_list(cur, ncalendar);
 		if (nte == NULL) {
 			free_te_list(nte_head);
 			return NULL;
@@ -1171,6 +2304,39 @@ dup_te_lists(te_list *ote, timed_event *new_timed_event_list) {
 	return nte_head;
 }
 
+/*
+ * @brief copy a te_list of events in the same calendar
+ *
+ * @param[in] tel - te_list to copy
+ *
+ * @return te_list *
+ * @retval copied te_list
+ * @retval NULL on error
+ */
+te_list *
+copy_te_list(te_list *tel)
+{
+	te_list *ntel;
+	te_list *ntel_head = NULL;
+	te_list *end_tel = NULL;
+	te_list *cur;
+
+	for (cur = tel; cur != NULL; cur = cur->next) {
+		if ((ntel = new_te_list()) == NULL) {
+			free_te_list(ntel_head);
+			return NULL;
+		}
+		ntel->event = cur->event;
+		if (end_tel != NULL)
+			end_tel->next = ntel;
+		else
+			ntel_head = ntel;
+
+		end_tel = ntel;
+	}
+	return ntel_head;
+}
+
 /*
  * @brief add a te_list for a timed_event to a list sorted by the event's time
  * @param[in,out] tel - te_list to add to
@@ -1323,6 +2489,11 @@ dup_timed_event_list(timed_event *ote_list, server_info *nsinfo)
 
 	for (ote = ote_list; ote != NULL; ote = ote->next) {
 		nte = dup_timed_event(ote, nsinfo);
+		if (nte == NULL) {
+			free_timed_event_list(nte_head);
+			return NULL;
+		}
+		nte->prev = nte_prev;
 		if (nte_prev != NULL)
 			nte_prev->next = nte;
 		else
@@ -1398,7 +2569,7 @@ add_event(event_list *calendar, timed_event *te)
 	if (calendar->events == NULL)
 		events_is_null = 1;
 
-	calendar->events = add_timed_event(calendar->events, te);
+	link_event(calendar, te);
 
 	/* empty event list - the new event is the only event */
 	if (events_is_null)
@@ -1411,9 +2582,14 @@ add_event(event_list *calendar, timed_event *te)
 			if (te->event_time < calendar->next_event->event_time)
 				calendar->next_event = te;
 			else if (te->event_time == calendar->next_event->event_time) {
-				calendar->next_event =
-					find_timed_event(calendar->events, NULL,
-					TIMED_NOEVENT, te->event_time);
+				if (calendar->time_index != NULL)
+					calendar->next_event =
+						search_event_time_index(calendar->time_index,
+						te->event_time, NULL)->first;
+				else
+					calendar->next_event =
+						find_timed_event(calendar->events, NULL,
+						TIMED_NOEVENT, te->event_time);
 			}
 		}
 	}
@@ -1447,7 +2623,7 @@ timed_event *
 add_timed_event(timed_event *events, timed_event *te)
 {
 	timed_event *eloop;
-	timed_event *eloop_prev = NULL;
+	timed_event *eloop_prev;
 
 	if (te == NULL)
 		return events;
@@ -1455,26 +2631,21 @@ add_timed_event(timed_event *events, timed_event *te)
 	if (events == NULL)
 		return te;
 
-	for (eloop = events; eloop != NULL; eloop = eloop->next) {
-		if (eloop->event_time > te->event_time)
-			break;
-		if (eloop->event_time == te->event_time &&
-			te->event_type == TIMED_END_EVENT) {
-			break;
-		}
-
-		eloop_prev = eloop;
-	}
+	eloop_prev = find_event_insert_point(events, te);
 
 	if (eloop_prev == NULL) {
 		te->next = events;
 		te->prev = NULL;
+		events->prev = te;
 		return te;
 	}
 
+	eloop = eloop_prev->next;
 	te->next = eloop;
 	eloop_prev->next = te;
 	te->prev = eloop_prev;
+	if (eloop != NULL)
+		eloop->prev = te;
 
 	return events;
 }
@@ -1498,13 +2669,41 @@ delete_event(server_info *sinfo, timed_event *e, unsigned int flags)
 {
 	timed_event *cur_e;
 	timed_event *prev_e = NULL;
+	timed_event *next_e;
 	event_list *calendar;
+	undo_log *ul;
 
 	if (sinfo == NULL || e == NULL)
 		return 0;
 
 	calendar = sinfo->calendar;
 
+	/* When the changes are undone, e is linked back in (or freed if the
+	 * simulation created it), so it can't be freed here.
+	 */
+	if ((ul = undo_calendar(calendar)) != NULL) {
+		flags |= DE_UNLINK;
+		if (e->prev != NULL)
+			undo_save(ul, e->prev, sizeof(timed_event));
+		if (e->next != NULL)
+			undo_save(ul, e->next, sizeof(timed_event));
+	}
+
+	if (calendar->time_index != NULL) {
+		next_e = e->next;
+		if (unlink_indexed_event(calendar, e) == 0)
+			return 0;
+		if (remove_event_name_index(calendar->name_index, e) == 0)
+			free_event_list_index(calendar);
+
+		if (calendar->next_event == e)
+			calendar->next_event = next_e;
+
+		if ((flags & DE_UNLINK) == 0)
+			free_timed_event(e);
+
+		return 1;
+	}
 
 	for (cur_e = calendar->events; cur_e != e && cur_e != NULL;
 		prev_e = cur_e, cur_e = cur_e->next)
@@ -1519,6 +2718,8 @@ delete_event(server_info *sinfo, timed_event *e, unsigned int flags)
 			calendar->events = cur_e->next;
 		else
 			prev_e->next = cur_e->next;
+		if (cur_e->next != NULL)
+			cur_e->next->prev = prev_e;
 
 		if ((flags & DE_UNLINK) == 0)
 			free_timed_event(cur_e);
@@ -135,6 +135,22 @@ timed_event *
 find_timed_event(timed_event *te_list, char *name,
 	enum timed_event_types event_type, time_t event_time);
 
+/*
+ *	find_calendar_event - find a timed_event in a calendar, using the
+ *			      calendar's name index if it has one
+ *
+ *	  calendar   - calendar to search in
+ *	  start      - event to start searching at or NULL for the start
+ *	  name       - name of timed_event to search for
+ *	  event_type - event_type or TIMED_NOEVENT to ignore
+ *	  event_time - time or 0 to ignore
+ *
+ *	return first matching timed_event at or after start or NULL
+ */
+timed_event *
+find_calendar_event(event_list *calendar, timed_event *start, char *name,
+	enum timed_event_types event_type, time_t event_time);
+
 
 
 
@@ -341,6 +357,24 @@ create_event(enum timed_event_types event_type,
  */
 time_t calc_run_time(char *job_name, server_info *sinfo, int flags);
 
+/* free amount of a consumable on a node or SCHD_INFINITY if it is unbounded */
+sch_resource_t node_free_amount(node_info *node, resdef *def);
+
+/* build the summed free resources of the server's nodes for a job */
+node_res_profile *new_node_res_profile(server_info *sinfo, resource_resv *resresv);
+
+/* refresh one node's contribution to a node_res_profile */
+void update_node_res_profile(node_res_profile *nrp, node_info *node);
+
+/* refresh the nodes touched by the events performed between two events */
+void update_node_res_profile_events(node_res_profile *nrp, timed_event *from, timed_event *to);
+
+/* can the free resources of all the nodes hold the job's request */
+int node_res_profile_fits(node_res_profile *nrp, schd_error *err);
+
+/* free a node_res_profile */
+void free_node_res_profile(node_res_profile *nrp);
+
 /*
  *
  *	find_event_ptr - find the correct event pointer for the duplicated
@@ -443,8 +477,9 @@ generic_sim(event_list *calendar, unsigned int event_mask, time_t end, int defau
 
 te_list *new_te_list();
 
-te_list *dup_te_list(te_list *ote, timed_event *new_timed_event_list);
-te_list *dup_te_lists(te_list *ote, timed_event *new_timed_event_list);
+te_list *dup_te_list(te_list *ote, event_list *ncalendar);
+te_list *dup_te_lists(te_list *ote, event_list *ncalendar);
+te_list *copy_te_list(te_list *tel);
 
 void free_te_list(te_list *tel);
 
@@ -0,0 +1,540 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+/**
+ * @file    snapshot.c
+ *
+ * @brief
+ * 		snapshot.c - This file contains the capture and the read back of
+ *		scheduler snapshots.  A snapshot holds the replies to the server
+ *		queries made during a scheduling cycle (server, scheduler,
+ *		resources, vnodes, queues, jobs and reservations).  The
+ *		pbs_sched_replay program feeds them back into scheduling_cycle()
+ *		to reproduce the cycle without a server.
+ *
+ *		When the snapshot_file sched_config option is set, each cycle is
+ *		captured to "<snapshot_file>.new".  At the end of the cycle the
+ *		file replaces snapshot_file if the cycle took at least
+ *		snapshot_min_duration seconds and is removed otherwise, so
+ *		snapshot_file holds the last complete cycle worth keeping.
+ *
+ *		The file is text, one record per line with tab separated fields.
+ *		Backslash, tab and newline are escaped in the fields.
+ *			cycle	<time>	<scheduler name>
+ *			reply	<query>
+ *			obj	<name>
+ *			attr	<name>	<resource>	<value>
+ *			end
+ *			endcycle
+ *
+ * Functions included are:
+ * 	snapshot_begin_cycle()
+ * 	snapshot_status()
+ * 	snapshot_resources()
+ * 	snapshot_end_cycle()
+ * 	read_snapshot_cycle()
+ * 	next_snapshot_reply()
+ * 	rewind_snapshot_cycle()
+ * 	free_snapshot_cycle()
+ *
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pbs_ifl.h>
+#include <log.h>
+#include <libutil.h>
+#include "attribute.h"
+#include "snapshot.h"
+#include "data_types.h"
+#include "constant.h"
+#include "globals.h"
+#include "misc.h"
+
+/* a reply read back from a snapshot */
+struct snapshot_reply
+{
+	char *call;			/* the query, e.g. pbs_statvnode */
+	struct batch_status *bs;	/* the reply */
+	int used;			/* already handed out this cycle */
+	struct snapshot_reply *next;
+};
+
+static FILE *snap_fp;			/* snapshot being captured */
+static time_t snap_start;		/* when the captured cycle started */
+static int snap_rsc_captured;		/* pbs_statrsc() was captured this cycle */
+static struct batch_status *snap_rsc;	/* last pbs_statrsc() reply */
+
+static struct snapshot_reply *replies;	/* replies of the cycle read back */
+static struct snapshot_reply *replies_tail;
+
+/**
+ * @brief
+ * 		write a field to the snapshot, escaping backslash, tab and newline
+ *
+ * @param[in]	fp	-	the snapshot
+ * @param[in]	str	-	the field (NULL is written as an empty field)
+ *
+ * @return	void
+ */
+static void
+write_field(FILE *fp, char *str)
+{
+	char *p;
+
+	if (str == NULL)
+		return;
+
+	for (p = str; *p != '\0'; p++) {
+		if (*p == '\\')
+			fputs("\\\\", fp);
+		else if (*p == '\t')
+			fputs("\\t", fp);
+		else if (*p == '\n')
+			fputs("\\n", fp);
+		else
+			fputc(*p, fp);
+	}
+}
+
+/**
+ * @brief
+ * 		write a reply to the snapshot
+ *
+ * @param[in]	fp	-	the snapshot
+ * @param[in]	call	-	the query the reply is for
+ * @param[in]	bs	-	the reply
+ *
+ * @return	void
+ */
+static void
+write_reply(FILE *fp, char *call, struct batch_status *bs)
+{
+	struct attrl *attrp;
+
+	fprintf(fp, "reply\t%s\n", call);
+	for (; bs != NULL; bs = bs->next) {
+		fputs("obj\t", fp);
+		write_field(fp, bs->name);
+		fputc('\n', fp);
+		for (attrp = bs->attribs; attrp != NULL; attrp = attrp->next) {
+			fputs("attr\t", fp);
+			write_field(fp, attrp->name);
+			fputc('\t', fp);
+			write_field(fp, attrp->resource);
+			fputc('\t', fp);
+			write_field(fp, attrp->value);
+			fputc('\n', fp);
+		}
+	}
+	fputs("end\n", fp);
+}
+
+/**
+ * @brief
+ * 		copy a batch_status list
+ *
+ * @param[in]	obs	-	the list to copy
+ *
+ * @return	struct batch_status *
+ * @retval	the copy
+ * @retval	NULL	: obs is empty or on error
+ */
+static struct batch_status *
+dup_batch_status_list(struct batch_status *obs)
+{
+	struct batch_status *head = NULL;
+	struct batch_status *tail = NULL;
+	struct batch_status *nbs;
+
+	for (; obs != NULL; obs = obs->next) {
+		if ((nbs = calloc(1, sizeof(struct batch_status))) == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			pbs_statfree(head);
+			return NULL;
+		}
+		nbs->name = string_dup(obs->name);
+		nbs->attribs = dup_attrl_list(obs->attribs);
+		if (head == NULL)
+			head = nbs;
+		else
+			tail->next = nbs;
+		tail = nbs;
+	}
+
+	return head;
+}
+
+/**
+ * @brief
+ * 		start capturing the server replies of a cycle to
+ *		"<snapshot_file>.new" if snapshot_file is set
+ *
+ * @param[in]	now	-	the time of the cycle
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+snapshot_begin_cycle(time_t now)
+{
+	char path[MAXPATHLEN + 1];
+	char logbuf[MAX_LOG_SIZE];
+
+	if (snap_fp != NULL) {
+		fclose(snap_fp);
+		snap_fp = NULL;
+	}
+
+	if (conf.snapshot_file == NULL)
+		return;
+
+	snprintf(path, sizeof(path), "%s.new", conf.snapshot_file);
+	if ((snap_fp = fopen(path, "w")) == NULL) {
+		snprintf(logbuf, sizeof(logbuf), "Can not open %s.new: %s", conf.snapshot_file, strerror(errno));
+		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, __func__, logbuf);
+		return;
+	}
+
+	snap_start = time(NULL);
+	snap_rsc_captured = 0;
+	fprintf(snap_fp, "cycle\t%ld\t", (long) now);
+	write_field(snap_fp, sc_name);
+	fputc('\n', snap_fp);
+}
+
+/**
+ * @brief
+ * 		capture the reply to a server query.  A NULL reply is captured
+ *		too, so the replies line up with the queries when replayed.
+ *
+ * @param[in]	call	-	the query, e.g. pbs_statvnode
+ * @param[in]	bs	-	the reply
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+snapshot_status(char *call, struct batch_status *bs)
+{
+	if (snap_fp == NULL)
+		return;
+
+	write_reply(snap_fp, call, bs);
+}
+
+/**
+ * @brief
+ * 		capture the reply to pbs_statrsc().  The resource definitions
+ *		are only queried when they change, so a copy of the reply is
+ *		kept and captured with every cycle.
+ *
+ * @param[in]	bs	-	the reply
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+snapshot_resources(struct batch_status *bs)
+{
+	if (conf.snapshot_file == NULL)
+		return;
+
+	pbs_statfree(snap_rsc);
+	snap_rsc = dup_batch_status_list(bs);
+
+	if (snap_fp != NULL) {
+		write_reply(snap_fp, "pbs_statrsc", bs);
+		snap_rsc_captured = 1;
+	}
+}
+
+/**
+ * @brief
+ * 		finish capturing the cycle.  The snapshot replaces snapshot_file
+ *		if the cycle took at least snapshot_min_duration seconds.
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+snapshot_end_cycle(void)
+{
+	char path[MAXPATHLEN + 1];
+	char logbuf[MAX_LOG_SIZE];
+	int err;
+
+	if (snap_fp == NULL)
+		return;
+
+	if (!snap_rsc_captured && snap_rsc != NULL)
+		write_reply(snap_fp, "pbs_statrsc", snap_rsc);
+	fputs("endcycle\n", snap_fp);
+
+	err = ferror(snap_fp);
+	err |= fclose(snap_fp);
+	snap_fp = NULL;
+
+	snprintf(path, sizeof(path), "%s.new", conf.snapshot_file);
+	if (err) {
+		snprintf(logbuf, sizeof(logbuf), "Error writing %s.new", conf.snapshot_file);
+		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, __func__, logbuf);
+		remove(path);
+	}
+	else if (time(NULL) - snap_start < conf.snapshot_min_duration)
+		remove(path);
+	else if (rename(path, conf.snapshot_file) != 0) {
+		snprintf(logbuf, sizeof(logbuf), "Can not rename %s.new: %s", conf.snapshot_file, strerror(errno));
+		schdlog(PBSEVENT_SCHED, PBS_EVENTCLASS_SCHED, LOG_WARNING, __func__, logbuf);
+	}
+}
+
+/**
+ * @brief
+ * 		split a snapshot line into its fields and unescape them in place
+ *
+ * @param[in,out]	line	-	the line, without the newline
+ * @param[out]	fields	-	the fields
+ * @param[in]	max	-	size of fields
+ *
+ * @return	int
+ * @retval	number of fields
+ */
+static int
+split_fields(char *line, char **fields, int max)
+{
+	char *p;
+	char *q;
+	int n = 0;
+
+	fields[n++] = line;
+	for (p = q = line; *p != '\0'; p++) {
+		if (*p == '\t' && n < max) {
+			*q++ = '\0';
+			fields[n++] = q;
+		}
+		else if (*p == '\\' && p[1] != '\0') {
+			p++;
+			*q++ = *p == 't' ? '\t' : *p == 'n' ? '\n' : *p;
+		}
+		else
+			*q++ = *p;
+	}
+	*q = '\0';
+
+	return n;
+}
+
+/**
+ * @brief
+ * 		read the replies of the next cycle of a snapshot.  They replace
+ *		the replies of the cycle read before.
+ *
+ * @param[in]	fp	-	the snapshot
+ * @param[out]	cycle_time	-	the time of the cycle
+ * @param[out]	sched_name	-	the name of the scheduler which captured
+ *					the cycle (free()'d by the caller)
+ *
+ * @return	int
+ * @retval	1	: a cycle was read
+ * @retval	0	: end of the snapshot
+ * @retval	-1	: the snapshot is malformed
+ *
+ * @par MT-Safe:	no
+ */
+int
+read_snapshot_cycle(FILE *fp, time_t *cycle_time, char **sched_name)
+{
+	static char *buf = NULL;
+	static int buf_size = 0;
+	char *fields[4];
+	int n;
+	int in_cycle = 0;
+	struct snapshot_reply *reply = NULL;
+	struct batch_status *bs = NULL;
+	struct attrl *attrp;
+	struct attrl *attr_tail = NULL;
+
+	free_snapshot_cycle();
+
+	while (pbs_fgets(&buf, &buf_size, fp) != NULL) {
+		n = strlen(buf);
+		if (n > 0 && buf[n - 1] == '\n')
+			buf[n - 1] = '\0';
+		if (buf[0] == '\0' || buf[0] == '#')
+			continue;
+
+		n = split_fields(buf, fields, 4);
+		if (!strcmp(fields[0], "cycle") && n == 3 && !in_cycle) {
+			*cycle_time = (time_t) strtol(fields[1], NULL, 10);
+			*sched_name = string_dup(fields[2]);
+			in_cycle = 1;
+		}
+		else if (!in_cycle)
+			return -1;
+		else if (!strcmp(fields[0], "endcycle"))
+			return 1;
+		else if (!strcmp(fields[0], "reply") && n == 2 && reply == NULL) {
+			if ((reply = calloc(1, sizeof(struct snapshot_reply))) == NULL) {
+				log_err(errno, __func__, MEM_ERR_MSG);
+				return -1;
+			}
+			reply->call = string_dup(fields[1]);
+			if (replies == NULL)
+				replies = reply;
+			else
+				replies_tail->next = reply;
+			replies_tail = reply;
+			bs = NULL;
+		}
+		else if (!strcmp(fields[0], "end") && reply != NULL)
+			reply = NULL;
+		else if (!strcmp(fields[0], "obj") && n == 2 && reply != NULL) {
+			struct batch_status *nbs;
+
+			if ((nbs = calloc(1, sizeof(struct batch_status))) == NULL) {
+				log_err(errno, __func__, MEM_ERR_MSG);
+				return -1;
+			}
+			nbs->name = string_dup(fields[1]);
+			if (bs == NULL)
+				reply->bs = nbs;
+			else
+				bs->next = nbs;
+			bs = nbs;
+			attr_tail = NULL;
+		}
+		else if (!strcmp(fields[0], "attr") && n == 4 && bs != NULL) {
+			if ((attrp = new_attrl()) == NULL) {
+				log_err(errno, __func__, MEM_ERR_MSG);
+				return -1;
+			}
+			attrp->name = string_dup(fields[1]);
+			attrp->resource = fields[2][0] == '\0' ? NULL : string_dup(fields[2]);
+			attrp->value = string_dup(fields[3]);
+			if (attr_tail == NULL)
+				bs->attribs = attrp;
+			else
+				attr_tail->next = attrp;
+			attr_tail = attrp;
+		}
+		else
+			return -1;
+	}
+
+	return in_cycle ? -1 : 0;
+}
+
+/**
+ * @brief
+ * 		a copy of the next reply to a query in the cycle read by
+ *		read_snapshot_cycle().  The replies to each query are handed
+ *		out in the order they were captured.
+ *
+ * @param[in]	call	-	the query, e.g. pbs_statvnode
+ *
+ * @return	struct batch_status *
+ * @retval	the reply, to be freed with pbs_statfree()
+ * @retval	NULL	: the reply was empty or there are no more replies
+ *
+ * @par MT-Safe:	no
+ */
+struct batch_status *
+next_snapshot_reply(char *call)
+{
+	struct snapshot_reply *reply;
+
+	for (reply = replies; reply != NULL; reply = reply->next) {
+		if (!reply->used && !strcmp(reply->call, call)) {
+			reply->used = 1;
+			return dup_batch_status_list(reply->bs);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief
+ * 		hand out the replies of the cycle read by read_snapshot_cycle()
+ *		again, to replay the cycle once more
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+rewind_snapshot_cycle(void)
+{
+	struct snapshot_reply *reply;
+
+	for (reply = replies; reply != NULL; reply = reply->next)
+		reply->used = 0;
+}
+
+/**
+ * @brief
+ * 		free the replies read by read_snapshot_cycle()
+ *
+ * @return	void
+ *
+ * @par MT-Safe:	no
+ */
+void
+free_snapshot_cycle(void)
+{
+	struct snapshot_reply *reply;
+	struct snapshot_reply *next;
+
+	for (reply = replies; reply != NULL; reply = next) {
+		next = reply->next;
+		free(reply->call);
+		pbs_statfree(reply->bs);
+		free(reply);
+	}
+	replies = NULL;
+	replies_tail = NULL;
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+#ifndef	_SNAPSHOT_H
+#define	_SNAPSHOT_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <time.h>
+#include "pbs_ifl.h"
+
+/*
+ *	snapshot_begin_cycle - start capturing the server replies of a cycle
+ *			       if snapshot_file is set
+ */
+void snapshot_begin_cycle(time_t now);
+
+/*
+ *	snapshot_status - capture the reply to a server query
+ */
+void snapshot_status(char *call, struct batch_status *bs);
+
+/*
+ *	snapshot_resources - capture the reply to pbs_statrsc() and keep it
+ *			     for the cycles which use the cached definitions
+ */
+void snapshot_resources(struct batch_status *bs);
+
+/*
+ *	snapshot_end_cycle - finish capturing the cycle and keep the snapshot
+ *			     if the cycle was long enough
+ */
+void snapshot_end_cycle(void);
+
+/*
+ *	read_snapshot_cycle - read the replies of the next cycle of a snapshot
+ *			      returns 1 if a cycle was read, 0 at the end of
+ *			      the file and -1 on error
+ */
+int read_snapshot_cycle(FILE *fp, time_t *cycle_time, char **sched_name);
+
+/*
+ *	next_snapshot_reply - a copy of the next reply to call in the cycle
+ *			      read by read_snapshot_cycle()
+ */
+struct batch_status *next_snapshot_reply(char *call);
+
+/*
+ *	rewind_snapshot_cycle - hand out the cycle's replies again
+ */
+void rewind_snapshot_cycle(void);
+
+/*
+ *	free_snapshot_cycle - free the replies read by read_snapshot_cycle()
+ */
+void free_snapshot_cycle(void);
+
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* _SNAPSHOT_H */
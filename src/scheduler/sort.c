@@ -69,6 +69,8 @@
  * 	cmp_job_preemption_time_asc()
  * 	cmp_starving_jobs()
  * 	sort_jobs()
+ * 	resort_jobs()
+ * 	sort_job_array()
  * 	swapfunc()
  * 	med3()
  * 	qsort()
@@ -92,6 +94,8 @@
 #include "check.h"
 #include "constant.h"
 #include "server_info.h"
+#include "cycle_stats.h"
+#include "undo_log.h"
 #include "resource.h"
 #include "constant.h"
 
@@ -1263,9 +1267,354 @@ cmp_resv_state(const void *r1, const void *r2)
 		return 0;
 }
 
+/*
+ * A job's sort keys, taken once per sort so that comparisons don't walk
+ * resource lists.  cmp_job_sort_keys() compares them the way cmp_sort()
+ * compares the jobs themselves.
+ */
+struct job_sort_key {
+	resource_resv *resresv;		/* the job */
+	sch_resource_t *vals;		/* amounts of the job_sort_key resources */
+	struct group_path *gpath;	/* fairshare path of the job */
+	unsigned long long fp;		/* fingerprint of the keys */
+	long sch_priority;
+	long qrank;
+	time_t time_preempted;
+	float formula_value;
+	int preempt;
+	int rank;
+	unsigned runnable:1;
+	unsigned is_starving:1;
+	unsigned has_ginfo:1;
+	unsigned changed:1;		/* keys changed since the last sort */
+};
+
+/* what the job sort keys are compared by */
+struct job_sort_policy {
+	struct sort_info *sort_by;	/* the job_sort_key resources */
+	int num_sorts;			/* number of job_sort_key resources */
+	int help_starving_jobs;
+	int fair_share;
+};
+
+/**
+ * @brief
+ *		fill in a job's sort keys and their fingerprint
+ *
+ * @param[in]	jsp	-	what jobs are sorted by
+ * @param[in]	resresv	-	the job
+ * @param[out]	key	-	the keys
+ * @param[in]	vals	-	storage for jsp->num_sorts resource amounts
+ *
+ * @return	void
+ */
+static void
+fill_job_sort_key(struct job_sort_policy *jsp, resource_resv *resresv,
+	struct job_sort_key *key, sch_resource_t *vals)
+{
+	struct group_path *gp;
+	unsigned long long fp = FINGERPRINT_INIT;
+	int flags[4];
+	int i;
+
+	key->resresv = resresv;
+	key->vals = vals;
+	key->runnable = in_runnable_state(resresv) ? 1 : 0;
+	key->preempt = resresv->job->preempt;
+	key->time_preempted = resresv->job->time_preempted;
+	key->is_starving = resresv->job->is_starving;
+	key->sch_priority = resresv->sch_priority;
+	key->formula_value = resresv->job->formula_value;
+	key->has_ginfo = resresv->job->ginfo != NULL;
+	key->gpath = key->has_ginfo ? resresv->job->ginfo->gpath : NULL;
+	key->qrank = resresv->qrank;
+	key->rank = resresv->rank;
+
+	for (i = 0; i < jsp->num_sorts; i++)
+		vals[i] = find_resresv_amount(resresv, jsp->sort_by[i].res_name, jsp->sort_by[i].def);
+
+	flags[0] = key->runnable;
+	flags[1] = key->preempt;
+	flags[2] = key->is_starving;
+	flags[3] = key->rank;
+	fp = fingerprint_bytes(fp, flags, sizeof(flags));
+	fp = fingerprint_bytes(fp, &key->time_preempted, sizeof(key->time_preempted));
+	fp = fingerprint_bytes(fp, &key->sch_priority, sizeof(key->sch_priority));
+	fp = fingerprint_bytes(fp, &key->qrank, sizeof(key->qrank));
+	fp = fingerprint_bytes(fp, &key->formula_value, sizeof(key->formula_value));
+	fp = fingerprint_bytes(fp, vals, jsp->num_sorts * sizeof(sch_resource_t));
+	/* every path starts at the root, so its usage never orders two jobs */
+	for (gp = (key->gpath != NULL) ? key->gpath->next : NULL; gp != NULL; gp = gp->next) {
+		fp = fingerprint_bytes(fp, &gp->ginfo, sizeof(gp->ginfo));
+		fp = fingerprint_bytes(fp, &gp->ginfo->tree_percentage, sizeof(gp->ginfo->tree_percentage));
+		fp = fingerprint_bytes(fp, &gp->ginfo->temp_usage, sizeof(gp->ginfo->temp_usage));
+	}
+	key->fp = fp;
+}
+
+/**
+ * @brief
+ *		compare two jobs' sort keys.  This mirrors cmp_sort().
+ *
+ * @param[in]	jsp	-	what jobs are sorted by
+ * @param[in]	k1	-	keys of job 1
+ * @param[in]	k2	-	keys of job 2
+ *
+ * @return	-1, 0, 1 : standard qsort() cmp
+ */
+static int
+cmp_job_sort_keys(struct job_sort_policy *jsp, struct job_sort_key *k1, struct job_sort_key *k2)
+{
+	int cmp;
+	int i;
+
+	if (k1->runnable && !k2->runnable)
+		return -1;
+	if (k2->runnable && !k1->runnable)
+		return 1;
+
+	/* sort based on preemption */
+	if (k1->preempt < k2->preempt)
+		return 1;
+	if (k1->preempt > k2->preempt)
+		return -1;
+
+	/* preempted jobs in the order they were preempted */
+	if (k1->time_preempted != UNSPECIFIED || k2->time_preempted != UNSPECIFIED) {
+		if (k2->time_preempted == UNSPECIFIED)
+			return -1;
+		if (k1->time_preempted == UNSPECIFIED)
+			return 1;
+		if (k1->time_preempted < k2->time_preempted)
+			return -1;
+		if (k1->time_preempted > k2->time_preempted)
+			return 1;
+	}
+#ifndef NAS /* localmod 041 */
+	if (jsp->help_starving_jobs && (k1->is_starving || k2->is_starving)) {
+		if (!k1->is_starving)
+			return 1;
+		if (!k2->is_starving)
+			return -1;
+		if (k1->sch_priority > k2->sch_priority)
+			return -1;
+		if (k1->sch_priority < k2->sch_priority)
+			return 1;
+	}
+#endif /* localmod 041 */
+	/* job sort formula */
+	if (k1->formula_value < k2->formula_value)
+		return 1;
+	if (k1->formula_value > k2->formula_value)
+		return -1;
+#ifndef NAS /* localmod 041 */
+	if (jsp->fair_share && k1->has_ginfo && k2->has_ginfo) {
+		cmp = compare_path(k1->gpath, k2->gpath);
+		if (cmp != 0)
+			return cmp;
+	}
+#endif /* localmod 041 */
+
+	/* normal resource based sort */
+	for (i = 0; i < jsp->num_sorts; i++) {
+		if (k1->vals[i] == k2->vals[i])
+			continue;
+		if (jsp->sort_by[i].order == ASC)
+			cmp = (k1->vals[i] < k2->vals[i]) ? -1 : 1;
+		else
+			cmp = (k1->vals[i] < k2->vals[i]) ? 1 : -1;
+		return cmp;
+	}
+
+	/* stabilize the sort */
+	if (k1->qrank < k2->qrank)
+		return -1;
+	if (k1->qrank > k2->qrank)
+		return 1;
+	if (k1->rank < k2->rank)
+		return -1;
+	if (k1->rank > k2->rank)
+		return 1;
+	return 0;
+}
+
+/**
+ * @brief
+ *		merge two sorted runs of job sort keys
+ *
+ * @param[in]	jsp	-	what jobs are sorted by
+ * @param[in]	a	-	first run
+ * @param[in]	na	-	length of a
+ * @param[in]	b	-	second run
+ * @param[in]	nb	-	length of b
+ * @param[out]	out	-	the merged run (na + nb long)
+ *
+ * @return	void
+ */
+static void
+merge_job_sort_keys(struct job_sort_policy *jsp, struct job_sort_key **a, int na,
+	struct job_sort_key **b, int nb, struct job_sort_key **out)
+{
+	int i = 0;
+	int j = 0;
+	int k = 0;
+
+	while (i < na && j < nb) {
+		if (cmp_job_sort_keys(jsp, b[j], a[i]) < 0)
+			out[k++] = b[j++];
+		else
+			out[k++] = a[i++];
+	}
+	while (i < na)
+		out[k++] = a[i++];
+	while (j < nb)
+		out[k++] = b[j++];
+}
+
 /**
  * @brief
- * 		sort_jobs - This function sorts all jobs according to their preemption
+ *		bottom up merge sort of job sort keys
+ *
+ * @param[in]	jsp	-	what jobs are sorted by
+ * @param[in,out]	keys	-	the keys to sort
+ * @param[in]	tmp	-	scratch space as long as keys
+ * @param[in]	n	-	number of keys
+ *
+ * @return	void
+ */
+static void
+merge_sort_job_sort_keys(struct job_sort_policy *jsp, struct job_sort_key **keys,
+	struct job_sort_key **tmp, int n)
+{
+	struct job_sort_key **src = keys;
+	struct job_sort_key **dst = tmp;
+	struct job_sort_key **swap;
+	int width;
+	int i;
+
+	for (width = 1; width < n; width *= 2) {
+		for (i = 0; i < n; i += 2 * width) {
+			int na = (i + width < n) ? width : n - i;
+			int nb = (i + 2 * width < n) ? width : n - i - na;
+
+			merge_job_sort_keys(jsp, src + i, na, src + i + na, nb, dst + i);
+		}
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if (src != keys)
+		memcpy(keys, src, n * sizeof(struct job_sort_key *));
+}
+
+/**
+ * @brief
+ *		sort an array of jobs the way cmp_sort() orders them.  Each job's
+ *		sort keys are taken once and the keys are merge sorted.
+ *
+ * @par
+ *		If incremental is set, the array must still be in the order of
+ *		the last sort.  Only the jobs whose keys changed since then are
+ *		sorted and merged back into the others.
+ *
+ * @param[in,out]	jobs	-	the jobs to sort
+ * @param[in]	num_jobs	-	number of jobs in the array
+ * @param[in]	incremental	-	only reposition the jobs whose keys changed
+ *
+ * @return	void
+ */
+static void
+sort_job_keys(resource_resv **jobs, int num_jobs, int incremental)
+{
+	struct job_sort_policy jsp;
+	struct job_sort_key *keys;
+	struct job_sort_key **ptrs;
+	struct job_sort_key **tmp;
+	struct job_sort_key **sorted;
+	sch_resource_t *vals = NULL;
+	int num_changed = 0;
+	int num_kept = 0;
+	int i;
+	undo_log *ul;
+
+	if (jobs == NULL || num_jobs <= 0)
+		return;
+
+	ul = jobs[0]->server->undo;
+
+	jsp.sort_by = cstat.sort_by;
+	for (jsp.num_sorts = 0; jsp.num_sorts <= MAX_SORTS &&
+		cstat.sort_by[jsp.num_sorts].res_name != NULL; jsp.num_sorts++)
+		;
+	jsp.help_starving_jobs = jobs[0]->server->policy->help_starving_jobs;
+	jsp.fair_share = jobs[0]->server->policy->fair_share;
+
+	keys = malloc(num_jobs * sizeof(struct job_sort_key));
+	ptrs = malloc(3 * num_jobs * sizeof(struct job_sort_key *));
+	if (jsp.num_sorts > 0)
+		vals = malloc(num_jobs * jsp.num_sorts * sizeof(sch_resource_t));
+	if (keys == NULL || ptrs == NULL || (jsp.num_sorts > 0 && vals == NULL)) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free(keys);
+		free(ptrs);
+		free(vals);
+		qsort(jobs, num_jobs, sizeof(resource_resv *), cmp_sort);
+		return;
+	}
+	tmp = ptrs + num_jobs;
+	sorted = tmp + num_jobs;
+
+	for (i = 0; i < num_jobs; i++) {
+		undo_resource_resv(ul, jobs[i]);
+		fill_job_sort_key(&jsp, jobs[i], &keys[i], vals + i * jsp.num_sorts);
+		keys[i].changed = keys[i].fp != jobs[i]->job->sort_fp;
+		jobs[i]->job->sort_fp_new = keys[i].fp;
+		if (keys[i].changed)
+			num_changed++;
+	}
+
+	/* Repositioning pays off only if few jobs changed.  The jobs that
+	 * did not change are kept in their order, but only if the array is
+	 * really still sorted.
+	 */
+	if (incremental && num_changed <= num_jobs / 2) {
+		for (i = 0; i < num_jobs; i++) {
+			if (keys[i].changed)
+				continue;
+			if (num_kept > 0 && cmp_job_sort_keys(&jsp, ptrs[num_kept - 1], &keys[i]) > 0)
+				break;
+			ptrs[num_kept++] = &keys[i];
+		}
+		if (i < num_jobs)
+			incremental = 0;
+	} else
+		incremental = 0;
+
+	if (incremental) {
+		for (i = 0, num_changed = 0; i < num_jobs; i++)
+			if (keys[i].changed)
+				tmp[num_changed++] = &keys[i];
+		merge_sort_job_sort_keys(&jsp, tmp, sorted, num_changed);
+		merge_job_sort_keys(&jsp, ptrs, num_kept, tmp, num_changed, sorted);
+	} else {
+		for (i = 0; i < num_jobs; i++)
+			ptrs[i] = &keys[i];
+		merge_sort_job_sort_keys(&jsp, ptrs, tmp, num_jobs);
+		sorted = ptrs;
+	}
+
+	for (i = 0; i < num_jobs; i++)
+		jobs[i] = sorted[i]->resresv;
+
+	free(keys);
+	free(ptrs);
+	free(vals);
+}
+
+/**
+ * @brief
+ * 		sort_server_jobs - This function sorts all jobs according to their preemption
  *      priority, preempted time and fairshare.
  *		sort_jobs is called whenever we need to sort jobs on the basis of
  *		various policies set in scheduler.
@@ -1274,10 +1623,12 @@ cmp_resv_state(const void *r1, const void *r2)
  *                     			by_queue or round_robin.
  * @param[in,out]	sinfo 	- 	Server info struct which contains all the jobs that needs
  *                        		sorting.
+ * @param[in]	incremental	-	only reposition the jobs whose sort keys changed
+ *                        		since the last sort
  * @return	void
  */
-void
-sort_jobs(status *policy, server_info *sinfo)
+static void
+sort_server_jobs(status *policy, server_info *sinfo, int incremental)
 {
 	int i = 0;
 	int job_index = 0;
@@ -1297,8 +1648,8 @@ sort_jobs(status *policy, server_info *sinfo)
 			 */
 			for (; i < sinfo->num_queues; i++) {
 				if (sinfo->queues[i]->sc.total > 0) {
-					qsort(sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total,
-						sizeof(resource_resv*), cmp_sort);
+					sort_job_keys(sinfo->queues[i]->jobs, sinfo->queues[i]->sc.total,
+						incremental);
 				}
 			}
 			for (count = 0; count != sinfo->num_queues; count++) {
@@ -1311,16 +1662,16 @@ sort_jobs(status *policy, server_info *sinfo)
 		}
 		/** Sort on entire complex **/
 		else if (!policy->by_queue && !policy->round_robin) {
-			qsort(sinfo->jobs, count_array((void **)sinfo->jobs),
-				sizeof(resource_resv *), cmp_sort);
+			sort_job_keys(sinfo->jobs, count_array((void **)sinfo->jobs),
+				incremental);
 		}
 	}
 	else if (policy->by_queue) {
 		for (i = 0; i < sinfo->num_queues; i++) {
-			qsort(sinfo->queues[i]->jobs, count_array((void **)sinfo->queues[i]->jobs),
-				sizeof(resource_resv *), cmp_sort);
+			sort_job_keys(sinfo->queues[i]->jobs, count_array((void **)sinfo->queues[i]->jobs),
+				incremental);
 		}
-		qsort(sinfo->jobs, count_array((void **)sinfo->jobs), sizeof(resource_resv*), cmp_sort);
+		sort_job_keys(sinfo->jobs, count_array((void **)sinfo->jobs), incremental);
 	}
 	else if (policy->round_robin) {
 		if (sinfo -> queue_list != NULL) {
@@ -1331,13 +1682,74 @@ sort_jobs(status *policy, server_info *sinfo)
 				int queue_index_size = count_array((void **)sinfo->queue_list[i]);
 				for (j = 0; j < queue_index_size; j++)
 				{
-				    qsort(sinfo->queue_list[i][j]->jobs, count_array((void **)sinfo->queue_list[i][j]->jobs),
-					    sizeof(resource_resv *), cmp_sort);
+				    sort_job_keys(sinfo->queue_list[i][j]->jobs, count_array((void **)sinfo->queue_list[i][j]->jobs),
+					    incremental);
 				}
 			}
 
 		}
 	}
 	else
-		qsort(sinfo->jobs, count_array((void **)sinfo->jobs), sizeof(resource_resv*), cmp_sort);
+		sort_job_keys(sinfo->jobs, count_array((void **)sinfo->jobs), incremental);
+
+	/* the arrays are now sorted on the new keys */
+	if (sinfo->jobs != NULL) {
+		for (i = 0; sinfo->jobs[i] != NULL; i++)
+			sinfo->jobs[i]->job->sort_fp = sinfo->jobs[i]->job->sort_fp_new;
+	}
+}
+
+/**
+ * @brief
+ *		sort all the jobs on the basis of the policies set in the scheduler
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in,out]	sinfo	-	server info with the jobs to sort
+ *
+ * @return	void
+ */
+void
+sort_jobs(status *policy, server_info *sinfo)
+{
+	begin_phase(PHASE_SORT_JOBS);
+	sort_server_jobs(policy, sinfo, 0);
+	end_phase(PHASE_SORT_JOBS);
+}
+
+/**
+ * @brief
+ *		sort the jobs again after some of them changed, e.g. a job ran
+ *		and its owner's fairshare usage went up.  Only the jobs whose
+ *		sort keys changed since the last sort are repositioned.
+ *
+ * @param[in]	policy	-	policy info
+ * @param[in,out]	sinfo	-	server info with the jobs to sort
+ *
+ * @return	void
+ */
+void
+resort_jobs(status *policy, server_info *sinfo)
+{
+	begin_phase(PHASE_SORT_JOBS);
+	sort_server_jobs(policy, sinfo, 1);
+	end_phase(PHASE_SORT_JOBS);
+}
+
+/**
+ * @brief
+ *		sort an array of jobs into cmp_sort() order
+ *
+ * @param[in,out]	jobs	-	the jobs to sort
+ * @param[in]	num_jobs	-	number of jobs in the array
+ *
+ * @return	void
+ */
+void
+sort_job_array(resource_resv **jobs, int num_jobs)
+{
+	int i;
+
+	sort_job_keys(jobs, num_jobs, 0);
+	for (i = 0; i < num_jobs; i++)
+		jobs[i]->job->sort_fp = jobs[i]->job->sort_fp_new;
 }
@@ -204,6 +204,15 @@ int cmp_resv_state(const void *r1, const void *r2);
  */
 void sort_jobs(status *policy, server_info *sinfo);
 
+/*
+ * resort_jobs - sort the jobs again, only repositioning the jobs whose sort
+ *               keys changed since the last sort
+ */
+void resort_jobs(status *policy, server_info *sinfo);
+
+/* sort an array of jobs into cmp_sort() order */
+void sort_job_array(resource_resv **jobs, int num_jobs);
+
 #ifdef	__cplusplus
 }
 #endif
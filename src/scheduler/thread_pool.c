@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+/**
+ * @file    thread_pool.c
+ *
+ * @brief
+ * 		thread_pool.c - This file contains a small pool of worker threads
+ *		used to spread independent work (e.g. checking vnode eligibility
+ *		or converting queried jobs) across several cpus.  The workers are
+ *		started the first time they are needed and are kept between
+ *		cycles.  Callers must not use anything from a work function which
+ *		isn't safe to be used from more than one thread (e.g. the global
+ *		log_buffer).
+ *
+ * Functions included are:
+ * 	run_in_thread_pool()
+ * 	in_thread_pool_worker()
+ * 	shutdown_thread_pool()
+ *
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <log.h>
+#ifndef WIN32
+#include <signal.h>
+#include <pthread.h>
+#endif
+#include "thread_pool.h"
+#include "constant.h"
+
+/* number of blocks each thread's share of a job is split into */
+#define POOL_BLOCKS_PER_THREAD 8
+
+#ifndef WIN32
+/* the worker threads and the job they are working on */
+static struct thread_pool
+{
+	pthread_mutex_t lock;
+	pthread_cond_t work_cond;	/* signaled when a new job is posted */
+	pthread_cond_t done_cond;	/* signaled when the last worker is done */
+	pthread_t *threads;
+	int num_threads;		/* number of worker threads */
+	int size;			/* number of threads the pool was started for */
+	int active;			/* number of workers working on the job */
+	unsigned long generation;	/* incremented for each job */
+	unsigned long start_generation;	/* generation when the workers started */
+	int shutdown;			/* workers should exit */
+	int busy;			/* workers still working on the job */
+
+	pool_func func;			/* the job: func(i, arg) for i < num */
+	void *arg;
+	int num;
+	int next;			/* next index to hand out */
+	int block;			/* number of indices handed out at once */
+} pool = {
+	PTHREAD_MUTEX_INITIALIZER,
+	PTHREAD_COND_INITIALIZER,
+	PTHREAD_COND_INITIALIZER
+};
+
+/* set in the worker threads */
+static __thread int is_pool_worker = 0;
+
+/**
+ * @brief
+ * 		work on the current job until all of its indices have been
+ *		handed out
+ *
+ * @par MT-Safe: yes - called with pool.lock held, which is dropped while
+ *		the work function runs
+ *
+ * @return void
+ */
+static void
+work_on_job(void)
+{
+	int start;
+	int end;
+	int i;
+
+	while (pool.next < pool.num) {
+		start = pool.next;
+		end = start + pool.block;
+		if (end > pool.num)
+			end = pool.num;
+		pool.next = end;
+
+		pthread_mutex_unlock(&pool.lock);
+		for (i = start; i < end; i++)
+			pool.func(i, pool.arg);
+		pthread_mutex_lock(&pool.lock);
+	}
+}
+
+/**
+ * @brief
+ * 		main loop of a worker thread: wait for a job, help with it
+ *		and report back when done
+ *
+ * @param[in]	arg	-	index of the worker
+ *
+ * @return NULL
+ */
+static void *
+pool_worker(void *arg)
+{
+	int index = (int) (long) arg;
+	unsigned long seen;
+
+	is_pool_worker = 1;
+
+	pthread_mutex_lock(&pool.lock);
+	/* a job may already have been posted before this thread ran */
+	seen = pool.start_generation;
+	while (1) {
+		while (!pool.shutdown && pool.generation == seen)
+			pthread_cond_wait(&pool.work_cond, &pool.lock);
+		if (pool.shutdown)
+			break;
+		seen = pool.generation;
+
+		/* workers past the number asked for sit the job out */
+		if (index < pool.active)
+			work_on_job();
+
+		pool.busy--;
+		if (pool.busy == 0)
+			pthread_cond_signal(&pool.done_cond);
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return NULL;
+}
+
+/**
+ * @brief
+ * 		start num worker threads.  Signals are blocked in the workers
+ *		so they are always handled by the main thread.
+ *
+ * @param[in]	num	-	number of workers to start
+ *
+ * @return	number of workers started
+ */
+static int
+start_pool_workers(int num)
+{
+	sigset_t allsigs;
+	sigset_t oldsigs;
+	int rc;
+	int i;
+
+	pool.threads = malloc(num * sizeof(pthread_t));
+	if (pool.threads == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return 0;
+	}
+
+	sigfillset(&allsigs);
+	pthread_sigmask(SIG_SETMASK, &allsigs, &oldsigs);
+
+	pool.shutdown = 0;
+	pool.start_generation = pool.generation;
+	for (i = 0; i < num; i++) {
+		rc = pthread_create(&pool.threads[i], NULL, pool_worker, (void *) (long) i);
+		if (rc != 0) {
+			log_err(rc, __func__, "could not start worker thread");
+			break;
+		}
+	}
+
+	pthread_sigmask(SIG_SETMASK, &oldsigs, NULL);
+
+	pool.num_threads = i;
+	if (i == 0) {
+		free(pool.threads);
+		pool.threads = NULL;
+	}
+
+	return i;
+}
+#endif /* WIN32 */
+
+/**
+ * @brief
+ * 		call func(i, arg) for every i in [0, num).  The calls are
+ *		spread over nthreads threads including the calling thread.
+ *		The worker threads are restarted when more threads are asked
+ *		for than the pool was started with.  If no worker threads can be
+ *		started, all the calls are made from the calling thread.
+ *		Pooled objects (see mem_pool.c) allocated by func are malloc()'d
+ *		rather than pooled, so func may only free pooled objects it
+ *		allocated itself.
+ *
+ * @param[in]	nthreads	-	number of threads to use
+ * @param[in]	num	-	number of indices
+ * @param[in]	func	-	function to call for each index
+ * @param[in]	arg	-	argument passed to func
+ *
+ * @par MT-Safe: no - only call from the main thread
+ *
+ * @return void
+ */
+void
+run_in_thread_pool(int nthreads, int num, pool_func func, void *arg)
+{
+	int i;
+
+	if (func == NULL || num <= 0)
+		return;
+
+#ifndef WIN32
+	if (nthreads > 1 && pool.size < nthreads) {
+		shutdown_thread_pool();
+		start_pool_workers(nthreads - 1);
+		pool.size = nthreads;
+	}
+
+	if (nthreads > 1 && pool.num_threads > 0 && num > 1) {
+		pthread_mutex_lock(&pool.lock);
+		pool.func = func;
+		pool.arg = arg;
+		pool.num = num;
+		pool.next = 0;
+		pool.active = nthreads - 1;
+		if (pool.active > pool.num_threads)
+			pool.active = pool.num_threads;
+		pool.block = num / ((pool.active + 1) * POOL_BLOCKS_PER_THREAD);
+		if (pool.block < 1)
+			pool.block = 1;
+		pool.busy = pool.num_threads;
+		pool.generation++;
+		pthread_cond_broadcast(&pool.work_cond);
+
+		work_on_job();
+
+		while (pool.busy > 0)
+			pthread_cond_wait(&pool.done_cond, &pool.lock);
+		pool.func = NULL;
+		pool.arg = NULL;
+		pthread_mutex_unlock(&pool.lock);
+		return;
+	}
+#endif /* WIN32 */
+
+	for (i = 0; i < num; i++)
+		func(i, arg);
+}
+
+/**
+ * @brief
+ * 		is the calling thread one of the pool's worker threads?
+ *
+ * @return	int
+ * @retval	1	: called from a worker thread
+ * @retval	0	: called from the main thread
+ */
+int
+in_thread_pool_worker(void)
+{
+#ifndef WIN32
+	return is_pool_worker;
+#else
+	return 0;
+#endif /* WIN32 */
+}
+
+/**
+ * @brief
+ * 		stop the worker threads and wait for them to exit
+ *
+ * @par MT-Safe: no - only call from the main thread
+ *
+ * @return void
+ */
+void
+shutdown_thread_pool(void)
+{
+#ifndef WIN32
+	int i;
+
+	pool.size = 0;
+	if (pool.num_threads == 0)
+		return;
+
+	pthread_mutex_lock(&pool.lock);
+	pool.shutdown = 1;
+	pthread_cond_broadcast(&pool.work_cond);
+	pthread_mutex_unlock(&pool.lock);
+
+	for (i = 0; i < pool.num_threads; i++)
+		pthread_join(pool.threads[i], NULL);
+
+	free(pool.threads);
+	pool.threads = NULL;
+	pool.num_threads = 0;
+	pool.shutdown = 0;
+#endif /* WIN32 */
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+#ifndef	_THREAD_POOL_H
+#define	_THREAD_POOL_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/* work function run by the thread pool for each index of a job */
+typedef void (*pool_func)(int index, void *arg);
+
+/*
+ *	run_in_thread_pool - call func(i, arg) for every i in [0, num) using
+ *			     nthreads threads (including the calling thread)
+ *			     returns once every call has finished
+ */
+void run_in_thread_pool(int nthreads, int num, pool_func func, void *arg);
+
+/*
+ *	in_thread_pool_worker - is the calling thread a worker thread?
+ */
+int in_thread_pool_worker(void);
+
+/*
+ *	shutdown_thread_pool - stop and join the worker threads
+ */
+void shutdown_thread_pool(void);
+
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* _THREAD_POOL_H */
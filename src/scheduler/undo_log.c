@@ -0,0 +1,868 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+/**
+ * @file    undo_log.c
+ *
+ * @brief
+ * 		undo_log.c - This file contains the undo log used to run a
+ *		simulation directly on a universe.  Instead of duplicating the
+ *		whole universe before a simulation, the code which changes the
+ *		universe records the old contents of what it changes.  Undoing
+ *		the simulation puts back what was recorded, so a simulation
+ *		only pays for the objects it touches.
+ *
+ *		There are four kinds of records:
+ *		  bytes - a copy of memory taken before it was changed
+ *		  ptr   - an owned pointer and its original value.  Whatever
+ *			  the simulation leaves there is freed.
+ *		  new   - an object created by the simulation, freed on undo
+ *		  call  - a function which reverses a change (e.g. unlinking
+ *			  an event from the calendar)
+ *
+ *		Only the first save of a piece of memory is kept, so saving
+ *		the same object many times is cheap.  Changes to an object
+ *		created by the simulation are never recorded since the object
+ *		itself is freed on undo.
+ *
+ * Functions included are:
+ * 	new_undo_log()
+ * 	free_undo_log()
+ * 	start_undo_log()
+ * 	end_undo_log()
+ * 	undo_changes()
+ * 	undo_save()
+ * 	undo_own()
+ * 	undo_free_ptr()
+ * 	undo_copy_ptr()
+ * 	undo_copy_array()
+ * 	undo_new()
+ * 	undo_call()
+ * 	undo_is_new()
+ * 	undo_owner()
+ * 	undo_resource_resv()
+ * 	undo_resource()
+ * 	undo_counts()
+ * 	undo_node_partition()
+ * 	undo_node_partitions()
+ * 	undo_bucket_bit()
+ *
+ */
+#include <pbs_config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <log.h>
+#include <avltree.h>
+#include "undo_log.h"
+#include "constant.h"
+#include "misc.h"
+#include "server_info.h"
+#include "resource_resv.h"
+#include "node_partition.h"
+#include "pbs_bitmap.h"
+
+/* kinds of undo records */
+enum undo_type {
+	UNDO_BYTES,
+	UNDO_PTR,
+	UNDO_NEW,
+	UNDO_CALL
+};
+
+struct undo_rec {
+	enum undo_type type;
+	void *addr;		/* memory saved, pointer field, new object, or call arg */
+	size_t len;		/* length of the memory saved */
+	void *data;		/* saved memory or the original value of a pointer */
+	void *cur;		/* value of a pointer field when undoing */
+	undo_func_t func;	/* free function or function to call */
+};
+
+/* key of the index of what has been recorded.  Memory is keyed on its
+ * address and length, pointer fields and new objects on their address and
+ * one of the special lengths below
+ */
+struct undo_key {
+	void *addr;
+	size_t len;
+};
+
+#define UNDO_PTR_KEY ((size_t) -1)
+#define UNDO_NEW_KEY ((size_t) -2)
+
+struct undo_log {
+	struct undo_rec *recs;
+	int num_recs;
+	int max_recs;
+	AVL_IX_DESC *index;	/* undo_key -> record index + 1 */
+};
+
+/**
+ * @brief
+ *		find a record in an undo log's index
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	addr	-	address recorded
+ * @param[in]	len	-	length or special key
+ *
+ * @return	int
+ * @retval	index of the record + 1
+ * @retval	0	: not recorded
+ */
+static int
+find_undo_rec(undo_log *ul, void *addr, size_t len)
+{
+	struct undo_key key;
+
+	memset(&key, 0, sizeof(key));
+	key.addr = addr;
+	key.len = len;
+
+	return (int) (long) find_tree(ul->index, &key);
+}
+
+/**
+ * @brief
+ *		index a record of an undo log
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	addr	-	address recorded
+ * @param[in]	key_len	-	length or special key to index the record with
+ * @param[in]	recnum	-	index of the record
+ *
+ * @return	int
+ * @retval	1	: success
+ * @retval	0	: on error
+ */
+static int
+index_undo_rec(undo_log *ul, void *addr, size_t key_len, int recnum)
+{
+	struct undo_key key;
+
+	memset(&key, 0, sizeof(key));
+	key.addr = addr;
+	key.len = key_len;
+
+	/* A copy made by undo_copy_ptr() which the simulation reallocated
+	 * (e.g. an array grown by add_resresv_to_array()) leaves its old
+	 * address indexed as new.  The address now belongs to another object.
+	 */
+	if (key_len == UNDO_NEW_KEY && find_tree(ul->index, &key) != NULL)
+		tree_add_del(ul->index, &key, NULL, TREE_OP_DEL);
+
+	if (tree_add_del(ul->index, &key, (void *) (long) (recnum + 1), TREE_OP_ADD) != 0) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * @brief
+ *		add a record to an undo log and optionally to its index
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	type	-	type of record
+ * @param[in]	addr	-	address recorded
+ * @param[in]	len	-	length of memory recorded
+ * @param[in]	key_len	-	length to index the record with, 0 for none
+ *
+ * @return	struct undo_rec *
+ * @retval	the new record
+ * @retval	NULL	: on error
+ */
+static struct undo_rec *
+add_undo_rec(undo_log *ul, enum undo_type type, void *addr, size_t len, size_t key_len)
+{
+	struct undo_rec *rec;
+
+	if (ul->num_recs == ul->max_recs) {
+		int max = ul->max_recs == 0 ? 256 : ul->max_recs * 2;
+
+		rec = realloc(ul->recs, max * sizeof(struct undo_rec));
+		if (rec == NULL) {
+			log_err(errno, __func__, MEM_ERR_MSG);
+			return NULL;
+		}
+		ul->recs = rec;
+		ul->max_recs = max;
+	}
+
+	if (key_len != 0 && !index_undo_rec(ul, addr, key_len, ul->num_recs))
+		return NULL;
+
+	rec = &ul->recs[ul->num_recs++];
+	rec->type = type;
+	rec->addr = addr;
+	rec->len = len;
+	rec->data = NULL;
+	rec->cur = NULL;
+	rec->func = NULL;
+
+	return rec;
+}
+
+/**
+ * @brief
+ *		undo_log constructor
+ *
+ * @return	undo_log *
+ * @retval	new undo log
+ * @retval	NULL	: on error
+ */
+undo_log *
+new_undo_log(void)
+{
+	undo_log *ul;
+
+	if ((ul = malloc(sizeof(undo_log))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return NULL;
+	}
+
+	ul->recs = NULL;
+	ul->num_recs = 0;
+	ul->max_recs = 0;
+	if ((ul->index = create_tree(AVL_NO_DUP_KEYS, sizeof(struct undo_key))) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		free(ul);
+		return NULL;
+	}
+
+	return ul;
+}
+
+/**
+ * @brief
+ *		undo the changes still recorded in an undo log and free it
+ *
+ * @param[in]	ul	-	the undo log
+ *
+ * @return	void
+ */
+void
+free_undo_log(undo_log *ul)
+{
+	if (ul == NULL)
+		return;
+
+	undo_changes(ul);
+	avl_destroy_index(ul->index);
+	free(ul->index);
+	free(ul->recs);
+	free(ul);
+}
+
+/**
+ * @brief
+ *		start recording the changes made to a universe.  Simulations
+ *		can't be nested.
+ *
+ * @param[in]	sinfo	-	the universe
+ *
+ * @return	int
+ * @retval	1	: the changes are being recorded
+ * @retval	0	: on error
+ */
+int
+start_undo_log(server_info *sinfo)
+{
+	if (sinfo == NULL || sinfo->undo != NULL)
+		return 0;
+
+	if ((sinfo->undo = new_undo_log()) == NULL)
+		return 0;
+
+	/* Like a duplicated universe, the simulation starts with an empty
+	 * node partition cache.  The real cache is put back on undo.
+	 */
+	undo_free_ptr(sinfo->undo, (void **) &sinfo->npc_arr, (undo_func_t) free_np_cache_array);
+
+	return 1;
+}
+
+/**
+ * @brief
+ *		undo the changes made to a universe since start_undo_log()
+ *		and stop recording
+ *
+ * @param[in]	sinfo	-	the universe
+ *
+ * @return	void
+ */
+void
+end_undo_log(server_info *sinfo)
+{
+	undo_log *ul;
+
+	if (sinfo == NULL || sinfo->undo == NULL)
+		return;
+
+	/* nothing done while undoing is recorded */
+	ul = sinfo->undo;
+	sinfo->undo = NULL;
+	undo_changes(ul);
+	/* the saved copy of the server put the log back */
+	sinfo->undo = NULL;
+	free_undo_log(ul);
+}
+
+/**
+ * @brief
+ *		undo every change recorded in an undo log and empty it.
+ *
+ * @par
+ *		Calls are made first, newest first, while everything they may
+ *		look at is still allocated.  Saved memory is then put back,
+ *		newest first so the oldest copy of memory saved more than
+ *		once wins.  Pointer fields are set back last since saved
+ *		memory may hold a newer value of them.  Nothing is freed
+ *		until everything has been put back.
+ *
+ * @param[in]	ul	-	the undo log
+ *
+ * @return	void
+ */
+void
+undo_changes(undo_log *ul)
+{
+	int i;
+	struct undo_rec *rec;
+
+	if (ul == NULL || ul->num_recs == 0)
+		return;
+
+	for (i = 0; i < ul->num_recs; i++) {
+		rec = &ul->recs[i];
+		if (rec->type == UNDO_PTR)
+			rec->cur = *((void **) rec->addr);
+	}
+
+	for (i = ul->num_recs - 1; i >= 0; i--) {
+		rec = &ul->recs[i];
+		if (rec->type == UNDO_CALL)
+			rec->func(rec->addr);
+	}
+
+	for (i = ul->num_recs - 1; i >= 0; i--) {
+		rec = &ul->recs[i];
+		if (rec->type == UNDO_BYTES)
+			memcpy(rec->addr, rec->data, rec->len);
+	}
+
+	for (i = 0; i < ul->num_recs; i++) {
+		rec = &ul->recs[i];
+		if (rec->type == UNDO_PTR)
+			*((void **) rec->addr) = rec->data;
+	}
+
+	for (i = ul->num_recs - 1; i >= 0; i--) {
+		rec = &ul->recs[i];
+		switch (rec->type) {
+			case UNDO_BYTES:
+				free(rec->data);
+				break;
+			case UNDO_PTR:
+				if (rec->cur != NULL && rec->cur != rec->data && rec->func != NULL)
+					rec->func(rec->cur);
+				break;
+			case UNDO_NEW:
+				if (rec->func != NULL)
+					rec->func(rec->addr);
+				break;
+			case UNDO_CALL:
+				break;
+		}
+	}
+
+	ul->num_recs = 0;
+	avl_destroy_index(ul->index);
+	avl_create_index(ul->index, AVL_NO_DUP_KEYS, sizeof(struct undo_key));
+}
+
+/**
+ * @brief
+ *		save memory before it is changed
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	addr	-	memory to save
+ * @param[in]	len	-	length of memory
+ *
+ * @return	void
+ */
+void
+undo_save(undo_log *ul, void *addr, size_t len)
+{
+	struct undo_rec *rec;
+	void *data;
+
+	if (ul == NULL || addr == NULL || len == 0)
+		return;
+
+	if (find_undo_rec(ul, addr, len))
+		return;
+
+	if ((data = malloc(len)) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return;
+	}
+	memcpy(data, addr, len);
+
+	if ((rec = add_undo_rec(ul, UNDO_BYTES, addr, len, len)) == NULL) {
+		free(data);
+		return;
+	}
+	rec->data = data;
+}
+
+/**
+ * @brief
+ *		record an owned pointer before it is replaced.  The original
+ *		value is put back on undo and the value the simulation puts
+ *		there is freed.
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	field	-	the pointer field
+ * @param[in]	free_func	-	function to free a value of the field
+ *
+ * @return	void
+ */
+void
+undo_own(undo_log *ul, void **field, undo_func_t free_func)
+{
+	struct undo_rec *rec;
+
+	if (ul == NULL || field == NULL)
+		return;
+
+	if (find_undo_rec(ul, field, UNDO_PTR_KEY))
+		return;
+
+	if ((rec = add_undo_rec(ul, UNDO_PTR, field, sizeof(void *), UNDO_PTR_KEY)) == NULL)
+		return;
+	rec->data = *field;
+	rec->func = free_func;
+}
+
+/**
+ * @brief
+ *		free an owned pointer and set it to NULL.  If the pointer is
+ *		the original value of the field, it is kept until undo.
+ *
+ * @param[in]	ul	-	the undo log (NULL to free the pointer now)
+ * @param[in]	field	-	the pointer field
+ * @param[in]	free_func	-	function to free a value of the field
+ *
+ * @return	void
+ */
+void
+undo_free_ptr(undo_log *ul, void **field, undo_func_t free_func)
+{
+	int i;
+
+	if (field == NULL)
+		return;
+
+	if (ul == NULL) {
+		if (*field != NULL)
+			free_func(*field);
+		*field = NULL;
+		return;
+	}
+
+	if ((i = find_undo_rec(ul, field, UNDO_PTR_KEY)) == 0)
+		undo_own(ul, field, free_func);
+	else if (*field != NULL && *field != ul->recs[i - 1].data)
+		free_func(*field);
+
+	*field = NULL;
+}
+
+/**
+ * @brief
+ *		replace an owned pointer by a copy the simulation may change
+ *		(copy on write).  The copy is freed and the original put back
+ *		on undo.  Nothing is done if the field already holds a value
+ *		of the simulation's.
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	field	-	the pointer field
+ * @param[in]	copy_func	-	function to copy a value of the field
+ * @param[in]	free_func	-	function to free a value of the field
+ *
+ * @return	void
+ */
+void
+undo_copy_ptr(undo_log *ul, void **field, undo_copy_func_t copy_func,
+	undo_func_t free_func)
+{
+	int i;
+	void *copy;
+
+	if (ul == NULL || field == NULL)
+		return;
+
+	if ((i = find_undo_rec(ul, field, UNDO_PTR_KEY)) == 0) {
+		undo_own(ul, field, free_func);
+		if ((i = find_undo_rec(ul, field, UNDO_PTR_KEY)) == 0)
+			return;
+	}
+	else if (*field != ul->recs[i - 1].data)
+		return;
+
+	if (*field == NULL)
+		return;
+
+	if ((copy = copy_func(*field)) == NULL) {
+		log_err(errno, __func__, MEM_ERR_MSG);
+		return;
+	}
+
+	/* The copy is freed by the pointer record.  It is only indexed as new
+	 * so changes to it aren't recorded.
+	 */
+	index_undo_rec(ul, copy, UNDO_NEW_KEY, i - 1);
+	*field = copy;
+}
+
+/**
+ * @brief
+ *		copy a NULL terminated array of pointers
+ *
+ * @param[in]	arr	-	the array
+ *
+ * @return	void *
+ * @retval	the copy
+ * @retval	NULL	: on error
+ */
+static void *
+copy_ptr_array(void *arr)
+{
+	void **narr;
+	int n;
+
+	n = count_array(arr);
+	if ((narr = malloc((n + 1) * sizeof(void *))) == NULL)
+		return NULL;
+	memcpy(narr, arr, (n + 1) * sizeof(void *));
+
+	return narr;
+}
+
+/**
+ * @brief
+ *		undo_copy_ptr() for a NULL terminated array of pointers.  Used
+ *		for arrays which may be reallocated by the simulation.
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	arr	-	the array field
+ *
+ * @return	void
+ */
+void
+undo_copy_array(undo_log *ul, void ***arr)
+{
+	undo_copy_ptr(ul, (void **) arr, copy_ptr_array, free);
+}
+
+/**
+ * @brief
+ *		free an object created by the simulation on undo.  Changes to
+ *		the object are not recorded from now on.
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	obj	-	the new object
+ * @param[in]	free_func	-	function to free the object
+ *
+ * @return	void
+ */
+void
+undo_new(undo_log *ul, void *obj, undo_func_t free_func)
+{
+	struct undo_rec *rec;
+	int i;
+
+	if (ul == NULL || obj == NULL)
+		return;
+
+	/* already freed on undo */
+	if ((i = find_undo_rec(ul, obj, UNDO_NEW_KEY)) != 0 && ul->recs[i - 1].type == UNDO_NEW)
+		return;
+
+	if ((rec = add_undo_rec(ul, UNDO_NEW, obj, 0, UNDO_NEW_KEY)) == NULL)
+		return;
+	rec->func = free_func;
+}
+
+/**
+ * @brief
+ *		call a function which reverses a change on undo
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	func	-	the function to call
+ * @param[in]	arg	-	argument to pass func
+ *
+ * @return	void
+ */
+void
+undo_call(undo_log *ul, undo_func_t func, void *arg)
+{
+	struct undo_rec *rec;
+
+	if (ul == NULL || func == NULL)
+		return;
+
+	if ((rec = add_undo_rec(ul, UNDO_CALL, arg, 0, 0)) == NULL)
+		return;
+	rec->func = func;
+}
+
+/**
+ * @brief
+ *		was an object created since the log was started
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	obj	-	the object
+ *
+ * @return	int
+ * @retval	1	: the object is new
+ * @retval	0	: the object is not new or there is no log
+ */
+int
+undo_is_new(undo_log *ul, void *obj)
+{
+	if (ul == NULL || obj == NULL)
+		return 0;
+
+	return find_undo_rec(ul, obj, UNDO_NEW_KEY) != 0;
+}
+
+/**
+ * @brief
+ *		the log to record the changes to an object's fields in.
+ *		Changes to objects created by the simulation aren't recorded.
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	obj	-	the object
+ *
+ * @return	undo_log *
+ * @retval	ul
+ * @retval	NULL	: the object is new
+ */
+undo_log *
+undo_owner(undo_log *ul, void *obj)
+{
+	if (undo_is_new(ul, obj))
+		return NULL;
+
+	return ul;
+}
+
+/**
+ * @brief
+ *		save a resource_resv and its job_info or resresv_info
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	resresv	-	the resource_resv
+ *
+ * @return	void
+ */
+void
+undo_resource_resv(undo_log *ul, resource_resv *resresv)
+{
+	if (ul == NULL || resresv == NULL || undo_is_new(ul, resresv))
+		return;
+
+	undo_save(ul, resresv, sizeof(resource_resv));
+	if (resresv->job != NULL)
+		undo_save(ul, resresv->job, sizeof(job_info));
+	if (resresv->resv != NULL)
+		undo_save(ul, resresv->resv, sizeof(resv_info));
+}
+
+/**
+ * @brief
+ *		save the amount assigned of a resource
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	res	-	the resource
+ *
+ * @return	void
+ */
+void
+undo_resource(undo_log *ul, schd_resource *res)
+{
+	if (res == NULL)
+		return;
+
+	undo_save(ul, &res->assigned, sizeof(res->assigned));
+}
+
+/**
+ * @brief
+ *		save a counts structure and replace its resource counts by a
+ *		copy.  The name index and tail of a list are changed only
+ *		when counts are added, see update_counts_list_on_run().
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	cts	-	the counts
+ *
+ * @return	void
+ */
+void
+undo_counts(undo_log *ul, counts *cts)
+{
+	if (ul == NULL || cts == NULL || undo_is_new(ul, cts))
+		return;
+
+	undo_save(ul, &cts->running, sizeof(cts->running));
+	undo_copy_ptr(ul, (void **) &cts->rescts,
+		(undo_copy_func_t) dup_resource_req_list,
+		(undo_func_t) free_resource_req_list);
+}
+
+/**
+ * @brief
+ *		save a node partition, replace its resources by a copy and
+ *		save the order of its nodes
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	np	-	the node partition
+ *
+ * @return	void
+ */
+void
+undo_node_partition(undo_log *ul, node_partition *np)
+{
+	if (ul == NULL || np == NULL)
+		return;
+
+	undo_save(ul, np, sizeof(node_partition));
+	undo_copy_ptr(ul, (void **) &np->res,
+		(undo_copy_func_t) dup_resource_list,
+		(undo_func_t) free_resource_list);
+	if (np->ninfo_arr != NULL)
+		undo_save(ul, np->ninfo_arr, (np->tot_nodes + 1) * sizeof(node_info *));
+}
+
+/**
+ * @brief
+ *		save an array of node partitions before they are updated
+ *		and resorted
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	nodepart	-	the node partition array
+ * @param[in]	num_parts	-	number of partitions in nodepart
+ *
+ * @return	void
+ */
+void
+undo_node_partitions(undo_log *ul, node_partition **nodepart, int num_parts)
+{
+	int i;
+
+	if (ul == NULL || nodepart == NULL)
+		return;
+
+	undo_save(ul, nodepart, num_parts * sizeof(node_partition *));
+	for (i = 0; nodepart[i] != NULL; i++)
+		undo_node_partition(ul, nodepart[i]);
+}
+
+/**
+ * @brief
+ *		copy a bitmap
+ *
+ * @param[in]	bm	-	the bitmap
+ *
+ * @return	void *
+ * @retval	the copy
+ * @retval	NULL	: on error
+ */
+static void *
+copy_bitmap(void *bm)
+{
+	pbs_bitmap *nbm;
+
+	if ((nbm = pbs_bitmap_alloc(NULL, ((pbs_bitmap *) bm)->num_bits)) == NULL)
+		return NULL;
+	if (!pbs_bitmap_assign(nbm, bm)) {
+		pbs_bitmap_free(nbm);
+		return NULL;
+	}
+
+	return nbm;
+}
+
+/**
+ * @brief
+ *		save the bit of a node in a bucket pool before it is turned
+ *		on or off.  If the bitmap has to grow, it is copied instead.
+ *
+ * @param[in]	ul	-	the undo log
+ * @param[in]	bp	-	the bucket pool
+ * @param[in]	bit	-	the bit
+ *
+ * @return	void
+ */
+void
+undo_bucket_bit(undo_log *ul, bucket_bitpool *bp, int bit)
+{
+	pbs_bitmap *bm;
+	int word_bits;
+
+	if (ul == NULL || bp == NULL || bp->truth == NULL)
+		return;
+
+	undo_save(ul, &bp->truth_ct, sizeof(bp->truth_ct));
+
+	bm = bp->truth;
+	if (undo_is_new(ul, bm))
+		return;
+
+	word_bits = sizeof(unsigned long) * 8;
+	if (bit < bm->num_bits)
+		undo_save(ul, &bm->bits[bit / word_bits], sizeof(unsigned long));
+	else
+		undo_copy_ptr(ul, (void **) &bp->truth, copy_bitmap,
+			(undo_func_t) pbs_bitmap_free);
+}
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 1994-2018 Altair Engineering, Inc.
+ * For more information, contact Altair at www.altair.com.
+ *
+ * This file is part of the PBS Professional ("PBS Pro") software.
+ *
+ * Open Source License Information:
+ *
+ * PBS Pro is free software. You can redistribute it and/or modify it under the
+ * terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * Commercial License Information:
+ *
+ * For a copy of the commercial license terms and conditions,
+ * go to: (http://www.pbspro.com/UserArea/agreement.html)
+ * or contact the Altair Legal Department.
+ *
+ * Altair’s dual-license business model allows companies, individuals, and
+ * organizations to create proprietary derivative works of PBS Pro and
+ * distribute them - whether embedded or bundled with other software -
+ * under a commercial license agreement.
+ *
+ * Use of Altair’s trademarks, including but not limited to "PBS™",
+ * "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+ * trademark licensing policies.
+ *
+ */
+
+#ifndef	_UNDO_LOG_H
+#define	_UNDO_LOG_H
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "data_types.h"
+
+/* function which frees an object or reverses a change */
+typedef void (*undo_func_t)(void *);
+
+/* function which copies an object */
+typedef void *(*undo_copy_func_t)(void *);
+
+/*
+ * An undo log records the changes a simulation makes to a universe so they
+ * can be undone in time proportional to the number of changes rather than
+ * by duplicating the universe first.  While server_info -> undo is set,
+ * the update_*_on_run() and update_*_on_end() functions and the calendar
+ * record every change they make.  All of the functions below do nothing
+ * (or just make the change) when passed a NULL log.
+ */
+
+/*
+ *	new_undo_log - undo_log constructor
+ */
+undo_log *new_undo_log(void);
+
+/*
+ *	free_undo_log - undo the changes still in a log and free it
+ */
+void free_undo_log(undo_log *ul);
+
+/*
+ *	start_undo_log - start recording the changes made to a universe
+ *			 returns 1 on success and 0 on error
+ */
+int start_undo_log(server_info *sinfo);
+
+/*
+ *	end_undo_log - undo the changes made to a universe since
+ *		       start_undo_log() and stop recording
+ */
+void end_undo_log(server_info *sinfo);
+
+/*
+ *	undo_changes - undo every change recorded in a log and empty it
+ */
+void undo_changes(undo_log *ul);
+
+/*
+ *	undo_save - save memory before it is changed
+ */
+void undo_save(undo_log *ul, void *addr, size_t len);
+
+/*
+ *	undo_own - record an owned pointer before it is replaced.  A value
+ *		   the simulation puts there is freed with free_func
+ */
+void undo_own(undo_log *ul, void **field, undo_func_t free_func);
+
+/*
+ *	undo_free_ptr - free an owned pointer and set it to NULL.  The original
+ *			value is kept until the changes are undone
+ */
+void undo_free_ptr(undo_log *ul, void **field, undo_func_t free_func);
+
+/*
+ *	undo_copy_ptr - replace an owned pointer with a copy to be changed by
+ *			the simulation (copy on write)
+ */
+void undo_copy_ptr(undo_log *ul, void **field, undo_copy_func_t copy_func,
+	undo_func_t free_func);
+
+/*
+ *	undo_copy_array - undo_copy_ptr() for a NULL terminated array
+ *			  of pointers
+ */
+void undo_copy_array(undo_log *ul, void ***arr);
+
+/*
+ *	undo_new - free an object created by the simulation when the changes
+ *		   are undone.  Changes to the object aren't recorded.
+ */
+void undo_new(undo_log *ul, void *obj, undo_func_t free_func);
+
+/*
+ *	undo_call - call a function which reverses a change when the changes
+ *		    are undone
+ */
+void undo_call(undo_log *ul, undo_func_t func, void *arg);
+
+/*
+ *	undo_is_new - was an object created since the log was started
+ */
+int undo_is_new(undo_log *ul, void *obj);
+
+/*
+ *	undo_owner - the log to record changes to an object in: NULL if the
+ *		     object was created since the log was started
+ */
+undo_log *undo_owner(undo_log *ul, void *obj);
+
+/*
+ *	undo_resource_resv - save a resource_resv and its job or reservation
+ */
+void undo_resource_resv(undo_log *ul, resource_resv *resresv);
+
+/*
+ *	undo_resource - save the amount assigned of a resource
+ */
+void undo_resource(undo_log *ul, schd_resource *res);
+
+/*
+ *	undo_counts - save a counts structure and its resource counts
+ */
+void undo_counts(undo_log *ul, counts *cts);
+
+/*
+ *	undo_node_partition - save a node partition and its resources
+ */
+void undo_node_partition(undo_log *ul, node_partition *np);
+
+/*
+ *	undo_node_partitions - save an array of node partitions
+ */
+void undo_node_partitions(undo_log *ul, node_partition **nodepart, int num_parts);
+
+/*
+ *	undo_bucket_bit - save the bit of a node in a bucket pool
+ */
+void undo_bucket_bit(undo_log *ul, bucket_bitpool *bp, int bit);
+
+#ifdef	__cplusplus
+}
+#endif
+#endif	/* _UNDO_LOG_H */
@@ -690,6 +690,14 @@ dis_request_read(int sfds, struct batch_request *request)
 			decode_DIS_ModifyResv(sfds, request);
 			break;
 
+		case PBS_BATCH_ModifyJobs:
+			rc = decode_DIS_ModifyJobs(sfds, request);
+			break;
+
+		case PBS_BATCH_AsyrunJobs:
+			rc = decode_DIS_RunJobs(sfds, request);
+			break;
+
 #else	/* yes PBS_MOM */
 
 		case PBS_BATCH_CopyHookFile:
@@ -736,7 +744,8 @@ dis_request_read(int sfds, struct batch_request *request)
 			rc, request->rq_type);
 		log_event(PBSEVENT_DEBUG, PBS_EVENTCLASS_REQUEST,
 			LOG_DEBUG, "?", log_buffer);
-		rc = PBSE_DISPROTO;
+		if (rc != PBSE_PROTOCOL)
+			rc = PBSE_DISPROTO;
 	}
 
 	return (rc);
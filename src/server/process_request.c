@@ -61,6 +61,7 @@
  *	dispatch_request()
  *	close_client()
  *	alloc_br()
+ *	alloc_jobent_br()
  *	close_quejob()
  *	free_rescrq()
  *	arrayfree()
@@ -68,6 +69,7 @@
  *	decode_DIS_PySpawn()
  *	free_br()
  *	freebr_manage()
+ *	freebr_jobs()
  *	freebr_cpyfile()
  *	freebr_cpyfile_cred()
  *	parse_servername()
@@ -132,6 +134,7 @@ extern void   req_stat_hook(struct batch_request *);
 /* Private functions local to this file */
 
 static void freebr_manage(struct rq_manage *);
+static void freebr_jobs(struct rq_jobs *);
 static void freebr_cpyfile(struct rq_cpyfile *);
 static void freebr_cpyfile_cred(struct rq_cpyfile_cred *);
 static void close_quejob(int sfds);
@@ -690,6 +693,7 @@ process_request(int sfds)
 	if (server.sv_attr[(int)SRV_ATR_State].at_val.at_long > SV_STATE_RUN) {
 		switch (request->rq_type) {
 			case PBS_BATCH_AsyrunJob:
+			case PBS_BATCH_AsyrunJobs:
 			case PBS_BATCH_JobCred:
 			case PBS_BATCH_UserCred:
 			case PBS_BATCH_UserMigrate:
@@ -979,6 +983,12 @@ dispatch_request(int sfds, struct batch_request *request)
 			req_modifyjob(request);
 			break;
 
+#ifndef PBS_MOM
+		case PBS_BATCH_ModifyJobs:
+			req_modifyjobs(request);
+			break;
+#endif
+
 		case PBS_BATCH_Rerun:
 			req_rerunjob(request);
 			break;
@@ -1014,6 +1024,10 @@ dispatch_request(int sfds, struct batch_request *request)
 			req_runjob(request);
 			break;
 
+		case PBS_BATCH_AsyrunJobs:
+			req_asyrunjobs(request);
+			break;
+
 		case PBS_BATCH_DefSchReply:
 			req_defschedreply(request);
 			break;
@@ -1267,6 +1281,65 @@ struct batch_request *alloc_br(int type)
 	return (req);
 }
 
+/**
+ * @brief
+ * 		alloc_jobent_br - allocate the child request for one entry of a
+ *		multi-job request such as ModifyJobs
+ *
+ * @par Functionality:
+ *		The first call sets up the parent's BATCH_REPLY_CHOICE_JobCodes reply.
+ *		The child inherits the client and permission information of the
+ *		parent and, when its reply is sent, stores its code in entry 'idx'
+ *		of the parent's reply instead of the parent's brp_code.  Unlike
+ *		the subjob children of dup_br_for_subjob(), the child owns its
+ *		request data, which free_br() releases.
+ *
+ * @param[in,out]	parent	- the multi-job request
+ * @param[in]	type	- type of the child request
+ * @param[in]	idx	- index of the entry in the parent request
+ *
+ * @return	batch_request *
+ * @retval	NULL	- error
+ */
+
+struct batch_request *
+alloc_jobent_br(struct batch_request *parent, int type, int idx)
+{
+	struct batch_request *req;
+	struct brp_jobcodes *pcodes = &parent->rq_reply.brp_un.brp_jobcodes;
+
+	if (parent->rq_reply.brp_choice != BATCH_REPLY_CHOICE_JobCodes) {
+		pcodes->brp_codes = (int *)calloc(parent->rq_ind.rq_jobs.rq_njobs, sizeof(int));
+		if (pcodes->brp_codes == NULL) {
+			log_err(errno, __func__, msg_err_malloc);
+			return NULL;
+		}
+		pcodes->brp_njobs = parent->rq_ind.rq_jobs.rq_njobs;
+		parent->rq_reply.brp_choice = BATCH_REPLY_CHOICE_JobCodes;
+	}
+
+	req = alloc_br(type);
+	if (req == NULL) {
+		pcodes->brp_codes[idx] = PBSE_SYSTEM;
+		return NULL;
+	}
+
+	req->rq_perm = parent->rq_perm;
+	req->rq_fromsvr = parent->rq_fromsvr;
+	req->rq_conn = parent->rq_conn;
+	req->rq_orgconn = parent->rq_orgconn;
+	req->rq_time = parent->rq_time;
+	strcpy(req->rq_user, parent->rq_user);
+	strcpy(req->rq_host, parent->rq_host);
+	req->rq_extend = parent->rq_extend;
+
+	req->rq_parentbr = parent;
+	req->rq_jobcode = &pcodes->brp_codes[idx];
+	parent->rq_refct++;
+
+	return (req);
+}
+
 /**
  * @brief
  * 		close_quejob - locate and deal with the new job that was being received
@@ -1506,11 +1579,19 @@ free_br(struct batch_request *preq)
 				reply_send(preq->rq_parentbr);
 		}
 
-		if (preq->rppcmd_msgid)
-			free(preq->rppcmd_msgid);
+		if (preq->rq_jobcode == NULL) {
+			if (preq->rppcmd_msgid)
+				free(preq->rppcmd_msgid);
 
-		(void)free(preq);
-		return;
+			(void)free(preq);
+			return;
+		}
+
+		/*
+		 * a multi-job child owns its request data, see
+		 * alloc_jobent_br(), but shares the parent's extension
+		 */
+		preq->rq_extend = NULL;
 	}
 
 	/*
@@ -1564,6 +1645,10 @@ free_br(struct batch_request *preq)
 		case PBS_BATCH_ModifyResv:
 			freebr_manage(&preq->rq_ind.rq_modify);
 			break;
+		case PBS_BATCH_ModifyJobs:
+		case PBS_BATCH_AsyrunJobs:
+			freebr_jobs(&preq->rq_ind.rq_jobs);
+			break;
 
 		case PBS_BATCH_RunJob:
 		case PBS_BATCH_AsyrunJob:
@@ -1639,6 +1724,25 @@ freebr_manage(struct rq_manage *pmgr)
 {
 	free_attrlist(&pmgr->rq_attr);
 }
+/**
+ * @brief
+ * 		free the entries of a multi-job request
+ *
+ * @param[in]	pjobs - request jobs structure.
+ */
+static void
+freebr_jobs(struct rq_jobs *pjobs)
+{
+	int i;
+
+	for (i = 0; i < pjobs->rq_njobs; i++) {
+		free_attrlist(&pjobs->rq_jobs[i].rq_attr);
+		free(pjobs->rq_jobs[i].rq_destin);
+	}
+	free(pjobs->rq_jobs);
+	pjobs->rq_jobs = NULL;
+	pjobs->rq_njobs = 0;
+}
 /**
  * @brief
  * 		remove all the rqfpair and free their memory
@@ -239,7 +239,10 @@ reply_send(struct batch_request *request)
 
 	/* if this is a child request, just move the error to the parent */
 
-	if (request->rq_parentbr) {
+	if (request->rq_jobcode) {
+		/* entry of a multi-job request, the parent replies per job */
+		*request->rq_jobcode = request->rq_reply.brp_code;
+	} else if (request->rq_parentbr) {
 		if ((request->rq_parentbr->rq_reply.brp_choice == BATCH_REPLY_CHOICE_NULL) && (request->rq_parentbr->rq_reply.brp_code == 0)) {
 			request->rq_parentbr->rq_reply.brp_code = request->rq_reply.brp_code;
 			request->rq_parentbr->rq_reply.brp_auxcode = request->rq_reply.brp_auxcode;
@@ -377,6 +380,8 @@ reply_free(struct batch_reply *prep)
 		(void)free(prep->brp_un.brp_rescq.brq_alloc);
 		(void)free(prep->brp_un.brp_rescq.brq_resvd);
 		(void)free(prep->brp_un.brp_rescq.brq_down);
+	} else if (prep->brp_choice == BATCH_REPLY_CHOICE_JobCodes) {
+		(void)free(prep->brp_un.brp_jobcodes.brp_codes);
 	}
 	prep->brp_choice = BATCH_REPLY_CHOICE_NULL;
 }
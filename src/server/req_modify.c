@@ -44,6 +44,7 @@
  * Included funtions are:
  *	post_modify_req()
  *	req_modifyjob()
+ *	req_modifyjobs()
  *	find_name_in_svrattrl()
  *	modify_job_attr()
  */
@@ -412,6 +413,61 @@ req_modifyjob(struct batch_request *preq)
 	reply_ack(preq);
 }
 
+/**
+ * @brief
+ * 		Service the Modify Jobs Request, normally from the scheduler.
+ *
+ * @par	Functionality:
+ *		Each entry is handled as its own Modify Job request by req_modifyjob(),
+ *		so permission checks and hooks are the same as for one job at a time.
+ *		A single reply carrying a code for each entry is sent once every
+ *		entry has completed.
+ *
+ * @param[in] preq - pointer to batch request from client
+ */
+
+void
+req_modifyjobs(struct batch_request *preq)
+{
+	int			i;
+	struct rq_jobent	*pent;
+	struct batch_request	*pchild;
+
+	if (preq->rq_ind.rq_jobs.rq_njobs == 0) {
+		reply_ack(preq);
+		return;
+	}
+
+	/* hold a reference so entries which complete at once don't send the reply */
+	preq->rq_refct++;
+
+	for (i = 0; i < preq->rq_ind.rq_jobs.rq_njobs; i++) {
+		pent = &preq->rq_ind.rq_jobs.rq_jobs[i];
+		pchild = alloc_jobent_br(preq, PBS_BATCH_ModifyJob, i);
+		if (pchild == NULL) {
+			if (preq->rq_reply.brp_choice != BATCH_REPLY_CHOICE_JobCodes)
+				break;
+			continue;
+		}
+		pchild->rq_ind.rq_modify.rq_cmd = MGR_CMD_SET;
+		pchild->rq_ind.rq_modify.rq_objtype = MGR_OBJ_JOB;
+		strcpy(pchild->rq_ind.rq_modify.rq_objname, pent->rq_jid);
+		CLEAR_HEAD(pchild->rq_ind.rq_modify.rq_attr);
+		list_move(&pent->rq_attr, &pchild->rq_ind.rq_modify.rq_attr);
+		req_modifyjob(pchild);
+	}
+
+	if (preq->rq_reply.brp_choice != BATCH_REPLY_CHOICE_JobCodes) {
+		/* could not even set up the reply */
+		preq->rq_refct = 0;
+		req_reject(PBSE_SYSTEM, 0, preq);
+		return;
+	}
+
+	if (--preq->rq_refct == 0)
+		reply_send(preq);
+}
+
 /**
  * @brief
  * 		Returns the svrattrl entry matching attribute 'name', or NULL if not found.
@@ -45,6 +45,7 @@
  *	check_and_provision_job()
  *	clear_from_defr()
  *	req_runjob()
+ *	req_asyrunjobs()
  *	req_runjob2()
  *	clear_exec_on_run_fail()
  *	req_stagein()
@@ -594,6 +595,60 @@ req_runjob(struct batch_request *preq)
 		reply_send(preq);
 	return;
 }
+
+/**
+ * @brief
+ * 		req_asyrunjobs - service the Async Run Jobs Request
+ * @par
+ *		Each entry is handled as its own Async Run Job request by
+ *		req_runjob(), so privilege checks and runjob hooks are the same as
+ *		for one job at a time.  A single reply carrying a code for each
+ *		entry is sent once every entry has been answered.
+ *
+ * @param[in]	preq	-	Async Run Jobs Request
+ */
+
+void
+req_asyrunjobs(struct batch_request *preq)
+{
+	int			i;
+	struct rq_jobent	*pent;
+	struct batch_request	*pchild;
+
+	if (preq->rq_ind.rq_jobs.rq_njobs == 0) {
+		reply_ack(preq);
+		return;
+	}
+
+	/* hold a reference so entries which complete at once don't send the reply */
+	preq->rq_refct++;
+
+	for (i = 0; i < preq->rq_ind.rq_jobs.rq_njobs; i++) {
+		pent = &preq->rq_ind.rq_jobs.rq_jobs[i];
+		pchild = alloc_jobent_br(preq, PBS_BATCH_AsyrunJob, i);
+		if (pchild == NULL) {
+			if (preq->rq_reply.brp_choice != BATCH_REPLY_CHOICE_JobCodes)
+				break;
+			continue;
+		}
+		strcpy(pchild->rq_ind.rq_run.rq_jid, pent->rq_jid);
+		pchild->rq_ind.rq_run.rq_destin = pent->rq_destin;
+		pent->rq_destin = NULL;
+		pchild->rq_ind.rq_run.rq_resch = 0;
+		req_runjob(pchild);
+	}
+
+	if (preq->rq_reply.brp_choice != BATCH_REPLY_CHOICE_JobCodes) {
+		/* could not even set up the reply */
+		preq->rq_refct = 0;
+		req_reject(PBSE_SYSTEM, 0, preq);
+		return;
+	}
+
+	if (--preq->rq_refct == 0)
+		reply_send(preq);
+}
+
 /**
  * @brief
  * 		req_runjob - service the Run Job and Asyc Run Job Requests
@@ -1967,3 +1967,85 @@ else:
         # one for no foores
         self.scheduler.log_match("Number of job equivalence classes: 3",
                                  max_attempts=10, starttime=self.t)
+
+    def test_verdict_cache(self):
+        """
+        Test that with equiv_class_verdict_cache a class which could not
+        run keeps its verdict in the next cycle, and that freeing the
+        resources lets its jobs run
+        """
+        self.scheduler.set_sched_config({'equiv_class_verdict_cache':
+                                         'True'})
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'scheduling': 'False'})
+
+        # Eat up all the resources
+        a = {'Resource_List.select': '1:ncpus=8'}
+        J = Job(TEST_USER, attrs=a)
+        jid1 = self.server.submit(J)
+
+        a = {'Resource_List.select': '1:ncpus=4'}
+        jids = self.submit_jobs(3, a)
+
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'scheduling': 'True'})
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        self.server.expect(JOB, 'comment', op=SET, id=jids[0])
+
+        # the first cycle ran jid1 before the verdict was reached, so it
+        # takes another cycle to cache it.  Nothing changes, so the
+        # cycle after that reuses it.
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'scheduling': 'True'})
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'scheduling': 'True'})
+        self.scheduler.log_match(
+            "Reused can't run verdicts of 1 of 2 job equivalence classes",
+            max_attempts=10, starttime=self.t)
+        m = 'Not Running: Insufficient amount of resource: ncpus'
+        self.server.expect(JOB, {'comment': (MATCH_RE, m)}, id=jids[0])
+
+        # freeing the resources drops the verdict
+        self.server.delete(jid1, wait=True)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[0])
+        self.server.expect(JOB, {'job_state': 'R'}, id=jids[1])
+
+    def test_verdict_cache_limits(self):
+        """
+        Test that a cached limit verdict is only dropped when the limit
+        state of the class changes
+        """
+        self.scheduler.set_sched_config({'equiv_class_verdict_cache':
+                                         'True'})
+        a = {'max_run': '[u:PBS_GENERIC=1]'}
+        self.server.manager(MGR_CMD_SET, SERVER, a)
+
+        a = {'Resource_List.select': '1:ncpus=1'}
+        J = Job(TEST_USER, attrs=a)
+        J.set_sleep_time(1000)
+        jid1 = self.server.submit(J)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        (jid2, ) = self.submit_jobs(1, a)
+        self.server.expect(JOB, 'comment', op=SET, id=jid2)
+
+        # TEST_USER2's job changes the node state, but not TEST_USER's
+        # limit state, so TEST_USER's verdict is reused
+        (jid3, ) = self.submit_jobs(1, a, user=TEST_USER2)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid3)
+        self.scheduler.log_match(
+            "Reused can't run verdicts of 1 of",
+            max_attempts=10, starttime=self.t)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid2)
+
+        # with no overall limit set, the count of all running jobs is not
+        # part of the fingerprint, so the verdict outlives jid3 starting
+        time.sleep(1)
+        t = int(time.time())
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'scheduling': 'True'})
+        self.scheduler.log_match(
+            "Reused can't run verdicts of 1 of",
+            max_attempts=10, starttime=t)
+
+        self.server.delete(jid1, wait=True)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid2)
@@ -338,6 +338,115 @@ class TestMomDynRes(TestFunctional):
         self.server.expect(JOB, {'job_state': 'Q', 'comment': c},
                            id=jid, attrop=PTL_AND)
 
+    def test_refresh_multi_vnode(self):
+        """
+        Test that with mom_resources_refresh a mom serving several vnodes
+        is asked once for all of them, and that its answer is used for
+        every vnode until the refresh time has passed
+        """
+        # The mom dynamic resource script adds a line to this file every
+        # time it is run
+        fpath_count = os.path.join(os.sep, "tmp", "PtlPbs_mom_resc_count")
+        self.du.rm(hostname=self.mom.hostname, path=fpath_count,
+                   force=True, sudo=True)
+
+        a = {'resources_available.ncpus': 1}
+        self.server.create_vnodes('vn', a, 3, self.mom)
+        self.scheduler.set_sched_config({'mom_resources_refresh': '300'})
+
+        resc_name = ["foo"]
+        resc_type = ["long"]
+        resc_flag = ["nh"]
+        script_body = ["echo run >> %s; /bin/echo 3" % fpath_count]
+
+        self.create_mom_resources(resc_name, resc_type, resc_flag, script_body)
+
+        # Submit a job to each vnode that requests the mom dynamic resource
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        jids = []
+        for i in range(3):
+            a = {'Resource_List.select': '1:ncpus=1:foo=3:vnode=vn[%d]' % i}
+            j = Job(TEST_USER, attrs=a)
+            jids.append(self.server.submit(j))
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+
+        # The jobs should run
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+
+        # Run a few more cycles within the refresh time
+        t = int(time.time())
+        for _ in range(3):
+            self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+            self.scheduler.log_match("Leaving Scheduling Cycle",
+                                     starttime=t)
+            time.sleep(1)
+            t = int(time.time())
+
+        # The mom was asked once for all its vnodes
+        ret = self.du.cat(hostname=self.mom.hostname, filename=fpath_count,
+                          sudo=True)
+        self.assertEqual(len(ret['out']), 1)
+        self.scheduler.log_match("Failed to talk with mom", existence=False,
+                                 max_attempts=5)
+
+        self.du.rm(hostname=self.mom.hostname, path=fpath_count,
+                   force=True, sudo=True)
+
+    def test_timeout_no_answer(self):
+        """
+        Test that a mom which does not answer within mom_resources_timeout
+        is given up on for the cycle: its node is marked offline for the
+        cycle if the mom never answered, and its last answer is used if
+        it did
+        """
+        self.scheduler.set_sched_config({'mom_resources_timeout': '2'})
+
+        resc_name = ["foo"]
+        resc_type = ["long"]
+        resc_flag = ["nh"]
+        script_body = ["/bin/echo 3"]
+
+        self.create_mom_resources(resc_name, resc_type, resc_flag, script_body)
+
+        # Restart the scheduler so it has no answers from the mom
+        self.scheduler.restart()
+
+        # A mom that doesn't answer and never did: its node can't be used
+        self.mom.signal('-STOP')
+        try:
+            t = int(time.time())
+            self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+            self.scheduler.log_match("Mom did not answer in time",
+                                     starttime=t)
+            self.scheduler.log_match(
+                "Failed to talk with mom, marking node offline",
+                starttime=t)
+        finally:
+            self.mom.signal('-CONT')
+
+        # Submit a job that requests the mom dynamic resource
+        attr = {"Resource_List." + resc_name[0]: 3}
+        j = Job(TEST_USER, attrs=attr)
+        jid = self.server.submit(j)
+
+        # The job should run
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+
+        # A mom that doesn't answer, but did before: its answer is used
+        self.mom.signal('-STOP')
+        try:
+            t = int(time.time())
+            self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+            self.scheduler.log_match(
+                "Mom did not answer in time, using its answers from",
+                starttime=t)
+            self.scheduler.log_match(
+                "Failed to talk with mom, marking node offline",
+                starttime=t, existence=False, max_attempts=5)
+        finally:
+            self.mom.signal('-CONT')
+
     def tearDown(self):
         #removing all files creating in test
         for i in self.filenames:
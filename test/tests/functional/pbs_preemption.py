@@ -126,3 +126,49 @@ exit 0
         marked as "Job will never run"
         """
         self.submit_and_preempt_jobs(preempt_order='R')
+
+    def test_preempt_resv_jobs_candidates(self):
+        """
+        Test preemption when some of the candidate jobs run inside a
+        reservation: only the job outside the reservation is preempted
+        """
+        a = {'resources_available.ncpus': 2}
+        self.server.manager(MGR_CMD_SET, NODE, a, id=self.mom.shortname,
+                            expect=True)
+
+        # Submit a reservation for half of the node
+        now = int(time.time())
+        r = Reservation(TEST_USER)
+        r.set_attributes({'Resource_List.select': '1:ncpus=1',
+                          'reserve_start': now + 10,
+                          'reserve_end': now + 3600})
+        rid = self.server.submit(r)
+        a = {'reserve_state': (MATCH_RE, 'RESV_CONFIRMED|2')}
+        self.server.expect(RESV, a, id=rid)
+        a = {'reserve_state': (MATCH_RE, 'RESV_RUNNING|5')}
+        self.server.expect(RESV, a, id=rid, offset=10)
+
+        attrs = {ATTR_l + '.select': '1:ncpus=1'}
+
+        # submit a job to the reservation
+        attrs['queue'] = rid.split('.')[0]
+        j1 = Job(TEST_USER, attrs)
+        jid1 = self.server.submit(j1)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+
+        # submit a job to the regular queue
+        del attrs['queue']
+        j2 = Job(TEST_USER, attrs)
+        jid2 = self.server.submit(j2)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid2)
+
+        # submit a job to the high priority queue
+        attrs['queue'] = 'expressq'
+        j3 = Job(TEST_USER, attrs)
+        jid3 = self.server.submit(j3)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid3)
+        self.server.expect(JOB, {'job_state': 'S'}, id=jid2)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid1)
+        self.scheduler.log_match(jid2 + ";Job preempted by suspension")
+        self.scheduler.log_match(jid1 + ";Job preempted by",
+                                 existence=False, max_attempts=5)
@@ -0,0 +1,72 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2018 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# PBS Pro is free software. You can redistribute it and/or modify it under the
+# terms of the GNU Affero General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or (at your option) any
+# later version.
+#
+# PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.
+# See the GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# For a copy of the commercial license terms and conditions,
+# go to: (http://www.pbspro.com/UserArea/agreement.html)
+# or contact the Altair Legal Department.
+#
+# Altair’s dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of PBS Pro and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair’s trademarks, including but not limited to "PBS™",
+# "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+# trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestBatchedJobRuns(TestFunctional):
+
+    """
+    Test that jobs run in throughput mode are sent to the server in
+    batches and all of them start
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 1200}
+        self.server.manager(MGR_CMD_SET, NODE, a, self.mom.shortname,
+                            expect=True)
+        self.server.manager(MGR_CMD_SET, SCHED, {'throughput_mode': 'True'},
+                            expect=True)
+
+    def test_run_many_jobs(self):
+        """
+        Run more jobs in one cycle than fit in one Async Run Jobs request
+        """
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'scheduling': 'False'}, expect=True)
+        a = {'Resource_List.select': '1:ncpus=1', ATTR_J: '1-1100'}
+        j = Job(TEST_USER, a)
+        j.set_sleep_time(1000)
+        jid = self.server.submit(j)
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'scheduling': 'True'}, expect=True)
+        for i in (1, 1000, 1001, 1100):
+            self.server.expect(JOB, {'job_state': 'R'},
+                               id=j.create_subjob_id(jid, i))
+        self.scheduler.log_match('Failed to run', existence=False,
+                                 max_attempts=1)
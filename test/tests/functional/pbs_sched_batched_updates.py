@@ -0,0 +1,90 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2018 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# PBS Pro is free software. You can redistribute it and/or modify it under the
+# terms of the GNU Affero General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or (at your option) any
+# later version.
+#
+# PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.
+# See the GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# For a copy of the commercial license terms and conditions,
+# go to: (http://www.pbspro.com/UserArea/agreement.html)
+# or contact the Altair Legal Department.
+#
+# Altair’s dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of PBS Pro and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair’s trademarks, including but not limited to "PBS™",
+# "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+# trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestBatchedJobUpdates(TestFunctional):
+
+    """
+    Test that job attribute updates the scheduler queues during a cycle
+    are all sent to the server
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 1}
+        self.server.manager(MGR_CMD_SET, NODE, a, self.mom.shortname,
+                            expect=True)
+
+    def test_comments_on_many_jobs(self):
+        """
+        Submit more jobs than fit in one Modify Jobs request and check
+        every job which could not run gets its comment in one cycle
+        """
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'scheduling': 'False'}, expect=True)
+        j = Job(TEST_USER, {'Resource_List.ncpus': 1})
+        j.set_sleep_time(1000)
+        jid = self.server.submit(j)
+        jids = []
+        for _ in range(1100):
+            j = Job(TEST_USER, {'Resource_List.ncpus': 1})
+            jids.append(self.server.submit(j))
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'log_events': 2047}, expect=True)
+        t = int(time.time())
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'scheduling': 'True'}, expect=True)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        msg = 'Not Running: Insufficient amount of resource: ncpus'
+        for qjid in (jids[0], jids[999], jids[1000], jids[-1]):
+            self.server.expect(JOB, {'comment': (MATCH_RE, msg)},
+                               id=qjid)
+        self.scheduler.log_match('Failed to update', existence=False,
+                                 max_attempts=1)
+
+        # The comments were sent with Modify Jobs requests (type 93) of
+        # up to 1000 jobs each, not with one Modify Job request (type 11)
+        # per job
+        lines = self.server.log_match('Type 93 request received from '
+                                      'Scheduler', n='ALL', allmatch=True,
+                                      starttime=t)
+        self.assertGreaterEqual(len(lines), 2)
+        self.server.log_match('Type 11 request received from Scheduler',
+                              n='ALL', starttime=t, existence=False,
+                              max_attempts=1)
@@ -0,0 +1,89 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2018 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# PBS Pro is free software. You can redistribute it and/or modify it under the
+# terms of the GNU Affero General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or (at your option) any
+# later version.
+#
+# PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.
+# See the GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# For a copy of the commercial license terms and conditions,
+# go to: (http://www.pbspro.com/UserArea/agreement.html)
+# or contact the Altair Legal Department.
+#
+# Altair’s dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of PBS Pro and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair’s trademarks, including but not limited to "PBS™",
+# "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+# trademark licensing policies.
+
+
+from tests.functional import *
+
+
+class TestFormulaNative(TestFunctional):
+
+    """
+    Test the scheduler's native job_sort_formula evaluator
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        self.scheduler.set_sched_config({'log_filter': 2048})
+        self.t = int(time.time())
+
+    def submit_and_match(self, formula, select, value):
+        """
+        Set the formula, submit a job and match its formula value
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        self.server.manager(MGR_CMD_SET, SERVER,
+                            {'job_sort_formula': formula})
+        j = Job(TEST_USER, {'Resource_List.select': select})
+        jid = self.server.submit(j)
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+        self.scheduler.log_match(jid + ';Formula Evaluation = ' + value,
+                                 starttime=self.t)
+
+    def test_integer_division(self):
+        """
+        Test that dividing two integers floors like python 2 does
+        """
+        self.submit_and_match('ncpus/2', '1:ncpus=3', '1')
+        self.submit_and_match('ncpus/2.0', '1:ncpus=3', '1.5')
+
+    def test_evaluation_error(self):
+        """
+        Test that an error while evaluating the formula gives 0
+        """
+        self.submit_and_match('"ncpus/(ncpus-1)"', '1:ncpus=1', '0')
+        self.scheduler.log_match('Zero value will be used: '
+                                 'integer division or modulo by zero',
+                                 starttime=self.t)
+
+    def test_python_fallback(self):
+        """
+        Test that a formula with syntax the native evaluator doesn't
+        handle is still evaluated through python
+        """
+        self.submit_and_match('"3 if ncpus > 1 else 5"', '1:ncpus=2', '3')
+        self.scheduler.log_match('Formula will be evaluated by python',
+                                 starttime=self.t)
@@ -0,0 +1,118 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2018 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# PBS Pro is free software. You can redistribute it and/or modify it under the
+# terms of the GNU Affero General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or (at your option) any
+# later version.
+#
+# PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.
+# See the GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# For a copy of the commercial license terms and conditions,
+# go to: (http://www.pbspro.com/UserArea/agreement.html)
+# or contact the Altair Legal Department.
+#
+# Altair’s dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of PBS Pro and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair’s trademarks, including but not limited to "PBS™",
+# "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+# trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestJobQueryDelta(TestFunctional):
+
+    """
+    Test the scheduler's delta job query (job_query_delta)
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 2}
+        self.server.manager(MGR_CMD_SET, NODE, a, self.mom.shortname,
+                            expect=True)
+        self.scheduler.set_sched_config({'log_filter': 2048,
+                                         'job_query_delta': 'True',
+                                         'job_query_resync': 100})
+        self.t = int(time.time())
+
+    def test_cached_jobs_reused(self):
+        """
+        Test that unchanged queued jobs are served from the job status
+        cache and that a job whose mtime changes is queried again
+        """
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'False'})
+        jids = []
+        for _ in range(2):
+            j = Job(TEST_USER, {'Resource_List.select': '1:ncpus=1',
+                                ATTR_h: None})
+            jids.append(self.server.submit(j))
+        j = Job(TEST_USER, {'Resource_List.select': '1:ncpus=2'})
+        jid3 = self.server.submit(j)
+        j = Job(TEST_USER, {'Resource_List.select': '1:ncpus=2'})
+        jid4 = self.server.submit(j)
+
+        # first cycle fills the cache, second one uses it
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid3)
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+        self.scheduler.log_match("Delta job query: [23] jobs from cache",
+                                 regexp=True, starttime=self.t)
+
+        # releasing the held jobs changes their mtime
+        self.server.delete(jid3, wait=True)
+        for jid in jids:
+            self.server.rlsjob(jid, USER_HOLD)
+        for jid in jids:
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.expect(JOB, {'job_state': 'Q'}, id=jid4)
+
+    def test_job_altered_in_cycle_second(self):
+        """
+        Test that a job altered in the same second it was queried by a
+        cycle is queried again by the next cycle rather than served from
+        the job status cache
+        """
+        j = Job(TEST_USER, {'Resource_List.select': '1:ncpus=4'})
+        jid = self.server.submit(j)
+        self.server.expect(JOB, 'comment', op=SET, id=jid)
+
+        # the job's mtime is the second it was submitted and commented
+        # in; alter it right away so the change is likely in that second
+        self.server.alterjob(jid, {'Resource_List.select': '1:ncpus=1'})
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+
+        # a job is queried again until it hasn't changed since well
+        # before it was fetched; then it is served from the cache
+        j = Job(TEST_USER, {'Resource_List.select': '1:ncpus=4'})
+        jid2 = self.server.submit(j)
+        self.server.expect(JOB, 'comment', op=SET, id=jid2)
+        time.sleep(3)
+        t = int(time.time())
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+        self.scheduler.log_match("Delta job query: 0 jobs from cache, "
+                                 "2 jobs fetched", starttime=t)
+        time.sleep(1)
+        t = int(time.time())
+        self.server.manager(MGR_CMD_SET, SERVER, {'scheduling': 'True'})
+        self.scheduler.log_match("Delta job query: 1 jobs from cache, "
+                                 "1 jobs fetched", starttime=t)
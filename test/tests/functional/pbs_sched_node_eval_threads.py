@@ -0,0 +1,80 @@
+# coding: utf-8
+
+# Copyright (C) 1994-2018 Altair Engineering, Inc.
+# For more information, contact Altair at www.altair.com.
+#
+# This file is part of the PBS Professional ("PBS Pro") software.
+#
+# Open Source License Information:
+#
+# PBS Pro is free software. You can redistribute it and/or modify it under the
+# terms of the GNU Affero General Public License as published by the Free
+# Software Foundation, either version 3 of the License, or (at your option) any
+# later version.
+#
+# PBS Pro is distributed in the hope that it will be useful, but WITHOUT ANY
+# WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE.
+# See the GNU Affero General Public License for more details.
+#
+# You should have received a copy of the GNU Affero General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+# Commercial License Information:
+#
+# For a copy of the commercial license terms and conditions,
+# go to: (http://www.pbspro.com/UserArea/agreement.html)
+# or contact the Altair Legal Department.
+#
+# Altair’s dual-license business model allows companies, individuals, and
+# organizations to create proprietary derivative works of PBS Pro and
+# distribute them - whether embedded or bundled with other software -
+# under a commercial license agreement.
+#
+# Use of Altair’s trademarks, including but not limited to "PBS™",
+# "PBS Professional®", and "PBS Pro™" and Altair’s logos is subject to Altair's
+# trademark licensing policies.
+
+from tests.functional import *
+
+
+class TestNodeEvalThreads(TestFunctional):
+
+    """
+    Test checking vnode eligibility with several threads (node_eval_threads)
+    """
+
+    def setUp(self):
+        TestFunctional.setUp(self)
+        a = {'resources_available.ncpus': 1}
+        self.server.create_vnodes('vn', a, 300, self.mom)
+        # make some vnodes ineligible scattered through the list
+        for i in range(0, 300, 7):
+            self.server.manager(MGR_CMD_SET, NODE, {'state': 'offline'},
+                                id='vn[%d]' % i, expect=True)
+
+    def place_job(self, threads):
+        """
+        Run a job with node_eval_threads set to threads and return
+        where it ran
+        """
+        self.scheduler.set_sched_config({'node_eval_threads': threads})
+        j = Job(TEST_USER, {'Resource_List.select': '40:ncpus=1',
+                            'Resource_List.place': 'scatter'})
+        jid = self.server.submit(j)
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        execvnode = j.get_vnodes(self.server.status(JOB, 'exec_vnode',
+                                                    id=jid)[0]['exec_vnode'])
+        self.server.delete(jid, wait=True)
+        return execvnode
+
+    def test_same_placement(self):
+        """
+        Test that a job is placed on the same vnodes with and without
+        threads
+        """
+        serial = self.place_job(1)
+        threaded = self.place_job(4)
+        self.assertEqual(serial, threaded)
+        for i in range(0, 300, 7):
+            self.assertNotIn('vn[%d]' % i, threaded)
@@ -588,3 +588,151 @@ class TestServerDynRes(TestFunctional):
         job_comment += " foo (True != False)"
         a = {'job_state': 'Q', 'comment': job_comment}
         self.server.expect(JOB, a, id=jid, attrop=PTL_AND)
+
+    def test_res_timeout(self):
+        """
+        Test that a server_dyn_res script which runs longer than
+        server_dyn_res_timeout is killed along with its children, and that
+        the resource keeps the value of the script's last run
+        """
+        # Create a resource of type long
+        resname = ["foobar"]
+        restype = ["long"]
+
+        # Prep for server_dyn_resource script.  The script hangs while
+        # the file "PtlPbs_dyn_res_hang" exists, and writes the pid of
+        # its child to "PtlPbs_dyn_res_pid".
+        fpath_hang = os.path.join(os.sep, "tmp", "PtlPbs_dyn_res_hang")
+        fpath_pid = os.path.join(os.sep, "tmp", "PtlPbs_dyn_res_pid")
+        self.du.rm(path=fpath_hang, force=True, sudo=True)
+        self.du.rm(path=fpath_pid, force=True, sudo=True)
+
+        script_body = "if [ -f %s ]; then\n" % fpath_hang
+        script_body += "    sleep 30 &\n"
+        script_body += "    echo $! > %s\n" % fpath_pid
+        script_body += "    wait\n"
+        script_body += "fi\n"
+        script_body += "echo 4"
+
+        fn = self.du.create_temp_file(prefix="PtlPbs_hang",
+                                      suffix=".scr",
+                                      body=script_body)
+        self.du.chmod(path=fn, mode=0755, sudo=True)
+
+        resval = ['"' + resname[0] + ' ' + '!' + fn + '"']
+
+        self.scheduler.set_sched_config({'server_dyn_res_timeout': '2'})
+        self.setup_dyn_res(resname, restype, resval)
+
+        # Submit job
+        a = {'Resource_List.foobar': '4'}
+        j = Job(TEST_USER, attrs=a)
+        jid = self.server.submit(j)
+
+        # Job must run successfully
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.delete(jid, wait=True)
+
+        # Make the script hang from now on
+        self.du.run_cmd(cmd=['touch', fpath_hang])
+        t = int(time.time())
+
+        # Submit job
+        j = Job(TEST_USER, attrs=a)
+        jid = self.server.submit(j)
+
+        # The script is killed and the value of its last run is used
+        self.scheduler.log_match("Script %s timed out after 2 seconds" % (fn),
+                                 starttime=t)
+        self.scheduler.log_match("Using stale value of script %s" % (fn),
+                                 starttime=t)
+
+        # Job must run successfully
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+
+        # The script's child was killed with it.  It may linger as a
+        # zombie until it is reaped.
+        self.assertTrue(self.du.isfile(path=fpath_pid))
+        ret = self.du.cat(filename=fpath_pid)
+        pid = ret['out'][0].strip()
+        killed = False
+        for _ in range(10):
+            ret = self.du.run_cmd(cmd=['ps', '-o', 'stat=', '-p', pid],
+                                  logerr=False)
+            if ret['rc'] != 0 or ret['out'][0].strip().startswith('Z'):
+                killed = True
+                break
+            time.sleep(1)
+        self.assertTrue(killed)
+
+        self.du.rm(path=fpath_hang, force=True, sudo=True)
+        self.du.rm(path=fpath_pid, force=True, sudo=True)
+
+    def test_res_timeout_escaped_child(self):
+        """
+        Test that the cycle doesn't wait for a server_dyn_res script which
+        timed out when a child of the script left its process group and
+        still holds the script's output open
+        """
+        # Create a resource of type long
+        resname = ["foobar"]
+        restype = ["long"]
+
+        # Prep for server_dyn_resource script.  While the file
+        # "PtlPbs_dyn_res_hang" exists, the script starts a child in its
+        # own session which keeps the script's output open for a minute,
+        # and hangs.  The child's pid is written to "PtlPbs_dyn_res_pid".
+        fpath_hang = os.path.join(os.sep, "tmp", "PtlPbs_dyn_res_hang")
+        fpath_pid = os.path.join(os.sep, "tmp", "PtlPbs_dyn_res_pid")
+        self.du.rm(path=fpath_hang, force=True, sudo=True)
+        self.du.rm(path=fpath_pid, force=True, sudo=True)
+
+        script_body = "if [ -f %s ]; then\n" % fpath_hang
+        script_body += "    setsid sleep 60 &\n"
+        script_body += "    echo $! > %s\n" % fpath_pid
+        script_body += "    sleep 60\n"
+        script_body += "fi\n"
+        script_body += "echo 4"
+
+        fn = self.du.create_temp_file(prefix="PtlPbs_hang",
+                                      suffix=".scr",
+                                      body=script_body)
+        self.du.chmod(path=fn, mode=0755, sudo=True)
+
+        resval = ['"' + resname[0] + ' ' + '!' + fn + '"']
+
+        self.scheduler.set_sched_config({'server_dyn_res_timeout': '2'})
+        self.setup_dyn_res(resname, restype, resval)
+
+        # Submit job
+        a = {'Resource_List.foobar': '4'}
+        j = Job(TEST_USER, attrs=a)
+        jid = self.server.submit(j)
+
+        # Job must run successfully
+        self.server.expect(JOB, {'job_state': 'R'}, id=jid)
+        self.server.delete(jid, wait=True)
+
+        # Make the script hang from now on
+        self.du.run_cmd(cmd=['touch', fpath_hang])
+        t = int(time.time())
+
+        try:
+            # Submit job
+            j = Job(TEST_USER, attrs=a)
+            jid = self.server.submit(j)
+
+            # The cycle uses the value of the script's last run and
+            # finishes long before the escaped child exits
+            self.scheduler.log_match("Script %s timed out after 2 seconds"
+                                     % (fn), starttime=t)
+            self.server.expect(JOB, {'job_state': 'R'}, id=jid,
+                               max_attempts=15, interval=1)
+            self.assertLess(int(time.time()) - t, 30)
+        finally:
+            if self.du.isfile(path=fpath_pid):
+                ret = self.du.cat(filename=fpath_pid)
+                self.du.run_cmd(cmd=['kill', ret['out'][0].strip()],
+                                sudo=True, logerr=False)
+            self.du.rm(path=fpath_hang, force=True, sudo=True)
+            self.du.rm(path=fpath_pid, force=True, sudo=True)